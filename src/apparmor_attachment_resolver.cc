@@ -0,0 +1,117 @@
+#include "apparmor_attachment_resolver.hh"
+#include "parser/dfa.hh"
+#include "parser/glob.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <algorithm>
+
+AppArmor::AttachmentResolver::AttachmentResolver(const std::list<Profile> &profiles)
+{
+  for(auto &profile : profiles) {
+    auto model = profile.model();
+
+    std::string attachment = model->getAttachment();
+    if(attachment.empty() && !model->getText().empty() && model->getText()[0] == '/') {
+      attachment = model->getText();
+    }
+    if(attachment.empty()) {
+      continue;
+    }
+
+    Candidate candidate;
+    candidate.profile = model->getText();
+    candidate.attachment = attachment;
+    candidate.literal = attachment.find_first_of("*?[{") == std::string::npos;
+    candidate.prefix = globLiteralPrefix(attachment).size();
+    candidate.xattrs = model->getXattrs();
+    candidates.push_back(candidate);
+  }
+
+  std::stable_sort(candidates.begin(), candidates.end(), moreSpecific);
+
+  std::vector<std::string> patterns;
+  for(auto &candidate : candidates) {
+    patterns.push_back(candidate.attachment);
+  }
+
+  dfa = std::make_unique<Dfa>(patterns);
+  for(size_t index : dfa->getSkipped()) {
+    skipped.push_back(candidates[index].profile);
+  }
+}
+
+AppArmor::AttachmentResolver::~AttachmentResolver() = default;
+
+bool AppArmor::AttachmentResolver::moreSpecific(const Candidate &a, const Candidate &b)
+{
+  if(a.literal != b.literal) {
+    return a.literal;
+  }
+  if(a.prefix != b.prefix) {
+    return a.prefix > b.prefix;
+  }
+  return a.xattrs.size() > b.xattrs.size();
+}
+
+// Every xattr of the profile has to be present, with a value one of its globs matches
+static bool xattrsMatch(const std::map<std::string, std::vector<std::string>> &required,
+                        const std::map<std::string, std::string> &present)
+{
+  for(auto &xattr : required) {
+    auto value = present.find(xattr.first);
+    if(value == present.end()) {
+      return false;
+    }
+
+    bool matched = xattr.second.empty();
+    for(auto &glob : xattr.second) {
+      matched = matched || globContains(glob, value->second);
+    }
+    if(!matched) {
+      return false;
+    }
+  }
+  return true;
+}
+
+AppArmor::Attachment AppArmor::AttachmentResolver::resolve(const std::string &path,
+                                                           const std::map<std::string, std::string> &xattrs) const
+{
+  Attachment result;
+  const Candidate *best = nullptr;
+
+  // Accepting candidates come most specific first, so the search stops at the first one
+  // that attaches less specifically than the best match
+  for(uint32_t index : dfa->getAccepting(dfa->match(path))) {
+    auto &candidate = candidates[index];
+    if(best != nullptr && moreSpecific(*best, candidate)) {
+      break;
+    }
+    if(!xattrsMatch(candidate.xattrs, xattrs)) {
+      continue;
+    }
+
+    if(best == nullptr) {
+      best = &candidate;
+      result.profile = candidate.profile;
+      result.attachment = candidate.attachment;
+    }
+    else {
+      if(result.conflicts.empty()) {
+        result.conflicts.push_back(best->profile);
+      }
+      result.conflicts.push_back(candidate.profile);
+    }
+  }
+
+  if(!result.conflicts.empty()) {
+    result.profile.clear();
+    result.attachment.clear();
+  }
+  return result;
+}
+
+std::vector<std::string> AppArmor::AttachmentResolver::getSkipped() const
+{
+  return skipped;
+}
@@ -0,0 +1,76 @@
+#ifndef APPARMOR_ATTACHMENT_RESOLVER_HH
+#define APPARMOR_ATTACHMENT_RESOLVER_HH
+
+#include "apparmor_profile.hh"
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Dfa;
+
+namespace AppArmor {
+  // The profile the kernel would confine an executable with when it is run
+  struct Attachment {
+    // Empty when no profile attaches, or when the best ones conflict
+    std::string profile;
+
+    // The attachment glob that matched, the profile name unless one was given
+    std::string attachment;
+
+    // Profiles that attach as specifically as each other and more specifically than any other.
+    // The kernel refuses to choose between them, so the exec fails. Empty otherwise.
+    std::vector<std::string> conflicts;
+  };
+
+  // Answers "which profile would confine this binary" for the top-level profiles of a policy.
+  //
+  // A profile attaches to the paths matched by its attachment (profile name /usr/bin/foo* {),
+  // or by its name when that is a path, and only when the executable carries every extended
+  // attribute of its xattrs=(...) with a matching value. Local profiles and hats are only
+  // reached through transitions, so they never attach.
+  //
+  // As in the kernel, an attachment without globs wins over every glob. Between globs, the
+  // one with the longest literal text before its first special character wins, then the one
+  // with the most xattrs. Profiles still tied conflict.
+  //
+  // Every attachment is compiled into a single DFA, with the accepting profiles of each state
+  // kept from most to least specific, so a lookup is one pass over the path.
+  // Attachments holding a variable are not compiled, see getSkipped().
+  // The resolver does not change once built and may be shared between threads.
+  class AttachmentResolver {
+    public:
+      explicit AttachmentResolver(const std::list<Profile> &profiles);
+      ~AttachmentResolver();
+
+      // The attachment for an executable path, given the values of its extended attributes.
+      // Xattr values are matched conservatively, as globs that contain the value. When a profile
+      // lists several values for an attribute, any one of them may match.
+      Attachment resolve(const std::string &path, const std::map<std::string, std::string> &xattrs = {}) const;
+
+      // Profiles whose attachment could not be compiled
+      std::vector<std::string> getSkipped() const;
+
+    private:
+      struct Candidate {
+        std::string profile;
+        std::string attachment;
+        bool literal;
+        size_t prefix;
+        std::map<std::string, std::vector<std::string>> xattrs;
+      };
+
+      // Whether a attaches more specifically than b
+      static bool moreSpecific(const Candidate &a, const Candidate &b);
+
+      // Sorted from most to least specific, so the DFA reports them in that order
+      std::vector<Candidate> candidates;
+      std::unique_ptr<Dfa> dfa;
+      std::vector<std::string> skipped;
+  };
+}
+
+#endif // APPARMOR_ATTACHMENT_RESOLVER_HH
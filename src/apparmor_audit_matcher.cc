@@ -0,0 +1,390 @@
+#include "apparmor_audit_matcher.hh"
+#include "parser/audit_record.hh"
+#include "parser/dfa.hh"
+#include "parser/file_mode.hh"
+#include "parser/glob.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+// Bytes of the log handed to a worker at a time, cut back to the last whole line
+static constexpr size_t BLOCK_SIZE = 1 << 20;
+
+// Results of one worker, merged once the whole log has been read
+struct AuditTotals {
+  uint64_t lines = 0;
+  uint64_t allowed = 0;
+  uint64_t denied = 0;
+  uint64_t unmatched = 0;
+  uint64_t indeterminate = 0;
+  uint64_t unknownProfile = 0;
+
+  // Keyed by profile, a NUL byte, then path. Holds the missing permissions and the number of records.
+  std::unordered_map<std::string, std::pair<uint32_t, uint64_t>> suggestions;
+};
+
+// Permissions of a requested or denied mask. Creating and deleting a file need write access.
+static uint32_t auditPerms(std::string_view mask)
+{
+  uint32_t perms = 0;
+  for(char c : mask) {
+    switch(c) {
+      case 'r': perms |= FileMode::READ; break;
+      case 'w': case 'c': case 'd': perms |= FileMode::WRITE; break;
+      case 'a': perms |= FileMode::APPEND; break;
+      case 'l': perms |= FileMode::LINK; break;
+      case 'k': perms |= FileMode::LOCK; break;
+      case 'm': perms |= FileMode::MMAP; break;
+      case 'x': perms |= FileMode::EXEC; break;
+    }
+  }
+  return perms;
+}
+
+static std::string modeString(uint32_t perms)
+{
+  std::string mode;
+  if(perms & FileMode::MMAP)  mode += 'm';
+  if(perms & FileMode::READ)  mode += 'r';
+  if(perms & FileMode::WRITE) mode += 'w';
+  else if(perms & FileMode::APPEND) mode += 'a';
+  if(perms & FileMode::LINK)  mode += 'l';
+  if(perms & FileMode::LOCK)  mode += 'k';
+  if(perms & FileMode::EXEC)  mode += 'x';
+  return mode;
+}
+
+// Allow and deny rules, with the qualifiers of their enclosing blocks applied
+template<class Rule>
+static void collectRules(const RuleList<ProfileNode> &rules, const PrefixNode &outer, const std::string &abstraction,
+                         std::vector<Rule> &out, std::vector<std::string> &patterns, std::vector<std::string> &includes)
+{
+  for(auto &file : rules.getFileList()) {
+    bool deny  = outer.isDeny()  || file.getPrefix().isDeny();
+    bool owner = outer.isOwner() || file.getPrefix().isOwner();
+
+    // A bare "file," rule allows everything
+    bool bare = file.getFilename().empty();
+    uint32_t perms = FileMode(bare? "mrwlkix" : file.getFilemode()).perms;
+
+    out.push_back({AppArmor::FileRule(std::make_shared<FileNode>(file)), abstraction, perms, deny, owner});
+    patterns.push_back(bare? "/**" : file.getFilename());
+  }
+
+  for(auto &include : rules.getAbstractionList()) {
+    includes.push_back(include.getPath());
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    PrefixNode inner(outer.isAudit() || block.getPrefix().isAudit(),
+                     outer.isDeny()  || block.getPrefix().isDeny(),
+                     outer.isOwner() || block.getPrefix().isOwner());
+    collectRules(block, inner, abstraction, out, patterns, includes);
+  }
+}
+
+AppArmor::AuditMatcher::AuditMatcher(const std::list<Profile> &profiles, const std::map<std::string, Profile> &abstractions)
+{
+  std::map<std::string, std::shared_ptr<ProfileNode>> models;
+  for(auto &abstraction : abstractions) {
+    models.emplace(abstraction.first, abstraction.second.model());
+  }
+
+  for(auto &profile : profiles) {
+    auto node = profile.model();
+    compile(node->getText(), *node, models);
+  }
+}
+
+void AppArmor::AuditMatcher::compile(const std::string &name, const ProfileNode &profile,
+                                     const std::map<std::string, std::shared_ptr<ProfileNode>> &abstractions)
+{
+  CompiledProfile compiled;
+  std::vector<std::string> patterns;
+  std::vector<std::string> pending;
+
+  // The profile's own rules come first, so they are the ones reported when an abstraction also matches
+  collectRules(profile.getRules(), PrefixNode(), "", compiled.rules, patterns, pending);
+
+  std::unordered_set<std::string> included;
+  while(!pending.empty()) {
+    auto path = pending.back();
+    pending.pop_back();
+
+    auto abstraction = abstractions.find(path);
+    if(abstraction == abstractions.end() || !included.insert(path).second) {
+      continue;
+    }
+
+    collectRules(abstraction->second->getRules(), PrefixNode(), path, compiled.rules, patterns, pending);
+  }
+
+  compiled.dfa = std::make_shared<Dfa>(patterns);
+  for(size_t index : compiled.dfa->getSkipped()) {
+    std::vector<std::string> alternatives;
+    if(!expandAlternations(patterns[index], alternatives)) {
+      alternatives.clear();
+    }
+
+    compiled.skipped.emplace_back(index, std::move(alternatives));
+    skipped.push_back(compiled.rules[index].rule);
+  }
+  profiles[name] = std::move(compiled);
+
+  for(auto &subprofile : profile.getRules().getSubprofiles()) {
+    compile(name + "//" + subprofile.getText(), subprofile, abstractions);
+  }
+}
+
+AppArmor::AuditMatch::Kind AppArmor::AuditMatcher::classify(const AuditRecord &record, uint32_t &missing,
+                                                            const Rule *&rule) const
+{
+  rule = nullptr;
+
+  auto profile = profiles.find(std::string(record.profile));
+  if(profile == profiles.end()) {
+    return AuditMatch::Kind::UNKNOWN_PROFILE;
+  }
+
+  auto &dfa = *profile->second.dfa;
+  uint32_t state = Dfa::START;
+  for(char c : record.name) {
+    state = dfa.next(state, static_cast<uint8_t>(c));
+  }
+
+  bool owner = record.fsuid.empty() || record.ouid.empty() || record.fsuid == record.ouid;
+
+  const Rule *grant = nullptr;
+  const Rule *refuse = nullptr;
+  uint32_t allowed = 0;
+
+  for(uint32_t index : dfa.getAccepting(state)) {
+    auto &candidate = profile->second.rules[index];
+    if((candidate.owner && !owner) || (candidate.perms & missing) == 0) {
+      continue;
+    }
+
+    if(candidate.deny) {
+      refuse = refuse == nullptr? &candidate : refuse;
+    }
+    else {
+      allowed |= candidate.perms;
+      grant = grant == nullptr? &candidate : grant;
+    }
+  }
+
+  // Deny rules take precedence over allow rules
+  if(refuse != nullptr) {
+    rule = refuse;
+    return AuditMatch::Kind::DENIED;
+  }
+
+  // A rule that was not compiled may deny the access, or allow what no other rule does
+  uint32_t ungranted = missing & ~allowed;
+  for(auto &entry : profile->second.skipped) {
+    auto &candidate = profile->second.rules[entry.first];
+    uint32_t relevant = candidate.deny? missing : ungranted;
+    if((candidate.owner && !owner) || (candidate.perms & relevant) == 0) {
+      continue;
+    }
+
+    bool mayMatch = entry.second.empty();
+    for(auto &alternative : entry.second) {
+      mayMatch = mayMatch || globsOverlap(alternative, std::string(record.name));
+    }
+
+    if(mayMatch) {
+      rule = &candidate;
+      return AuditMatch::Kind::INDETERMINATE;
+    }
+  }
+
+  if(ungranted == 0) {
+    rule = grant;
+    return AuditMatch::Kind::ALLOWED;
+  }
+
+  missing = ungranted;
+  return AuditMatch::Kind::UNMATCHED;
+}
+
+bool AppArmor::AuditMatcher::match(const std::string &line, AuditMatch &out) const
+{
+  AuditRecord record;
+  std::string scratch;
+  if(!parseAuditRecord(line, record, scratch)) {
+    return false;
+  }
+
+  uint32_t missing = auditPerms(record.denied.empty()? record.requested : record.denied);
+  if(missing == 0) {
+    return false;
+  }
+
+  const Rule *rule;
+  out.kind = classify(record, missing, rule);
+  out.profile = std::string(record.profile);
+  out.path = std::string(record.name);
+  out.mode = modeString(missing);
+  out.rule = rule != nullptr? rule->rule : AppArmor::FileRule();
+  out.abstraction = rule != nullptr? rule->abstraction : "";
+  return true;
+}
+
+const std::list<AppArmor::FileRule> &AppArmor::AuditMatcher::getSkippedRules() const
+{
+  return skipped;
+}
+
+AppArmor::AuditSummary AppArmor::AuditMatcher::process(std::istream &log, unsigned int threads) const
+{
+  if(threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::condition_variable space;
+  std::deque<std::string> blocks;
+  bool finished = false;
+
+  std::vector<AuditTotals> totals(threads);
+  std::vector<std::thread> workers;
+
+  for(unsigned int i = 0; i < threads; i++) {
+    workers.emplace_back([&, i]() {
+      auto &own = totals[i];
+      AuditRecord record;
+      std::string scratch;
+      std::string key;
+
+      while(true) {
+        std::string block;
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          ready.wait(lock, [&]() { return finished || !blocks.empty(); });
+          if(blocks.empty()) {
+            return;
+          }
+
+          block = std::move(blocks.front());
+          blocks.pop_front();
+        }
+        space.notify_one();
+
+        std::string_view rest(block);
+        while(!rest.empty()) {
+          size_t end = rest.find('\n');
+          std::string_view line = rest.substr(0, end);
+          rest = end == std::string_view::npos? std::string_view() : rest.substr(end + 1);
+          own.lines++;
+
+          if(!parseAuditRecord(line, record, scratch)) {
+            continue;
+          }
+
+          uint32_t missing = auditPerms(record.denied.empty()? record.requested : record.denied);
+          if(missing == 0) {
+            continue;
+          }
+
+          const Rule *rule;
+          switch(classify(record, missing, rule)) {
+            case AuditMatch::Kind::ALLOWED:         own.allowed++; break;
+            case AuditMatch::Kind::DENIED:          own.denied++; break;
+            case AuditMatch::Kind::INDETERMINATE:   own.indeterminate++; break;
+            case AuditMatch::Kind::UNKNOWN_PROFILE: own.unknownProfile++; break;
+            case AuditMatch::Kind::UNMATCHED: {
+              own.unmatched++;
+
+              key.assign(record.profile);
+              key.push_back('\0');
+              key.append(record.name);
+
+              auto &suggestion = own.suggestions[key];
+              suggestion.first |= missing;
+              suggestion.second++;
+              break;
+            }
+          }
+        }
+      }
+    });
+  }
+
+  // Reads ahead of the workers by at most two blocks each, so memory stays bounded on any log size
+  std::string carry;
+  while(log) {
+    std::string block = std::move(carry);
+    carry.clear();
+
+    size_t start = block.size();
+    block.resize(start + BLOCK_SIZE);
+    log.read(&block[start], BLOCK_SIZE);
+    block.resize(start + log.gcount());
+
+    if(log) {
+      size_t cut = block.rfind('\n');
+      if(cut == std::string::npos) {
+        carry = std::move(block);
+        continue;
+      }
+
+      carry = block.substr(cut + 1);
+      block.resize(cut + 1);
+    }
+
+    if(block.empty()) {
+      continue;
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      space.wait(lock, [&]() { return blocks.size() < 2 * threads; });
+      blocks.push_back(std::move(block));
+    }
+    ready.notify_one();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+  }
+  ready.notify_all();
+
+  for(auto &worker : workers) {
+    worker.join();
+  }
+
+  AuditSummary summary;
+  std::map<std::string, std::pair<uint32_t, uint64_t>> merged;
+
+  for(auto &own : totals) {
+    summary.lines += own.lines;
+    summary.allowed += own.allowed;
+    summary.denied += own.denied;
+    summary.unmatched += own.unmatched;
+    summary.indeterminate += own.indeterminate;
+    summary.unknownProfile += own.unknownProfile;
+
+    for(auto &entry : own.suggestions) {
+      auto &suggestion = merged[entry.first];
+      suggestion.first |= entry.second.first;
+      suggestion.second += entry.second.second;
+    }
+  }
+
+  // The NUL byte sorts before any other, so the keys are ordered by profile, then path
+  for(auto &entry : merged) {
+    size_t split = entry.first.find('\0');
+    summary.suggestions.push_back({entry.first.substr(0, split), entry.first.substr(split + 1),
+                                   modeString(entry.second.first), entry.second.second});
+  }
+
+  return summary;
+}
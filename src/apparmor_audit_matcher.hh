@@ -0,0 +1,137 @@
+#ifndef APPARMOR_AUDIT_MATCHER_HH
+#define APPARMOR_AUDIT_MATCHER_HH
+
+#include "apparmor_file_rule.hh"
+#include "apparmor_profile.hh"
+
+#include <cstdint>
+#include <istream>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Dfa;
+struct AuditRecord;
+
+namespace AppArmor {
+  // The rule of the policy that covers one file access from the audit log
+  struct AuditMatch {
+    enum class Kind {
+      // An allow rule grants the access, so the policy changed after it was logged
+      ALLOWED,
+      // A deny rule refuses the access
+      DENIED,
+      // No rule covers the access, it is counted towards a suggested rule
+      UNMATCHED,
+      // A rule the matcher could not compile, such as one using a variable, may change the
+      // outcome. The rule is that one.
+      INDETERMINATE,
+      // The profile of the record is not part of the policy
+      UNKNOWN_PROFILE
+    };
+
+    Kind kind;
+
+    // Local profiles and hats are named parent//child, as in the log
+    std::string profile;
+    std::string path;
+
+    // The permissions that were refused, as the mode of a file rule
+    std::string mode;
+
+    // For ALLOWED and DENIED, the first rule that grants or refuses any of the permissions
+    AppArmor::FileRule rule;
+
+    // Include path of the abstraction that holds the rule, empty when it is in the profile itself
+    std::string abstraction;
+  };
+
+  // A rule that would allow every unmatched access to one path from one profile
+  struct AuditSuggestion {
+    std::string profile;
+    std::string path;
+    std::string mode;
+
+    // Number of records it covers
+    uint64_t count = 0;
+  };
+
+  struct AuditSummary {
+    uint64_t lines = 0;
+
+    // Lines holding an AppArmor file access record, split by how they matched
+    uint64_t allowed = 0;
+    uint64_t denied = 0;
+    uint64_t unmatched = 0;
+    uint64_t indeterminate = 0;
+    uint64_t unknownProfile = 0;
+
+    // Sorted by profile, then path
+    std::vector<AuditSuggestion> suggestions;
+  };
+
+  // Attributes the file access records of the kernel audit log (apparmor="DENIED", and
+  // apparmor="ALLOWED" from profiles in complain mode) to the rules of a policy, and collects
+  // the rules that would allow what no rule covers, as aa-logprof does.
+  //
+  // Every profile, local profiles and hats included, is compiled up front into a DFA over its
+  // file rule paths, so matching a record is one pass over its path. Lines are tokenized in
+  // place, without copying their fields. Owner rules apply when the record's fsuid matches
+  // its ouid, or when the log does not say. Rules from included abstractions are taken from
+  // the abstractions passed in, keyed by include path, as for PolicyCompiler.
+  //
+  // Rules whose path holds a variable such as @{HOME} are not compiled, since variables are not
+  // expanded. They are listed by getSkippedRules(), and a record one of them may cover is
+  // INDETERMINATE rather than allowed or unmatched.
+  //
+  // Suggested modes name the permissions that were refused. Exec is written as a bare x, the
+  // log does not say which transition (ix, px, cx or ux) the rule should take.
+  // The matcher does not change once built and may be shared between threads.
+  class AuditMatcher {
+    public:
+      AuditMatcher(const std::list<Profile> &profiles, const std::map<std::string, Profile> &abstractions = {});
+
+      // Matches one line of the log. Returns false when it holds no AppArmor file access record.
+      bool match(const std::string &line, AuditMatch &out) const;
+
+      // Matches every line of a log. Blocks of lines are handed to threads worker threads,
+      // or one per core when threads is 0, and each aggregates its own results until the end.
+      AuditSummary process(std::istream &log, unsigned int threads = 0) const;
+
+      // File rules left out of the matching, because their path could not be compiled
+      const std::list<FileRule> &getSkippedRules() const;
+
+    private:
+      struct Rule {
+        AppArmor::FileRule rule;
+        std::string abstraction;
+        uint32_t perms;
+        bool deny;
+        bool owner;
+      };
+
+      struct CompiledProfile {
+        std::shared_ptr<const Dfa> dfa;
+        std::vector<Rule> rules;
+
+        // Indexes of the rules the DFA does not hold, with the alternatives of their paths.
+        // There are none when there were too many to expand, and the rule may match any path.
+        std::vector<std::pair<size_t, std::vector<std::string>>> skipped;
+      };
+
+      void compile(const std::string &name, const ProfileNode &profile,
+                   const std::map<std::string, std::shared_ptr<ProfileNode>> &abstractions);
+
+      // Which rule of its profile covers a record. missing starts as the permissions the record
+      // asks for, and is left holding those that no rule grants. rule is null when none matched.
+      AuditMatch::Kind classify(const AuditRecord &record, uint32_t &missing, const Rule *&rule) const;
+
+      std::unordered_map<std::string, CompiledProfile> profiles;
+      std::list<FileRule> skipped;
+  };
+}
+
+#endif // APPARMOR_AUDIT_MATCHER_HH
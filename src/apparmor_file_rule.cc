@@ -1,7 +1,7 @@
 #include "apparmor_file_rule.hh"
 #include "parser/tree/FileNode.hh"
 
-AppArmor::FileRule::FileRule(std::shared_ptr<FileNode> model)
+AppArmor::FileRule::FileRule(std::shared_ptr<const FileNode> model)
   : model{model}
 {   }
 
@@ -25,8 +25,111 @@ uint64_t AppArmor::FileRule::getEndPosition() const
   return model->getStopPosition();
 }
 
+std::string AppArmor::FileRule::getExecTarget() const
+{
+  return model->getExecTarget();
+}
+
+bool AppArmor::FileRule::isAudit() const
+{
+  return model->getPrefix().isAudit();
+}
+
+bool AppArmor::FileRule::isDeny() const
+{
+  return model->getPrefix().isDeny();
+}
+
+bool AppArmor::FileRule::isOwner() const
+{
+  return model->getPrefix().isOwner();
+}
+
 bool AppArmor::FileRule::operator==(const AppArmor::FileRule& that) const
 {
   return (that.getFilename() == this->getFilename()) && 
          (that.getFilemode() == this->getFilemode());
 }
+
+AppArmor::FileRuleRef::FileRuleRef(const std::shared_ptr<const ProfileNode> *owner, const FileNode *node)
+  : owner{owner},
+    node{node}
+{   }
+
+const std::string &AppArmor::FileRuleRef::getFilename() const
+{
+  return node->getFilename();
+}
+
+const std::string &AppArmor::FileRuleRef::getFilemode() const
+{
+  return node->getFilemode();
+}
+
+uint64_t AppArmor::FileRuleRef::getStartPosition() const
+{
+  return node->getStartPosition();
+}
+
+uint64_t AppArmor::FileRuleRef::getEndPosition() const
+{
+  return node->getStopPosition();
+}
+
+AppArmor::FileRule AppArmor::FileRuleRef::toFileRule() const
+{
+  // Shares ownership of the tree rather than copying the rule out of it
+  return AppArmor::FileRule(std::shared_ptr<const FileNode>(*owner, node));
+}
+
+AppArmor::FileRuleRange::Iterator::Iterator(const std::shared_ptr<const ProfileNode> *owner,
+                                            std::list<FileNode>::const_iterator position)
+  : owner{owner},
+    position{position}
+{   }
+
+AppArmor::FileRuleRef AppArmor::FileRuleRange::Iterator::operator*() const
+{
+  return AppArmor::FileRuleRef(owner, &*position);
+}
+
+AppArmor::FileRuleRange::Iterator &AppArmor::FileRuleRange::Iterator::operator++()
+{
+  ++position;
+  return *this;
+}
+
+bool AppArmor::FileRuleRange::Iterator::operator==(const Iterator &that) const
+{
+  return position == that.position;
+}
+
+bool AppArmor::FileRuleRange::Iterator::operator!=(const Iterator &that) const
+{
+  return position != that.position;
+}
+
+AppArmor::FileRuleRange::FileRuleRange(std::shared_ptr<const ProfileNode> owner, const std::list<FileNode> *files)
+  : owner{owner},
+    files{files}
+{   }
+
+AppArmor::FileRuleRange::Iterator AppArmor::FileRuleRange::begin() const
+{
+  return files == nullptr? Iterator(&owner, {}) : Iterator(&owner, files->begin());
+}
+
+AppArmor::FileRuleRange::Iterator AppArmor::FileRuleRange::end() const
+{
+  return files == nullptr? Iterator(&owner, {}) : Iterator(&owner, files->end());
+}
+
+size_t AppArmor::FileRuleRange::size() const
+{
+  return files == nullptr? 0 : files->size();
+}
+
+bool AppArmor::FileRuleRange::empty() const
+{
+  return size() == 0;
+}
@@ -1,27 +1,104 @@
 #ifndef APPARMOR_FILE_RULE_HH
 #define APPARMOR_FILE_RULE_HH
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <list>
 #include <memory>
 #include <string>
 
 class FileNode;
+class ProfileNode;
 
 namespace AppArmor {
+  // A file rule that keeps the parsed tree it belongs to alive on its own
   class FileRule {
     public:
       FileRule() = default;
-      FileRule(std::shared_ptr<FileNode> model);
+      FileRule(std::shared_ptr<const FileNode> model);
 
       std::string getFilename() const;
       std::string getFilemode() const;
       uint64_t getStartPosition() const;
       uint64_t getEndPosition() const;
 
+      // Profile named by an exec transition ("px -> name"), empty when there is none
+      std::string getExecTarget() const;
+
+      // The audit, deny and owner qualifiers written in front of the rule
+      bool isAudit() const;
+      bool isDeny() const;
+      bool isOwner() const;
+
       // Whether or not two FileRule objects are equal
       bool operator==(const AppArmor::FileRule& that) const;
 
     private:
-      std::shared_ptr<FileNode> model;
+      std::shared_ptr<const FileNode> model;
+  };
+
+  // A file rule borrowed from a FileRuleRange, which is only a pointer into the parsed tree.
+  // Valid for as long as the range it came from, use toFileRule() to keep the rule longer.
+  class FileRuleRef {
+    public:
+      const std::string &getFilename() const;
+      const std::string &getFilemode() const;
+      uint64_t getStartPosition() const;
+      uint64_t getEndPosition() const;
+
+      AppArmor::FileRule toFileRule() const;
+
+    private:
+      friend class FileRuleRange;
+
+      FileRuleRef(const std::shared_ptr<const ProfileNode> *owner, const FileNode *node);
+
+      const std::shared_ptr<const ProfileNode> *owner;
+      const FileNode *node;
+  };
+
+  // The file rules of a profile, as returned by Profile::fileRules(). The range holds
+  // the only reference on the tree, so going through the rules copies and allocates nothing.
+  class FileRuleRange {
+    public:
+      class Iterator {
+        public:
+          using iterator_category = std::forward_iterator_tag;
+          using value_type = FileRuleRef;
+          using difference_type = std::ptrdiff_t;
+          using pointer = void;
+          using reference = FileRuleRef;
+
+          FileRuleRef operator*() const;
+          Iterator &operator++();
+          bool operator==(const Iterator &that) const;
+          bool operator!=(const Iterator &that) const;
+
+        private:
+          friend class FileRuleRange;
+
+          Iterator(const std::shared_ptr<const ProfileNode> *owner, std::list<FileNode>::const_iterator position);
+
+          const std::shared_ptr<const ProfileNode> *owner;
+          std::list<FileNode>::const_iterator position;
+      };
+
+      FileRuleRange() = default;
+
+      // Moving or copying the range leaves the handles taken from it tied to the original
+      Iterator begin() const;
+      Iterator end() const;
+      size_t size() const;
+      bool empty() const;
+
+    private:
+      friend class Profile;
+
+      FileRuleRange(std::shared_ptr<const ProfileNode> owner, const std::list<FileNode> *files);
+
+      std::shared_ptr<const ProfileNode> owner;
+      const std::list<FileNode> *files = nullptr;
   };
 }
 
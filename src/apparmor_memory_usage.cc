@@ -0,0 +1,20 @@
+#include "apparmor_memory_usage.hh"
+
+size_t AppArmor::MemoryUsage::total() const
+{
+  return profiles + subprofiles + ruleLists + files + links + abstractions + aliases + strings + other;
+}
+
+AppArmor::MemoryUsage &AppArmor::MemoryUsage::operator+=(const MemoryUsage &usage)
+{
+  profiles += usage.profiles;
+  subprofiles += usage.subprofiles;
+  ruleLists += usage.ruleLists;
+  files += usage.files;
+  links += usage.links;
+  abstractions += usage.abstractions;
+  aliases += usage.aliases;
+  strings += usage.strings;
+  other += usage.other;
+  return *this;
+}
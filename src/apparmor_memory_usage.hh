@@ -0,0 +1,28 @@
+#ifndef APPARMOR_MEMORY_USAGE_HH
+#define APPARMOR_MEMORY_USAGE_HH
+
+#include <cstddef>
+
+namespace AppArmor {
+  // Bytes held by a parsed policy, split by the kind of node that holds them.
+  // Each node is counted with the list element that stores it, and the characters of
+  // every string that does not fit in its small string buffer are counted under strings.
+  // Allocator bookkeeping (malloc headers and rounding) is not included.
+  struct MemoryUsage {
+    size_t profiles = 0;
+    size_t subprofiles = 0;
+    size_t ruleLists = 0;       // Prefixed blocks such as "audit { ... }"
+    size_t files = 0;
+    size_t links = 0;
+    size_t abstractions = 0;
+    size_t aliases = 0;
+    size_t strings = 0;
+    size_t other = 0;           // The tree root, preamble, change_profile, conditional and other rules, generic child nodes
+
+    size_t total() const;
+
+    MemoryUsage &operator+=(const MemoryUsage &usage);
+  };
+}
+
+#endif // APPARMOR_MEMORY_USAGE_HH
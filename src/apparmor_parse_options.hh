@@ -0,0 +1,63 @@
+#ifndef APPARMOR_PARSE_OPTIONS_HH
+#define APPARMOR_PARSE_OPTIONS_HH
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace AppArmor {
+  // Controls how AppArmor::Parser reads a file
+  struct ParseOptions {
+    // Kinds of rules that can be left out of the tree, combined into kinds below
+    enum Kind : uint32_t {
+      FILE           = 1 << 0,
+      LINK           = 1 << 1,
+      // include rules, in the preamble as well as in profiles
+      INCLUDE        = 1 << 2,
+      CHANGE_PROFILE = 1 << 3,
+      // Local profiles and hats
+      SUBPROFILE     = 1 << 4,
+      // Rules kept as text: capability, network, mount, dbus, signal, ptrace, unix, userns, rlimit, abi
+      GENERIC        = 1 << 5,
+      ALL            = ~uint32_t(0)
+    };
+
+    // Only pre-scan the file for profile boundaries in the constructor, and run the
+    // full parse of a profile the first time one of its accessors needs it.
+    // Syntax errors inside a profile are then reported by that accessor.
+    bool lazy = false;
+
+    // Number of threads used to parse a file with many top-level profiles.
+    // The file is split at profile boundaries, and the preamble is parsed once.
+    unsigned int threads = 1;
+
+    // Collect counters and timings, returned by Parser::getStats(). Off by default,
+    // since it reads the whole file up front and times every token. When off, the
+    // parse still tests a pointer once per token and once per reduction.
+    bool stats = false;
+
+    // Values of boolean variables, keyed by name without the $, that if rules are folded with
+    // while parsing. They take precedence over the values assigned in the file. Only the live
+    // branch of a conditional whose value is known is kept, the other one never reaches the tree.
+    std::map<std::string, bool> booleans;
+
+    // Keep every if rule with both of its branches instead, so the same profiles can be
+    // resolved for several sets of values with Profile::evaluate()
+    bool keepConditionals = false;
+
+    // Apply the alias rules of the file to the profiles: every file rule whose path starts
+    // with the source of an alias gets a copy under the target, as the kernel policy would.
+    // Off by default, so the profiles hold the rules as they are written.
+    bool applyAliases = false;
+
+    // Only build the kinds of rules listed here, such as FILE | INCLUDE for callers that only
+    // read file rules and includes. Blocks and conditionals are always kept, for the rules they hold.
+    // Other rules are still lexed and reduced, so they are checked for syntax and the scan takes
+    // as long as before: what is saved is the nodes and the strings copied into them. Leaving
+    // GENERIC out saves the most, as the lexer then stops copying every token it matches into
+    // the text that generic rules are built from, whatever other kinds are kept.
+    uint32_t kinds = ALL;
+  };
+}
+
+#endif // APPARMOR_PARSE_OPTIONS_HH
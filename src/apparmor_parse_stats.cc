@@ -0,0 +1,30 @@
+#include "apparmor_parse_stats.hh"
+
+// Start condition names are plain identifiers, so nothing needs escaping
+std::string AppArmor::ParseStats::toJson() const
+{
+  std::string json = "{";
+  json += "\"bytes_read\":" + std::to_string(bytesRead);
+
+  json += ",\"tokens\":{";
+  bool first = true;
+  for(auto &entry : tokens) {
+    json += (first? "\"" : ",\"") + entry.first + "\":" + std::to_string(entry.second);
+    first = false;
+  }
+  json += "}";
+
+  json += ",\"reductions\":" + std::to_string(reductions);
+  json += ",\"nodes\":" + std::to_string(nodes);
+  json += ",\"allocations\":" + std::to_string(allocations);
+  json += ",\"allocated_bytes\":" + std::to_string(allocatedBytes);
+
+  json += ",\"time_ns\":{";
+  json += "\"io\":" + std::to_string(ioTime.count());
+  json += ",\"lex\":" + std::to_string(lexTime.count());
+  json += ",\"parse\":" + std::to_string(parseTime.count());
+  json += ",\"conversion\":" + std::to_string(conversionTime.count());
+  json += "}}";
+
+  return json;
+}
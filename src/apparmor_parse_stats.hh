@@ -0,0 +1,54 @@
+#ifndef APPARMOR_PARSE_STATS_HH
+#define APPARMOR_PARSE_STATS_HH
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace AppArmor {
+  // Heap allocations made by the calling thread so far
+  struct AllocationCount {
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+  };
+
+  // The library does not count allocations itself, since that takes replacing the global
+  // operator new of the whole program. A program that does so can install a function
+  // returning its counts, which ParseStats then reports. Pass nullptr to remove it.
+  using AllocationCounter = AllocationCount (*)();
+  void setAllocationCounter(AllocationCounter counter);
+
+  // Counters and timings collected by AppArmor::Parser when ParseOptions::stats is set.
+  // Lexing and grammar counters only cover the default single-threaded parse,
+  // since lazy and parallel parses do their work elsewhere.
+  struct ParseStats {
+    uint64_t bytesRead = 0;
+
+    // Tokens returned by the lexer, keyed by the start condition it was in (INITIAL, DBUS_MODE, ...)
+    std::map<std::string, uint64_t> tokens;
+
+    // Grammar rules reduced by the parser
+    uint64_t reductions = 0;
+
+    // Nodes in the finished tree: profiles, rule lists, rules, includes and aliases
+    uint64_t nodes = 0;
+
+    // Heap allocations made while parsing, as reported by the function passed to
+    // setAllocationCounter. Zero when none was installed.
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+
+    // Reading the file, inside the lexer, in the parser apart from the lexer,
+    // and building the profile list from the tree (initializeProfileList)
+    std::chrono::nanoseconds ioTime{0};
+    std::chrono::nanoseconds lexTime{0};
+    std::chrono::nanoseconds parseTime{0};
+    std::chrono::nanoseconds conversionTime{0};
+
+    // A single JSON object, with times in nanoseconds
+    std::string toJson() const;
+  };
+}
+
+#endif // APPARMOR_PARSE_STATS_HH
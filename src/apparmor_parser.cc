@@ -1,11 +1,18 @@
 #include "apparmor_parser.hh"
+#include "parser/alias_trie.hh"
+#include "parser/alloc_counter.hh"
 #include "parser/driver.hh"
-#include "parser/lexer.hh"
+#include "parser/lazy_profile.hh"
+#include "parser/parallel_parse.hh"
+#include "parser/prescan.hh"
+#include "parser/profile_writer.hh"
 #include "parser/tree/ParseTree.hh"
 
+#include <chrono>
 #include <iostream>
 #include <memory>
-#include <parser_yacc.hh>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <iostream>
 #include <fstream>
@@ -17,30 +24,240 @@
  * Create ofstream within remove function
 */
 AppArmor::Parser::Parser(std::string path)
+  : Parser(path, ParseOptions())
+{   }
+
+AppArmor::Parser::Parser(std::string path, const ParseOptions &options)
+  : path{path},
+    options{options}
 {
-    Driver driver;
-    std::ifstream stream;
-    stream.open(path);
-    Lexer lexer(stream, std::cout);
+    if(options.stats) {
+        parseWithStats();
+        return;
+    }
+
+    if(options.lazy) {
+        initializeLazyProfileList();
+        return;
+    }
 
-    yy::parser parse(lexer, driver);
-    parse();
+    if(options.threads > 1) {
+        Driver settings;
+        configure(settings);
 
-    if(!driver.success) {
-        std::throw_with_nested(std::runtime_error("error occured when parsing profile"));
+        auto source = readFile(path);
+        initializeProfileList(parseParallel(*source, options.threads, settings.context, settings.keep_conditionals, settings.kinds));
+        return;
     }
 
+    Driver driver;
+    configure(driver);
+    parse(path, driver);
     initializeProfileList(driver.ast);
 }
 
+// Hands the values of ParseOptions that change the tree to a driver
+void AppArmor::Parser::configure(Driver &driver) const
+{
+    configure(options, driver);
+}
+
+void AppArmor::Parser::configure(const ParseOptions &options, Driver &driver)
+{
+    driver.context.booleans = options.booleans;
+    driver.keep_conditionals = options.keepConditionals;
+    driver.kinds = options.kinds;
+}
+
+static uint64_t countNodes(const RuleList<ProfileNode> &rules)
+{
+    uint64_t nodes = 1 + rules.getFileList().size() + rules.getLinkList().size() + rules.getAbstractionList().size() +
+                     rules.getChangeProfileList().size() + rules.getGenericRuleList().size();
+
+    for(auto &block : rules.getRuleList()) {
+        nodes += countNodes(block);
+    }
+
+    for(auto &conditional : rules.getConditionalList()) {
+        nodes += 1 + countNodes(conditional.getThen()) + countNodes(conditional.getElse());
+    }
+
+    for(auto &subprofile : rules.getSubprofiles()) {
+        nodes += 1 + countNodes(subprofile.getRules());
+    }
+
+    return nodes;
+}
+
+// The same parse as the constructor, kept apart so the default path carries no timing code
+void AppArmor::Parser::parseWithStats()
+{
+    using clock = std::chrono::steady_clock;
+
+    auto allocations = allocationCount();
+
+    // Read the whole file first, so that I/O is not counted as lexing
+    auto start = clock::now();
+    auto source = readFile(path);
+    stats.ioTime = clock::now() - start;
+    stats.bytesRead = source->size();
+
+    std::shared_ptr<ParseTree> ast;
+    if(options.lazy) {
+        start = clock::now();
+        initializeLazyProfileList(source);
+        stats.conversionTime = clock::now() - start;
+    }
+    else {
+        if(options.threads > 1) {
+            Driver settings;
+            configure(settings);
+
+            start = clock::now();
+            ast = parseParallel(*source, options.threads, settings.context, settings.keep_conditionals, settings.kinds);
+            stats.parseTime = clock::now() - start;
+        }
+        else {
+            std::istringstream stream(*source);
+            Driver driver;
+            configure(driver);
+            driver.stats = &stats;
+            driver.parse(stream);
+            ast = driver.ast;
+        }
+
+        start = clock::now();
+        initializeProfileList(ast);
+        stats.conversionTime = clock::now() - start;
+
+        stats.nodes = ast->preamble.getAbstractionList().size() + ast->preamble.getAliasList().size();
+        for(auto &profile : *ast->profileList) {
+            stats.nodes += 1 + countNodes(profile.getRules());
+        }
+    }
+
+    auto allocated = allocationCount();
+    stats.allocations = allocated.allocations - allocations.allocations;
+    stats.allocatedBytes = allocated.bytes - allocations.bytes;
+}
+
+const AppArmor::ParseStats &AppArmor::Parser::getStats() const
+{
+    return stats;
+}
+
+void AppArmor::Parser::stream(const std::string &path, AppArmor::Visitor &visitor)
+{
+    Driver driver;
+    driver.visitor = &visitor;
+    parse(path, driver);
+}
+
+void AppArmor::Parser::stream(const std::string &path, const ParseOptions &options,
+                              const std::function<void(AppArmor::Profile)> &callback)
+{
+    Driver driver;
+    configure(options, driver);
+
+    // Built from the preamble when the first profile is reached
+    std::unique_ptr<AliasTrie> aliases;
+    bool preambleRead = false;
+
+    driver.on_profile = [&](ProfileNode &node) {
+        if(!preambleRead) {
+            if(options.applyAliases && !driver.preamble.getAliasList().empty()) {
+                aliases = std::make_unique<AliasTrie>(driver.preamble.getAliasList());
+            }
+            preambleRead = true;
+        }
+
+        // Moved out of the parser stack, so the profile is only held by the callback from here on
+        auto model = aliases? std::make_shared<ProfileNode>(aliases->apply(node))
+                            : std::make_shared<ProfileNode>(std::move(node));
+        callback(Profile(model));
+    };
+
+    std::ifstream stream(path);
+    if(!stream) {
+        throw std::runtime_error("could not open profile: " + path);
+    }
+    driver.parse(stream);
+}
+
+void AppArmor::Parser::parse(const std::string &path, Driver &driver)
+{
+    std::ifstream stream;
+    stream.open(path);
+    driver.parse(stream);
+}
+
 void AppArmor::Parser::initializeProfileList(std::shared_ptr<ParseTree> ast)
 {
+    this->ast = ast;
     profile_list = std::list<Profile>();
     
+    std::unique_ptr<AliasTrie> aliases;
+    if(options.applyAliases && !ast->preamble.getAliasList().empty()) {
+        aliases = std::make_unique<AliasTrie>(ast->preamble.getAliasList());
+    }
+
+    // Every profile shares ownership of the tree rather than being copied out of it
     auto astList = ast->profileList;
-    for (auto prof_iter = astList->begin(); prof_iter != astList->end(); prof_iter++){
-        std::shared_ptr<ProfileNode> node = std::make_shared<ProfileNode>(*prof_iter);
-        Profile profile(node);
+    for(auto prof_iter = astList->begin(); prof_iter != astList->end(); prof_iter++){
+        if(aliases) {
+            *prof_iter = aliases->apply(*prof_iter);
+        }
+
+        Profile profile(std::shared_ptr<ProfileNode>(ast, &*prof_iter));
+        profile_list.push_back(profile);
+    }
+}
+
+std::shared_ptr<const std::string> AppArmor::Parser::readFile(const std::string &path)
+{
+    std::ifstream stream(path);
+    if(!stream) {
+        throw std::runtime_error("could not open profile: " + path);
+    }
+
+    std::ostringstream contents;
+    contents << stream.rdbuf();
+    return std::make_shared<const std::string>(contents.str());
+}
+
+void AppArmor::Parser::initializeLazyProfileList()
+{
+    initializeLazyProfileList(readFile(path));
+}
+
+void AppArmor::Parser::initializeLazyProfileList(std::shared_ptr<const std::string> source)
+{
+    profile_list = std::list<Profile>();
+
+    auto scan = prescan(*source);
+
+    // Profiles are parsed without the preamble, so its variables and aliases are read up front
+    // and handed to each of them. Left out when neither is needed.
+    std::shared_ptr<const EvaluationContext> context;
+    std::shared_ptr<const AliasTrie> aliases;
+    if(!options.keepConditionals || options.applyAliases) {
+        Driver preamble;
+        configure(preamble);
+
+        std::istringstream stream(source->substr(0, scan.preambleStop));
+        preamble.parse(stream);
+
+        if(!options.keepConditionals) {
+            context = std::make_shared<const EvaluationContext>(preamble.context);
+        }
+
+        if(options.applyAliases && !preamble.ast->preamble.getAliasList().empty()) {
+            aliases = std::make_shared<const AliasTrie>(preamble.ast->preamble.getAliasList());
+        }
+    }
+
+    for(auto &range : scan.profiles) {
+        Profile profile(std::make_shared<LazyProfile>(source, range, context, aliases, options.kinds));
         profile_list.push_back(profile);
     }
 }
@@ -50,122 +267,125 @@ std::list<AppArmor::Profile> AppArmor::Parser::getProfileList() const
     return profile_list;
 }
 
+// Calls back with every line of the text without its newline, along with the offset
+// where the line starts and the offset just past its newline
+template <typename Function>
+static void forEachLine(const std::string &text, Function function)
+{
+    size_t lineStart = 0;
+    while (lineStart < text.size()) {
+        size_t newline = text.find('\n', lineStart);
+        size_t lineStop = (newline == std::string::npos)? text.size() : newline;
+        size_t nextLine = (newline == std::string::npos)? text.size() : newline + 1;
+
+        function(text.substr(lineStart, lineStop - lineStart), lineStart, nextLine);
+        lineStart = nextLine;
+    }
+}
+
+std::string AppArmor::Parser::format() const
+{
+    // Writing out a tree that lacks rules would silently drop them from the policy
+    if(ast == nullptr) {
+        throw std::logic_error("format() needs the whole tree, which a lazy parse does not build");
+    }
+    if(options.kinds != ParseOptions::ALL) {
+        throw std::logic_error("format() needs every kind of rule, but the parse left some out");
+    }
+    if(options.applyAliases) {
+        throw std::logic_error("format() writes the rules as parsed, but aliases were applied to them");
+    }
+
+    ProfileWriter writer(ProfileWriter::Mode::CANONICAL);
+    writer.write(*ast);
+    return writer.str();
+}
+
 AppArmor::Parser AppArmor::Parser::removeRule(AppArmor::Profile profile, AppArmor::FileRule fileRule) 
 {
-    std::string line {};
     std::string profileName = profile.name();
     std::string removeRule = fileRule.getFilename() + " " + fileRule.getFilemode() + ",";
 
-    std::ifstream file;
-    std::ofstream temp;
     bool foundProfile = false, removed = false;
-    
-    // Open the file we are working with and create a new temp file to write to.
-    file.open(path);
-    temp.open("temp.txt");
 
-    // Write each line except the one we are replacing.
+    auto source = readFile(path);
+    ProfileWriter writer(ProfileWriter::Mode::PRESERVING, source);
+
+    // Drop the line holding the rule, everything else is kept byte for byte.
     // Flags used to make sure we don't delete multiple similar rules in different profiles.
-    while (getline(file, line)) {
+    forEachLine(*source, [&](const std::string &line, size_t lineStart, size_t nextLine) {
         if(!foundProfile && !removed && (line == (profileName + " {") || line == ("profile " + profileName + " {")))
             foundProfile = true;
-        
+
         if (foundProfile && !removed && trim(line) == removeRule){
+            writer.erase(lineStart, nextLine);
             removed = true;
-            continue;
-        }else{
-            temp << line << std::endl;
         }
-    }
-
-    temp.close();
-    file.close();
+    });
 
-    // Delete original file and rename new file to old one.
-    std::remove(path.c_str());
-    std::rename("temp.txt", path.c_str());
+    // The whole file is written at once, replacing the original
+    writer.writeSource();
+    writer.save(path);
 
-    AppArmor::Parser parser(path);
+    AppArmor::Parser parser(path, options);
     return parser;
 }
 
 AppArmor::Parser AppArmor::Parser::addRule(AppArmor::Profile profile, const std::string& fileRule, std::string& fileMode)
 {
-    std::string line {};
     std::string profileName = profile.name();
-    std::string addRule = "  " + fileRule + " " + fileMode + ",";
+    std::string addRule = "  " + fileRule + " " + fileMode + ",\n";
 
-    std::ifstream file;
-    std::ofstream temp;
     bool foundProfile = false, added = false;
 
-    file.open(path);
-    temp.open("temp.txt");
+    auto source = readFile(path);
+    ProfileWriter writer(ProfileWriter::Mode::PRESERVING, source);
 
-    while(getline(file, line)){
+    // Insert the rule in front of the closing brace of the profile
+    forEachLine(*source, [&](const std::string &line, size_t lineStart, size_t) {
         if(!foundProfile && !added && (line == (profileName + " {") || line == ("profile " + profileName + " {")))
             foundProfile = true;
-        
+
         if (foundProfile && !added && (line == "}")){
+            writer.insert(lineStart, addRule);
             added = true;
-            temp << addRule << std::endl;
-            temp << "}" << std::endl;
-            continue;
-        }else{
-            temp << line << std::endl;
         }
-    }
-
-    temp.close();
-    file.close();
+    });
 
-    // Delete original file and rename new file to old one.
-    std::remove(path.c_str());
-    std::rename("temp.txt", path.c_str());
+    writer.writeSource();
+    writer.save(path);
 
-    AppArmor::Parser parser(path);
+    AppArmor::Parser parser(path, options);
     return parser;
 }
 
 // What should this do if old version of rule not found?
 AppArmor::Parser AppArmor::Parser::editRule(AppArmor::Profile profile, AppArmor::FileRule oldFileRule, const std::string& newFileRule, const std::string& newFileMode) {
     
-    std::string line {};
     std::string profileName = profile.name();
     std::string uneditedRule = oldFileRule.getFilename() + " " + oldFileRule.getFilemode() + ",";
     std::string editedRule = "  " + newFileRule + " " + newFileMode + ",";
 
-    std::ifstream file;
-    std::ofstream temp;
     bool foundProfile = false, edited = false;
 
-    // Open the file we are working with and create a new temp file to write to.
-    file.open(path);
-    temp.open("temp.txt");
+    auto source = readFile(path);
+    ProfileWriter writer(ProfileWriter::Mode::PRESERVING, source);
 
-    // Write each line except for the old/unedited rule.
-    // Write the edited version in its place.
-    while (getline(file, line)) {
+    // Replace the old/unedited rule with the edited version, keeping the rest of the line ending
+    forEachLine(*source, [&](const std::string &line, size_t lineStart, size_t) {
         if(!foundProfile && !edited && (line == (profileName + " {") || line == ("profile " + profileName + " {")))
             foundProfile = true;
-        
+
         if (foundProfile && !edited && trim(line) == uneditedRule){
-            temp << editedRule << std::endl;
+            writer.replace(lineStart, lineStart + line.size(), editedRule);
             edited = true;
-            continue;
-        }else{
-            temp << line << std::endl;
         }
-    }
-
-    temp.close();
-    file.close();
+    });
 
-    // Delete original file and rename new file to old one.
-    std::remove(path.c_str());
-    std::rename("temp.txt", path.c_str());
+    writer.writeSource();
+    writer.save(path);
 
-    AppArmor::Parser parser(path);
+    AppArmor::Parser parser(path, options);
     return parser;
 
 }
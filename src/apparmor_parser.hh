@@ -1,30 +1,71 @@
 #ifndef APPARMOR_PARSER_HH
 #define APPARMOR_PARSER_HH
 
+#include "apparmor_parse_options.hh"
+#include "apparmor_parse_stats.hh"
 #include "apparmor_profile.hh"
+#include "apparmor_visitor.hh"
 
 #include <fstream>
+#include <functional>
 #include <list>
+#include <memory>
 #include <string>
 
 std::string trim(const std::string& str);
 
+class Driver;
 class ParseTree;
 
 namespace AppArmor {
   class Parser {
     public:
       Parser(std::string path);
+      Parser(std::string path, const ParseOptions &options);
+
+      // Parses the file and reports every profile and rule to the visitor as it is reduced.
+      // No ParseTree is built, so memory use does not grow with the size of the file.
+      static void stream(const std::string &path, AppArmor::Visitor &visitor);
+
+      // Parses the file and hands every top-level profile to the callback as soon as its closing
+      // brace is read. The file is read in chunks and a profile is freed once the callback lets
+      // go of it, so memory use is bounded by the largest profile rather than the whole file.
+      // Variables and aliases of the preamble are applied as in the constructor. The lazy, threads
+      // and stats options do not apply. On a syntax error, the profiles before it have already
+      // been handed out when std::runtime_error is thrown.
+      static void stream(const std::string &path, const ParseOptions &options,
+                         const std::function<void(AppArmor::Profile)> &callback);
 
       std::list<Profile> getProfileList() const;
+
+      // Counters and timings of the parse in the constructor, if ParseOptions::stats was set
+      const ParseStats &getStats() const;
+
+      // Returns the policy in canonical form, with a normalized layout and rule order, written from
+      // the tree built in the constructor. Comments are dropped. Throws std::logic_error when the
+      // tree does not hold the policy as written: after a lazy parse, with ParseOptions::kinds
+      // leaving rules out or with ParseOptions::applyAliases.
+      std::string format() const;
+
       AppArmor::Parser removeRule(AppArmor::Profile profile, AppArmor::FileRule fileRule);
       AppArmor::Parser addRule(AppArmor::Profile profile, const std::string& fileRule, std::string& fileMode);
       AppArmor::Parser AppArmor::Parser::editRule(AppArmor::Profile profile, AppArmor::FileRule oldFileRule,
                                                   const std::string& newFileRule, const std::string& newFileMode);
 
     private:
+      static void parse(const std::string &path, Driver &driver);
+      void configure(Driver &driver) const;
+      static void configure(const ParseOptions &options, Driver &driver);
+      static std::shared_ptr<const std::string> readFile(const std::string &path);
       void initializeProfileList(std::shared_ptr<ParseTree> ast);
+      void initializeLazyProfileList();
+      void initializeLazyProfileList(std::shared_ptr<const std::string> source);
+      void parseWithStats();
       std::string path;
+      ParseOptions options;
+      ParseStats stats;
+      // The tree the profiles point into, kept for format(). Not set by a lazy parse.
+      std::shared_ptr<ParseTree> ast;
       std::list<Profile> profile_list; 
   };
 }
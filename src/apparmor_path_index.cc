@@ -0,0 +1,253 @@
+#include "apparmor_path_index.hh"
+#include "parser/file_mode.hh"
+#include "parser/glob.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <unordered_set>
+
+// File rules with the qualifiers of their enclosing blocks applied, deny rules included
+static void collectRules(const RuleList<ProfileNode> &rules, const PrefixNode &outer, const std::string &abstraction,
+                         std::vector<std::pair<std::shared_ptr<FileNode>, std::string>> &out,
+                         std::vector<std::string> &includes)
+{
+  for(auto &file : rules.getFileList()) {
+    auto node = std::make_shared<FileNode>(file);
+    node->setPrefix(PrefixNode(outer.isAudit() || file.getPrefix().isAudit(),
+                               outer.isDeny()  || file.getPrefix().isDeny(),
+                               outer.isOwner() || file.getPrefix().isOwner()));
+    out.emplace_back(node, abstraction);
+  }
+
+  for(auto &include : rules.getAbstractionList()) {
+    includes.push_back(include.getPath());
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    PrefixNode inner(outer.isAudit() || block.getPrefix().isAudit(),
+                     outer.isDeny()  || block.getPrefix().isDeny(),
+                     outer.isOwner() || block.getPrefix().isOwner());
+    collectRules(block, inner, abstraction, out, includes);
+  }
+}
+
+AppArmor::PathIndex::PathIndex(const std::list<Profile> &profiles, const std::map<std::string, Profile> &abstractions)
+  : abstractions{abstractions}
+{
+  for(auto &profile : profiles) {
+    update(profile);
+  }
+}
+
+void AppArmor::PathIndex::update(const Profile &profile)
+{
+  auto model = profile.model();
+  remove(model->getText());
+  add(model->getText(), *model);
+}
+
+void AppArmor::PathIndex::remove(const std::string &name)
+{
+  std::vector<uint32_t> dropped;
+  for(auto &entry : ids) {
+    if(entry.first == name || entry.first.compare(0, name.size() + 2, name + "//") == 0) {
+      dropped.push_back(entry.second);
+    }
+  }
+
+  for(uint32_t id : dropped) {
+    drop(id);
+  }
+}
+
+void AppArmor::PathIndex::updateAbstraction(const std::string &include, const Profile &abstraction)
+{
+  abstractions.insert_or_assign(include, abstraction);
+}
+
+void AppArmor::PathIndex::removeAbstraction(const std::string &include)
+{
+  abstractions.erase(include);
+}
+
+void AppArmor::PathIndex::drop(uint32_t id)
+{
+  auto &profile = profiles[id];
+
+  for(auto &key : profile.keys) {
+    auto entry = postings.find(key);
+    if(entry == postings.end()) {
+      continue;
+    }
+
+    auto &list = entry->second;
+    list.erase(std::remove_if(list.begin(), list.end(), [id](const Posting &posting) { return posting.profile == id; }),
+               list.end());
+    if(list.empty()) {
+      postings.erase(entry);
+    }
+  }
+
+  profile.rules.clear();
+  profile.denies.clear();
+  profile.keys.clear();
+  profile.live = false;
+}
+
+void AppArmor::PathIndex::add(const std::string &name, const ProfileNode &node)
+{
+  // The id of a profile is kept when it is indexed again, its old postings are gone by now
+  auto found = ids.emplace(name, profiles.size());
+  if(found.second) {
+    profiles.emplace_back();
+  }
+
+  uint32_t id = found.first->second;
+  auto &profile = profiles[id];
+  profile.name = name;
+  profile.live = true;
+
+  std::vector<std::pair<std::shared_ptr<FileNode>, std::string>> rules;
+  std::vector<std::string> pending;
+  collectRules(node.getRules(), PrefixNode(), "", rules, pending);
+
+  std::unordered_set<std::string> included;
+  while(!pending.empty()) {
+    auto path = pending.back();
+    pending.pop_back();
+
+    auto abstraction = abstractions.find(path);
+    if(abstraction == abstractions.end() || !included.insert(path).second) {
+      continue;
+    }
+
+    collectRules(abstraction->second.model()->getRules(), PrefixNode(), path, rules, pending);
+  }
+
+  std::set<std::string> keys;
+  for(auto &entry : rules) {
+    // A bare "file," rule covers everything
+    uint32_t perms = FileMode(entry.first->getFilemode()).perms;
+    std::vector<std::string> alternatives;
+    if(entry.first->getFilename().empty()) {
+      perms = FileMode("mrwlkix").perms;
+      alternatives.push_back("/**");
+    }
+    else {
+      expandAlternations(entry.first->getFilename(), alternatives);
+    }
+
+    bool owner = entry.first->getPrefix().isOwner();
+    if(entry.first->getPrefix().isDeny()) {
+      profile.denies.push_back({perms, owner, std::move(alternatives)});
+      continue;
+    }
+
+    IndexedRule rule{AppArmor::FileRule(entry.first), entry.second, perms, owner, std::move(alternatives)};
+
+    uint32_t index = profile.rules.size();
+    for(uint32_t alternative = 0; alternative < rule.alternatives.size(); alternative++) {
+      auto key = globLiteralPrefix(rule.alternatives[alternative]);
+      postings[key].push_back({id, index, alternative});
+      keys.insert(key);
+    }
+
+    profile.rules.push_back(std::move(rule));
+  }
+  profile.keys.assign(keys.begin(), keys.end());
+
+  // Last, since adding them may move the profile within the vector
+  for(auto &subprofile : node.getRules().getSubprofiles()) {
+    add(name + "//" + subprofile.getText(), subprofile);
+  }
+}
+
+std::vector<AppArmor::PathMatch> AppArmor::PathIndex::query(const std::string &pattern, const std::string &mode) const
+{
+  uint32_t wanted = mode.empty()? ~uint32_t(0) : FileMode(mode).perms;
+
+  std::set<std::pair<uint32_t, uint32_t>> matched;
+  auto check = [&](const std::string &path, const std::vector<Posting> &list) {
+    for(auto &posting : list) {
+      auto &profile = profiles[posting.profile];
+      auto &rule = profile.rules[posting.rule];
+      auto &alternative = rule.alternatives[posting.alternative];
+      if((rule.perms & wanted) == 0 || !globsOverlap(alternative, path)) {
+        continue;
+      }
+
+      // Permissions a deny rule takes back on every path both the query and the rule match
+      uint32_t denied = 0;
+      for(auto &deny : profile.denies) {
+        if(deny.owner && !rule.owner) {
+          continue;
+        }
+
+        for(auto &pattern : deny.alternatives) {
+          if(globContains(pattern, path) || globContains(pattern, alternative)) {
+            denied |= deny.perms;
+            break;
+          }
+        }
+      }
+
+      if((rule.perms & wanted & ~denied) != 0) {
+        matched.emplace(posting.profile, posting.rule);
+      }
+    }
+  };
+
+  std::vector<std::string> paths;
+  expandAlternations(pattern, paths);
+
+  for(auto &path : paths) {
+    auto prefix = globLiteralPrefix(path);
+
+    // Rules whose prefix extends the one of the query
+    for(auto entry = postings.lower_bound(prefix);
+        entry != postings.end() && entry->first.compare(0, prefix.size(), prefix) == 0; entry++) {
+      check(path, entry->second);
+    }
+
+    // Rules whose prefix is a shorter prefix of it
+    for(size_t length = 0; length < prefix.size(); length++) {
+      auto entry = postings.find(prefix.substr(0, length));
+      if(entry != postings.end()) {
+        check(path, entry->second);
+      }
+    }
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> order(matched.begin(), matched.end());
+  std::sort(order.begin(), order.end(), [this](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b) {
+    auto &first = profiles[a.first];
+    auto &second = profiles[b.first];
+    if(first.name != second.name) {
+      return first.name < second.name;
+    }
+    return first.rules[a.second].rule.getStartPosition() < second.rules[b.second].rule.getStartPosition();
+  });
+
+  std::vector<PathMatch> out;
+  for(auto &match : order) {
+    auto &profile = profiles[match.first];
+    auto &rule = profile.rules[match.second];
+    out.push_back({profile.name, rule.rule, rule.abstraction});
+  }
+  return out;
+}
+
+std::vector<std::string> AppArmor::PathIndex::getProfiles() const
+{
+  std::vector<std::string> out;
+  for(auto &profile : profiles) {
+    if(profile.live) {
+      out.push_back(profile.name);
+    }
+  }
+
+  std::sort(out.begin(), out.end());
+  return out;
+}
@@ -0,0 +1,110 @@
+#ifndef APPARMOR_PATH_INDEX_HH
+#define APPARMOR_PATH_INDEX_HH
+
+#include "apparmor_file_rule.hh"
+#include "apparmor_profile.hh"
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace AppArmor {
+  // A file rule that may grant access to some of the paths of a query
+  struct PathMatch {
+    // Local profiles and hats are named parent//child
+    std::string profile;
+
+    // The rule with the qualifiers of its enclosing blocks applied
+    AppArmor::FileRule rule;
+
+    // Include path of the abstraction that holds the rule, empty when it is in the profile itself
+    std::string abstraction;
+  };
+
+  // Maps the paths of the file rules of a whole policy to the profiles that hold them,
+  // to answer questions such as "which profiles may write under /etc/**?" without
+  // going through every rule of every profile.
+  //
+  // Rules are indexed by the literal prefix of each of their globs, so a query only looks
+  // at the rules whose prefix extends its own, or is a prefix of it. Those are then compared
+  // glob to glob, and only reported when some path is matched by both. Variables are not
+  // expanded and taken to match anything, so a match means the rule may grant access.
+  //
+  // Deny rules are not reported. They take their permissions away from a rule when a single
+  // deny glob covers the query or the rule, an owner deny only from owner rules. Paths that
+  // are only denied by several deny rules together are still reported.
+  //
+  // Rules from included abstractions are taken from the abstractions passed in, keyed by
+  // include path, as for RuleAnalysis.
+  // Build the index once per policy snapshot and update it as single profiles are parsed again.
+  class PathIndex {
+    public:
+      PathIndex(const std::list<Profile> &profiles, const std::map<std::string, Profile> &abstractions = {});
+
+      // Rules that may grant any of the permissions of mode (such as "w") on a path matched
+      // by pattern, or any permission when mode is empty. Sorted by profile, then position.
+      std::vector<PathMatch> query(const std::string &pattern, const std::string &mode = "") const;
+
+      // Indexes a profile again, with its local profiles and hats, replacing the rules it had.
+      // A profile that was not indexed yet is added.
+      void update(const Profile &profile);
+
+      // Drops a profile along with its local profiles and hats
+      void remove(const std::string &name);
+
+      // Replaces, adds or drops the abstraction kept under an include path. Profiles that
+      // include it keep the rules they were indexed with until they are updated.
+      void updateAbstraction(const std::string &include, const Profile &abstraction);
+      void removeAbstraction(const std::string &include);
+
+      // Names of the indexed profiles, local ones included
+      std::vector<std::string> getProfiles() const;
+
+    private:
+      struct IndexedRule {
+        AppArmor::FileRule rule;
+        std::string abstraction;
+        uint32_t perms;
+        bool owner;
+        std::vector<std::string> alternatives;
+      };
+
+      struct DenyRule {
+        uint32_t perms;
+        bool owner;
+        std::vector<std::string> alternatives;
+      };
+
+      struct IndexedProfile {
+        std::string name;
+        std::vector<IndexedRule> rules;
+        std::vector<DenyRule> denies;
+
+        // Prefixes the rules are indexed under, to find them again on update
+        std::vector<std::string> keys;
+        bool live = false;
+      };
+
+      struct Posting {
+        uint32_t profile;
+        uint32_t rule;
+        uint32_t alternative;
+      };
+
+      void add(const std::string &name, const ProfileNode &profile);
+      void drop(uint32_t id);
+
+      std::map<std::string, Profile> abstractions;
+
+      std::vector<IndexedProfile> profiles;
+      std::unordered_map<std::string, uint32_t> ids;
+
+      // Sorted, so the prefixes that extend another one are a contiguous range
+      std::map<std::string, std::vector<Posting>> postings;
+  };
+}
+
+#endif // APPARMOR_PATH_INDEX_HH
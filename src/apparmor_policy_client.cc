@@ -0,0 +1,115 @@
+#include "apparmor_policy_client.hh"
+#include "parser/policy_protocol.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using PolicyProtocol::Request;
+using PolicyProtocol::Status;
+
+AppArmor::PolicyClient::PolicyClient(const std::string &socketPath)
+{
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+
+  if(socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("invalid socket path: " + socketPath);
+  }
+  std::copy(socketPath.begin(), socketPath.end(), address.sun_path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd < 0 || connect(fd, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)) != 0) {
+    int error = errno;
+    if(fd >= 0) {
+      close(fd);
+    }
+    throw std::runtime_error("could not connect to " + socketPath + ": " + std::strerror(error));
+  }
+}
+
+AppArmor::PolicyClient::~PolicyClient()
+{
+  close(fd);
+}
+
+// Sends a request and returns the body of the response, after its status
+std::string AppArmor::PolicyClient::call(const std::string &request)
+{
+  std::string response;
+  if(!PolicyProtocol::sendMessage(fd, request) || !PolicyProtocol::receiveMessage(fd, response)) {
+    throw std::runtime_error("lost connection to the policy daemon");
+  }
+
+  PolicyProtocol::Reader in(response);
+  if(static_cast<Status>(in.u8()) != Status::OK) {
+    throw std::runtime_error(in.str());
+  }
+
+  return response.substr(1);
+}
+
+uint64_t AppArmor::PolicyClient::getGeneration()
+{
+  PolicyProtocol::Writer request;
+  request.u8(static_cast<uint8_t>(Request::GENERATION));
+
+  auto response = call(request.data());
+  return PolicyProtocol::Reader(response).u64();
+}
+
+std::vector<std::string> AppArmor::PolicyClient::getProfiles()
+{
+  PolicyProtocol::Writer request;
+  request.u8(static_cast<uint8_t>(Request::PROFILES));
+
+  auto response = call(request.data());
+  PolicyProtocol::Reader in(response);
+
+  std::vector<std::string> profiles;
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    profiles.push_back(in.str());
+  }
+  return profiles;
+}
+
+std::list<AppArmor::FileRule> AppArmor::PolicyClient::getFileRules(const std::string &profile)
+{
+  PolicyProtocol::Writer request;
+  request.u8(static_cast<uint8_t>(Request::RULES));
+  request.str(profile);
+
+  auto response = call(request.data());
+  PolicyProtocol::Reader in(response);
+
+  std::list<AppArmor::FileRule> rules;
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    rules.push_back(PolicyProtocol::readRule(in));
+  }
+  return rules;
+}
+
+std::vector<AppArmor::PathMatch> AppArmor::PolicyClient::query(const std::string &pattern, const std::string &mode)
+{
+  PolicyProtocol::Writer request;
+  request.u8(static_cast<uint8_t>(Request::MATCH));
+  request.str(pattern);
+  request.str(mode);
+
+  auto response = call(request.data());
+  PolicyProtocol::Reader in(response);
+
+  std::vector<AppArmor::PathMatch> matches;
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    AppArmor::PathMatch match;
+    match.profile = in.str();
+    match.rule = PolicyProtocol::readRule(in);
+    match.abstraction = in.str();
+    matches.push_back(std::move(match));
+  }
+  return matches;
+}
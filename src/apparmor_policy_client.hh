@@ -0,0 +1,43 @@
+#ifndef APPARMOR_POLICY_CLIENT_HH
+#define APPARMOR_POLICY_CLIENT_HH
+
+#include "apparmor_file_rule.hh"
+#include "apparmor_path_index.hh"
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace AppArmor {
+  // A connection to a PolicyDaemon. Calls block until the daemon answers, and throw
+  // std::runtime_error if the daemon reports an error or the connection is lost.
+  // Not safe to share between threads, open one client per thread instead.
+  class PolicyClient {
+    public:
+      explicit PolicyClient(const std::string &socketPath);
+      ~PolicyClient();
+
+      PolicyClient(const PolicyClient &) = delete;
+      PolicyClient& operator=(const PolicyClient &) = delete;
+
+      // Generation of the snapshot the daemon answers from, which increases as files change
+      uint64_t getGeneration();
+
+      // Names of every profile, local profiles and hats named parent//child
+      std::vector<std::string> getProfiles();
+
+      // The file rules of a profile, as given by Profile::getFileRules()
+      std::list<AppArmor::FileRule> getFileRules(const std::string &profile);
+
+      // Same as PathIndex::query() on the whole policy
+      std::vector<PathMatch> query(const std::string &pattern, const std::string &mode = "");
+
+    private:
+      std::string call(const std::string &request);
+
+      int fd = -1;
+  };
+}
+
+#endif // APPARMOR_POLICY_CLIENT_HH
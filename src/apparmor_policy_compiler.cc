@@ -0,0 +1,694 @@
+#include "apparmor_policy_compiler.hh"
+#include "parser/dfa.hh"
+#include "parser/file_mode.hh"
+#include "parser/glob.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <unordered_set>
+#include <vector>
+
+// Element codes of the packed policy stream, from the kernel's policy_unpack.c
+enum PackCode : uint8_t {
+  AA_U8, AA_U16, AA_U32, AA_U64, AA_NAME, AA_STRING, AA_BLOB,
+  AA_STRUCT, AA_STRUCTEND, AA_LIST, AA_LISTEND, AA_ARRAY, AA_ARRAYEND
+};
+
+static constexpr uint32_t POLICY_VERSION = 5;
+
+// File permissions in the accept tables, as the kernel maps them from the v5 ABI
+static constexpr uint32_t AA_MAY_EXEC   = 1 << 0;
+static constexpr uint32_t AA_MAY_WRITE  = 1 << 1;
+static constexpr uint32_t AA_MAY_READ   = 1 << 2;
+static constexpr uint32_t AA_MAY_APPEND = 1 << 3;
+static constexpr uint32_t AA_MAY_LINK   = 1 << 4;
+static constexpr uint32_t AA_MAY_LOCK   = 1 << 5;
+static constexpr uint32_t AA_EXEC_MMAP  = 1 << 6;
+
+// Exec transition of each user class, in the bits above its permissions (immunix.h).
+// The kernel reads them back with map_xindex: the type is a 4 bit index, where 1 to 3
+// name a transition and 4 and up an entry of the transition table (xtable).
+static constexpr uint32_t AA_EXEC_UNSAFE  = 1 << 8;
+static constexpr uint32_t AA_EXEC_INHERIT = 1 << 9;
+static constexpr unsigned AA_EXEC_TYPE_SHIFT = 10;
+static constexpr uint32_t AA_EXEC_UNCONFINED = 1;
+static constexpr uint32_t AA_EXEC_PROFILE    = 2;
+static constexpr uint32_t AA_EXEC_LOCAL      = 3;
+static constexpr uint32_t AA_EXEC_TABLE      = 4;
+static constexpr uint32_t AA_EXEC_TABLE_SIZE = 16 - AA_EXEC_TABLE;
+
+// Each accept entry holds the owner's permissions and exec bits, then those of other users
+static constexpr unsigned OTHER_SHIFT = 14;
+
+// The audit and quiet masks of accept2, per user class
+static constexpr unsigned QUIET_SHIFT = 7;
+
+// Profile modes of the flags struct, from the kernel's policy_unpack.c
+static constexpr uint32_t PACKED_MODE_ENFORCE    = 0;
+static constexpr uint32_t PACKED_MODE_COMPLAIN   = 1;
+static constexpr uint32_t PACKED_MODE_KILL       = 2;
+static constexpr uint32_t PACKED_MODE_UNCONFINED = 3;
+
+// path_flags, as apparmor_parser writes them for the kernel
+static constexpr uint32_t PATH_CONNECT_PATH     = 0x4;
+static constexpr uint32_t PATH_CHROOT_REL       = 0x8;
+static constexpr uint32_t PATH_CHROOT_NSCONNECT = 0x10;
+
+// Capabilities in the order of their numbers (linux/capability.h)
+static const char *const CAPABILITY_NAMES[] = {
+  "chown", "dac_override", "dac_read_search", "fowner", "fsetid", "kill", "setgid", "setuid",
+  "setpcap", "linux_immutable", "net_bind_service", "net_broadcast", "net_admin", "net_raw",
+  "ipc_lock", "ipc_owner", "sys_module", "sys_rawio", "sys_chroot", "sys_ptrace", "sys_pacct",
+  "sys_admin", "sys_boot", "sys_nice", "sys_resource", "sys_time", "sys_tty_config", "mknod",
+  "lease", "audit_write", "audit_control", "setfcap", "mac_override", "mac_admin", "syslog",
+  "wake_alarm", "block_suspend", "audit_read", "perfmon", "bpf", "checkpoint_restore"
+};
+
+// Writes the little endian, self describing stream read by the kernel's unpacker.
+// It appends to the whole output, so alignment is relative to the start of the policy.
+class PolicyStream {
+  public:
+    explicit PolicyStream(std::string &buffer)
+      : buffer{buffer}
+    {   }
+
+    void writeU32(uint32_t value, const char *name = nullptr)
+    {
+      writeName(name);
+      put(AA_U32, 1);
+      put(value, 4);
+    }
+
+    void writeString(const std::string &value, const char *name = nullptr)
+    {
+      writeName(name);
+      put(AA_STRING, 1);
+      put(value.size() + 1, 2);
+      buffer.append(value.c_str(), value.size() + 1);
+    }
+
+    // The data of the blob starts on an 8 byte boundary, which the DFA tables need
+    void writeAlignedBlob(const std::string &value, const char *name)
+    {
+      writeName(name);
+
+      // After the blob code and its size
+      size_t start = buffer.size() + 5;
+      size_t pad = ((start + 7) & ~size_t(7)) - start;
+
+      put(AA_BLOB, 1);
+      put(value.size() + pad, 4);
+      buffer.append(pad, '\0');
+      buffer += value;
+    }
+
+    void beginStruct(const char *name)
+    {
+      writeName(name);
+      put(AA_STRUCT, 1);
+    }
+
+    void endStruct()
+    {
+      put(AA_STRUCTEND, 1);
+    }
+
+    // An array holds count unnamed elements
+    void beginArray(uint16_t count, const char *name = nullptr)
+    {
+      writeName(name);
+      put(AA_ARRAY, 1);
+      put(count, 2);
+    }
+
+    void endArray()
+    {
+      put(AA_ARRAYEND, 1);
+    }
+
+  private:
+    void writeName(const char *name)
+    {
+      if(name == nullptr) {
+        return;
+      }
+
+      std::string text(name);
+      put(AA_NAME, 1);
+      put(text.size() + 1, 2);
+      buffer.append(text.c_str(), text.size() + 1);
+    }
+
+    void put(uint64_t value, size_t size)
+    {
+      for(size_t i = 0; i < size; i++) {
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+      }
+    }
+
+    std::string &buffer;
+};
+
+// A path pattern of the profile with the permissions it grants or denies
+struct CompiledRule {
+  std::shared_ptr<FileNode> node;
+  // The rule as written in a profile, reported if the pattern is skipped
+  std::string text;
+  std::string pattern;
+  uint32_t perms;
+  // Exec transition without the x, such as "P" or "ci", and the profile it names if any
+  std::string exec;
+  std::string target;
+  bool audit;
+  bool deny;
+  bool owner;
+};
+
+static uint32_t kernelPerms(const FileMode &mode)
+{
+  uint32_t perms = 0;
+  if(mode.perms & FileMode::EXEC)   perms |= AA_MAY_EXEC;
+  if(mode.perms & FileMode::WRITE)  perms |= AA_MAY_WRITE;
+  if(mode.perms & FileMode::READ)   perms |= AA_MAY_READ;
+  if(mode.perms & FileMode::APPEND) perms |= AA_MAY_APPEND;
+  if(mode.perms & FileMode::LINK)   perms |= AA_MAY_LINK;
+  if(mode.perms & FileMode::LOCK)   perms |= AA_MAY_LOCK;
+  if(mode.perms & FileMode::MMAP)   perms |= AA_EXEC_MMAP;
+  return perms;
+}
+
+// Named transitions of a profile, written as its xtable
+class TransitionTable {
+  public:
+    explicit TransitionTable(const std::string &profileName)
+      : profileName{profileName}
+    {   }
+
+    // The exec bits of a transition, with upper case ones scrubbing the environment
+    // and lower case ones unsafe, as apparmor_parser encodes them
+    uint32_t execBits(const std::string &exec, const std::string &target)
+    {
+      if(exec.empty()) {
+        return 0;
+      }
+
+      char type = std::tolower(static_cast<unsigned char>(exec[0]));
+      uint32_t bits = 0;
+      uint32_t index = 0;
+      switch(type) {
+        case 'i': bits = AA_EXEC_INHERIT; break;
+        case 'u': index = AA_EXEC_UNCONFINED; break;
+        case 'p': index = AA_EXEC_PROFILE; break;
+        case 'c': index = AA_EXEC_LOCAL; break;
+      }
+
+      if(type != 'i' && std::islower(static_cast<unsigned char>(exec[0]))) {
+        bits |= AA_EXEC_UNSAFE;
+      }
+
+      // pix and cix fall back to inheriting when the profile is missing
+      if(exec.size() > 1) {
+        bits |= AA_EXEC_INHERIT;
+      }
+
+      // A named profile is looked up through the table, a local one under this profile
+      if(!target.empty() && (type == 'p' || type == 'c')) {
+        index = AA_EXEC_TABLE + entry(type == 'c'? profileName + "//" + target : target);
+      }
+
+      return bits | (index << AA_EXEC_TYPE_SHIFT);
+    }
+
+    const std::vector<std::string> &getNames() const
+    {
+      return names;
+    }
+
+  private:
+    uint32_t entry(const std::string &name)
+    {
+      auto found = std::find(names.begin(), names.end(), name);
+      if(found != names.end()) {
+        return found - names.begin();
+      }
+
+      if(names.size() == AA_EXEC_TABLE_SIZE) {
+        throw std::runtime_error("profile " + profileName + " names more than " +
+                                 std::to_string(AA_EXEC_TABLE_SIZE) + " exec transition targets");
+      }
+      names.push_back(name);
+      return names.size() - 1;
+    }
+
+    std::string profileName;
+    std::vector<std::string> names;
+};
+
+// Allowed, audited, quieted and denied capabilities, one bit per capability number
+struct Capabilities {
+  uint64_t allow = 0;
+  uint64_t audit = 0;
+  uint64_t quiet = 0;
+  uint64_t deny = 0;
+};
+
+// The capabilities named by "capability a b,", every one of them for a bare "capability,"
+static uint64_t capabilityMask(const std::string &text, const std::string &name)
+{
+  constexpr size_t count = sizeof(CAPABILITY_NAMES) / sizeof(CAPABILITY_NAMES[0]);
+
+  std::vector<std::string> words;
+  std::string word;
+  for(char c : text.substr(0, text.find_last_not_of(", ") + 1)) {
+    if(std::isspace(static_cast<unsigned char>(c))) {
+      words.push_back(word);
+      word.clear();
+    }
+    else {
+      word += c;
+    }
+  }
+  words.push_back(word);
+
+  if(words.size() == 1) {
+    return (uint64_t(1) << count) - 1;
+  }
+
+  uint64_t mask = 0;
+  for(size_t i = 1; i < words.size(); i++) {
+    auto found = std::find(std::begin(CAPABILITY_NAMES), std::end(CAPABILITY_NAMES), words[i]);
+    if(found == std::end(CAPABILITY_NAMES)) {
+      throw std::runtime_error("profile " + name + " has the unknown capability " + words[i]);
+    }
+    mask |= uint64_t(1) << (found - std::begin(CAPABILITY_NAMES));
+  }
+  return mask;
+}
+
+static std::string prefixText(bool audit, bool deny, bool owner)
+{
+  return std::string(audit? "audit " : "") + (deny? "deny " : "") + (owner? "owner " : "");
+}
+
+// Rules falling back to unconfined (pux, cux) need a flag of the newer permission tables
+static bool compilable(const FileMode &mode)
+{
+  return mode.exec.size() < 2 || std::tolower(static_cast<unsigned char>(mode.exec[1])) != 'u';
+}
+
+// Rules of a kind the v5 layout can not express are refused, the same as unknown flags,
+// since loading the profile without them would change what it allows or denies
+static void collectRules(const RuleList<ProfileNode> &rules, const PrefixNode &outer, const std::string &name,
+                         std::vector<CompiledRule> &out, Capabilities &capabilities,
+                         std::list<AppArmor::FileRule> &skipped, std::list<std::string> &skippedText)
+{
+  if(!rules.getConditionalList().empty()) {
+    throw std::runtime_error("profile " + name + " has conditional rules, which must be evaluated before compiling");
+  }
+
+  for(auto &file : rules.getFileList()) {
+    auto node = std::make_shared<FileNode>(file);
+    bool audit = outer.isAudit() || file.getPrefix().isAudit();
+    bool deny  = outer.isDeny()  || file.getPrefix().isDeny();
+    bool owner = outer.isOwner() || file.getPrefix().isOwner();
+
+    std::string text = prefixText(audit, deny, owner) + (file.getFilename().empty()? "file" :
+                       file.getFilename() + " " + file.getFilemode());
+    if(!file.getExecTarget().empty()) {
+      text += " -> " + file.getExecTarget();
+    }
+    text += ",";
+
+    // A bare "file," rule allows everything
+    std::string pattern = file.getFilename().empty()? "/**" : file.getFilename();
+    FileMode mode(file.getFilename().empty()? "mrwlkix" : file.getFilemode());
+    if(!compilable(mode)) {
+      skipped.emplace_back(node);
+      skippedText.push_back(text);
+      continue;
+    }
+
+    out.push_back({node, text, pattern, kernelPerms(mode), mode.exec, file.getExecTarget(), audit, deny, owner});
+  }
+
+  // The kernel checks the link name first, then the target after a NUL byte. The joined
+  // pattern holds both paths, so only it is reported when a variable makes it skipped.
+  for(auto &link : rules.getLinkList()) {
+    bool audit = outer.isAudit() || link.getPrefix().isAudit();
+    bool deny  = outer.isDeny()  || link.getPrefix().isDeny();
+    bool owner = outer.isOwner() || link.getPrefix().isOwner();
+
+    std::string text = prefixText(audit, deny, owner) + "link " + (link.isSubsetRule()? "subset " : "") +
+                       link.getFrom() + " -> " + link.getTo() + ",";
+    out.push_back({nullptr, "", link.getFrom(), AA_MAY_LINK, "", "", audit, deny, owner});
+    out.push_back({nullptr, text, link.getFrom() + '\0' + link.getTo(), AA_MAY_LINK, "", "", audit, deny, owner});
+  }
+
+  for(auto &generic : rules.getGenericRuleList()) {
+    bool audit = outer.isAudit() || generic.getPrefix().isAudit();
+    bool deny  = outer.isDeny()  || generic.getPrefix().isDeny();
+
+    // An abi rule only says which features the profile was written for
+    if(generic.getKind() == "abi") {
+      continue;
+    }
+    if(generic.getKind() != "capability") {
+      throw std::runtime_error("profile " + name + " has the rule " + generic.getText() + " which can not be compiled");
+    }
+
+    uint64_t mask = capabilityMask(generic.getText(), name);
+    if(deny) {
+      capabilities.deny |= mask;
+      (audit? capabilities.audit : capabilities.quiet) |= mask;
+    }
+    else {
+      capabilities.allow |= mask;
+      if(audit) {
+        capabilities.audit |= mask;
+      }
+    }
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    PrefixNode inner(outer.isAudit() || block.getPrefix().isAudit(),
+                     outer.isDeny()  || block.getPrefix().isDeny(),
+                     outer.isOwner() || block.getPrefix().isOwner());
+    collectRules(block, inner, name, out, capabilities, skipped, skippedText);
+  }
+}
+
+static void collectIncludes(const RuleList<ProfileNode> &rules, std::vector<std::string> &out)
+{
+  for(auto &abstraction : rules.getAbstractionList()) {
+    out.push_back(abstraction.getPath());
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    collectIncludes(block, out);
+  }
+}
+
+// The exec transition of an accepting state. When several rules disagree, a rule without
+// globs wins over the globs it overlaps, as in apparmor_parser. Otherwise they conflict.
+static const CompiledRule *execRule(const std::vector<const CompiledRule *> &candidates)
+{
+  const CompiledRule *chosen = nullptr;
+  bool chosenLiteral = false;
+  bool conflict = false;
+
+  for(auto rule : candidates) {
+    bool literal = globLiteralPrefix(rule->pattern) == rule->pattern;
+    if(chosen == nullptr || (literal && !chosenLiteral)) {
+      chosen = rule;
+      chosenLiteral = literal;
+      conflict = false;
+    }
+    else if(literal == chosenLiteral && (rule->exec != chosen->exec || rule->target != chosen->target)) {
+      conflict = true;
+    }
+  }
+
+  if(conflict) {
+    throw std::runtime_error("conflicting exec transitions for " + chosen->pattern);
+  }
+  return chosen;
+}
+
+// Permissions of every accepting state, deny rules taking precedence over allow rules
+static void acceptTables(const Dfa &dfa, const std::vector<CompiledRule> &rules, TransitionTable &transitions,
+                         std::vector<uint32_t> &accept, std::vector<uint32_t> &accept2)
+{
+  for(uint32_t state = 0; state < dfa.stateCount(); state++) {
+    // Index 0 is the owner of the file, index 1 every other user
+    uint32_t allow[2] = {0, 0}, deny[2] = {0, 0}, audit[2] = {0, 0}, quiet[2] = {0, 0}, exec[2] = {0, 0};
+    std::vector<const CompiledRule *> execs[2];
+
+    for(uint32_t index : dfa.getAccepting(state)) {
+      auto &rule = rules[index];
+      for(int user = 0; user < (rule.owner? 1 : 2); user++) {
+        if(rule.deny) {
+          deny[user] |= rule.perms;
+          (rule.audit? audit : quiet)[user] |= rule.perms;
+        }
+        else {
+          allow[user] |= rule.perms;
+          if(rule.perms & AA_MAY_EXEC) {
+            execs[user].push_back(&rule);
+          }
+          if(rule.audit) {
+            audit[user] |= rule.perms;
+          }
+        }
+      }
+    }
+
+    for(int user = 0; user < 2; user++) {
+      allow[user] &= ~deny[user];
+      if((allow[user] & AA_MAY_EXEC) && !execs[user].empty()) {
+        auto rule = execRule(execs[user]);
+        exec[user] = transitions.execBits(rule->exec, rule->target);
+      }
+    }
+
+    accept.push_back(allow[0] | exec[0] | ((allow[1] | exec[1]) << OTHER_SHIFT));
+    accept2.push_back(audit[0] | (quiet[0] << QUIET_SHIFT) | ((audit[1] | (quiet[1] << QUIET_SHIFT)) << OTHER_SHIFT));
+  }
+}
+
+// The flags struct and path flags of a profile. Flags that the v5 policy can not express
+// are refused rather than dropped, since loading the profile without them changes what it allows.
+struct ProfileFlags {
+  uint32_t hat = 0;
+  uint32_t mode = PACKED_MODE_ENFORCE;
+  uint32_t audit = 0;
+  uint32_t path = 0;
+};
+
+static ProfileFlags profileFlags(const ProfileNode &profile, const std::string &name)
+{
+  ProfileFlags flags;
+  flags.hat = profile.isHat()? 1 : 0;
+
+  std::string mode;
+  for(auto &flag : profile.getFlags()) {
+    if(flag == "enforce" || flag == "complain" || flag == "kill" || flag == "unconfined") {
+      if(!mode.empty() && mode != flag) {
+        throw std::runtime_error("profile " + name + " has both the " + mode + " and " + flag + " flags");
+      }
+      mode = flag;
+    }
+    else if(flag == "hat") {
+      flags.hat = 1;
+    }
+    else if(flag == "audit") {
+      flags.audit = 1;
+    }
+    else if(flag == "attach_disconnected") {
+      flags.path |= PATH_CONNECT_PATH;
+    }
+    else if(flag == "chroot_relative") {
+      flags.path |= PATH_CHROOT_REL;
+    }
+    else if(flag == "chroot_attach") {
+      flags.path |= PATH_CHROOT_NSCONNECT;
+    }
+    // The defaults, which need no bits
+    else if(flag != "namespace_relative" && flag != "no_attach_disconnected" && flag != "chroot_no_attach") {
+      throw std::runtime_error("profile " + name + " has the flag " + flag + ", which can not be compiled");
+    }
+  }
+
+  if(mode == "complain") {
+    flags.mode = PACKED_MODE_COMPLAIN;
+  }
+  else if(mode == "kill") {
+    flags.mode = PACKED_MODE_KILL;
+  }
+  else if(mode == "unconfined") {
+    flags.mode = PACKED_MODE_UNCONFINED;
+  }
+
+  return flags;
+}
+
+// The DFA the kernel matches executables against to find the profile attached to them,
+// accepting with the exec permission. Without one, it only attaches profiles by their name.
+static std::string attachmentDfa(const std::string &attachment, const std::string &name)
+{
+  Dfa dfa({attachment});
+  if(!dfa.getSkipped().empty()) {
+    throw std::runtime_error("profile " + name + " has the attachment " + attachment + ", which can not be compiled");
+  }
+
+  std::vector<uint32_t> accept, accept2(dfa.stateCount(), 0);
+  for(uint32_t state = 0; state < dfa.stateCount(); state++) {
+    accept.push_back(dfa.getAccepting(state).empty()? 0 : AA_MAY_EXEC);
+  }
+  return dfa.pack(accept, accept2);
+}
+
+static void compileProfile(const ProfileNode &profile, const std::string &name,
+                           const std::map<std::string, std::shared_ptr<ProfileNode>> &abstractions,
+                           std::string &binary, std::list<AppArmor::FileRule> &skipped,
+                           std::list<std::string> &skippedText)
+{
+  auto flags = profileFlags(profile, name);
+  if(!profile.getXattrs().empty()) {
+    throw std::runtime_error("profile " + name + " matches extended attributes, which can not be compiled");
+  }
+
+  std::vector<CompiledRule> rules;
+  Capabilities capabilities;
+
+  std::vector<std::string> pending;
+  collectIncludes(profile.getRules(), pending);
+
+  std::unordered_set<std::string> included;
+  while(!pending.empty()) {
+    auto path = pending.back();
+    pending.pop_back();
+
+    auto abstraction = abstractions.find(path);
+    if(abstraction == abstractions.end() || !included.insert(path).second) {
+      continue;
+    }
+
+    auto &abstractionRules = abstraction->second->getRules();
+    collectRules(abstractionRules, PrefixNode(), name, rules, capabilities, skipped, skippedText);
+    collectIncludes(abstractionRules, pending);
+  }
+
+  collectRules(profile.getRules(), PrefixNode(), name, rules, capabilities, skipped, skippedText);
+
+  std::vector<std::string> patterns;
+  for(auto &rule : rules) {
+    patterns.push_back(rule.pattern);
+  }
+
+  Dfa dfa(patterns);
+  for(size_t index : dfa.getSkipped()) {
+    if(rules[index].node != nullptr) {
+      skipped.emplace_back(rules[index].node);
+    }
+    if(!rules[index].text.empty()) {
+      skippedText.push_back(rules[index].text);
+    }
+  }
+
+  // Table entries are numbered in the order of the rules naming them
+  TransitionTable transitions(name);
+  for(auto &rule : rules) {
+    transitions.execBits(rule.exec, rule.target);
+  }
+
+  std::vector<uint32_t> accept, accept2;
+  acceptTables(dfa, rules, transitions, accept, accept2);
+
+  PolicyStream stream(binary);
+  stream.writeU32(POLICY_VERSION, "version");
+
+  stream.beginStruct("profile");
+  stream.writeString(name);
+  if(!profile.getAttachment().empty()) {
+    stream.writeString(profile.getAttachment(), "attach");
+
+    // The kernel reads every DFA blob under the same name, then the length of the literal prefix
+    stream.writeAlignedBlob(attachmentDfa(profile.getAttachment(), name), "aadfa");
+    stream.writeU32(globLiteralPrefix(profile.getAttachment()).size());
+  }
+
+  stream.beginStruct("flags");
+  stream.writeU32(flags.hat);
+  stream.writeU32(flags.mode);
+  stream.writeU32(flags.audit);
+  stream.endStruct();
+
+  if(flags.path != 0) {
+    stream.writeU32(flags.path, "path_flags");
+  }
+
+  // Allowed, audited, quieted and denied capabilities, with those above 31 in caps64.
+  // Deny rules take precedence, and are quiet unless audited.
+  uint64_t masks[4] = {capabilities.allow & ~capabilities.deny, capabilities.audit,
+                       capabilities.quiet, capabilities.deny};
+  for(uint64_t mask : masks) {
+    stream.writeU32(mask & 0xffffffff);
+  }
+
+  if((masks[0] | masks[1] | masks[2] | masks[3]) >> 32) {
+    stream.beginStruct("caps64");
+    for(uint64_t mask : masks) {
+      stream.writeU32(mask >> 32);
+    }
+    stream.endStruct();
+  }
+
+  stream.writeAlignedBlob(dfa.pack(accept, accept2), "aadfa");
+
+  auto &names = transitions.getNames();
+  if(!names.empty()) {
+    stream.beginStruct("xtable");
+    stream.beginArray(names.size());
+    for(auto &target : names) {
+      stream.writeString(target);
+    }
+    stream.endArray();
+    stream.endStruct();
+  }
+
+  stream.endStruct();
+
+  for(auto &subprofile : profile.getRules().getSubprofiles()) {
+    compileProfile(subprofile, name + "//" + subprofile.getText(), abstractions, binary, skipped, skippedText);
+  }
+}
+
+AppArmor::PolicyCompiler::PolicyCompiler(const std::list<Profile> &profiles, const std::map<std::string, Profile> &abstractions)
+{
+  std::map<std::string, std::shared_ptr<ProfileNode>> models;
+  for(auto &abstraction : abstractions) {
+    models.emplace(abstraction.first, abstraction.second.model());
+  }
+
+  for(auto &profile : profiles) {
+    auto node = profile.model();
+    compileProfile(*node, node->getText(), models, binary, skipped, skippedText);
+  }
+}
+
+const std::string &AppArmor::PolicyCompiler::getBinary() const
+{
+  return binary;
+}
+
+const std::list<AppArmor::FileRule> &AppArmor::PolicyCompiler::getSkippedRules() const
+{
+  return skipped;
+}
+
+const std::list<std::string> &AppArmor::PolicyCompiler::getSkippedRuleText() const
+{
+  return skippedText;
+}
+
+void AppArmor::PolicyCompiler::save(const std::string &path) const
+{
+  std::string temp = path + ".tmp";
+
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(binary.data(), binary.size());
+    if(!file) {
+      throw std::runtime_error("could not write policy: " + temp);
+    }
+  }
+
+  if(std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+    throw std::runtime_error("could not replace policy: " + path);
+  }
+}
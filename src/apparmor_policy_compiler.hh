@@ -0,0 +1,53 @@
+#ifndef APPARMOR_POLICY_COMPILER_HH
+#define APPARMOR_POLICY_COMPILER_HH
+
+#include "apparmor_file_rule.hh"
+#include "apparmor_profile.hh"
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace AppArmor {
+  // Compiles profiles into the packed binary policy that the kernel loads, in memory,
+  // without running apparmor_parser. Each profile and local profile is written as its own
+  // entry (local ones named parent//child) with a file DFA and its permission tables,
+  // in the layout of the v5 policy ABI.
+  //
+  // File, link and capability rules are compiled, along with the profile flags and an
+  // attachment DFA (xmatch) for the attachment. File and link rules whose paths use variables
+  // are skipped, and so are exec rules that fall back to unconfined (pux, cux), which need the
+  // newer permission tables. Exec transitions to a named profile go through the transition
+  // table. Rules from included abstractions are taken from the abstractions passed in,
+  // keyed by include path, the same as for RuleAnalysis.
+  //
+  // Throws std::runtime_error for policy the v5 layout can not express: unknown or
+  // conflicting profile flags, network, mount, dbus, signal, ptrace, unix, userns and rlimit
+  // rules, unknown capabilities, conditional rules left by ParseOptions::keepConditionals
+  // (evaluate the profile first), xattrs, attachments with variables, rules that give one
+  // path different exec transitions, and more than 12 named exec targets in one profile.
+  class PolicyCompiler {
+    public:
+      PolicyCompiler(const std::list<Profile> &profiles, const std::map<std::string, Profile> &abstractions = {});
+
+      // The policy of every profile, one after the other, ready to be loaded or cached
+      const std::string &getBinary() const;
+
+      // File rules left out of the policy, because their path or exec transition could not be compiled
+      const std::list<FileRule> &getSkippedRules() const;
+
+      // Every rule left out of the policy, file and link rules alike, as written in a profile
+      const std::list<std::string> &getSkippedRuleText() const;
+
+      // Writes the policy to a file, such as an entry of the policy cache.
+      // The file is replaced atomically, readers never see a partial policy.
+      void save(const std::string &path) const;
+
+    private:
+      std::string binary;
+      std::list<FileRule> skipped;
+      std::list<std::string> skippedText;
+  };
+}
+
+#endif // APPARMOR_POLICY_COMPILER_HH
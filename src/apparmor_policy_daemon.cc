@@ -0,0 +1,445 @@
+#include "apparmor_policy_daemon.hh"
+#include "parser/policy_protocol.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using PolicyProtocol::Request;
+using PolicyProtocol::Status;
+
+// A client that stops halfway through a request, or stops reading its response, is dropped
+static constexpr auto CLIENT_TIMEOUT = std::chrono::seconds(5);
+
+// A connection with what has been received of its next request and what is left to send of its response
+struct DaemonClient {
+  int fd;
+  std::string received;
+  std::string pending;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+static struct sockaddr_un socketAddress(const std::string &path)
+{
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+
+  if(path.empty() || path.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("invalid socket path: " + path);
+  }
+
+  std::copy(path.begin(), path.end(), address.sun_path);
+  return address;
+}
+
+// Whether a daemon is still accepting connections on the socket
+static bool isListening(const struct sockaddr_un &address)
+{
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(fd < 0) {
+    return false;
+  }
+
+  bool listening = connect(fd, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)) == 0;
+  close(fd);
+  return listening;
+}
+
+AppArmor::PolicyDaemon::PolicyDaemon(const std::string &directory, const std::string &socketPath,
+                                     std::chrono::milliseconds debounce, mode_t socketMode)
+  : directory{std::filesystem::path(directory).lexically_normal().string()},
+    socket_path{socketPath},
+    socket_mode{socketMode},
+    watcher{directory, debounce}
+{
+  auto address = socketAddress(socket_path);
+
+  // Only a socket nobody listens on is replaced, never another file or a running daemon
+  struct stat info;
+  if(lstat(socket_path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+    if(isListening(address)) {
+      throw std::runtime_error("another daemon is listening on " + socket_path);
+    }
+    unlink(socket_path.c_str());
+  }
+
+  listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if(listen_fd < 0 || stop_fd < 0 ||
+     bind(listen_fd, reinterpret_cast<const struct sockaddr *>(&address), sizeof(address)) != 0 ||
+     chmod(socket_path.c_str(), socket_mode) != 0 ||
+     listen(listen_fd, SOMAXCONN) != 0) {
+    int error = errno;
+    if(listen_fd >= 0) {
+      close(listen_fd);
+    }
+    if(stop_fd >= 0) {
+      close(stop_fd);
+    }
+    throw std::runtime_error("could not listen on " + socket_path + ": " + std::strerror(error));
+  }
+
+  thread = std::thread(&PolicyDaemon::run, this);
+}
+
+AppArmor::PolicyDaemon::~PolicyDaemon()
+{
+  uint64_t stop = 1;
+  if(write(stop_fd, &stop, sizeof(stop)) != sizeof(stop)) {
+    std::terminate();
+  }
+  thread.join();
+
+  close(listen_fd);
+  close(stop_fd);
+  unlink(socket_path.c_str());
+}
+
+const std::string &AppArmor::PolicyDaemon::getSocketPath() const
+{
+  return socket_path;
+}
+
+std::shared_ptr<const AppArmor::PolicySnapshot> AppArmor::PolicyDaemon::snapshot() const
+{
+  return watcher.snapshot();
+}
+
+void AppArmor::PolicyDaemon::addNames(State &state, const std::string &name, const std::shared_ptr<ProfileNode> &model)
+{
+  state.byName.emplace(name, Profile(model));
+
+  // Profile only reads its model, the subprofiles are shared with the tree that owns them
+  for(auto &subprofile : model->getRules().getSubprofiles()) {
+    std::shared_ptr<ProfileNode> child(model, const_cast<ProfileNode *>(&subprofile));
+    addNames(state, name + "//" + subprofile.getText(), child);
+  }
+}
+
+// Indexes again the files the new snapshot marks as affected. Those are only relative to the
+// snapshot before it, so everything is indexed again when the daemon did not see that one.
+// Parsed trees are shared with the snapshot, so this only costs the index.
+const AppArmor::PolicyDaemon::State &AppArmor::PolicyDaemon::refresh()
+{
+  auto snapshot = watcher.snapshot();
+  if(state != nullptr && state->snapshot == snapshot) {
+    return *state;
+  }
+
+  bool rebuild = state == nullptr || snapshot->getGeneration() != state->snapshot->getGeneration() + 1;
+
+  std::list<std::string> paths;
+  if(rebuild) {
+    state = std::make_unique<State>();
+    paths = snapshot->getFiles();
+  }
+  else {
+    auto affected = snapshot->getAffectedFiles();
+    paths.assign(affected.begin(), affected.end());
+    for(auto &path : paths) {
+      unloadFile(path);
+    }
+  }
+  state->snapshot = snapshot;
+
+  std::list<Profile> profiles;
+  std::map<std::string, Profile> abstractions;
+  for(auto &path : paths) {
+    auto fileProfiles = snapshot->getProfileList(path);
+
+    // Abstractions are parsed as a single unnamed profile holding their rules
+    if(fileProfiles.size() == 1 && fileProfiles.front().name().empty()) {
+      auto include = std::filesystem::path(path).lexically_relative(directory).string();
+      state->abstractions.emplace(path, include);
+      abstractions.emplace(include, fileProfiles.front());
+      continue;
+    }
+
+    for(auto &profile : fileProfiles) {
+      addNames(*state, profile.name(), profile.model());
+      state->files[path].push_back(profile.name());
+      profiles.push_back(profile);
+    }
+  }
+
+  if(rebuild) {
+    state->index = std::make_unique<PathIndex>(profiles, abstractions);
+    return *state;
+  }
+
+  // Abstractions first, so the profiles including them are indexed with their new rules
+  for(auto &abstraction : abstractions) {
+    state->index->updateAbstraction(abstraction.first, abstraction.second);
+  }
+  for(auto &profile : profiles) {
+    state->index->update(profile);
+  }
+  return *state;
+}
+
+// Forgets the profiles or the abstraction of a file, local profiles and hats included
+void AppArmor::PolicyDaemon::unloadFile(const std::string &path)
+{
+  auto abstraction = state->abstractions.find(path);
+  if(abstraction != state->abstractions.end()) {
+    state->index->removeAbstraction(abstraction->second);
+    state->abstractions.erase(abstraction);
+  }
+
+  auto file = state->files.find(path);
+  if(file == state->files.end()) {
+    return;
+  }
+
+  for(auto &name : file->second) {
+    state->index->remove(name);
+    state->byName.erase(name);
+
+    auto child = state->byName.lower_bound(name + "//");
+    while(child != state->byName.end() && child->first.compare(0, name.size() + 2, name + "//") == 0) {
+      child = state->byName.erase(child);
+    }
+  }
+  state->files.erase(file);
+}
+
+// Whether the peer belongs to the group, as its primary group or one of its supplementary ones
+static bool peerInGroup(int client, const struct ucred &credentials, gid_t group)
+{
+  if(credentials.gid == group) {
+    return true;
+  }
+
+  std::vector<gid_t> groups(32);
+  socklen_t size = groups.size() * sizeof(gid_t);
+  if(getsockopt(client, SOL_SOCKET, SO_PEERGROUPS, groups.data(), &size) != 0) {
+    // The kernel says how much room the whole list needs
+    if(errno != ERANGE) {
+      return false;
+    }
+    groups.resize(size / sizeof(gid_t));
+    if(getsockopt(client, SOL_SOCKET, SO_PEERGROUPS, groups.data(), &size) != 0) {
+      return false;
+    }
+  }
+
+  groups.resize(size / sizeof(gid_t));
+  return std::find(groups.begin(), groups.end(), group) != groups.end();
+}
+
+// Whether the peer could have opened the socket itself with the mode it was created with
+bool AppArmor::PolicyDaemon::isAllowed(int client) const
+{
+  struct ucred credentials;
+  socklen_t size = sizeof(credentials);
+  if(getsockopt(client, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0) {
+    return false;
+  }
+
+  if(credentials.uid == 0 || credentials.uid == geteuid()) {
+    return true;
+  }
+  if((socket_mode & S_IWGRP) && peerInGroup(client, credentials, getegid())) {
+    return true;
+  }
+  return socket_mode & S_IWOTH;
+}
+
+std::string AppArmor::PolicyDaemon::answer(const std::string &request)
+{
+  PolicyProtocol::Writer out;
+
+  try {
+    PolicyProtocol::Reader in(request);
+    auto kind = static_cast<Request>(in.u8());
+    auto &current = refresh();
+
+    out.u8(static_cast<uint8_t>(Status::OK));
+
+    switch(kind) {
+      case Request::GENERATION: {
+        out.u64(current.snapshot->getGeneration());
+        break;
+      }
+      case Request::PROFILES: {
+        out.u32(current.byName.size());
+        for(auto &entry : current.byName) {
+          out.str(entry.first);
+        }
+        break;
+      }
+      case Request::RULES: {
+        auto profile = current.byName.find(in.str());
+        if(profile == current.byName.end()) {
+          throw std::runtime_error("no such profile");
+        }
+
+        auto rules = profile->second.getFileRules();
+        out.u32(rules.size());
+        for(auto &rule : rules) {
+          PolicyProtocol::writeRule(out, rule);
+        }
+        break;
+      }
+      case Request::MATCH: {
+        auto pattern = in.str();
+        auto mode = in.str();
+
+        auto matches = current.index->query(pattern, mode);
+        out.u32(matches.size());
+        for(auto &match : matches) {
+          out.str(match.profile);
+          PolicyProtocol::writeRule(out, match.rule);
+          out.str(match.abstraction);
+        }
+        break;
+      }
+      default:
+        throw std::runtime_error("unknown request");
+    }
+  }
+  catch(const std::exception &error) {
+    PolicyProtocol::Writer failed;
+    failed.u8(static_cast<uint8_t>(Status::ERROR));
+    failed.str(error.what());
+    return failed.data();
+  }
+
+  // The client would refuse it, and take the dropped connection for a daemon that went away
+  if(out.data().size() > PolicyProtocol::MAX_MESSAGE) {
+    PolicyProtocol::Writer failed;
+    failed.u8(static_cast<uint8_t>(Status::ERROR));
+    failed.str("response too large");
+    return failed.data();
+  }
+
+  return out.data();
+}
+
+// Reads what a client sent and writes what it is owed without blocking, and answers its next
+// request once the previous response is out. Returns false when the client has to be dropped.
+static bool serve(DaemonClient &client, short events, std::chrono::steady_clock::time_point now,
+                  const std::function<std::string(const std::string &)> &answer)
+{
+  if(events & (POLLERR | POLLNVAL)) {
+    return false;
+  }
+
+  if(events & POLLOUT) {
+    ssize_t count = send(client.fd, client.pending.data(), client.pending.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if(count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      return false;
+    }
+    if(count > 0) {
+      client.pending.erase(0, count);
+      client.deadline = now + CLIENT_TIMEOUT;
+    }
+  }
+  else if(events & POLLIN) {
+    char buffer[64 * 1024];
+    ssize_t count = recv(client.fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if(count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+      return false;
+    }
+    if(count > 0) {
+      client.received.append(buffer, count);
+      client.deadline = now + CLIENT_TIMEOUT;
+    }
+  }
+  else if(events & POLLHUP) {
+    return false;
+  }
+
+  std::string request;
+  try {
+    if(client.pending.empty() && PolicyProtocol::takeMessage(client.received, request)) {
+      client.pending = PolicyProtocol::frameMessage(answer(request));
+      client.deadline = now + CLIENT_TIMEOUT;
+    }
+  }
+  catch(const std::runtime_error &) {
+    return false;
+  }
+
+  bool busy = !client.received.empty() || !client.pending.empty();
+  return !busy || now < client.deadline;
+}
+
+void AppArmor::PolicyDaemon::run()
+{
+  using Clock = std::chrono::steady_clock;
+  std::vector<DaemonClient> clients;
+  auto respond = [this](const std::string &request) { return answer(request); };
+
+  while(true) {
+    std::vector<struct pollfd> fds = {
+      {.fd = stop_fd,   .events = POLLIN, .revents = 0},
+      {.fd = listen_fd, .events = POLLIN, .revents = 0},
+    };
+
+    // Wake up in time to drop the first client that stalls
+    auto now = Clock::now();
+    int timeout = -1;
+    for(auto &client : clients) {
+      short events = client.pending.empty()? POLLIN : POLLOUT;
+      fds.push_back({.fd = client.fd, .events = events, .revents = 0});
+
+      if(!client.received.empty() || !client.pending.empty()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(client.deadline - now).count() + 1;
+        timeout = timeout < 0? std::max<int>(left, 0) : std::min<int>(timeout, std::max<int>(left, 0));
+      }
+    }
+
+    if(poll(fds.data(), fds.size(), timeout) < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+
+    if(fds[0].revents & POLLIN) {
+      break;
+    }
+
+    // Each client gets at most one read or write and one request answered per pass,
+    // so none of them can starve the others
+    now = Clock::now();
+    std::vector<DaemonClient> open;
+    for(size_t i = 2; i < fds.size(); i++) {
+      auto &client = clients[i - 2];
+      if(serve(client, fds[i].revents, now, respond)) {
+        open.push_back(std::move(client));
+      }
+      else {
+        close(client.fd);
+      }
+    }
+    clients = std::move(open);
+
+    if(fds[1].revents & POLLIN) {
+      int client = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+      if(client >= 0 && !isAllowed(client)) {
+        close(client);
+      }
+      else if(client >= 0) {
+        clients.push_back({client, "", "", now + CLIENT_TIMEOUT});
+      }
+    }
+  }
+
+  for(auto &client : clients) {
+    close(client.fd);
+  }
+}
@@ -0,0 +1,85 @@
+#ifndef APPARMOR_POLICY_DAEMON_HH
+#define APPARMOR_POLICY_DAEMON_HH
+
+#include "apparmor_path_index.hh"
+#include "apparmor_policy_watcher.hh"
+#include "apparmor_profile.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
+
+namespace AppArmor {
+  // Keeps a policy directory parsed and indexed in a long-running process, and answers
+  // queries about it from other processes over a Unix domain socket, so short-lived tools
+  // do not each parse the whole policy again. Queries are sent with PolicyClient.
+  //
+  // The directory is kept up to date by a PolicyWatcher. Files that have no profile, such as
+  // abstractions, are keyed by their path relative to the directory for include lookups.
+  // Only the files a new snapshot marks as affected are indexed again.
+  //
+  // Queries are answered one at a time on a single thread, from the latest snapshot. Clients
+  // are read and written without blocking, so one that stops halfway through a message does
+  // not hold up the others, and it is dropped after a few seconds.
+  //
+  // The socket is created with socketMode, and a client is only answered when its credentials
+  // would let it open the socket with that mode: root and the daemon's user always, members of
+  // the daemon's group, as their primary or a supplementary group, when the mode grants the
+  // group access, and anybody when it grants others.
+  class PolicyDaemon {
+    public:
+      // Listens on socketPath, replacing a stale socket left there by an earlier daemon.
+      // Throws std::runtime_error if the directory cannot be watched or the socket cannot be bound.
+      PolicyDaemon(const std::string &directory, const std::string &socketPath,
+                   std::chrono::milliseconds debounce = std::chrono::milliseconds(100), mode_t socketMode = 0600);
+      ~PolicyDaemon();
+
+      PolicyDaemon(const PolicyDaemon &) = delete;
+      PolicyDaemon& operator=(const PolicyDaemon &) = delete;
+
+      const std::string &getSocketPath() const;
+
+      // The latest snapshot of the directory, which the next query is answered from
+      std::shared_ptr<const PolicySnapshot> snapshot() const;
+
+    private:
+      // Everything derived from the latest snapshot, updated as the watcher publishes new ones
+      struct State {
+        std::shared_ptr<const PolicySnapshot> snapshot;
+
+        // Names of the top-level profiles of each file, and the include path of each abstraction
+        std::map<std::string, std::vector<std::string>> files;
+        std::map<std::string, std::string> abstractions;
+
+        // Profiles by name, local profiles and hats included
+        std::map<std::string, Profile> byName;
+        std::unique_ptr<PathIndex> index;
+      };
+
+      const State &refresh();
+      void unloadFile(const std::string &path);
+      static void addNames(State &state, const std::string &name, const std::shared_ptr<ProfileNode> &model);
+      bool isAllowed(int client) const;
+      std::string answer(const std::string &request);
+      void run();
+
+      std::string directory;
+      std::string socket_path;
+      mode_t socket_mode;
+      PolicyWatcher watcher;
+
+      int listen_fd = -1;
+      int stop_fd = -1;
+
+      std::unique_ptr<State> state;
+      std::thread thread;
+  };
+}
+
+#endif // APPARMOR_POLICY_DAEMON_HH
@@ -0,0 +1,261 @@
+#include "apparmor_policy_diff.hh"
+#include "parser/hash.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+using Change = AppArmor::PolicyChange;
+
+// A rule with the prefix of its enclosing blocks already applied
+struct FlatRule {
+  Change::Target target;
+  std::string key;
+  std::string text;
+  uint64_t hash;
+  uint64_t startPos;
+  uint64_t stopPos;
+};
+
+static std::string prefixText(bool audit, bool deny, bool owner)
+{
+  std::string text;
+  text += audit? "audit " : "";
+  text += deny?  "deny "  : "";
+  text += owner? "owner " : "";
+  return text;
+}
+
+static void flatten(const RuleList<ProfileNode> &rules, const PrefixNode &outer, std::vector<FlatRule> &out)
+{
+  for(auto &node : rules.getFileList()) {
+    bool audit = outer.isAudit() || node.getPrefix().isAudit();
+    bool deny  = outer.isDeny()  || node.getPrefix().isDeny();
+    bool owner = outer.isOwner() || node.getPrefix().isOwner();
+
+    std::string text = prefixText(audit, deny, owner) + node.getFilename() + " " + node.getFilemode();
+    if(!node.getExecTarget().empty()) {
+      text += " -> " + node.getExecTarget();
+    }
+    text += ",";
+
+    out.push_back({Change::Target::FILE_RULE, node.getFilename(), text, hashCombine(node.hash(), outer.hash()),
+                   node.getStartPosition(), node.getStopPosition()});
+  }
+
+  for(auto &node : rules.getLinkList()) {
+    bool audit = outer.isAudit() || node.getPrefix().isAudit();
+    bool deny  = outer.isDeny()  || node.getPrefix().isDeny();
+    bool owner = outer.isOwner() || node.getPrefix().isOwner();
+
+    std::string text = prefixText(audit, deny, owner) + "link " + (node.isSubsetRule()? "subset " : "") +
+                       node.getFrom() + " -> " + node.getTo() + ",";
+
+    out.push_back({Change::Target::LINK_RULE, node.getFrom(), text, hashCombine(node.hash(), outer.hash()),
+                   node.getStartPosition(), node.getStopPosition()});
+  }
+
+  for(auto &node : rules.getChangeProfileList()) {
+    bool audit = outer.isAudit() || node.getPrefix().isAudit();
+    bool deny  = outer.isDeny()  || node.getPrefix().isDeny();
+    bool owner = outer.isOwner() || node.getPrefix().isOwner();
+
+    std::string text = prefixText(audit, deny, owner) + "change_profile";
+    if(!node.getExecMode().empty()) {
+      text += " " + node.getExecMode();
+    }
+    if(!node.getExecCondition().empty()) {
+      text += " " + node.getExecCondition();
+    }
+    if(!node.getTarget().empty()) {
+      text += " -> " + node.getTarget();
+    }
+    text += ",";
+
+    out.push_back({Change::Target::CHANGE_PROFILE, node.getExecCondition(), text, hashCombine(node.hash(), outer.hash()),
+                   node.getStartPosition(), node.getStopPosition()});
+  }
+
+  for(auto &node : rules.getAbstractionList()) {
+    std::string text = std::string("include ") + (node.isIfExists()? "if exists " : "") + "<" + node.getPath() + ">";
+    out.push_back({Change::Target::ABSTRACTION, node.getPath(), text, node.hash(),
+                   node.getStartPosition(), node.getStopPosition()});
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    PrefixNode inner(outer.isAudit() || block.getPrefix().isAudit(),
+                     outer.isDeny()  || block.getPrefix().isDeny(),
+                     outer.isOwner() || block.getPrefix().isOwner());
+    flatten(block, inner, out);
+  }
+}
+
+static std::vector<FlatRule> flatten(const ProfileNode &profile)
+{
+  std::vector<FlatRule> out;
+  flatten(profile.getRules(), PrefixNode(), out);
+  return out;
+}
+
+static Change profileChange(Change::Kind kind, const std::string &name, const ProfileNode *oldNode, const ProfileNode *newNode)
+{
+  Change change{kind, Change::Target::PROFILE, name};
+  if(oldNode != nullptr) {
+    change.oldText = oldNode->getText();
+    change.oldStartPos = oldNode->getStartPosition();
+    change.oldStopPos  = oldNode->getStopPosition();
+  }
+  if(newNode != nullptr) {
+    change.newText = newNode->getText();
+    change.newStartPos = newNode->getStartPosition();
+    change.newStopPos  = newNode->getStopPosition();
+  }
+  return change;
+}
+
+static void diffProfiles(const std::vector<const ProfileNode *> &oldProfiles,
+                         const std::vector<const ProfileNode *> &newProfiles,
+                         const std::string &parent, std::list<Change> &changes);
+
+static void diffRules(const ProfileNode &oldProfile, const ProfileNode &newProfile,
+                      const std::string &name, std::list<Change> &changes)
+{
+  auto oldRules = flatten(oldProfile);
+  auto newRules = flatten(newProfile);
+
+  // Rules with identical content are unchanged, wherever they moved to
+  std::unordered_multimap<uint64_t, size_t> unmatched;
+  for(size_t i = 0; i < oldRules.size(); i++) {
+    unmatched.emplace(oldRules[i].hash, i);
+  }
+
+  std::vector<bool> kept(oldRules.size(), false);
+  std::vector<const FlatRule *> added;
+  for(auto &rule : newRules) {
+    auto match = unmatched.find(rule.hash);
+    if(match != unmatched.end()) {
+      kept[match->second] = true;
+      unmatched.erase(match);
+    }
+    else {
+      added.push_back(&rule);
+    }
+  }
+
+  // What is left over on both sides for the same path was modified
+  std::map<std::pair<Change::Target, std::string>, std::list<const FlatRule *>> removed;
+  for(size_t i = 0; i < oldRules.size(); i++) {
+    if(!kept[i]) {
+      removed[{oldRules[i].target, oldRules[i].key}].push_back(&oldRules[i]);
+    }
+  }
+
+  for(auto *rule : added) {
+    Change change{Change::Kind::ADDED, rule->target, name};
+    change.newText = rule->text;
+    change.newStartPos = rule->startPos;
+    change.newStopPos  = rule->stopPos;
+
+    auto previous = removed.find({rule->target, rule->key});
+    if(previous != removed.end() && !previous->second.empty()) {
+      auto *old = previous->second.front();
+      previous->second.pop_front();
+
+      change.kind = Change::Kind::MODIFIED;
+      change.oldText = old->text;
+      change.oldStartPos = old->startPos;
+      change.oldStopPos  = old->stopPos;
+    }
+
+    changes.push_back(change);
+  }
+
+  for(auto &entry : removed) {
+    for(auto *rule : entry.second) {
+      Change change{Change::Kind::REMOVED, rule->target, name};
+      change.oldText = rule->text;
+      change.oldStartPos = rule->startPos;
+      change.oldStopPos  = rule->stopPos;
+      changes.push_back(change);
+    }
+  }
+
+  std::vector<const ProfileNode *> oldSubprofiles;
+  for(auto &subprofile : oldProfile.getRules().getSubprofiles()) {
+    oldSubprofiles.push_back(&subprofile);
+  }
+
+  std::vector<const ProfileNode *> newSubprofiles;
+  for(auto &subprofile : newProfile.getRules().getSubprofiles()) {
+    newSubprofiles.push_back(&subprofile);
+  }
+
+  diffProfiles(oldSubprofiles, newSubprofiles, name + "//", changes);
+}
+
+static void diffProfiles(const std::vector<const ProfileNode *> &oldProfiles,
+                         const std::vector<const ProfileNode *> &newProfiles,
+                         const std::string &parent, std::list<Change> &changes)
+{
+  std::map<std::string, const ProfileNode *> unmatched;
+  for(auto *profile : oldProfiles) {
+    unmatched.emplace(profile->getText(), profile);
+  }
+
+  for(auto *profile : newProfiles) {
+    std::string name = parent + profile->getText();
+
+    auto match = unmatched.find(profile->getText());
+    if(match == unmatched.end()) {
+      changes.push_back(profileChange(Change::Kind::ADDED, name, nullptr, profile));
+      continue;
+    }
+
+    const ProfileNode *old = match->second;
+    unmatched.erase(match);
+
+    if(old->hash() != profile->hash()) {
+      changes.push_back(profileChange(Change::Kind::MODIFIED, name, old, profile));
+      diffRules(*old, *profile, name, changes);
+    }
+  }
+
+  for(auto &entry : unmatched) {
+    changes.push_back(profileChange(Change::Kind::REMOVED, parent + entry.first, entry.second, nullptr));
+  }
+}
+
+AppArmor::PolicyDiff::PolicyDiff(const std::list<Profile> &oldProfiles, const std::list<Profile> &newProfiles)
+{
+  // Keep the models alive while comparing, lazy profiles are parsed here
+  std::vector<std::shared_ptr<ProfileNode>> models;
+
+  std::vector<const ProfileNode *> oldNodes;
+  for(auto &profile : oldProfiles) {
+    models.push_back(profile.model());
+    oldNodes.push_back(models.back().get());
+  }
+
+  std::vector<const ProfileNode *> newNodes;
+  for(auto &profile : newProfiles) {
+    models.push_back(profile.model());
+    newNodes.push_back(models.back().get());
+  }
+
+  diffProfiles(oldNodes, newNodes, "", changes);
+}
+
+AppArmor::PolicyDiff::PolicyDiff(const Parser &oldPolicy, const Parser &newPolicy)
+  : PolicyDiff(oldPolicy.getProfileList(), newPolicy.getProfileList())
+{   }
+
+const std::list<AppArmor::PolicyChange> &AppArmor::PolicyDiff::getChanges() const
+{
+  return changes;
+}
+
+bool AppArmor::PolicyDiff::empty() const
+{
+  return changes.empty();
+}
@@ -0,0 +1,52 @@
+#ifndef APPARMOR_POLICY_DIFF_HH
+#define APPARMOR_POLICY_DIFF_HH
+
+#include "apparmor_parser.hh"
+#include "apparmor_profile.hh"
+
+#include <cstdint>
+#include <list>
+#include <string>
+
+namespace AppArmor {
+  // One difference between two versions of a policy
+  struct PolicyChange {
+    enum class Kind   { ADDED, REMOVED, MODIFIED };
+    enum class Target { PROFILE, FILE_RULE, LINK_RULE, ABSTRACTION, CHANGE_PROFILE };
+
+    Kind kind;
+    Target target;
+
+    // Name of the profile the change belongs to, subprofiles are written as parent//child
+    std::string profile;
+
+    // The rule as it reads in each version, empty on the side where it does not exist
+    std::string oldText = "";
+    std::string newText = "";
+
+    // Byte positions in each version, zero on the side where it does not exist
+    uint64_t oldStartPos = 0;
+    uint64_t oldStopPos  = 0;
+    uint64_t newStartPos = 0;
+    uint64_t newStopPos  = 0;
+  };
+
+  // Structural difference between two sets of profiles.
+  // Profiles are matched by name and rules by content, regardless of their order,
+  // whitespace or comments. Unchanged profiles are skipped by comparing content hashes.
+  // A rule is reported as modified when a rule for the same path changed its mode,
+  // qualifiers or exec target, or a change_profile rule for the same executable its target.
+  class PolicyDiff {
+    public:
+      PolicyDiff(const std::list<Profile> &oldProfiles, const std::list<Profile> &newProfiles);
+      PolicyDiff(const Parser &oldPolicy, const Parser &newPolicy);
+
+      const std::list<PolicyChange> &getChanges() const;
+      bool empty() const;
+
+    private:
+      std::list<PolicyChange> changes;
+  };
+}
+
+#endif // APPARMOR_POLICY_DIFF_HH
@@ -0,0 +1,445 @@
+#include "apparmor_policy_watcher.hh"
+#include "parser/batch_reader.hh"
+#include "parser/driver.hh"
+#include "parser/prescan.hh"
+#include "parser/tree/ParseTree.hh"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <poll.h>
+#include <sstream>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <vector>
+
+// One parsed file of the policy directory
+struct PolicyFile {
+  std::shared_ptr<ParseTree> tree;
+  std::unordered_set<std::string> includes;
+  std::string error;
+};
+
+static constexpr uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                         IN_MOVED_TO | IN_DELETE_SELF;
+
+// Editor backups and hidden files are not part of the policy
+static bool isIgnored(const std::string &name)
+{
+  return name.empty() || name[0] == '.' || name.back() == '~';
+}
+
+static std::string parentDirectory(const std::string &path)
+{
+  return std::filesystem::path(path).parent_path().string();
+}
+
+// Include paths are relative to the policy directory, unless they are absolute
+static std::string resolveInclude(const std::string &directory, const std::string &include)
+{
+  if(!include.empty() && include[0] == '/') {
+    return include;
+  }
+
+  return (std::filesystem::path(directory) / include).lexically_normal().string();
+}
+
+static void collectIncludes(const std::string &directory, const RuleList<ProfileNode> &rules, std::unordered_set<std::string> &includes)
+{
+  for(auto &abstraction : rules.getAbstractionList()) {
+    includes.insert(resolveInclude(directory, abstraction.getPath()));
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    collectIncludes(directory, block, includes);
+  }
+
+  for(auto &subprofile : rules.getSubprofiles()) {
+    collectIncludes(directory, subprofile.getRules(), includes);
+  }
+}
+
+static std::shared_ptr<ParseTree> parseText(const std::string &text, bool rulesOnly)
+{
+  std::istringstream stream(text);
+
+  Driver driver;
+  driver.rules_only = rulesOnly;
+  driver.parse(stream);
+  return driver.ast;
+}
+
+static std::shared_ptr<const PolicyFile> parseFile(const std::string &directory, const std::string &text)
+{
+  auto file = std::make_shared<PolicyFile>();
+
+  // Abstractions are bare lists of rules, while tunables only hold variables.
+  // Neither has a top-level profile, so try the rules-only grammar first for those.
+  bool rulesOnlyFirst = prescan(text).profiles.empty();
+
+  try {
+    file->tree = parseText(text, rulesOnlyFirst);
+  }
+  catch(const std::exception &first_error) {
+    try {
+      file->tree = parseText(text, !rulesOnlyFirst);
+    }
+    catch(const std::exception &) {
+      file->error = first_error.what();
+      return file;
+    }
+  }
+
+  for(auto &abstraction : file->tree->preamble.getAbstractionList()) {
+    file->includes.insert(resolveInclude(directory, abstraction.getPath()));
+  }
+
+  for(auto &profile : *file->tree->profileList) {
+    collectIncludes(directory, profile.getRules(), file->includes);
+  }
+
+  return file;
+}
+
+// Regular files directly inside a directory, or below it as well
+static void listFiles(const std::string &path, bool recursive, std::vector<std::string> &found)
+{
+  std::error_code error;
+  for(auto &entry : std::filesystem::directory_iterator(path, error)) {
+    if(isIgnored(entry.path().filename().string())) {
+      continue;
+    }
+
+    if(entry.is_directory(error)) {
+      if(recursive) {
+        listFiles(entry.path().string(), recursive, found);
+      }
+    }
+    else if(entry.is_regular_file(error)) {
+      found.push_back(entry.path().string());
+    }
+  }
+}
+
+uint64_t AppArmor::PolicySnapshot::getGeneration() const
+{
+  return generation;
+}
+
+std::list<std::string> AppArmor::PolicySnapshot::getFiles() const
+{
+  std::list<std::string> paths;
+
+  for(auto &entry : files) {
+    if(entry.second->tree != nullptr) {
+      paths.push_back(entry.first);
+    }
+  }
+
+  return paths;
+}
+
+std::list<AppArmor::Profile> AppArmor::PolicySnapshot::getProfileList() const
+{
+  std::list<AppArmor::Profile> profiles;
+
+  for(auto &entry : files) {
+    profiles.splice(profiles.end(), getProfileList(entry.first));
+  }
+
+  return profiles;
+}
+
+std::list<AppArmor::Profile> AppArmor::PolicySnapshot::getProfileList(const std::string &path) const
+{
+  std::list<AppArmor::Profile> profiles;
+
+  auto entry = files.find(path);
+  if(entry == files.end() || entry->second->tree == nullptr) {
+    return profiles;
+  }
+
+  // Share ownership of the tree rather than copying every profile out of it
+  auto tree = entry->second->tree;
+  for(auto &node : *tree->profileList) {
+    profiles.emplace_back(std::shared_ptr<ProfileNode>(tree, &node));
+  }
+
+  return profiles;
+}
+
+std::unordered_set<std::string> AppArmor::PolicySnapshot::getIncludes(const std::string &path) const
+{
+  auto entry = files.find(path);
+  if(entry == files.end()) {
+    return {};
+  }
+
+  return entry->second->includes;
+}
+
+std::unordered_set<std::string> AppArmor::PolicySnapshot::getAffectedFiles() const
+{
+  return affected;
+}
+
+std::map<std::string, std::string> AppArmor::PolicySnapshot::getErrors() const
+{
+  std::map<std::string, std::string> errors;
+
+  for(auto &entry : files) {
+    if(entry.second->tree == nullptr) {
+      errors.emplace(entry.first, entry.second->error);
+    }
+  }
+
+  return errors;
+}
+
+AppArmor::PolicyWatcher::PolicyWatcher(const std::string &directory, std::chrono::milliseconds debounce)
+  : directory{std::filesystem::path(directory).lexically_normal().string()},
+    debounce{debounce}
+{
+  inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if(inotify_fd < 0 || stop_fd < 0) {
+    throw std::runtime_error("could not set up inotify for " + directory);
+  }
+
+  // Watches are added before the initial parse, so nothing written in between is missed
+  std::unordered_set<std::string> found;
+  watchDirectory(this->directory, found);
+
+  publish(std::make_shared<PolicySnapshot>());
+  reload(found);
+
+  thread = std::thread(&PolicyWatcher::run, this);
+}
+
+AppArmor::PolicyWatcher::~PolicyWatcher()
+{
+  uint64_t stop = 1;
+  if(write(stop_fd, &stop, sizeof(stop)) != sizeof(stop)) {
+    std::terminate();
+  }
+  thread.join();
+
+  close(inotify_fd);
+  close(stop_fd);
+}
+
+std::shared_ptr<const AppArmor::PolicySnapshot> AppArmor::PolicyWatcher::snapshot() const
+{
+  return std::atomic_load(&current);
+}
+
+void AppArmor::PolicyWatcher::publish(std::shared_ptr<const PolicySnapshot> snapshot)
+{
+  std::atomic_store(&current, snapshot);
+}
+
+// Adds a watch on the directory and every directory below it, collecting the files found
+void AppArmor::PolicyWatcher::watchDirectory(const std::string &path, std::unordered_set<std::string> &found)
+{
+  int wd = inotify_add_watch(inotify_fd, path.c_str(), WATCH_EVENTS);
+  if(wd < 0) {
+    return;
+  }
+  watches[wd] = path;
+
+  std::error_code error;
+  for(auto &entry : std::filesystem::directory_iterator(path, error)) {
+    auto name = entry.path().filename().string();
+    if(isIgnored(name)) {
+      continue;
+    }
+
+    if(entry.is_directory(error)) {
+      watchDirectory(entry.path().string(), found);
+    }
+    else if(entry.is_regular_file(error)) {
+      found.insert(entry.path().string());
+    }
+  }
+}
+
+void AppArmor::PolicyWatcher::run()
+{
+  std::unordered_set<std::string> changed;
+  std::vector<char> buffer(64 * 1024);
+
+  while(true) {
+    struct pollfd fds[2] = {
+      {.fd = inotify_fd, .events = POLLIN, .revents = 0},
+      {.fd = stop_fd,    .events = POLLIN, .revents = 0},
+    };
+
+    // Only wait for the debounce interval once something has changed
+    int timeout = changed.empty()? -1 : static_cast<int>(debounce.count());
+    int ready = poll(fds, 2, timeout);
+
+    if(ready < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+
+    if(fds[1].revents & POLLIN) {
+      return;
+    }
+
+    if(ready == 0) {
+      reload(changed);
+      changed.clear();
+      continue;
+    }
+
+    ssize_t length;
+    while((length = read(inotify_fd, buffer.data(), buffer.size())) > 0) {
+      for(char *ptr = buffer.data(); ptr < buffer.data() + length; ) {
+        auto *event = reinterpret_cast<struct inotify_event *>(ptr);
+        ptr += sizeof(struct inotify_event) + event->len;
+
+        if(event->mask & IN_IGNORED) {
+          watches.erase(event->wd);
+          continue;
+        }
+
+        auto watch = watches.find(event->wd);
+        if(watch == watches.end() || event->len == 0 || isIgnored(event->name)) {
+          continue;
+        }
+
+        std::string path = watch->second + "/" + event->name;
+        if((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+          watchDirectory(path, changed);
+        }
+        else if(!(event->mask & IN_ISDIR)) {
+          changed.insert(path);
+        }
+      }
+    }
+  }
+}
+
+std::shared_ptr<const AppArmor::PolicySnapshot> AppArmor::PolicyWatcher::load(const std::string &directory)
+{
+  std::vector<std::string> found;
+  auto normalized = std::filesystem::path(directory).lexically_normal().string();
+  listFiles(normalized, true, found);
+
+  auto snapshot = std::make_shared<PolicySnapshot>();
+  snapshot->generation = 1;
+  loadFiles(normalized, std::unordered_set<std::string>(found.begin(), found.end()), *snapshot);
+  return snapshot;
+}
+
+// Reads the files in batches and parses each one as soon as it has been read. Files they include
+// that the snapshot does not hold yet, such as those outside the directory, are loaded as well.
+// Paths that are no longer regular files are dropped from the snapshot.
+void AppArmor::PolicyWatcher::loadFiles(const std::string &directory, const std::unordered_set<std::string> &paths,
+                                        PolicySnapshot &snapshot)
+{
+  std::mutex mutex;
+  std::unordered_set<std::string> queued;
+  std::unique_ptr<BatchReader> reader;
+
+  // Queues a file, or every file of an included directory, once. Called with the mutex held.
+  std::function<void(const std::string &)> queue = [&](const std::string &path) {
+    if(!queued.insert(path).second) {
+      return;
+    }
+
+    std::error_code error;
+    if(std::filesystem::is_regular_file(path, error)) {
+      reader->submit(path);
+    }
+    else if(std::filesystem::is_directory(path, error)) {
+      std::vector<std::string> found;
+      listFiles(path, false, found);
+      for(auto &file : found) {
+        queue(file);
+      }
+    }
+  };
+
+  reader = std::make_unique<BatchReader>([&](const std::string &path, const std::string &contents, int error) {
+    std::shared_ptr<const PolicyFile> file;
+    if(error == 0) {
+      file = parseFile(directory, contents);
+    }
+    else {
+      auto failed = std::make_shared<PolicyFile>();
+      failed->error = "could not read " + path + ": " + std::strerror(error);
+      file = failed;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot.files[path] = file;
+    for(auto &include : file->includes) {
+      if(snapshot.files.count(include) == 0) {
+        queue(include);
+      }
+    }
+  });
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for(auto &path : paths) {
+      std::error_code error;
+      if(std::filesystem::is_regular_file(path, error)) {
+        queue(path);
+      }
+      else {
+        snapshot.files.erase(path);
+      }
+    }
+  }
+
+  reader->wait();
+}
+
+// Parses the changed files again and publishes a snapshot that shares every other file
+void AppArmor::PolicyWatcher::reload(const std::unordered_set<std::string> &changed)
+{
+  auto next = std::make_shared<PolicySnapshot>(*snapshot());
+  next->generation++;
+  next->affected.clear();
+
+  loadFiles(directory, changed, *next);
+
+  // Invalidate everything that includes a changed file, directly or through other includes.
+  // Including a directory depends on every file inside of it.
+  std::unordered_map<std::string, std::vector<std::string>> dependents;
+  for(auto &entry : next->files) {
+    for(auto &include : entry.second->includes) {
+      dependents[include].push_back(entry.first);
+    }
+  }
+
+  std::vector<std::string> pending(changed.begin(), changed.end());
+  while(!pending.empty()) {
+    auto path = pending.back();
+    pending.pop_back();
+
+    if(!next->affected.insert(path).second) {
+      continue;
+    }
+
+    for(auto &key : {path, parentDirectory(path)}) {
+      auto users = dependents.find(key);
+      if(users != dependents.end()) {
+        pending.insert(pending.end(), users->second.begin(), users->second.end());
+      }
+    }
+  }
+
+  publish(next);
+}
@@ -0,0 +1,92 @@
+#ifndef APPARMOR_POLICY_WATCHER_HH
+#define APPARMOR_POLICY_WATCHER_HH
+
+#include "apparmor_profile.hh"
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+struct PolicyFile;
+
+namespace AppArmor {
+  // An immutable view of every file in a policy directory, as it was parsed at one point in time.
+  // Files that did not change between two snapshots share the same parsed tree.
+  class PolicySnapshot {
+    public:
+      // Increases by one every time the watcher publishes a new snapshot
+      uint64_t getGeneration() const;
+
+      // Paths of every file that parsed successfully
+      std::list<std::string> getFiles() const;
+
+      // Profiles from every file, or from a single file.
+      // Abstractions appear as a single unnamed profile holding their rules.
+      std::list<AppArmor::Profile> getProfileList() const;
+      std::list<AppArmor::Profile> getProfileList(const std::string &path) const;
+
+      // Resolved paths of the files and directories included by a file
+      std::unordered_set<std::string> getIncludes(const std::string &path) const;
+
+      // Files that changed since the previous snapshot, along with every file that includes them
+      std::unordered_set<std::string> getAffectedFiles() const;
+
+      // Files that could not be parsed, with the error that was reported
+      std::map<std::string, std::string> getErrors() const;
+
+    private:
+      friend class PolicyWatcher;
+
+      uint64_t generation = 0;
+      std::map<std::string, std::shared_ptr<const PolicyFile>> files;
+      std::unordered_set<std::string> affected;
+  };
+
+  // Keeps an up-to-date parsed view of a policy directory such as /etc/apparmor.d.
+  // Changes are picked up with inotify and only the files that changed are parsed again.
+  // Bursts of writes are collected until the directory has been quiet for the debounce interval.
+  // Files are read and parsed the same way as by load().
+  class PolicyWatcher {
+    public:
+      explicit PolicyWatcher(const std::string &directory,
+                             std::chrono::milliseconds debounce = std::chrono::milliseconds(100));
+      ~PolicyWatcher();
+
+      PolicyWatcher(const PolicyWatcher &) = delete;
+      PolicyWatcher& operator=(const PolicyWatcher &) = delete;
+
+      // The most recently published snapshot. Never blocks on a reload in progress.
+      std::shared_ptr<const PolicySnapshot> snapshot() const;
+
+      // Parses every file of a directory once, without watching it for changes.
+      // Files are read in batches through io_uring where the kernel allows it, and each
+      // is parsed as soon as it has been read. Included files outside the directory are loaded too.
+      static std::shared_ptr<const PolicySnapshot> load(const std::string &directory);
+
+    private:
+      static void loadFiles(const std::string &directory, const std::unordered_set<std::string> &paths,
+                            PolicySnapshot &snapshot);
+      void watchDirectory(const std::string &path, std::unordered_set<std::string> &found);
+      void run();
+      void reload(const std::unordered_set<std::string> &changed);
+      void publish(std::shared_ptr<const PolicySnapshot> snapshot);
+
+      std::string directory;
+      std::chrono::milliseconds debounce;
+
+      int inotify_fd = -1;
+      int stop_fd = -1;
+      std::unordered_map<int, std::string> watches;
+
+      std::shared_ptr<const PolicySnapshot> current;
+      std::thread thread;
+  };
+}
+
+#endif // APPARMOR_POLICY_WATCHER_HH
@@ -2,6 +2,8 @@
 #include "parser/tree/AbstractionNode.hh"
 #include "parser/tree/ProfileNode.hh"
 #include "parser/tree/FileNode.hh"
+#include "parser/lazy_profile.hh"
+#include "parser/mapped_profile.hh"
 
 #include <iostream>
 
@@ -9,8 +11,39 @@ AppArmor::Profile::Profile(std::shared_ptr<ProfileNode> profile_model)
   : profile_model{profile_model}
 {   }
 
+AppArmor::Profile::Profile(std::shared_ptr<LazyProfile> lazy_model)
+  : lazy_model{lazy_model}
+{   }
+
+AppArmor::Profile::Profile(std::shared_ptr<MappedProfile> mapped_model)
+  : mapped_model{mapped_model}
+{   }
+
+std::shared_ptr<ProfileNode> AppArmor::Profile::model() const
+{
+  if(mapped_model != nullptr) {
+    return mapped_model->get();
+  }
+
+  if(profile_model == nullptr) {
+    return lazy_model->get();
+  }
+
+  return profile_model;
+}
+
 std::string AppArmor::Profile::name() const
 {
+    // The name is read from the image, without decoding the rest of the profile
+    if(mapped_model != nullptr) {
+      return mapped_model->getName();
+    }
+
+    // The pre-scan already knows the name, so this never triggers a parse
+    if(profile_model == nullptr) {
+      return lazy_model->getName();
+    }
+
     return profile_model->getText();
 }
 
@@ -18,10 +51,10 @@ std::unordered_set<std::string> AppArmor::Profile::getAbstractions() const
 {
   std::unordered_set<std::string> set;
 
-  auto ruleList = profile_model->getRules();
-  auto abstractionList = ruleList.getAbstractionList();
+  auto &ruleList = model()->getRules();
+  auto &abstractionList = ruleList.getAbstractionList();
 
-  for(AbstractionNode node : abstractionList) {
+  for(const AbstractionNode &node : abstractionList) {
     set.insert(node.getPath());
   }
 
@@ -33,13 +66,45 @@ std::list<AppArmor::FileRule> AppArmor::Profile::getFileRules() const
 {
   std::list<AppArmor::FileRule> set;
 
-  auto ruleList = profile_model->getRules();
-  auto fileRuleList = ruleList.getFileList();
+  auto profile = model();
+  auto &ruleList = profile->getRules();
+  auto &fileRuleList = ruleList.getFileList();
 
-  for(FileNode node : fileRuleList) {
-    auto ptr = std::make_shared<FileNode>(node);
-    set.emplace_back(ptr);
+  // Each rule shares ownership of the tree rather than being copied out of it
+  for(const FileNode &node : fileRuleList) {
+    set.emplace_back(std::shared_ptr<const FileNode>(profile, &node));
   }
 
   return set;
-}
\ No newline at end of file
+}
+
+AppArmor::FileRuleRange AppArmor::Profile::fileRules() const
+{
+  auto profile = model();
+  return FileRuleRange(profile, &profile->getRules().getFileList());
+}
+
+uint64_t AppArmor::Profile::hash() const
+{
+  return model()->hash();
+}
+
+AppArmor::MemoryUsage AppArmor::Profile::memoryUsage() const
+{
+  MemoryUsage usage;
+  usage.profiles += sizeof(ProfileNode);
+  model()->addMemoryUsage(usage);
+  return usage;
+}
+
+AppArmor::Profile AppArmor::Profile::evaluate(const std::map<std::string, bool> &booleans, const std::set<std::string> &variables) const
+{
+  EvaluationContext context;
+  context.booleans = booleans;
+  context.variables = variables;
+  context.complete = true;
+
+  auto node = std::make_shared<ProfileNode>(*model());
+  node->resolveConditionals(context);
+  return Profile(node);
+}
@@ -1,18 +1,27 @@
 #ifndef APPARMOR_PROFILE_HH
 #define APPARMOR_PROFILE_HH
 
+#include <cstdint>
 #include <list>
+#include <map>
 #include <memory>
+#include <set>
+#include <string>
 #include <unordered_set>
 
 #include "apparmor_file_rule.hh"
+#include "apparmor_memory_usage.hh"
 
+class LazyProfile;
+class MappedProfile;
 class ProfileNode;
 
 namespace AppArmor {
   class Profile {
     public:
       Profile(std::shared_ptr<ProfileNode> profile_model);
+      Profile(std::shared_ptr<LazyProfile> lazy_model);
+      Profile(std::shared_ptr<MappedProfile> mapped_model);
 
       // Returns the name of this profile
       std::string name() const;
@@ -23,8 +32,47 @@ namespace AppArmor {
       // Returns a list of file rules included in the profile
       std::list<AppArmor::FileRule> getFileRules() const;
 
+      // The same rules as handles into the parsed tree, which allocate nothing as they are gone through
+      FileRuleRange fileRules() const;
+
+      // Returns a hash of the profile contents, computed while parsing: its header with the
+      // attachment, xattrs and flags, and every rule of every kind, down to the tokens of the
+      // rules that have no node type of their own. Whitespace, comments, rule order and positions
+      // in the file do not affect it, so equal hashes mean the profile did not change.
+      // Variables are hashed as written; their values are part of the preamble, not the profile.
+      // Rule kinds left out with ParseOptions::kinds are left out of the hash as well.
+      // Parses a lazily loaded profile.
+      uint64_t hash() const;
+
+      // Returns the bytes held by the parsed profile, its rules and subprofiles, split by node type.
+      // The file source kept by a lazily loaded profile is not included. Parses a lazily loaded profile.
+      MemoryUsage memoryUsage() const;
+
+      // Returns the profile with every conditional rule replaced by its live branch, for the
+      // given values of boolean variables ($foo) and names of defined set variables (@{foo}).
+      // Variables that are not listed count as undefined, and undefined booleans as false.
+      // Rules under a conditional are only reported once it is resolved, so this is how a profile
+      // parsed with ParseOptions::keepConditionals is read in a given context.
+      Profile evaluate(const std::map<std::string, bool> &booleans, const std::set<std::string> &variables = {}) const;
+
     private:
+      friend class AttachmentResolver;
+      friend class AuditMatcher;
+      friend class PathIndex;
+      friend class PolicyCompiler;
+      friend class PolicyDaemon;
+      friend class PolicyDiff;
+      friend class ProfileStore;
+      friend class RuleAnalysis;
+      friend class SharedPolicy;
+      friend class TransitionGraph;
+
+      // Parses the profile first, if it was loaded lazily, or decodes it from a mapped policy image
+      std::shared_ptr<ProfileNode> model() const;
+
       std::shared_ptr<ProfileNode> profile_model;
+      std::shared_ptr<LazyProfile> lazy_model;
+      std::shared_ptr<MappedProfile> mapped_model;
   };
 }
 
@@ -0,0 +1,116 @@
+#include "apparmor_profile_store.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <atomic>
+#include <stdexcept>
+
+uint64_t AppArmor::ProfileVersion::getGeneration() const
+{
+  return generation;
+}
+
+std::list<AppArmor::Profile> AppArmor::ProfileVersion::getProfileList() const
+{
+  std::list<AppArmor::Profile> list;
+  for(auto &profile : profiles) {
+    list.emplace_back(profile);
+  }
+  return list;
+}
+
+AppArmor::Profile AppArmor::ProfileVersion::getProfile(const std::string &name) const
+{
+  auto entry = index.find(name);
+  if(entry == index.end()) {
+    throw std::out_of_range("no profile named " + name);
+  }
+  return AppArmor::Profile(profiles[entry->second]);
+}
+
+AppArmor::ProfileStore::ProfileStore(const std::list<Profile> &profiles)
+{
+  auto first = std::make_shared<ProfileVersion>();
+
+  // Lazily loaded profiles are parsed once here, rather than by whichever reader gets to them first
+  for(auto &profile : profiles) {
+    first->index.emplace(profile.name(), first->profiles.size());
+    first->profiles.push_back(profile.model());
+  }
+
+  current = first;
+}
+
+std::shared_ptr<const AppArmor::ProfileVersion> AppArmor::ProfileStore::snapshot() const
+{
+  return std::atomic_load(&current);
+}
+
+namespace {
+  // The node that a file rule was made from, so that only that one rule is removed
+  FileNode matching(const AppArmor::FileRule &fileRule)
+  {
+    FileNode node(0, 0, fileRule.getFilename(), fileRule.getFilemode(), fileRule.getExecTarget());
+    node.setPrefix(PrefixNode(fileRule.isAudit(), fileRule.isDeny(), fileRule.isOwner()));
+    return node;
+  }
+}
+
+// Copies the profile, applies the edit to the copy and publishes a version holding it
+template <typename Edit>
+std::shared_ptr<const AppArmor::ProfileVersion> AppArmor::ProfileStore::update(const std::string &profile, Edit edit)
+{
+  std::lock_guard<std::mutex> lock(writer);
+
+  auto base = snapshot();
+  auto entry = base->index.find(profile);
+  if(entry == base->index.end()) {
+    throw std::runtime_error("no profile named " + profile);
+  }
+
+  auto copy = std::make_shared<ProfileNode>(*base->profiles[entry->second]);
+  edit(*copy);
+
+  // Only the pointers are copied, every other profile is shared with the base version
+  auto next = std::make_shared<ProfileVersion>(*base);
+  next->generation++;
+  next->profiles[entry->second] = copy;
+
+  std::shared_ptr<const ProfileVersion> published = next;
+  std::atomic_store(&current, published);
+  return published;
+}
+
+std::shared_ptr<const AppArmor::ProfileVersion> AppArmor::ProfileStore::addRule(const std::string &profile,
+                                                                                const std::string &fileRule,
+                                                                                const std::string &fileMode)
+{
+  return update(profile, [&](ProfileNode &node) {
+    FileNode rule(0, 0, fileRule, fileMode);
+    node.appendFileNode(PrefixNode(), rule);
+  });
+}
+
+std::shared_ptr<const AppArmor::ProfileVersion> AppArmor::ProfileStore::removeRule(const std::string &profile,
+                                                                                   const AppArmor::FileRule &fileRule)
+{
+  return update(profile, [&](ProfileNode &node) {
+    if(!node.removeFileNode(matching(fileRule))) {
+      throw std::runtime_error("no rule " + fileRule.getFilename() + " " + fileRule.getFilemode() + " in " + profile);
+    }
+  });
+}
+
+std::shared_ptr<const AppArmor::ProfileVersion> AppArmor::ProfileStore::editRule(const std::string &profile,
+                                                                                 const AppArmor::FileRule &oldFileRule,
+                                                                                 const std::string &newFileRule,
+                                                                                 const std::string &newFileMode)
+{
+  return update(profile, [&](ProfileNode &node) {
+    if(!node.removeFileNode(matching(oldFileRule))) {
+      throw std::runtime_error("no rule " + oldFileRule.getFilename() + " " + oldFileRule.getFilemode() + " in " + profile);
+    }
+
+    FileNode rule(0, 0, newFileRule, newFileMode);
+    node.appendFileNode(PrefixNode(), rule);
+  });
+}
@@ -0,0 +1,76 @@
+#ifndef APPARMOR_PROFILE_STORE_HH
+#define APPARMOR_PROFILE_STORE_HH
+
+#include "apparmor_file_rule.hh"
+#include "apparmor_profile.hh"
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace AppArmor {
+  // One version of the profiles of a ProfileStore. It never changes once published,
+  // so it can be read from any number of threads without locking.
+  class ProfileVersion {
+    public:
+      // Starts at 0 and increases by one with every edit
+      uint64_t getGeneration() const;
+
+      // Every profile, in the order they were given to the store
+      std::list<AppArmor::Profile> getProfileList() const;
+
+      // Throws std::out_of_range if there is no profile with that name
+      AppArmor::Profile getProfile(const std::string &name) const;
+
+    private:
+      friend class ProfileStore;
+
+      uint64_t generation = 0;
+
+      // Profiles that an edit did not touch are shared with the versions before it
+      std::vector<std::shared_ptr<ProfileNode>> profiles;
+      std::unordered_map<std::string, size_t> index;
+  };
+
+  // Holds parsed profiles that many threads read while another one edits them.
+  //
+  // An edit copies the one profile it changes and builds a new version that shares every
+  // other profile with the current one, then publishes it with std::atomic_store.
+  // Readers take the current version with snapshot() and keep using it for as long as they
+  // like, and they never see a half-applied edit. This is not lock-free: libstdc++ guards the
+  // atomic shared_ptr functions with a small internal lock, but that lock is only held while
+  // the pointer is copied, so a reader never waits for an edit to be built.
+  // A version is freed once the last reader holding it lets go of it.
+  //
+  // Edits are made in memory only, use Parser::addRule() and the others to change a file.
+  // Edits are serialized with each other. Each one returns the version it published, and
+  // throws std::runtime_error, publishing nothing, when the profile or rule does not exist.
+  // A rule is removed only if its path, mode, exec target and audit/deny/owner qualifiers all
+  // match. Only the file rules directly in a profile can be edited: rules inside blocks,
+  // conditionals and subprofiles are not addressable, and removing one of them throws.
+  class ProfileStore {
+    public:
+      explicit ProfileStore(const std::list<Profile> &profiles);
+
+      std::shared_ptr<const ProfileVersion> snapshot() const;
+
+      std::shared_ptr<const ProfileVersion> addRule(const std::string &profile, const std::string &fileRule,
+                                                    const std::string &fileMode);
+      std::shared_ptr<const ProfileVersion> removeRule(const std::string &profile, const AppArmor::FileRule &fileRule);
+      std::shared_ptr<const ProfileVersion> editRule(const std::string &profile, const AppArmor::FileRule &oldFileRule,
+                                                     const std::string &newFileRule, const std::string &newFileMode);
+
+    private:
+      template <typename Edit>
+      std::shared_ptr<const ProfileVersion> update(const std::string &profile, Edit edit);
+
+      std::mutex writer;
+      std::shared_ptr<const ProfileVersion> current;
+  };
+}
+
+#endif // APPARMOR_PROFILE_STORE_HH
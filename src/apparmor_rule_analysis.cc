@@ -0,0 +1,255 @@
+#include "apparmor_rule_analysis.hh"
+#include "parser/file_mode.hh"
+#include "parser/glob.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+// A file rule with the prefix of its enclosing blocks applied, and its globs expanded
+struct AnalyzedRule {
+  std::shared_ptr<FileNode> node;
+  std::string abstraction;
+  FileMode mode = FileMode();
+  std::vector<std::string> alternatives = {};
+  bool expanded = false;
+};
+
+// Maps literal glob prefixes to the alternatives that start with them
+class PrefixIndex {
+  public:
+    PrefixIndex() : nodes(1) {}
+
+    void insert(const std::string &prefix, size_t value)
+    {
+      size_t current = 0;
+      for(char c : prefix) {
+        auto child = nodes[current].children.find(c);
+        if(child == nodes[current].children.end()) {
+          nodes.emplace_back();
+          child = nodes[current].children.emplace(c, nodes.size() - 1).first;
+        }
+        current = child->second;
+      }
+      nodes[current].values.push_back(value);
+    }
+
+    // Every value whose prefix is a prefix of text
+    template <typename Function>
+    void forEachPrefixOf(const std::string &text, Function function) const
+    {
+      size_t current = 0;
+      for(size_t i = 0; ; i++) {
+        for(size_t value : nodes[current].values) {
+          function(value);
+        }
+
+        if(i == text.size()) {
+          return;
+        }
+
+        auto child = nodes[current].children.find(text[i]);
+        if(child == nodes[current].children.end()) {
+          return;
+        }
+        current = child->second;
+      }
+    }
+
+  private:
+    struct Node {
+      std::map<char, size_t> children;
+      std::vector<size_t> values;
+    };
+
+    std::vector<Node> nodes;
+};
+
+static void collectRules(const RuleList<ProfileNode> &rules, const PrefixNode &outer,
+                         const std::string &abstraction, std::vector<AnalyzedRule> &out)
+{
+  for(auto &file : rules.getFileList()) {
+    auto node = std::make_shared<FileNode>(file);
+    node->setPrefix(PrefixNode(outer.isAudit() || file.getPrefix().isAudit(),
+                               outer.isDeny()  || file.getPrefix().isDeny(),
+                               outer.isOwner() || file.getPrefix().isOwner()));
+
+    AnalyzedRule rule{node, abstraction};
+
+    // A bare "file," rule allows everything
+    if(file.getFilename().empty()) {
+      rule.mode = FileMode("mrwlkix");
+      rule.alternatives.push_back("/**");
+      rule.expanded = true;
+    }
+    else {
+      rule.mode = FileMode(file.getFilemode());
+      rule.expanded = expandAlternations(file.getFilename(), rule.alternatives);
+    }
+
+    out.push_back(rule);
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    PrefixNode inner(outer.isAudit() || block.getPrefix().isAudit(),
+                     outer.isDeny()  || block.getPrefix().isDeny(),
+                     outer.isOwner() || block.getPrefix().isOwner());
+    collectRules(block, inner, abstraction, out);
+  }
+}
+
+static void collectIncludes(const RuleList<ProfileNode> &rules, std::vector<std::string> &out)
+{
+  for(auto &abstraction : rules.getAbstractionList()) {
+    out.push_back(abstraction.getPath());
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    collectIncludes(block, out);
+  }
+}
+
+// Whether the permissions and qualifiers of outer make inner pointless, ignoring paths
+static bool coversMode(const AnalyzedRule &outer, const AnalyzedRule &inner)
+{
+  auto &outerPrefix = outer.node->getPrefix();
+  auto &innerPrefix = inner.node->getPrefix();
+
+  if(outerPrefix.isOwner() && !innerPrefix.isOwner()) {
+    return false;
+  }
+
+  // Deny rules win over allow rules, whatever the exec transition
+  if(outerPrefix.isDeny()) {
+    if(innerPrefix.isDeny() && innerPrefix.isAudit() && !outerPrefix.isAudit()) {
+      return false;
+    }
+    return (inner.mode.perms & ~outer.mode.perms) == 0;
+  }
+
+  if(innerPrefix.isDeny() || (innerPrefix.isAudit() && !outerPrefix.isAudit())) {
+    return false;
+  }
+
+  return outer.mode.covers(inner.mode) &&
+         (!(inner.mode.perms & FileMode::EXEC) || outer.node->getExecTarget() == inner.node->getExecTarget());
+}
+
+static bool coversRule(const AnalyzedRule &outer, const AnalyzedRule &inner)
+{
+  if(!inner.expanded || !coversMode(outer, inner)) {
+    return false;
+  }
+
+  for(auto &innerPath : inner.alternatives) {
+    bool covered = false;
+    for(auto &outerPath : outer.alternatives) {
+      if(globContains(outerPath, innerPath)) {
+        covered = true;
+        break;
+      }
+    }
+
+    if(!covered) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+AppArmor::RuleAnalysis::RuleAnalysis(const Profile &profile, const std::map<std::string, Profile> &abstractions)
+{
+  auto model = profile.model();
+
+  // Abstraction rules come first, so a rule repeated in the profile is the one reported
+  std::vector<AnalyzedRule> rules;
+
+  std::vector<std::string> pending;
+  collectIncludes(model->getRules(), pending);
+
+  std::unordered_set<std::string> included;
+  while(!pending.empty()) {
+    auto path = pending.back();
+    pending.pop_back();
+
+    auto abstraction = abstractions.find(path);
+    if(abstraction == abstractions.end() || !included.insert(path).second) {
+      continue;
+    }
+
+    auto &abstractionRules = abstraction->second.model()->getRules();
+    collectRules(abstractionRules, PrefixNode(), path, rules);
+    collectIncludes(abstractionRules, pending);
+  }
+
+  size_t firstProfileRule = rules.size();
+  collectRules(model->getRules(), PrefixNode(), "", rules);
+
+  // (rule, alternative) pairs, indexed by the literal prefix of the alternative
+  std::vector<std::pair<size_t, size_t>> alternatives;
+  PrefixIndex index;
+  for(size_t i = 0; i < rules.size(); i++) {
+    for(size_t j = 0; j < rules[i].alternatives.size(); j++) {
+      index.insert(globLiteralPrefix(rules[i].alternatives[j]), alternatives.size());
+      alternatives.emplace_back(i, j);
+    }
+  }
+
+  for(size_t i = firstProfileRule; i < rules.size(); i++) {
+    auto &rule = rules[i];
+    if(!rule.expanded) {
+      continue;
+    }
+
+    bool covered = true;
+    bool shadowed = false;
+    size_t coveredBy = i;
+
+    for(auto &path : rule.alternatives) {
+      size_t found = i;
+
+      index.forEachPrefixOf(globLiteralPrefix(path), [&](size_t value) {
+        size_t other = alternatives[value].first;
+        if(found != i || other == i) {
+          return;
+        }
+
+        auto &candidate = rules[other];
+        if(!coversMode(candidate, rule) || !globContains(candidate.alternatives[alternatives[value].second], path)) {
+          return;
+        }
+
+        // Of two rules that cover each other, only the later one is redundant
+        if(other > i && coversRule(rule, candidate)) {
+          return;
+        }
+
+        found = other;
+      });
+
+      if(found == i) {
+        covered = false;
+        break;
+      }
+
+      if(coveredBy == i) {
+        coveredBy = found;
+      }
+      shadowed |= rules[found].node->getPrefix().isDeny() && !rule.node->getPrefix().isDeny();
+    }
+
+    if(covered) {
+      findings.push_back({shadowed? RuleFinding::Kind::SHADOWED : RuleFinding::Kind::REDUNDANT,
+                          AppArmor::FileRule(rule.node),
+                          AppArmor::FileRule(rules[coveredBy].node),
+                          rules[coveredBy].abstraction});
+    }
+  }
+}
+
+const std::list<AppArmor::RuleFinding> &AppArmor::RuleAnalysis::getFindings() const
+{
+  return findings;
+}
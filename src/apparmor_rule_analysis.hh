@@ -0,0 +1,53 @@
+#ifndef APPARMOR_RULE_ANALYSIS_HH
+#define APPARMOR_RULE_ANALYSIS_HH
+
+#include "apparmor_file_rule.hh"
+#include "apparmor_profile.hh"
+
+#include <list>
+#include <map>
+#include <string>
+
+namespace AppArmor {
+  // A file rule of a profile that has no effect on the policy
+  struct RuleFinding {
+    enum class Kind {
+      // Everything the rule allows (or denies) is already allowed (or denied) by another rule
+      REDUNDANT,
+      // Everything the rule allows is denied by a deny rule
+      SHADOWED
+    };
+
+    Kind kind;
+
+    // The rule that has no effect
+    AppArmor::FileRule rule;
+
+    // The rule that covers it
+    AppArmor::FileRule coveredBy;
+
+    // Include path of the abstraction that holds coveredBy, empty when it is in the profile itself
+    std::string abstraction;
+  };
+
+  // Finds the file rules of a profile that are covered by other rules, comparing
+  // globs and permissions. Rules from included abstractions are taken into account
+  // when they are passed in, keyed by their include path (e.g. "abstractions/base").
+  // Abstractions that include other abstractions are followed through the same map.
+  //
+  // Covering rules are indexed by the literal prefix of their globs, so each rule
+  // is only compared with the rules whose prefix it starts with.
+  // The glob comparison is conservative: a rule that is reported is always covered,
+  // but a rule that is covered only by a combination of variables may be missed.
+  class RuleAnalysis {
+    public:
+      RuleAnalysis(const Profile &profile, const std::map<std::string, Profile> &abstractions = {});
+
+      const std::list<RuleFinding> &getFindings() const;
+
+    private:
+      std::list<RuleFinding> findings;
+  };
+}
+
+#endif // APPARMOR_RULE_ANALYSIS_HH
@@ -0,0 +1,170 @@
+#include "apparmor_shared_policy.hh"
+#include "parser/mapped_profile.hh"
+#include "parser/policy_image.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static std::runtime_error systemError(const std::string &what)
+{
+  return std::runtime_error(what + ": " + strerror(errno));
+}
+
+// Writes the image through the descriptor rather than a mapping, since a sealed memfd
+// refuses F_SEAL_WRITE while a writable mapping of it exists
+static void writeImage(int fd, const std::string &image)
+{
+  if(ftruncate(fd, image.size()) != 0) {
+    throw systemError("could not size policy image");
+  }
+
+  // The header goes last, so a reader that opens the segment early never finds a valid one
+  size_t offset = PolicyImage::HEADER_SIZE;
+  while(offset < image.size()) {
+    ssize_t count = pwrite(fd, image.data() + offset, image.size() - offset, offset);
+    if(count < 0 && errno == EINTR) {
+      continue;
+    }
+    if(count < 0) {
+      throw systemError("could not write policy image");
+    }
+    offset += count;
+  }
+
+  if(pwrite(fd, image.data(), PolicyImage::HEADER_SIZE, 0) != static_cast<ssize_t>(PolicyImage::HEADER_SIZE)) {
+    throw systemError("could not write policy image");
+  }
+}
+
+std::string AppArmor::SharedPolicy::encode(const std::list<Profile> &profiles)
+{
+  std::vector<std::shared_ptr<ProfileNode>> models;
+  for(auto &profile : profiles) {
+    models.push_back(profile.model());
+  }
+
+  return PolicyImage::encode(models);
+}
+
+void AppArmor::SharedPolicy::publish(const std::string &name, const std::list<Profile> &profiles)
+{
+  std::string image = encode(profiles);
+
+  // A new object rather than the old one rewritten, which processes may still have mapped
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0444);
+  if(fd < 0) {
+    throw systemError("could not create " + name);
+  }
+
+  try {
+    writeImage(fd, image);
+  }
+  catch(...) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw;
+  }
+
+  close(fd);
+}
+
+void AppArmor::SharedPolicy::unpublish(const std::string &name)
+{
+  if(shm_unlink(name.c_str()) != 0 && errno != ENOENT) {
+    throw systemError("could not remove " + name);
+  }
+}
+
+int AppArmor::SharedPolicy::publishSealed(const std::list<Profile> &profiles)
+{
+  std::string image = encode(profiles);
+
+  int fd = memfd_create("apparmor-policy", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if(fd < 0) {
+    throw systemError("could not create policy memfd");
+  }
+
+  try {
+    writeImage(fd, image);
+
+    if(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+      throw systemError("could not seal policy memfd");
+    }
+  }
+  catch(...) {
+    close(fd);
+    throw;
+  }
+
+  return fd;
+}
+
+AppArmor::SharedPolicy::SharedPolicy(const std::string &name)
+  : SharedPolicy(name, geteuid())
+{   }
+
+AppArmor::SharedPolicy::SharedPolicy(const std::string &name, uid_t owner)
+{
+  int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if(fd < 0) {
+    throw systemError("could not open " + name);
+  }
+
+  try {
+    // Anyone who can write the segment decides what the profiles say
+    struct stat status;
+    if(fstat(fd, &status) != 0) {
+      throw systemError("could not read " + name);
+    }
+    if(status.st_uid != owner && status.st_uid != 0) {
+      throw std::runtime_error(name + " is owned by uid " + std::to_string(status.st_uid));
+    }
+    if(!S_ISREG(status.st_mode) || (status.st_mode & (S_IWGRP | S_IWOTH)) != 0) {
+      throw std::runtime_error(name + " is writable by others");
+    }
+
+    image = PolicyImage::map(fd);
+  }
+  catch(...) {
+    close(fd);
+    throw;
+  }
+
+  close(fd);
+}
+
+AppArmor::SharedPolicy::SharedPolicy(int fd)
+{
+  // The image is decoded lazily, so the sender must not be able to change or shrink it later
+  int seals = fcntl(fd, F_GET_SEALS);
+  if(seals < 0) {
+    throw systemError("could not read the seals of policy image");
+  }
+  const int required = F_SEAL_WRITE | F_SEAL_SHRINK | F_SEAL_GROW;
+  if((seals & required) != required) {
+    throw std::runtime_error("policy image is not sealed against writes");
+  }
+
+  image = PolicyImage::map(fd);
+}
+
+std::list<AppArmor::Profile> AppArmor::SharedPolicy::getProfileList() const
+{
+  std::list<Profile> list;
+  for(uint32_t index = 0; index < image->profileCount(); index++) {
+    list.emplace_back(std::make_shared<MappedProfile>(image, index));
+  }
+  return list;
+}
+
+size_t AppArmor::SharedPolicy::size() const
+{
+  return image->size();
+}
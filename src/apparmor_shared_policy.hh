@@ -0,0 +1,66 @@
+#ifndef APPARMOR_SHARED_POLICY_HH
+#define APPARMOR_SHARED_POLICY_HH
+
+#include "apparmor_profile.hh"
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+class PolicyImage;
+
+namespace AppArmor {
+  // Parsed profiles kept once per host in shared memory, for processes that would otherwise
+  // each parse the same policy.
+  //
+  // One process publishes the profiles it parsed as an image that holds no pointers, either
+  // under a POSIX shared memory name or in a sealed memfd. Every other process maps the image
+  // read-only and gets the profiles back as ordinary AppArmor::Profile objects. Attaching only
+  // maps the image, a profile is decoded into the process the first time one of its accessors
+  // needs its rules, and name() reads the image directly.
+  //
+  // Conditionals and aliases are stored as they were in the published profiles.
+  // Throws std::runtime_error when a segment cannot be created, opened or mapped,
+  // or does not hold a whole policy image.
+  class SharedPolicy {
+    public:
+      // Writes the profiles under name, such as "/apparmor-policy", replacing the image
+      // published there before. Processes that already mapped the old image keep it.
+      // The image is only readable by others once it is complete.
+      static void publish(const std::string &name, const std::list<Profile> &profiles);
+
+      // Removes the name. Images that are mapped stay valid until they are let go of.
+      static void unpublish(const std::string &name);
+
+      // Writes the profiles to an anonymous memfd sealed against any change, to be handed
+      // to other processes over a Unix socket. The caller owns the descriptor.
+      static int publishSealed(const std::list<Profile> &profiles);
+
+      // Maps the image published under name. The segment must belong to owner or to root,
+      // and must not be writable by group or others, or std::runtime_error is thrown.
+      // The first form expects the effective user of this process as the owner.
+      explicit SharedPolicy(const std::string &name);
+      SharedPolicy(const std::string &name, uid_t owner);
+
+      // Maps the image behind the descriptor, such as one from publishSealed().
+      // The descriptor is not kept and can be closed afterwards. It must be sealed against
+      // writing, shrinking and growing, or std::runtime_error is thrown.
+      explicit SharedPolicy(int fd);
+
+      // Every profile, in the order they were published. The profiles keep the
+      // image mapped for as long as they live, even after the SharedPolicy is gone.
+      std::list<AppArmor::Profile> getProfileList() const;
+
+      // Bytes of the mapped image
+      size_t size() const;
+
+    private:
+      static std::string encode(const std::list<Profile> &profiles);
+
+      std::shared_ptr<const PolicyImage> image;
+  };
+}
+
+#endif // APPARMOR_SHARED_POLICY_HH
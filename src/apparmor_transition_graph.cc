@@ -0,0 +1,292 @@
+#include "apparmor_transition_graph.hh"
+#include "parser/file_mode.hh"
+#include "parser/glob.hh"
+#include "parser/tree/ProfileNode.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <memory>
+#include <unordered_set>
+
+const std::string AppArmor::TransitionGraph::UNCONFINED = "unconfined";
+
+// A profile, local profile or hat of the policy, with the path globs it attaches to
+struct GraphProfile {
+  const ProfileNode *node;
+  size_t id;
+  std::vector<std::string> attachments;
+  std::vector<size_t> children;
+};
+
+static std::vector<std::string> attachmentsOf(const ProfileNode &profile)
+{
+  std::string attachment = profile.getAttachment();
+  if(attachment.empty() && !profile.getText().empty() && profile.getText()[0] == '/') {
+    attachment = profile.getText();
+  }
+
+  std::vector<std::string> out;
+  if(!attachment.empty()) {
+    expandAlternations(attachment, out);
+  }
+  return out;
+}
+
+// Whether any alternative of a rule path matches some path the profile attaches to
+static bool attachesTo(const std::vector<std::string> &paths, const GraphProfile &profile)
+{
+  for(auto &attachment : profile.attachments) {
+    for(auto &path : paths) {
+      if(globsOverlap(path, attachment)) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Allow rules only, deny rules never grant a transition
+static void collectRules(const RuleList<ProfileNode> &rules, bool deny,
+                         std::vector<const FileNode *> &files, std::vector<const ChangeProfileNode *> &changes,
+                         std::vector<std::string> &includes)
+{
+  if(deny) {
+    return;
+  }
+
+  for(auto &file : rules.getFileList()) {
+    if(!file.getPrefix().isDeny()) {
+      files.push_back(&file);
+    }
+  }
+
+  for(auto &change : rules.getChangeProfileList()) {
+    if(!change.getPrefix().isDeny()) {
+      changes.push_back(&change);
+    }
+  }
+
+  for(auto &abstraction : rules.getAbstractionList()) {
+    includes.push_back(abstraction.getPath());
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    collectRules(block, block.getPrefix().isDeny(), files, changes, includes);
+  }
+}
+
+AppArmor::TransitionGraph::TransitionGraph(const std::list<Profile> &profiles, const std::map<std::string, Profile> &abstractions)
+{
+  addNode(UNCONFINED);
+
+  // Keeps lazily parsed profiles alive while the graph is built
+  std::vector<std::shared_ptr<ProfileNode>> models;
+  std::vector<GraphProfile> graphProfiles;
+  std::vector<size_t> topLevel;
+
+  for(auto &profile : profiles) {
+    models.push_back(profile.model());
+    topLevel.push_back(graphProfiles.size());
+    graphProfiles.push_back({models.back().get(), addNode(models.back()->getText()), attachmentsOf(*models.back()), {}});
+  }
+
+  // Children are appended as their parents are reached, so every profile is visited once
+  for(size_t i = 0; i < graphProfiles.size(); i++) {
+    for(auto &subprofile : graphProfiles[i].node->getRules().getSubprofiles()) {
+      size_t child = graphProfiles.size();
+      size_t id = addNode(nodes[graphProfiles[i].id] + "//" + subprofile.getText());
+
+      graphProfiles[i].children.push_back(child);
+      graphProfiles.push_back({&subprofile, id, attachmentsOf(subprofile), {}});
+
+      if(subprofile.isHat()) {
+        addTransition(Transition::Kind::HAT, graphProfiles[i].id, id);
+      }
+    }
+  }
+
+  std::map<std::string, std::shared_ptr<ProfileNode>> abstractionModels;
+  for(auto &abstraction : abstractions) {
+    abstractionModels.emplace(abstraction.first, abstraction.second.model());
+  }
+
+  for(auto &profile : graphProfiles) {
+    std::vector<const FileNode *> files;
+    std::vector<const ChangeProfileNode *> changes;
+    std::vector<std::string> includes;
+    collectRules(profile.node->getRules(), false, files, changes, includes);
+
+    std::unordered_set<std::string> included;
+    while(!includes.empty()) {
+      auto path = includes.back();
+      includes.pop_back();
+
+      auto abstraction = abstractionModels.find(path);
+      if(abstraction != abstractionModels.end() && included.insert(path).second) {
+        collectRules(abstraction->second->getRules(), false, files, changes, includes);
+      }
+    }
+
+    std::string name = nodes[profile.id];
+
+    for(auto *file : files) {
+      FileMode mode(file->getFilemode());
+      if(!(mode.perms & FileMode::EXEC) || mode.exec.empty()) {
+        continue;
+      }
+
+      char type = std::tolower(static_cast<unsigned char>(mode.exec[0]));
+      char fallback = mode.exec.size() > 1? std::tolower(static_cast<unsigned char>(mode.exec[1])) : '\0';
+
+      if(type == 'u' || fallback == 'u') {
+        addTransition(Transition::Kind::EXEC, profile.id, index.at(UNCONFINED));
+      }
+
+      if(type != 'p' && type != 'c') {
+        continue;
+      }
+
+      std::string target = file->getExecTarget();
+      if(!target.empty()) {
+        addTransition(Transition::Kind::EXEC, profile.id, addNode(type == 'c'? name + "//" + target : target));
+        continue;
+      }
+
+      // Without a target, the profile attached to the executable is used
+      std::vector<std::string> paths;
+      expandAlternations(file->getFilename(), paths);
+
+      auto &candidates = type == 'c'? profile.children : topLevel;
+      for(size_t candidate : candidates) {
+        if(attachesTo(paths, graphProfiles[candidate])) {
+          addTransition(Transition::Kind::EXEC, profile.id, graphProfiles[candidate].id);
+        }
+      }
+    }
+
+    for(auto *change : changes) {
+      std::vector<std::string> targets;
+      expandAlternations(change->getTarget().empty()? "**" : change->getTarget(), targets);
+
+      bool found = false;
+      for(size_t node = 0; node < nodes.size(); node++) {
+        for(auto &target : targets) {
+          if(node != profile.id && globContains(target, nodes[node])) {
+            addTransition(Transition::Kind::CHANGE_PROFILE, profile.id, node);
+            found = true;
+            break;
+          }
+        }
+      }
+
+      // A profile that is not part of this policy, but may be loaded later
+      if(!found && !change->getTarget().empty() &&
+         change->getTarget().find_first_of("*?[{@") == std::string::npos) {
+        addTransition(Transition::Kind::CHANGE_PROFILE, profile.id, addNode(change->getTarget()));
+      }
+    }
+  }
+
+  // Transitive closure with one row of bits per node, taking whole words at a time
+  words = (nodes.size() + 63) / 64;
+  closure.assign(nodes.size() * words, 0);
+  for(auto &edge : edges) {
+    size_t from = std::get<1>(edge);
+    size_t to = std::get<2>(edge);
+    closure[from * words + to / 64] |= uint64_t(1) << (to % 64);
+  }
+
+  for(size_t k = 0; k < nodes.size(); k++) {
+    const uint64_t *row = &closure[k * words];
+    for(size_t i = 0; i < nodes.size(); i++) {
+      if(reaches(i, k)) {
+        uint64_t *target = &closure[i * words];
+        for(size_t word = 0; word < words; word++) {
+          target[word] |= row[word];
+        }
+      }
+    }
+  }
+}
+
+size_t AppArmor::TransitionGraph::addNode(const std::string &name)
+{
+  auto found = index.emplace(name, nodes.size());
+  if(found.second) {
+    nodes.push_back(name);
+  }
+  return found.first->second;
+}
+
+void AppArmor::TransitionGraph::addTransition(Transition::Kind kind, size_t from, size_t to)
+{
+  if(!edges.emplace(kind, from, to).second) {
+    return;
+  }
+
+  transitions.push_back({kind, nodes[from], nodes[to]});
+}
+
+bool AppArmor::TransitionGraph::reaches(size_t from, size_t to) const
+{
+  return closure[from * words + to / 64] & (uint64_t(1) << (to % 64));
+}
+
+const std::vector<std::string> &AppArmor::TransitionGraph::getNodes() const
+{
+  return nodes;
+}
+
+const std::list<AppArmor::Transition> &AppArmor::TransitionGraph::getTransitions() const
+{
+  return transitions;
+}
+
+bool AppArmor::TransitionGraph::canReach(const std::string &from, const std::string &to) const
+{
+  auto fromNode = index.find(from);
+  auto toNode = index.find(to);
+  if(fromNode == index.end() || toNode == index.end()) {
+    return false;
+  }
+
+  return reaches(fromNode->second, toNode->second);
+}
+
+std::vector<std::string> AppArmor::TransitionGraph::getReachableFrom(const std::string &profile) const
+{
+  std::vector<std::string> out;
+
+  auto node = index.find(profile);
+  if(node == index.end()) {
+    return out;
+  }
+
+  for(size_t other = 0; other < nodes.size(); other++) {
+    if(reaches(node->second, other)) {
+      out.push_back(nodes[other]);
+    }
+  }
+
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+std::vector<std::string> AppArmor::TransitionGraph::getReaching(const std::string &profile) const
+{
+  std::vector<std::string> out;
+
+  auto node = index.find(profile);
+  if(node == index.end()) {
+    return out;
+  }
+
+  for(size_t other = 0; other < nodes.size(); other++) {
+    if(reaches(other, node->second)) {
+      out.push_back(nodes[other]);
+    }
+  }
+
+  std::sort(out.begin(), out.end());
+  return out;
+}
@@ -0,0 +1,81 @@
+#ifndef APPARMOR_TRANSITION_GRAPH_HH
+#define APPARMOR_TRANSITION_GRAPH_HH
+
+#include "apparmor_profile.hh"
+
+#include <cstdint>
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace AppArmor {
+  // One way a task confined by a profile can end up confined by another
+  struct Transition {
+    enum class Kind {
+      // px, cx and ux file rules, with or without a named target
+      EXEC,
+      // change_profile rules
+      CHANGE_PROFILE,
+      // From a profile into one of its hats
+      HAT
+    };
+
+    Kind kind;
+    std::string from;
+    std::string to;
+  };
+
+  // The profiles of a policy and every transition between them, with the transitive
+  // closure computed up front so reachability queries are a lookup.
+  // Local profiles and hats are named parent//child. Unconfined execution (ux, and the
+  // ux fallback of pux and cux) leads to the UNCONFINED node.
+  //
+  // Exec rules without a named target lead to every profile whose attachment, or name
+  // when it is a path, matches some path the rule does, such as /usr/bin/* and
+  // /usr/bin/{a,b}. Rules from included abstractions are taken from the abstractions
+  // passed in, keyed by include path. Deny rules never add a transition.
+  //
+  // The graph does not change once built, so build it once per policy snapshot.
+  class TransitionGraph {
+    public:
+      static const std::string UNCONFINED;
+
+      TransitionGraph(const std::list<Profile> &profiles, const std::map<std::string, Profile> &abstractions = {});
+
+      // Every node: the profiles, their local profiles and hats, UNCONFINED,
+      // and the targets of named transitions to profiles that are not defined
+      const std::vector<std::string> &getNodes() const;
+
+      const std::list<Transition> &getTransitions() const;
+
+      // Whether a task confined by from can end up confined by to, through any number of transitions
+      bool canReach(const std::string &from, const std::string &to) const;
+
+      // Every node reachable from a profile, sorted
+      std::vector<std::string> getReachableFrom(const std::string &profile) const;
+
+      // Every node that can reach a profile, sorted. getReaching(UNCONFINED) lists
+      // the profiles that can escape confinement.
+      std::vector<std::string> getReaching(const std::string &profile) const;
+
+    private:
+      size_t addNode(const std::string &name);
+      void addTransition(Transition::Kind kind, size_t from, size_t to);
+      bool reaches(size_t from, size_t to) const;
+
+      std::vector<std::string> nodes;
+      std::unordered_map<std::string, size_t> index;
+      std::list<Transition> transitions;
+      std::set<std::tuple<Transition::Kind, size_t, size_t>> edges;
+
+      // One row of bits per node, row i holds the nodes reachable from node i
+      size_t words = 0;
+      std::vector<uint64_t> closure;
+  };
+}
+
+#endif // APPARMOR_TRANSITION_GRAPH_HH
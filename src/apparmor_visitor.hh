@@ -0,0 +1,45 @@
+#ifndef APPARMOR_VISITOR_HH
+#define APPARMOR_VISITOR_HH
+
+#include <cstdint>
+#include <string>
+
+namespace AppArmor {
+  // Qualifiers of a rule, including those of the blocks it is nested in
+  struct RulePrefix {
+    bool audit = false;
+    bool deny  = false;
+    bool owner = false;
+  };
+
+  // Receives parse events straight from the grammar actions, without building a ParseTree.
+  // Positions are byte offsets into the file, the same ones reported by AppArmor::FileRule.
+  // Override only the callbacks you need, the defaults do nothing.
+  class Visitor {
+    public:
+      virtual ~Visitor() = default;
+
+      // Called once the opening brace of a profile, hat or subprofile has been read
+      virtual void onProfileBegin(const std::string &/*name*/, uint64_t /*startPos*/) {}
+
+      // Called after the closing brace of a profile, hat or subprofile
+      virtual void onProfileEnd(const std::string &/*name*/, uint64_t /*stopPos*/) {}
+
+      virtual void onFileRule(const std::string &/*filename*/, const std::string &/*filemode*/,
+                              const RulePrefix &/*prefix*/, uint64_t /*startPos*/, uint64_t /*stopPos*/) {}
+
+      virtual void onLinkRule(const std::string &/*from*/, const std::string &/*to*/,
+                              const RulePrefix &/*prefix*/, uint64_t /*startPos*/, uint64_t /*stopPos*/) {}
+
+      virtual void onInclude(const std::string &/*path*/, bool /*isIfExists*/,
+                             uint64_t /*startPos*/, uint64_t /*stopPos*/) {}
+
+      virtual void onAlias(const std::string &/*from*/, const std::string &/*to*/,
+                           uint64_t /*startPos*/, uint64_t /*stopPos*/) {}
+
+      // Rules that have no node type yet (network, mount, dbus, capability, ...)
+      virtual void onRule(const std::string &/*kind*/, uint64_t /*startPos*/, uint64_t /*stopPos*/) {}
+  };
+}
+
+#endif // APPARMOR_VISITOR_HH
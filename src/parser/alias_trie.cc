@@ -0,0 +1,129 @@
+#include "alias_trie.hh"
+
+#include <algorithm>
+
+AliasTrie::AliasTrie(const std::list<AliasNode> &aliases)
+  : nodes(1)
+{
+  for(auto &alias : aliases) {
+    std::string from = alias.getFrom();
+
+    uint32_t node = 0;
+    for(char c : from) {
+      auto &children = nodes[node].children;
+      auto child = std::lower_bound(children.begin(), children.end(), std::make_pair(c, uint32_t(0)),
+                                    [](const std::pair<char, uint32_t> &a, const std::pair<char, uint32_t> &b) {
+                                      return a.first < b.first;
+                                    });
+
+      if(child != children.end() && child->first == c) {
+        node = child->second;
+        continue;
+      }
+
+      uint32_t next = nodes.size();
+      children.insert(child, std::make_pair(c, next));
+      nodes.emplace_back();
+      node = next;
+    }
+
+    auto &targets = nodes[node].targets;
+    if(std::find(targets.begin(), targets.end(), alias.getTo()) == targets.end()) {
+      targets.push_back(alias.getTo());
+    }
+  }
+}
+
+bool AliasTrie::empty() const
+{
+  return nodes.size() == 1 && nodes[0].targets.empty();
+}
+
+void AliasTrie::rewrite(const std::string &path, std::vector<std::string> &out) const
+{
+  uint32_t node = 0;
+  for(size_t i = 0; ; i++) {
+    for(auto &target : nodes[node].targets) {
+      out.push_back(target + path.substr(i));
+    }
+
+    if(i == path.size()) {
+      return;
+    }
+
+    auto &children = nodes[node].children;
+    auto child = std::find_if(children.begin(), children.end(),
+                              [&](const std::pair<char, uint32_t> &entry) { return entry.first == path[i]; });
+    if(child == children.end()) {
+      return;
+    }
+    node = child->second;
+  }
+}
+
+ProfileNode AliasTrie::apply(const ProfileNode &profile) const
+{
+  ProfileNode out(profile.getText(), apply(profile.getRules()), profile.getStartPosition(), profile.getStopPosition(),
+                  profile.getAttachment());
+  out.setHat(profile.isHat());
+  out.setXattrs(profile.getXattrs());
+  out.setFlags(profile.getFlags());
+  return out;
+}
+
+RuleList<ProfileNode> AliasTrie::apply(const RuleList<ProfileNode> &rules) const
+{
+  RuleList<ProfileNode> out(rules.getStartPosition());
+  out.setStopPosition(rules.getStopPosition());
+
+  std::vector<std::string> paths;
+  for(auto &file : rules.getFileList()) {
+    FileNode copy = file;
+    out.appendFileNode(file.getPrefix(), copy);
+
+    paths.clear();
+    rewrite(file.getFilename(), paths);
+    for(auto &path : paths) {
+      FileNode aliased(file.getStartPosition(), file.getStopPosition(), path, file.getFilemode(),
+                       file.getExecTarget(), file.isSubsetRule());
+      out.appendFileNode(file.getPrefix(), aliased);
+    }
+  }
+
+  for(auto &link : rules.getLinkList()) {
+    LinkNode copy = link;
+    out.appendLinkNode(link.getPrefix(), copy);
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    auto copy = apply(block);
+    out.appendRuleList(block.getPrefix(), copy);
+  }
+
+  for(auto &abstraction : rules.getAbstractionList()) {
+    AbstractionNode copy = abstraction;
+    out.appendAbstraction(copy);
+  }
+
+  for(auto &change : rules.getChangeProfileList()) {
+    ChangeProfileNode copy = change;
+    out.appendChangeProfile(change.getPrefix(), copy);
+  }
+
+  for(auto &generic : rules.getGenericRuleList()) {
+    GenericRuleNode copy = generic;
+    out.appendGenericRule(generic.getPrefix(), copy);
+  }
+
+  for(auto &conditional : rules.getConditionalList()) {
+    ConditionalNode copy = conditional;
+    out.appendConditional(copy);
+  }
+
+  for(auto &subprofile : rules.getSubprofiles()) {
+    auto copy = apply(subprofile);
+    out.appendSubprofile(copy);
+  }
+
+  return out;
+}
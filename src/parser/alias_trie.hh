@@ -0,0 +1,46 @@
+#ifndef ALIAS_TRIE_HH
+#define ALIAS_TRIE_HH
+
+#include "tree/AliasNode.hh"
+#include "tree/ProfileNode.hh"
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+
+// The alias rules of a file (alias /usr/ -> /mnt/usr/,) compiled into a trie of their
+// source prefixes, so the aliases that apply to a path are found in one walk along it
+// instead of comparing the path with every alias.
+//
+// As with apparmor_parser, a rule whose path starts with the source of an alias is kept,
+// and a copy with the prefix replaced by the target is added for every alias that matches.
+// Aliases are not applied to the copies again.
+class AliasTrie {
+  public:
+    AliasTrie(const std::list<AliasNode> &aliases);
+
+    bool empty() const;
+
+    // Appends the path rewritten by each alias whose source is a prefix of it
+    void rewrite(const std::string &path, std::vector<std::string> &out) const;
+
+    // The profile with the aliased copies of its file rules added, in subprofiles and blocks too.
+    // Rules under conditionals that were kept are left as written.
+    ProfileNode apply(const ProfileNode &profile) const;
+
+  private:
+    RuleList<ProfileNode> apply(const RuleList<ProfileNode> &rules) const;
+
+    struct Node {
+      // Sorted by byte, most nodes have a single child
+      std::vector<std::pair<char, uint32_t>> children;
+
+      // Targets of the aliases whose source ends at this node
+      std::vector<std::string> targets;
+    };
+
+    std::vector<Node> nodes;
+};
+
+#endif // ALIAS_TRIE_HH
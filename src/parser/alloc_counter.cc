@@ -0,0 +1,16 @@
+#include "alloc_counter.hh"
+
+#include <atomic>
+
+static std::atomic<AppArmor::AllocationCounter> counter{nullptr};
+
+void AppArmor::setAllocationCounter(AllocationCounter function)
+{
+  counter = function;
+}
+
+AppArmor::AllocationCount allocationCount()
+{
+  auto function = counter.load();
+  return function != nullptr? function() : AppArmor::AllocationCount();
+}
@@ -0,0 +1,10 @@
+#ifndef ALLOC_COUNTER_HH
+#define ALLOC_COUNTER_HH
+
+#include "apparmor_parse_stats.hh"
+
+// Heap allocations made by the calling thread so far, from the function installed with
+// AppArmor::setAllocationCounter. Zero when there is none.
+AppArmor::AllocationCount allocationCount();
+
+#endif // ALLOC_COUNTER_HH
@@ -0,0 +1,95 @@
+#include "audit_record.hh"
+
+static int hexValue(char c)
+{
+  if(c >= '0' && c <= '9') return c - '0';
+  if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+// Untrusted strings are logged quoted, or as bare hex when they hold special characters
+static std::string_view decodeValue(std::string_view value, bool quoted, std::string &scratch)
+{
+  if(quoted || value.empty() || value.size() % 2 != 0) {
+    return value;
+  }
+
+  for(char c : value) {
+    if(hexValue(c) < 0) {
+      return value;
+    }
+  }
+
+  // Every decoded value of the line fits, so appending never moves the earlier ones
+  size_t start = scratch.size();
+  for(size_t i = 0; i < value.size(); i += 2) {
+    scratch.push_back(static_cast<char>(hexValue(value[i]) * 16 + hexValue(value[i + 1])));
+  }
+  return std::string_view(scratch).substr(start);
+}
+
+bool parseAuditRecord(std::string_view line, AuditRecord &record, std::string &scratch)
+{
+  // Most lines of a busy audit log are not from AppArmor at all
+  if(line.find("apparmor=") == std::string_view::npos) {
+    return false;
+  }
+
+  record = AuditRecord();
+  scratch.clear();
+  scratch.reserve(line.size());
+
+  size_t pos = 0;
+  while(pos < line.size()) {
+    while(pos < line.size() && line[pos] == ' ') {
+      pos++;
+    }
+
+    size_t end = pos;
+    while(end < line.size() && line[end] != ' ' && line[end] != '=') {
+      end++;
+    }
+
+    // A token without a value, such as "audit:" in dmesg output
+    if(end >= line.size() || line[end] != '=') {
+      pos = end;
+      continue;
+    }
+
+    std::string_view key = line.substr(pos, end - pos);
+    pos = end + 1;
+
+    bool quoted = pos < line.size() && line[pos] == '"';
+    if(quoted) {
+      end = line.find('"', pos + 1);
+      if(end == std::string_view::npos) {
+        return false;
+      }
+      pos++;
+    }
+    else {
+      end = line.find(' ', pos);
+      if(end == std::string_view::npos) {
+        end = line.size();
+      }
+    }
+
+    std::string_view value = line.substr(pos, end - pos);
+    pos = quoted? end + 1 : end;
+
+    if(key == "apparmor")            record.apparmor = value;
+    else if(key == "operation")      record.operation = value;
+    else if(key == "profile")        record.profile = decodeValue(value, quoted, scratch);
+    else if(key == "name")           record.name = decodeValue(value, quoted, scratch);
+    else if(key == "requested_mask") record.requested = value;
+    else if(key == "denied_mask")    record.denied = value;
+    else if(key == "fsuid")          record.fsuid = value;
+    else if(key == "ouid")           record.ouid = value;
+  }
+
+  // Records of other mediation classes have no path, or one that is not a file
+  return !record.apparmor.empty() && !record.profile.empty() &&
+         !record.name.empty() && record.name[0] == '/' &&
+         !(record.denied.empty() && record.requested.empty());
+}
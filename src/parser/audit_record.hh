@@ -0,0 +1,29 @@
+#ifndef AUDIT_RECORD_HH
+#define AUDIT_RECORD_HH
+
+#include <string>
+#include <string_view>
+
+// The fields of an AppArmor file record from the kernel audit log, such as
+//   type=1400 audit(...): apparmor="DENIED" operation="open" profile="/usr/bin/foo"
+//   name="/etc/shadow" ... requested_mask="r" denied_mask="r" fsuid=1000 ouid=0
+// as written by auditd, syslog or dmesg. Fields that are missing are left empty.
+//
+// The views point into the line that was parsed. Values the kernel wrote hex encoded,
+// because they hold spaces or other special characters, point into the scratch buffer instead.
+struct AuditRecord {
+  std::string_view apparmor;
+  std::string_view operation;
+  std::string_view profile;
+  std::string_view name;
+  std::string_view requested;
+  std::string_view denied;
+  std::string_view fsuid;
+  std::string_view ouid;
+};
+
+// Tokenizes one line without copying it. Returns false when the line is not an AppArmor
+// record of an access to a path, such as a status message or a capability or network record.
+bool parseAuditRecord(std::string_view line, AuditRecord &record, std::string &scratch);
+
+#endif // AUDIT_RECORD_HH
@@ -0,0 +1,515 @@
+#include "batch_reader.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <optional>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Headers from Linux 5.6 on, which added openat, statx and read to io_uring
+#if defined(IORING_FEAT_RW_CUR_POS) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING 1
+#endif
+
+// Reads a whole file with plain syscalls, as the workers do when there is no ring
+static int readFile(const std::string &path, std::string &contents)
+{
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if(fd < 0) {
+    return errno;
+  }
+
+  // Without a size to expect, only the end of the file stops the loop
+  struct stat info;
+  std::optional<size_t> expected;
+  if(fstat(fd, &info) == 0) {
+    expected = info.st_size;
+  }
+  contents.resize(expected && *expected > 0? *expected : 4096);
+
+  size_t size = 0;
+  while(true) {
+    if(size == contents.size()) {
+      contents.resize(contents.size() * 2);
+    }
+
+    ssize_t count = read(fd, &contents[size], contents.size() - size);
+    if(count < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+
+      int error = errno;
+      close(fd);
+      return error;
+    }
+
+    size += count;
+    if(count == 0 || size == expected) {
+      break;
+    }
+  }
+
+  contents.resize(size);
+  close(fd);
+  return 0;
+}
+
+#ifdef HAVE_IO_URING
+
+// A submission and completion queue pair, driven with the raw syscalls so there is no dependency on liburing
+class BatchReader::Ring {
+  public:
+    static std::unique_ptr<Ring> create(unsigned int entries)
+    {
+      std::unique_ptr<Ring> ring(new Ring());
+
+      struct io_uring_params params;
+      std::memset(&params, 0, sizeof(params));
+      ring->fd = syscall(__NR_io_uring_setup, entries, &params);
+      if(ring->fd < 0) {
+        return nullptr;
+      }
+
+      ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      ring->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+      bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+      if(single) {
+        ring->sq_size = ring->cq_size = std::max(ring->sq_size, ring->cq_size);
+      }
+
+      ring->sq_ptr = mmap(nullptr, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+      if(ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = nullptr;
+        return nullptr;
+      }
+
+      ring->cq_ptr = single? ring->sq_ptr : mmap(nullptr, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                 ring->fd, IORING_OFF_CQ_RING);
+      if(ring->cq_ptr == MAP_FAILED) {
+        ring->cq_ptr = nullptr;
+        return nullptr;
+      }
+
+      ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+      void *sqes = mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+      if(sqes == MAP_FAILED) {
+        return nullptr;
+      }
+      ring->sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+      char *sq = static_cast<char *>(ring->sq_ptr);
+      ring->sq_head  = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+      ring->sq_tail  = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+      ring->sq_mask  = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+      ring->sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+      ring->sq_entries = params.sq_entries;
+      ring->tail = *ring->sq_tail;
+
+      char *cq = static_cast<char *>(ring->cq_ptr);
+      ring->cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+      ring->cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+      ring->cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+      ring->cqes    = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+      return ring;
+    }
+
+    ~Ring()
+    {
+      if(sqes != nullptr) {
+        munmap(sqes, sqes_size);
+      }
+      if(cq_ptr != nullptr && cq_ptr != sq_ptr) {
+        munmap(cq_ptr, cq_size);
+      }
+      if(sq_ptr != nullptr) {
+        munmap(sq_ptr, sq_size);
+      }
+      if(fd >= 0) {
+        close(fd);
+      }
+    }
+
+    // A cleared submission entry, handing what is queued to the kernel first if the queue is full
+    struct io_uring_sqe *prepare(uint8_t opcode, int fd, uint64_t addr, uint32_t len, uint64_t offset, uint64_t userData)
+    {
+      if(tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries) {
+        submit(false);
+      }
+
+      unsigned index = tail & sq_mask;
+      struct io_uring_sqe *sqe = &sqes[index];
+      std::memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = opcode;
+      sqe->fd = fd;
+      sqe->addr = addr;
+      sqe->len = len;
+      sqe->off = offset;
+      sqe->user_data = userData;
+
+      sq_array[index] = index;
+      tail++;
+      return sqe;
+    }
+
+    // Hands every queued entry to the kernel, and waits for at least one completion if asked to
+    void submit(bool wait)
+    {
+      __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+
+      while(true) {
+        unsigned pending = tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if(pending == 0 && !wait) {
+          return;
+        }
+
+        int result = syscall(__NR_io_uring_enter, fd, pending, wait? 1 : 0, wait? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+        if(result >= 0 || (errno != EINTR && errno != EAGAIN && errno != EBUSY)) {
+          return;
+        }
+      }
+    }
+
+    bool reap(struct io_uring_cqe &cqe)
+    {
+      unsigned head = *cq_head;
+      if(head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+      }
+
+      cqe = cqes[head & cq_mask];
+      __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+      return true;
+    }
+
+  private:
+    Ring() = default;
+
+    int fd = -1;
+
+    void *sq_ptr = nullptr;
+    void *cq_ptr = nullptr;
+    size_t sq_size = 0;
+    size_t cq_size = 0;
+    struct io_uring_sqe *sqes = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned *sq_head = nullptr;
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned sq_entries = 0;
+    unsigned tail = 0;
+
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    struct io_uring_cqe *cqes = nullptr;
+};
+
+#else
+
+class BatchReader::Ring {
+  public:
+    static std::unique_ptr<Ring> create(unsigned int)
+    {
+      return nullptr;
+    }
+};
+
+#endif // HAVE_IO_URING
+
+static constexpr unsigned int RING_ENTRIES = 256;
+
+// Every file has at most two requests in flight and a close behind it,
+// which keeps the completion queue (twice the entries) from overflowing
+static constexpr size_t MAX_FILES_IN_FLIGHT = RING_ENTRIES / 4;
+
+BatchReader::BatchReader(Callback callback, unsigned int threads, bool useIoUring)
+  : callback{callback}
+{
+  if(threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  if(useIoUring) {
+    ring = Ring::create(RING_ENTRIES);
+  }
+
+  if(ring) {
+    ring_thread = std::thread(&BatchReader::runRing, this);
+  }
+
+  for(unsigned int i = 0; i < threads; i++) {
+    workers.emplace_back(&BatchReader::runWorker, this);
+  }
+}
+
+BatchReader::~BatchReader()
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]() { return outstanding == 0; });
+    stopping = true;
+  }
+  paths_ready.notify_all();
+  tasks_ready.notify_all();
+
+  if(ring_thread.joinable()) {
+    ring_thread.join();
+  }
+  for(auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void BatchReader::submit(const std::string &path)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  outstanding++;
+
+  if(ring) {
+    paths.push_back(path);
+    paths_ready.notify_one();
+  }
+  else {
+    tasks.push_back({path, "", 0, false});
+    tasks_ready.notify_one();
+  }
+}
+
+void BatchReader::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [this]() { return outstanding == 0; });
+
+  if(failure) {
+    auto error = failure;
+    failure = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+bool BatchReader::usesIoUring() const
+{
+  return ring != nullptr;
+}
+
+void BatchReader::complete(Task &&task)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  tasks.push_back(std::move(task));
+  tasks_ready.notify_one();
+}
+
+void BatchReader::runWorker()
+{
+  while(true) {
+    Task task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      tasks_ready.wait(lock, [this]() { return stopping || !tasks.empty(); });
+      if(tasks.empty()) {
+        return;
+      }
+
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+
+    if(!task.read) {
+      task.error = readFile(task.path, task.contents);
+    }
+
+    try {
+      callback(task.path, task.contents, task.error);
+    }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if(!failure) {
+        failure = std::current_exception();
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if(--outstanding == 0) {
+      finished.notify_all();
+    }
+  }
+}
+
+#ifdef HAVE_IO_URING
+
+// One file on its way through the ring: open and statx, then reads until the end, then close
+struct RingRequest {
+  std::string path;
+  std::string buffer;
+  size_t size = 0;
+  int fd = -1;
+  int error = 0;
+  int waiting = 0;
+  struct statx info;
+};
+
+enum RingOp : uint64_t {
+  OP_OPEN,
+  OP_STATX,
+  OP_READ,
+  OP_CLOSE
+};
+
+void BatchReader::runRing()
+{
+  std::vector<std::unique_ptr<RingRequest>> requests;
+  std::vector<size_t> free_slots;
+  size_t in_flight = 0;
+
+  auto userData = [](size_t slot, RingOp op) { return (static_cast<uint64_t>(slot) << 2) | op; };
+
+  auto readNext = [&](size_t slot) {
+    auto &request = *requests[slot];
+    if(request.size == request.buffer.size()) {
+      request.buffer.resize(std::max<size_t>(request.buffer.size() * 2, 4096));
+    }
+
+    request.waiting = 1;
+    ring->prepare(IORING_OP_READ, request.fd, reinterpret_cast<uint64_t>(&request.buffer[request.size]),
+                  request.buffer.size() - request.size, request.size, userData(slot, OP_READ));
+  };
+
+  auto finish = [&](size_t slot) {
+    auto &request = *requests[slot];
+    if(request.fd >= 0) {
+      ring->prepare(IORING_OP_CLOSE, request.fd, 0, 0, 0, userData(slot, OP_CLOSE));
+    }
+
+    // Kernels before 5.6 do not know openat, statx and read through the ring
+    bool unsupported = request.error == EINVAL || request.error == EOPNOTSUPP;
+    if(unsupported) {
+      complete({request.path, "", 0, false});
+    }
+    else {
+      request.buffer.resize(request.size);
+      complete({request.path, std::move(request.buffer), request.error, true});
+    }
+
+    requests[slot].reset();
+    free_slots.push_back(slot);
+    in_flight--;
+  };
+
+  while(true) {
+    std::vector<size_t> started;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if(in_flight == 0) {
+        paths_ready.wait(lock, [this]() { return stopping || !paths.empty(); });
+        if(paths.empty()) {
+          return;
+        }
+      }
+
+      while(!paths.empty() && in_flight < MAX_FILES_IN_FLIGHT) {
+        size_t slot = requests.size();
+        if(!free_slots.empty()) {
+          slot = free_slots.back();
+          free_slots.pop_back();
+        }
+        else {
+          requests.emplace_back();
+        }
+
+        requests[slot] = std::make_unique<RingRequest>();
+        requests[slot]->path = std::move(paths.front());
+        paths.pop_front();
+
+        started.push_back(slot);
+        in_flight++;
+      }
+    }
+
+    // The open and the size of every new file go out together, in one batch
+    for(size_t slot : started) {
+      auto &request = *requests[slot];
+      request.waiting = 2;
+
+      auto *open = ring->prepare(IORING_OP_OPENAT, AT_FDCWD, reinterpret_cast<uint64_t>(request.path.c_str()), 0, 0,
+                                 userData(slot, OP_OPEN));
+      open->open_flags = O_RDONLY | O_CLOEXEC;
+
+      auto *stat = ring->prepare(IORING_OP_STATX, AT_FDCWD, reinterpret_cast<uint64_t>(request.path.c_str()), STATX_SIZE,
+                                 reinterpret_cast<uint64_t>(&request.info), userData(slot, OP_STATX));
+      stat->statx_flags = 0;
+    }
+
+    ring->submit(true);
+
+    struct io_uring_cqe cqe;
+    while(ring->reap(cqe)) {
+      size_t slot = cqe.user_data >> 2;
+      auto op = static_cast<RingOp>(cqe.user_data & 3);
+      if(op == OP_CLOSE) {
+        continue;
+      }
+
+      auto &request = *requests[slot];
+      request.waiting--;
+
+      if(op == OP_OPEN || op == OP_STATX) {
+        if(cqe.res < 0 && request.error == 0) {
+          request.error = -cqe.res;
+        }
+        if(op == OP_OPEN && cqe.res >= 0) {
+          request.fd = cqe.res;
+        }
+
+        if(request.waiting > 0) {
+          continue;
+        }
+
+        if(request.error != 0) {
+          finish(slot);
+          continue;
+        }
+
+        request.buffer.resize(request.info.stx_size > 0? request.info.stx_size : 4096);
+        readNext(slot);
+        continue;
+      }
+
+      if(cqe.res < 0) {
+        request.error = -cqe.res;
+        finish(slot);
+        continue;
+      }
+
+      // Stop at the end of the file, or once the size from statx has been read
+      request.size += cqe.res;
+      if(cqe.res == 0 || (request.info.stx_size > 0 && request.size == request.info.stx_size)) {
+        finish(slot);
+      }
+      else {
+        readNext(slot);
+      }
+    }
+
+    // Reads and closes queued while reaping, which nothing may wait for once the ring is idle
+    ring->submit(false);
+  }
+}
+
+#else
+
+void BatchReader::runRing()
+{   }
+
+#endif // HAVE_IO_URING
@@ -0,0 +1,83 @@
+#ifndef BATCH_READER_HH
+#define BATCH_READER_HH
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads many small files at once, such as the profiles and abstractions of a policy directory.
+// The opens, sizes and reads of every queued file are submitted to io_uring in batches, so the
+// cost of a syscall is shared by many files. When io_uring cannot be used (an old kernel,
+// or a seccomp filter that blocks it) each worker thread reads files with open, read and close.
+//
+// The callback runs on the worker threads, once per file, as soon as its read completes,
+// so files are parsed while others are still being read. It may queue more files.
+class BatchReader {
+  public:
+    // error is 0 when the file was read, or the errno of the call that failed
+    using Callback = std::function<void(const std::string &path, const std::string &contents, int error)>;
+
+    explicit BatchReader(Callback callback, unsigned int threads = 0, bool useIoUring = true);
+    ~BatchReader();
+
+    BatchReader(const BatchReader &) = delete;
+    BatchReader& operator=(const BatchReader &) = delete;
+
+    // Queues a file. Safe to call from any thread, the callback included.
+    void submit(const std::string &path);
+
+    // Blocks until the callback has returned for every file queued so far,
+    // including the files queued by the callback itself.
+    // Rethrows the first exception that escaped the callback.
+    void wait();
+
+    // Whether files are read through io_uring rather than by the worker threads
+    bool usesIoUring() const;
+
+  private:
+    struct Task {
+      std::string path;
+      std::string contents;
+      int error = 0;
+
+      // Set once the file has been read by the ring, otherwise the worker reads it
+      bool read = false;
+    };
+
+    class Ring;
+
+    void runWorker();
+    void runRing();
+    void complete(Task &&task);
+
+    Callback callback;
+
+    std::mutex mutex;
+    std::condition_variable tasks_ready;
+    std::condition_variable paths_ready;
+    std::condition_variable finished;
+
+    // Completed reads, or paths to read when there is no ring
+    std::deque<Task> tasks;
+
+    // Paths waiting for the ring
+    std::deque<std::string> paths;
+
+    size_t outstanding = 0;
+    bool stopping = false;
+
+    // The first exception thrown by the callback, rethrown by wait()
+    std::exception_ptr failure;
+
+    std::unique_ptr<Ring> ring;
+    std::thread ring_thread;
+    std::vector<std::thread> workers;
+};
+
+#endif // BATCH_READER_HH
@@ -0,0 +1,452 @@
+#include "dfa.hh"
+#include "glob.hh"
+
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <stdexcept>
+
+// Table set layout, from the kernel's security/apparmor/include/match.h
+static constexpr uint32_t YYTH_MAGIC = 0x1B5E783D;
+
+static constexpr uint16_t YYTD_ID_ACCEPT  = 1;
+static constexpr uint16_t YYTD_ID_BASE    = 2;
+static constexpr uint16_t YYTD_ID_CHK     = 3;
+static constexpr uint16_t YYTD_ID_DEF     = 4;
+static constexpr uint16_t YYTD_ID_EC      = 5;
+static constexpr uint16_t YYTD_ID_ACCEPT2 = 7;
+static constexpr uint16_t YYTD_ID_NXT     = 8;
+
+static constexpr uint16_t YYTD_DATA8  = 1;
+static constexpr uint16_t YYTD_DATA16 = 2;
+static constexpr uint16_t YYTD_DATA32 = 4;
+
+// One step of a glob: a set of bytes, matched once or any number of times
+struct GlobItem {
+  std::bitset<256> bytes;
+  bool repeat;
+};
+
+static std::bitset<256> anyByte(bool slash)
+{
+  std::bitset<256> bytes;
+  bytes.set();
+  bytes.reset(0);
+  if(!slash) {
+    bytes.reset('/');
+  }
+  return bytes;
+}
+
+// Parses [...] starting at pattern[start], returns the position of the closing bracket or npos
+static size_t parseClass(const std::string &pattern, size_t start, std::bitset<256> &bytes)
+{
+  size_t i = start + 1;
+  bool negate = i < pattern.size() && (pattern[i] == '^' || pattern[i] == '!');
+  if(negate) {
+    i++;
+  }
+
+  bool first = true;
+  for(; i < pattern.size(); i++) {
+    unsigned char c = pattern[i];
+    if(c == ']' && !first) {
+      if(negate) {
+        bytes.flip();
+        bytes.reset(0);
+      }
+      return i;
+    }
+    first = false;
+
+    if(c == '\\' && i + 1 < pattern.size()) {
+      c = pattern[++i];
+    }
+
+    if(i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+      unsigned char last = pattern[i + 2];
+      for(unsigned value = c; value <= last; value++) {
+        bytes.set(value);
+      }
+      i += 2;
+    }
+    else {
+      bytes.set(c);
+    }
+  }
+
+  return std::string::npos;
+}
+
+// Fails on variables, which would need the tunables to be resolved
+static bool parseGlob(const std::string &pattern, std::vector<GlobItem> &items)
+{
+  for(size_t i = 0; i < pattern.size(); i++) {
+    unsigned char c = pattern[i];
+    bool afterSlash = !items.empty() && !items.back().repeat && items.back().bytes.count() == 1 &&
+                      items.back().bytes.test('/');
+
+    if(c == '@' && i + 1 < pattern.size() && pattern[i + 1] == '{') {
+      return false;
+    }
+
+    if(c == '*') {
+      bool globstar = i + 1 < pattern.size() && pattern[i + 1] == '*';
+      while(i + 1 < pattern.size() && pattern[i + 1] == '*') {
+        i++;
+      }
+
+      auto bytes = anyByte(globstar);
+      if(afterSlash) {
+        items.push_back({anyByte(false), false});
+      }
+      items.push_back({bytes, true});
+      continue;
+    }
+
+    if(c == '?') {
+      items.push_back({anyByte(false), false});
+      continue;
+    }
+
+    if(c == '[') {
+      std::bitset<256> bytes;
+      size_t end = parseClass(pattern, i, bytes);
+      if(end != std::string::npos) {
+        items.push_back({bytes, false});
+        i = end;
+        continue;
+      }
+    }
+
+    if(c == '\\' && i + 1 < pattern.size()) {
+      c = pattern[++i];
+    }
+
+    std::bitset<256> bytes;
+    bytes.set(c);
+    items.push_back({bytes, false});
+  }
+
+  return true;
+}
+
+// A state of the subset construction: (glob, position) pairs, sorted
+using Positions = std::vector<uint64_t>;
+
+static void addClosure(const std::vector<std::vector<GlobItem>> &globs, uint32_t glob, uint32_t pos, Positions &out)
+{
+  auto &items = globs[glob];
+  while(true) {
+    out.push_back((static_cast<uint64_t>(glob) << 32) | pos);
+    if(pos == items.size() || !items[pos].repeat) {
+      return;
+    }
+    pos++;
+  }
+}
+
+Dfa::Dfa(const std::vector<std::string> &patterns)
+{
+  // Every alternative of a pattern accepts for the pattern itself
+  std::vector<std::vector<GlobItem>> globs;
+  std::vector<uint32_t> owner;
+
+  for(size_t i = 0; i < patterns.size(); i++) {
+    std::vector<std::string> alternatives;
+    std::vector<std::vector<GlobItem>> parsed;
+
+    bool ok = expandAlternations(patterns[i], alternatives);
+    for(size_t j = 0; ok && j < alternatives.size(); j++) {
+      parsed.emplace_back();
+      ok = parseGlob(alternatives[j], parsed.back());
+    }
+
+    if(!ok) {
+      skipped.push_back(i);
+      continue;
+    }
+
+    for(auto &glob : parsed) {
+      globs.push_back(std::move(glob));
+      owner.push_back(i);
+    }
+  }
+
+  // Subset construction, with the empty set as state 0
+  std::vector<Positions> states(1);
+  std::map<Positions, uint32_t> ids{{Positions(), NOMATCH}};
+
+  Positions start;
+  for(uint32_t glob = 0; glob < globs.size(); glob++) {
+    addClosure(globs, glob, 0, start);
+  }
+  std::sort(start.begin(), start.end());
+  states.push_back(start);
+  ids.emplace(start, START);
+
+  std::vector<std::array<uint32_t, 256>> raw;
+  for(uint32_t state = 0; state < states.size(); state++) {
+    raw.emplace_back();
+
+    for(unsigned byte = 0; byte < 256; byte++) {
+      Positions next;
+      for(uint64_t position : states[state]) {
+        uint32_t glob = position >> 32;
+        uint32_t pos = position & 0xffffffff;
+        auto &items = globs[glob];
+
+        if(pos < items.size() && items[pos].bytes.test(byte)) {
+          addClosure(globs, glob, items[pos].repeat? pos : pos + 1, next);
+        }
+      }
+
+      std::sort(next.begin(), next.end());
+      next.erase(std::unique(next.begin(), next.end()), next.end());
+
+      auto found = ids.emplace(next, states.size());
+      if(found.second) {
+        states.push_back(next);
+      }
+      raw[state][byte] = found.first->second;
+    }
+  }
+
+  for(auto &positions : states) {
+    std::vector<uint32_t> accepts;
+    for(uint64_t position : positions) {
+      uint32_t glob = position >> 32;
+      if((position & 0xffffffff) == globs[glob].size()) {
+        accepts.push_back(owner[glob]);
+      }
+    }
+
+    std::sort(accepts.begin(), accepts.end());
+    accepts.erase(std::unique(accepts.begin(), accepts.end()), accepts.end());
+    accepting.push_back(accepts);
+  }
+
+  // Every byte is its own class until the automaton is minimized
+  for(unsigned byte = 0; byte < 256; byte++) {
+    classes[byte] = byte;
+  }
+  classCount = 256;
+  for(auto &row : raw) {
+    transitions.insert(transitions.end(), row.begin(), row.end());
+  }
+
+  minimize();
+}
+
+// Merges states that accept the same patterns and lead to equivalent states on every byte,
+// then groups the bytes that cannot be told apart into classes
+void Dfa::minimize()
+{
+  size_t count = accepting.size();
+
+  std::vector<uint32_t> partition(count);
+  std::map<std::vector<uint32_t>, uint32_t> initial;
+  for(size_t state = 0; state < count; state++) {
+    partition[state] = initial.emplace(accepting[state], initial.size()).first->second;
+  }
+
+  size_t partitions = initial.size();
+  while(true) {
+    std::map<std::vector<uint32_t>, uint32_t> signatures;
+    std::vector<uint32_t> refined(count);
+
+    for(size_t state = 0; state < count; state++) {
+      std::vector<uint32_t> signature{partition[state]};
+      for(unsigned byte = 0; byte < 256; byte++) {
+        signature.push_back(partition[transitions[state * 256 + byte]]);
+      }
+      refined[state] = signatures.emplace(signature, signatures.size()).first->second;
+    }
+
+    partition = refined;
+    if(signatures.size() == partitions) {
+      break;
+    }
+    partitions = signatures.size();
+  }
+
+  // The dead state keeps number 0 and the start state number 1, even when nothing is accepted
+  std::vector<int64_t> renumber(partitions, -1);
+  std::vector<uint32_t> representative;
+  renumber[partition[NOMATCH]] = NOMATCH;
+  representative.push_back(NOMATCH);
+  if(partition[START] != partition[NOMATCH]) {
+    renumber[partition[START]] = START;
+  }
+  representative.push_back(START);
+
+  for(size_t state = 0; state < count; state++) {
+    if(renumber[partition[state]] < 0) {
+      renumber[partition[state]] = representative.size();
+      representative.push_back(state);
+    }
+  }
+
+  size_t minimized = representative.size();
+  std::vector<std::array<uint32_t, 256>> rows(minimized);
+  std::vector<std::vector<uint32_t>> accepts(minimized);
+
+  for(size_t state = 0; state < minimized; state++) {
+    for(unsigned byte = 0; byte < 256; byte++) {
+      rows[state][byte] = renumber[partition[transitions[representative[state] * 256 + byte]]];
+    }
+    accepts[state] = accepting[representative[state]];
+  }
+
+  // Bytes with the same column lead everywhere to the same state
+  std::map<std::vector<uint32_t>, uint8_t> columns;
+  for(unsigned byte = 0; byte < 256; byte++) {
+    std::vector<uint32_t> column;
+    for(auto &row : rows) {
+      column.push_back(row[byte]);
+    }
+    classes[byte] = columns.emplace(column, columns.size()).first->second;
+  }
+  classCount = columns.size();
+
+  std::vector<uint8_t> sample(classCount);
+  for(unsigned byte = 256; byte-- > 0; ) {
+    sample[classes[byte]] = byte;
+  }
+
+  transitions.clear();
+  for(auto &row : rows) {
+    for(size_t cls = 0; cls < classCount; cls++) {
+      transitions.push_back(row[sample[cls]]);
+    }
+  }
+  accepting = accepts;
+}
+
+size_t Dfa::stateCount() const
+{
+  return accepting.size();
+}
+
+uint32_t Dfa::next(uint32_t state, uint8_t byte) const
+{
+  return transitions[state * classCount + classes[byte]];
+}
+
+uint32_t Dfa::match(const std::string &text) const
+{
+  uint32_t state = START;
+  for(char c : text) {
+    state = next(state, c);
+  }
+  return state;
+}
+
+const std::vector<uint32_t> &Dfa::getAccepting(uint32_t state) const
+{
+  return accepting[state];
+}
+
+const std::vector<size_t> &Dfa::getSkipped() const
+{
+  return skipped;
+}
+
+/** Table packing **/
+static void putBigEndian(std::string &out, uint64_t value, size_t size)
+{
+  for(size_t i = size; i-- > 0; ) {
+    out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+  }
+}
+
+template <typename T>
+static void putTable(std::string &out, uint16_t id, uint16_t size, const std::vector<T> &values)
+{
+  putBigEndian(out, id, 2);
+  putBigEndian(out, size, 2);
+  putBigEndian(out, 0, 4);
+  putBigEndian(out, values.size(), 4);
+  for(auto value : values) {
+    putBigEndian(out, value, size);
+  }
+  out.resize((out.size() + 7) & ~size_t(7), '\0');
+}
+
+// Transitions to the dead state are left out, and each state's row is placed at the
+// first offset where it does not collide with the rows placed before it
+std::string Dfa::pack(const std::vector<uint32_t> &accept, const std::vector<uint32_t> &accept2) const
+{
+  size_t count = stateCount();
+  if(count > UINT16_MAX) {
+    throw std::length_error("automaton has too many states for the kernel tables");
+  }
+
+  std::vector<uint32_t> base(count, 0);
+  std::vector<uint16_t> def(count, NOMATCH);
+  std::vector<uint16_t> next, check;
+  std::vector<bool> used;
+
+  for(size_t state = 0; state < count; state++) {
+    std::vector<size_t> entries;
+    for(size_t cls = 0; cls < classCount; cls++) {
+      if(transitions[state * classCount + cls] != NOMATCH) {
+        entries.push_back(cls);
+      }
+    }
+
+    if(entries.empty()) {
+      continue;
+    }
+
+    size_t offset = 0;
+    while(std::any_of(entries.begin(), entries.end(), [&](size_t cls) {
+      return offset + cls < used.size() && used[offset + cls];
+    })) {
+      offset++;
+    }
+
+    if(used.size() < offset + classCount) {
+      used.resize(offset + classCount, false);
+      next.resize(offset + classCount, NOMATCH);
+      check.resize(offset + classCount, NOMATCH);
+    }
+
+    base[state] = offset;
+    for(size_t cls : entries) {
+      used[offset + cls] = true;
+      next[offset + cls] = transitions[state * classCount + cls];
+      check[offset + cls] = state;
+    }
+  }
+
+  // The kernel checks that a full row of 256 entries fits after every base
+  size_t size = *std::max_element(base.begin(), base.end()) + 256;
+  next.resize(size, NOMATCH);
+  check.resize(size, NOMATCH);
+
+  std::vector<uint8_t> ec(classes.begin(), classes.end());
+
+  std::string tables;
+  putTable(tables, YYTD_ID_ACCEPT, YYTD_DATA32, accept);
+  putTable(tables, YYTD_ID_ACCEPT2, YYTD_DATA32, accept2);
+  putTable(tables, YYTD_ID_BASE, YYTD_DATA32, base);
+  putTable(tables, YYTD_ID_DEF, YYTD_DATA16, def);
+  putTable(tables, YYTD_ID_NXT, YYTD_DATA16, next);
+  putTable(tables, YYTD_ID_CHK, YYTD_DATA16, check);
+  putTable(tables, YYTD_ID_EC, YYTD_DATA8, ec);
+
+  // Header: magic, header size, total size, flags and a version string, padded to 8 bytes
+  std::string header;
+  const char version[] = "notflex";
+  size_t headerSize = (4 + 4 + 4 + 2 + sizeof(version) + 7) & ~size_t(7);
+
+  putBigEndian(header, YYTH_MAGIC, 4);
+  putBigEndian(header, headerSize, 4);
+  putBigEndian(header, headerSize + tables.size(), 4);
+  putBigEndian(header, 0, 2);
+  header.append(version, sizeof(version));
+  header.resize(headerSize, '\0');
+
+  return header + tables;
+}
@@ -0,0 +1,57 @@
+#ifndef DFA_HH
+#define DFA_HH
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A deterministic automaton over the bytes of a path, built from AppArmor globs.
+// Globs follow the kernel's matching rules: * and ? never match a /, ** matches across
+// components, and a * or ** right after a / does not match the empty string.
+// Alternations are expanded, and a NUL byte in a pattern matches itself,
+// which is how two paths of a link rule are joined.
+//
+// State 0 matches nothing and loops on itself, and state 1 is the start state,
+// the same numbering the kernel uses for the tables built from it.
+class Dfa {
+  public:
+    static constexpr uint32_t NOMATCH = 0;
+    static constexpr uint32_t START = 1;
+
+    // Builds the minimal automaton that accepts every pattern.
+    // Patterns that hold a variable or too many alternations are not added, their
+    // indexes are returned by getSkipped().
+    explicit Dfa(const std::vector<std::string> &patterns);
+
+    size_t stateCount() const;
+
+    uint32_t next(uint32_t state, uint8_t byte) const;
+
+    // The state reached from the start state after the whole text
+    uint32_t match(const std::string &text) const;
+
+    // Indexes of the patterns that accept in a state, in increasing order
+    const std::vector<uint32_t> &getAccepting(uint32_t state) const;
+
+    const std::vector<size_t> &getSkipped() const;
+
+    // Packs the automaton into the table set format read by the kernel (YYTH header,
+    // then the accept, base, default, next, check and equivalence class tables).
+    // accept and accept2 hold one value per state.
+    std::string pack(const std::vector<uint32_t> &accept, const std::vector<uint32_t> &accept2) const;
+
+  private:
+    void minimize();
+
+    // Bytes that lead to the same state from every state share a class
+    std::array<uint8_t, 256> classes;
+    size_t classCount = 0;
+
+    // transitions[state * classCount + class]
+    std::vector<uint32_t> transitions;
+    std::vector<std::vector<uint32_t>> accepting;
+    std::vector<size_t> skipped;
+};
+
+#endif // DFA_HH
@@ -0,0 +1,225 @@
+#include "driver.hh"
+#include "hash.hh"
+#include "lexer.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <parser_yacc.hh>
+#include <stdexcept>
+#include <unordered_map>
+
+extern std::unordered_map<int, std::string> state_names;
+
+void Driver::parse(std::istream &stream, uint64_t offset)
+{
+  yylloc = {.first_pos = offset, .last_pos = offset};
+
+  record_rules = visitor == nullptr && (kinds & AppArmor::ParseOptions::GENERIC) != 0;
+  recent_text.clear();
+  recent_tokens.clear();
+  recent_text_pos = statement_pos = previous_statement_pos = offset;
+
+  Lexer lexer(stream, std::cout);
+  yy::parser parser(lexer, *this);
+
+  if(stats == nullptr) {
+    parser();
+  }
+  else {
+    tokens_by_state.assign(state_names.size(), 0);
+    auto lexTime = stats->lexTime;
+    auto start = std::chrono::steady_clock::now();
+
+    parser();
+
+    // The lexer runs from inside the parser, so take its share back out
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    stats->parseTime += elapsed - (stats->lexTime - lexTime);
+
+    for(size_t state = 0; state < tokens_by_state.size(); state++) {
+      if(tokens_by_state[state] > 0) {
+        stats->tokens[state_names[state]] += tokens_by_state[state];
+      }
+    }
+  }
+
+  if(!success) {
+    std::throw_with_nested(std::runtime_error("error occured when parsing profile"));
+  }
+}
+
+// Hashes a token the way the parser sees it, without the blanks some patterns match along
+static uint64_t tokenHash(int kind, const char *text, size_t length)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  bool quoted = false;
+
+  for(size_t i = 0; i < length; i++) {
+    char c = text[i];
+    if(c == '"') {
+      quoted = !quoted;
+    }
+    else if(!quoted && isspace(static_cast<unsigned char>(c))) {
+      continue;
+    }
+    else if(c == '\\' && i + 1 < length) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+      c = text[++i];
+    }
+
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+  }
+
+  return hashCombine(kind, hashMix(hash));
+}
+
+void Driver::recordToken(const symbol_type &token, const char *text, size_t length)
+{
+  auto kind = token.kind();
+  if(kind == yy::parser::symbol_kind::S_YYEOF) {
+    return;
+  }
+
+  if(kind == yy::parser::symbol_kind::S_TOK_END_OF_RULE || kind == yy::parser::symbol_kind::S_TOK_OPEN ||
+     kind == yy::parser::symbol_kind::S_TOK_CLOSE) {
+    // Everything before the statement ahead of the one this token ends has been reduced
+    size_t dropped = 0;
+    while(dropped < recent_tokens.size() && recent_tokens[dropped].pos < previous_statement_pos) {
+      dropped++;
+    }
+    recent_tokens.erase(recent_tokens.begin(), recent_tokens.begin() + dropped);
+
+    if(previous_statement_pos > recent_text_pos) {
+      recent_text.erase(0, std::min<uint64_t>(previous_statement_pos - recent_text_pos, recent_text.size()));
+      recent_text_pos = previous_statement_pos;
+    }
+
+    previous_statement_pos = statement_pos;
+    statement_pos = token.location.last_pos;
+  }
+
+  recent_tokens.push_back({token.location.first_pos, tokenHash(kind, text, length)});
+}
+
+symbol_type Driver::lex(Lexer &lexer)
+{
+  if(stats == nullptr) {
+    symbol_type token = lexer.yylex(*this);
+    if(record_rules) {
+      recordToken(token, lexer.YYText(), lexer.YYLeng());
+    }
+    return token;
+  }
+
+  // Tokens are counted under the start condition the lexer began matching them in
+  size_t state = lexer.startCondition();
+  auto start = std::chrono::steady_clock::now();
+
+  symbol_type token = lexer.yylex(*this);
+  if(record_rules) {
+    recordToken(token, lexer.YYText(), lexer.YYLeng());
+  }
+
+  stats->lexTime += std::chrono::steady_clock::now() - start;
+  if(state >= tokens_by_state.size()) {
+    tokens_by_state.resize(state + 1, 0);
+  }
+  tokens_by_state[state]++;
+
+  return token;
+}
+
+AppArmor::RulePrefix Driver::visitorPrefix(const PrefixNode &prefix) const
+{
+  AppArmor::RulePrefix outer;
+  if (!visitor_prefixes.empty())
+    outer = visitor_prefixes.back();
+
+  return {outer.audit || prefix.isAudit(), outer.deny || prefix.isDeny(), outer.owner || prefix.isOwner()};
+}
+
+void Driver::appendConditional(RuleList<ProfileNode> &rules, const ConditionalNode &conditional) const
+{
+  std::optional<bool> value;
+  if(!keep_conditionals) {
+    value = conditional.getCondition().evaluate(context);
+  }
+
+  // Branches are folded as they are parsed, so the live one has nothing left to resolve
+  if(!value) {
+    ConditionalNode node = conditional;
+    rules.appendConditional(node);
+  }
+  else {
+    rules.appendRules(*value? conditional.getThen() : conditional.getElse());
+  }
+}
+
+// The source of a rule with every run of blanks and comments turned into a single space
+static std::string ruleText(const std::string &source)
+{
+  std::string text;
+  bool quoted = false;
+  bool blank = false;
+
+  for(size_t i = 0; i < source.size(); i++) {
+    char c = source[i];
+
+    if(!quoted && c == '#' && (text.empty() || blank)) {
+      while(i + 1 < source.size() && source[i + 1] != '\n') {
+        i++;
+      }
+      continue;
+    }
+
+    if(!quoted && isspace(static_cast<unsigned char>(c))) {
+      blank = true;
+      continue;
+    }
+
+    if(blank && !text.empty()) {
+      text += ' ';
+    }
+    blank = false;
+
+    if(c == '"') {
+      quoted = !quoted;
+    }
+    else if(c == '\\' && i + 1 < source.size()) {
+      text += c;
+      c = source[++i];
+    }
+    text += c;
+  }
+
+  return text;
+}
+
+void Driver::appendGenericRule(RuleList<ProfileNode> &rules, const PrefixNode &prefix, const std::string &kind,
+                               uint64_t startPos, uint64_t stopPos)
+{
+  if(visitor) {
+    visitor->onRule(kind, startPos, stopPos);
+    return;
+  }
+
+  if(!record_rules) {
+    return;
+  }
+
+  uint64_t hash = 0;
+  for(auto &token : recent_tokens) {
+    if(token.pos >= startPos && token.pos < stopPos) {
+      hash = hashCombine(hash, token.hash);
+    }
+  }
+
+  std::string source;
+  if(startPos >= recent_text_pos && startPos - recent_text_pos < recent_text.size()) {
+    source = recent_text.substr(startPos - recent_text_pos, stopPos - startPos);
+  }
+
+  GenericRuleNode node(startPos, stopPos, kind, ruleText(source), hash);
+  rules.appendGenericRule(prefix, node);
+}
@@ -1,22 +1,107 @@
 #ifndef DRIVER_HH
 #define DRIVER_HH
 
+#include "apparmor_parse_options.hh"
+#include "apparmor_parse_stats.hh"
+#include "apparmor_visitor.hh"
+#include "common.hh"
 #include "parser.h"
+#include "tree/Condition.hh"
+#include "tree/ConditionalNode.hh"
 #include "tree/ParseTree.hh"
 #include "tree/TreeNode.hh"
+#include <functional>
+#include <istream>
 #include <string>
+#include <vector>
+
+class Lexer;
 
 class Driver
 {
   public:
+    // Runs the lexer and parser over the stream, leaving the result in ast.
+    // Positions are reported relative to offset, so a slice of a file can be
+    // parsed on its own and still report positions within the whole file.
+    void parse(std::istream &stream, uint64_t offset = 0);
+
+    // Called by the parser for every token
+    symbol_type lex(Lexer &lexer);
+    void recordToken(const symbol_type &token, const char *text, size_t length);
+
+    // Appends the live branch of the conditional when its condition is known from context,
+    // or the conditional itself when it is not
+    void appendConditional(RuleList<ProfileNode> &rules, const ConditionalNode &conditional) const;
+
+    // Reports a rule that has no node type of its own to the visitor, or appends it as a
+    // GenericRuleNode with its text and a hash of its tokens
+    void appendGenericRule(RuleList<ProfileNode> &rules, const PrefixNode &prefix, const std::string &kind,
+                           uint64_t startPos, uint64_t stopPos);
+
     bool success = false;
 
     // Parser fields
     std::shared_ptr<ParseTree> ast;
 
+    // When set, grammar actions report to the visitor instead of building the tree
+    AppArmor::Visitor *visitor = nullptr;
+
+    // Prefix of the enclosing blocks for the visitor, one entry per open profile or block
+    std::vector<AppArmor::RulePrefix> visitor_prefixes;
+
+    // The prefix of a rule combined with that of its enclosing blocks
+    AppArmor::RulePrefix visitorPrefix(const PrefixNode &prefix) const;
+
+    // When set, every top-level profile is handed to it once parsed instead of being kept in the
+    // tree, so only one profile is held at a time. The preamble is kept in preamble before the
+    // first profile is handed out.
+    std::function<void(ProfileNode &)> on_profile;
+    PreambleNode preamble;
+
+    // Parse a file of rules without an enclosing profile, like an abstraction.
+    // The rules end up in a single unnamed profile.
+    bool rules_only = false;
+
+    // Values that conditional rules are folded with as they are parsed. Variables assigned
+    // in the preamble are added as they are reached, without replacing the values given here.
+    // With keep_conditionals, every conditional is kept in the tree with both of its branches.
+    EvaluationContext context;
+    bool keep_conditionals = false;
+
+    // Kinds of rules the actions build, from AppArmor::ParseOptions::kinds
+    uint32_t kinds = AppArmor::ParseOptions::ALL;
+
+    // Whether the actions build nodes of a kind. Always true when reporting to a visitor.
+    bool keeps(uint32_t kind) const;
+
+    // When set, the lexer and parser count into it. Left alone otherwise.
+    AppArmor::ParseStats *stats = nullptr;
+    std::vector<uint64_t> tokens_by_state;
+
     // Lexer fields
     YYLTYPE yylloc = {.first_pos = 0, .last_pos = 0};
+
+    // The text and token hashes a GenericRuleNode is built from. The lexer appends every match
+    // to recent_text while record_rules is set. Only the statement being parsed and the one
+    // before it are kept, as a rule may be reduced once the first token of the next one is read.
+    struct TokenHash {
+      uint64_t pos;
+      uint64_t hash;
+    };
+    bool record_rules = false;
+    std::string recent_text;
+    uint64_t recent_text_pos = 0;
+    std::vector<TokenHash> recent_tokens;
+    uint64_t statement_pos = 0;
+    uint64_t previous_statement_pos = 0;
+    bool started = false;
     uint64_t current_lineno = 0;
 };
 
+// Called for every reduced rule, so kept inline
+inline bool Driver::keeps(uint32_t kind) const
+{
+  return visitor != nullptr || (kinds & kind) != 0;
+}
+
 #endif // DRIVER_HH
@@ -0,0 +1,52 @@
+#include "file_mode.hh"
+
+#include <cctype>
+
+FileMode::FileMode(const std::string &mode)
+{
+  for(size_t i = 0; i < mode.size(); i++) {
+    char c = mode[i];
+    char lower = std::tolower(static_cast<unsigned char>(c));
+    char next  = i + 1 < mode.size()? std::tolower(static_cast<unsigned char>(mode[i + 1])) : '\0';
+    char after = i + 2 < mode.size()? std::tolower(static_cast<unsigned char>(mode[i + 2])) : '\0';
+
+    // Exec transitions follow the lexer: [PpCc]x, [IiUu]x and [PpCc][IiUu]x
+    if((lower == 'p' || lower == 'c') && next == 'x') {
+      exec = mode.substr(i, 1);
+      perms |= EXEC;
+      i += 1;
+      continue;
+    }
+    if((lower == 'p' || lower == 'c') && (next == 'i' || next == 'u') && after == 'x') {
+      exec = mode.substr(i, 2);
+      perms |= EXEC;
+      i += 2;
+      continue;
+    }
+    if((lower == 'i' || lower == 'u') && next == 'x') {
+      exec = mode.substr(i, 1);
+      perms |= EXEC;
+      i += 1;
+      continue;
+    }
+
+    switch(lower) {
+      case 'r': perms |= READ; break;
+      case 'w': perms |= WRITE | APPEND; break;
+      case 'a': perms |= APPEND; break;
+      case 'l': perms |= LINK; break;
+      case 'k': perms |= LOCK; break;
+      case 'm': perms |= MMAP; break;
+      case 'x': perms |= EXEC; break;
+    }
+  }
+}
+
+bool FileMode::covers(const FileMode &other) const
+{
+  if((other.perms & ~perms) != 0) {
+    return false;
+  }
+
+  return !(other.perms & EXEC) || other.exec == exec;
+}
@@ -0,0 +1,31 @@
+#ifndef FILE_MODE_HH
+#define FILE_MODE_HH
+
+#include <cstdint>
+#include <string>
+
+// Permissions granted by the mode of a file rule, such as "rw" or "mrPx"
+struct FileMode {
+  static constexpr uint32_t READ   = 1 << 0;
+  static constexpr uint32_t WRITE  = 1 << 1;
+  static constexpr uint32_t APPEND = 1 << 2;
+  static constexpr uint32_t LINK   = 1 << 3;
+  static constexpr uint32_t LOCK   = 1 << 4;
+  static constexpr uint32_t MMAP   = 1 << 5;
+  static constexpr uint32_t EXEC   = 1 << 6;
+
+  FileMode() = default;
+  explicit FileMode(const std::string &mode);
+
+  // Write access implies append access
+  uint32_t perms = 0;
+
+  // Exec transition without the trailing x, such as "i", "P" or "Ci".
+  // Empty for a bare x, which is only valid in deny rules.
+  std::string exec;
+
+  // Whether this mode grants everything the other one does, with the same exec transition
+  bool covers(const FileMode &other) const;
+};
+
+#endif // FILE_MODE_HH
@@ -0,0 +1,320 @@
+#include "glob.hh"
+
+#include <bitset>
+#include <cstdint>
+#include <utility>
+
+enum class GlobToken { LITERAL, ANY, STAR, GLOBSTAR, CLASS, VARIABLE };
+
+struct Token {
+  GlobToken type;
+  std::string text;
+  bool nonEmpty = false; // * or ** right after '/', which never matches the empty string
+};
+
+static std::vector<Token> tokenize(const std::string &pattern)
+{
+  std::vector<Token> tokens;
+
+  for(size_t i = 0; i < pattern.size(); i++) {
+    char c = pattern[i];
+
+    if(c == '\\' && i + 1 < pattern.size()) {
+      tokens.push_back({GlobToken::LITERAL, std::string(1, pattern[++i])});
+    }
+    else if(c == '*') {
+      bool globstar = i + 1 < pattern.size() && pattern[i + 1] == '*';
+      while(i + 1 < pattern.size() && pattern[i + 1] == '*') {
+        i++;
+      }
+      bool afterSlash = !tokens.empty() && tokens.back().type == GlobToken::LITERAL && tokens.back().text == "/";
+      tokens.push_back({globstar? GlobToken::GLOBSTAR : GlobToken::STAR, "", afterSlash});
+    }
+    else if(c == '?') {
+      tokens.push_back({GlobToken::ANY, ""});
+    }
+    else if(c == '[') {
+      size_t end = pattern.find(']', i + 2);
+      if(end == std::string::npos) {
+        tokens.push_back({GlobToken::LITERAL, "["});
+        continue;
+      }
+      tokens.push_back({GlobToken::CLASS, pattern.substr(i + 1, end - i - 1)});
+      i = end;
+    }
+    else if(c == '@' && i + 1 < pattern.size() && pattern[i + 1] == '{') {
+      size_t end = pattern.find('}', i);
+      if(end == std::string::npos) {
+        tokens.push_back({GlobToken::LITERAL, "@"});
+        continue;
+      }
+      tokens.push_back({GlobToken::VARIABLE, pattern.substr(i, end - i + 1)});
+      i = end;
+    }
+    else {
+      tokens.push_back({GlobToken::LITERAL, std::string(1, c)});
+    }
+  }
+
+  return tokens;
+}
+
+static bool classContains(const std::string &body, char c)
+{
+  bool negate = !body.empty() && (body[0] == '^' || body[0] == '!');
+  bool found = false;
+
+  for(size_t i = negate? 1 : 0; i < body.size(); i++) {
+    if(i + 2 < body.size() && body[i + 1] == '-') {
+      found |= body[i] <= c && c <= body[i + 2];
+      i += 2;
+    }
+    else {
+      found |= body[i] == c;
+    }
+  }
+
+  return found != negate;
+}
+
+// Tokens of inner that only ever match a single character other than '/'
+static bool isSingleChar(const Token &token)
+{
+  return (token.type == GlobToken::LITERAL && token.text != "/") ||
+          token.type == GlobToken::ANY ||
+          token.type == GlobToken::CLASS;
+}
+
+bool expandAlternations(const std::string &pattern, std::vector<std::string> &out, size_t limit)
+{
+  // Find the first top-level alternation, everything after it is expanded recursively
+  size_t open = std::string::npos;
+  for(size_t i = 0; i < pattern.size(); i++) {
+    if(pattern[i] == '\\') {
+      i++;
+    }
+    else if(pattern[i] == '{' && (i == 0 || pattern[i - 1] != '@')) {
+      open = i;
+      break;
+    }
+  }
+
+  if(open == std::string::npos) {
+    if(out.size() >= limit) {
+      return false;
+    }
+    out.push_back(pattern);
+    return true;
+  }
+
+  std::vector<std::string> choices;
+  size_t depth = 0;
+  size_t start = open + 1;
+  size_t close = std::string::npos;
+
+  for(size_t i = open + 1; i < pattern.size() && close == std::string::npos; i++) {
+    switch(pattern[i]) {
+      case '\\':
+        i++;
+        break;
+      case '{':
+        depth++;
+        break;
+      case '}':
+        if(depth == 0) {
+          choices.push_back(pattern.substr(start, i - start));
+          close = i;
+        }
+        else {
+          depth--;
+        }
+        break;
+      case ',':
+        if(depth == 0) {
+          choices.push_back(pattern.substr(start, i - start));
+          start = i + 1;
+        }
+        break;
+    }
+  }
+
+  // An unbalanced brace is matched literally
+  if(close == std::string::npos) {
+    if(out.size() >= limit) {
+      return false;
+    }
+    out.push_back(pattern);
+    return true;
+  }
+
+  std::string head = pattern.substr(0, open);
+  std::string tail = pattern.substr(close + 1);
+
+  for(auto &choice : choices) {
+    if(!expandAlternations(head + choice + tail, out, limit)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::string globLiteralPrefix(const std::string &pattern)
+{
+  std::string prefix;
+
+  for(size_t i = 0; i < pattern.size(); i++) {
+    char c = pattern[i];
+    if(c == '*' || c == '?' || c == '[' || c == '{' || (c == '@' && i + 1 < pattern.size() && pattern[i + 1] == '{')) {
+      break;
+    }
+    if(c == '\\' && i + 1 < pattern.size()) {
+      c = pattern[++i];
+    }
+    prefix += c;
+  }
+
+  return prefix;
+}
+
+bool globContains(const std::string &outer, const std::string &inner)
+{
+  auto o = tokenize(outer);
+  auto n = tokenize(inner);
+
+  // contains[i][j]: whether o[i..] matches everything n[j..] matches.
+  // loose[i][j]: the same with o[i] allowed to match the empty string, only differs
+  // for a star that already consumed part of its match.
+  // Filled from the back, so every lookup below is already known.
+  size_t width = n.size() + 1;
+  std::vector<uint8_t> contains((o.size() + 1) * width, false);
+  std::vector<uint8_t> loose((o.size() + 1) * width, false);
+  contains[o.size() * width + n.size()] = true;
+
+  for(size_t i = o.size(); i-- > 0; ) {
+    for(size_t j = n.size() + 1; j-- > 0; ) {
+      bool result = false;
+      bool more = j < n.size();
+      bool next = more && contains[(i + 1) * width + j + 1];
+      bool consumes = false;
+
+      switch(o[i].type) {
+        case GlobToken::GLOBSTAR:
+          // An inner star that may be empty can not be the only thing a non-empty ** matches
+          consumes = more && (isSingleChar(n[j]) || n[j].type == GlobToken::LITERAL || n[j].nonEmpty || !o[i].nonEmpty);
+          loose[i * width + j] = contains[(i + 1) * width + j] || (more && loose[i * width + j + 1]);
+          result = o[i].nonEmpty? consumes && loose[i * width + j + 1] : loose[i * width + j];
+          break;
+        case GlobToken::STAR:
+          consumes = more && (isSingleChar(n[j]) || (n[j].type == GlobToken::STAR && (n[j].nonEmpty || !o[i].nonEmpty)));
+          loose[i * width + j] = contains[(i + 1) * width + j] ||
+                                 (more && (isSingleChar(n[j]) || n[j].type == GlobToken::STAR) && loose[i * width + j + 1]);
+          result = o[i].nonEmpty? consumes && loose[i * width + j + 1] : loose[i * width + j];
+          break;
+        case GlobToken::ANY:
+          result = more && isSingleChar(n[j]) && next;
+          break;
+        case GlobToken::CLASS:
+          result = more && next &&
+                   ((n[j].type == GlobToken::LITERAL && classContains(o[i].text, n[j].text[0])) ||
+                    (n[j].type == GlobToken::CLASS && n[j].text == o[i].text));
+          break;
+        case GlobToken::LITERAL:
+        case GlobToken::VARIABLE:
+          result = more && next && n[j].type == o[i].type && n[j].text == o[i].text;
+          break;
+      }
+
+      contains[i * width + j] = result;
+    }
+  }
+
+  return contains[0];
+}
+
+// Bytes one step of a token can match. Stars stay on the token after the step.
+static std::bitset<256> stepChars(const Token &token)
+{
+  std::bitset<256> chars;
+
+  switch(token.type) {
+    case GlobToken::LITERAL:
+      chars.set(static_cast<unsigned char>(token.text[0]));
+      break;
+    case GlobToken::CLASS:
+      for(int c = 1; c < 256; c++) {
+        chars[c] = classContains(token.text, static_cast<char>(c));
+      }
+      break;
+    case GlobToken::ANY:
+    case GlobToken::STAR:
+      chars.set();
+      chars.reset('/');
+      chars.reset(0);
+      break;
+    case GlobToken::GLOBSTAR:
+    case GlobToken::VARIABLE:
+      chars.set();
+      chars.reset(0);
+      break;
+  }
+
+  return chars;
+}
+
+static bool repeats(const Token &token)
+{
+  return token.type == GlobToken::STAR || token.type == GlobToken::GLOBSTAR || token.type == GlobToken::VARIABLE;
+}
+
+bool globsOverlap(const std::string &first, const std::string &second)
+{
+  auto a = tokenize(first);
+  auto b = tokenize(second);
+
+  // Walks both patterns over the same path at once. A state is a position in each pattern,
+  // and whether the star at that position has matched a character yet.
+  struct State {
+    size_t i, j;
+    bool startedA, startedB;
+  };
+
+  size_t width = b.size() + 1;
+  std::vector<uint8_t> seen((a.size() + 1) * width * 4, false);
+  std::vector<State> pending{{0, 0, false, false}};
+
+  auto push = [&](State state) {
+    size_t index = ((state.i * width + state.j) * 2 + state.startedA) * 2 + state.startedB;
+    if(!seen[index]) {
+      seen[index] = true;
+      pending.push_back(state);
+    }
+  };
+
+  while(!pending.empty()) {
+    State state = pending.back();
+    pending.pop_back();
+
+    bool endA = state.i == a.size(), endB = state.j == b.size();
+    if(endA && endB) {
+      return true;
+    }
+
+    // A star can stop matching, unless it still owes the character it must match after a '/'
+    if(!endA && repeats(a[state.i]) && (state.startedA || !a[state.i].nonEmpty)) {
+      push({state.i + 1, state.j, false, state.startedB});
+    }
+    if(!endB && repeats(b[state.j]) && (state.startedB || !b[state.j].nonEmpty)) {
+      push({state.i, state.j + 1, state.startedA, false});
+    }
+
+    if(endA || endB || (stepChars(a[state.i]) & stepChars(b[state.j])).none()) {
+      continue;
+    }
+
+    bool starA = repeats(a[state.i]), starB = repeats(b[state.j]);
+    push({starA? state.i : state.i + 1, starB? state.j : state.j + 1, starA, starB});
+  }
+
+  return false;
+}
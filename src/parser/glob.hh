@@ -0,0 +1,30 @@
+#ifndef GLOB_HH
+#define GLOB_HH
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// AppArmor path globs: * matches within one path component, ** across components,
+// ? matches one character, [...] a character class and {a,b} any of the alternatives.
+// A * or ** right after '/' matches at least one character, so /dir/** does not match /dir/.
+// Variables such as @{HOME} are not expanded and only match themselves.
+
+// Expands every {a,b} alternation, nested ones included, into out.
+// Returns false if there were more than limit alternatives, out then holds the first limit of them.
+bool expandAlternations(const std::string &pattern, std::vector<std::string> &out, size_t limit = 256);
+
+// Text before the first special character of a pattern without alternations
+std::string globLiteralPrefix(const std::string &pattern);
+
+// Whether every path matched by inner is also matched by outer.
+// Neither pattern may contain alternations, expand them first.
+// The check is conservative: a false answer does not prove that some path is only matched by inner.
+bool globContains(const std::string &outer, const std::string &inner);
+
+// Whether some path is matched by both patterns.
+// Neither pattern may contain alternations, expand them first.
+// A variable is taken to match anything, so patterns using one may overlap when they do not.
+bool globsOverlap(const std::string &first, const std::string &second);
+
+#endif // GLOB_HH
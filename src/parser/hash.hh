@@ -0,0 +1,39 @@
+#ifndef HASH_HH
+#define HASH_HH
+
+#include <cstdint>
+#include <string>
+
+// Stable 64-bit hashing of tree contents. std::hash may differ between builds and
+// standard libraries, so strings are hashed with FNV-1a and finished with the
+// splitmix64 avalanche step.
+
+inline uint64_t hashMix(uint64_t value)
+{
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+
+inline uint64_t hashString(const std::string &str)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+
+  for(unsigned char c : str) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+
+  return hashMix(hash ^ str.size());
+}
+
+// Order dependent, for combining the fields of a single node
+inline uint64_t hashCombine(uint64_t seed, uint64_t value)
+{
+  return hashMix(seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+#endif // HASH_HH
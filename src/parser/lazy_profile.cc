@@ -0,0 +1,53 @@
+#include "lazy_profile.hh"
+#include "driver.hh"
+
+#include <sstream>
+#include <stdexcept>
+
+LazyProfile::LazyProfile(std::shared_ptr<const std::string> source, const ProfileRange &range,
+                         std::shared_ptr<const EvaluationContext> context, std::shared_ptr<const AliasTrie> aliases,
+                         uint32_t kinds)
+  : source{source},
+    range{range},
+    context{context},
+    aliases{aliases},
+    kinds{kinds}
+{   }
+
+const std::string &LazyProfile::getName() const
+{
+  return range.name;
+}
+
+std::shared_ptr<ProfileNode> LazyProfile::get()
+{
+  std::call_once(parsed, [this]() {
+    // Only the profile itself is handed to the lexer, the preamble does not
+    // change how its rules are parsed other than through the context
+    std::istringstream stream(source->substr(range.startPos, range.stopPos - range.startPos));
+
+    Driver driver;
+    driver.kinds = kinds;
+    if(context) {
+      driver.context = *context;
+    }
+    else {
+      driver.keep_conditionals = true;
+    }
+    driver.parse(stream, range.startPos);
+
+    if(driver.ast->profileList->empty()) {
+      throw std::runtime_error("no profile found where the pre-scan expected '" + range.name + "'");
+    }
+
+    auto &profile = driver.ast->profileList->front();
+    if(aliases) {
+      profile = aliases->apply(profile);
+    }
+
+    // Keeps the small tree of this one profile alive, rather than copying the profile out of it
+    node = std::shared_ptr<ProfileNode>(driver.ast, &profile);
+  });
+
+  return node;
+}
@@ -0,0 +1,41 @@
+#ifndef LAZY_PROFILE_HH
+#define LAZY_PROFILE_HH
+
+#include "alias_trie.hh"
+#include "apparmor_parse_options.hh"
+#include "prescan.hh"
+#include "tree/Condition.hh"
+#include "tree/ProfileNode.hh"
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+// A top-level profile that has been located by the pre-scan but not parsed yet.
+// The profile is parsed the first time get() is called, and shared from then on.
+// Conditional rules are folded with context, which holds the variables of the preamble
+// since that is not part of the profile. Without a context every conditional is kept.
+// The aliases of the preamble, when given, are applied to the parsed profile.
+// Only the kinds of rules in kinds are built, see AppArmor::ParseOptions::kinds.
+class LazyProfile {
+  public:
+    LazyProfile(std::shared_ptr<const std::string> source, const ProfileRange &range,
+                std::shared_ptr<const EvaluationContext> context = nullptr,
+                std::shared_ptr<const AliasTrie> aliases = nullptr,
+                uint32_t kinds = AppArmor::ParseOptions::ALL);
+
+    const std::string &getName() const;
+    std::shared_ptr<ProfileNode> get();
+
+  private:
+    std::shared_ptr<const std::string> source;
+    ProfileRange range;
+    std::shared_ptr<const EvaluationContext> context;
+    std::shared_ptr<const AliasTrie> aliases;
+    uint32_t kinds;
+
+    std::once_flag parsed;
+    std::shared_ptr<ProfileNode> node;
+};
+
+#endif // LAZY_PROFILE_HH
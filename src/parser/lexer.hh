@@ -22,6 +22,9 @@ class Lexer : public yyFlexLexer {
       : yyFlexLexer(arg_yyin, arg_yyout) {}
   
     virtual symbol_type yylex(Driver& driver);
+
+    // The current start condition, the same as YY_START inside the rules
+    int startCondition() const { return (yy_start - 1) / 2; }
 };
 
 // Define the lexer prototype
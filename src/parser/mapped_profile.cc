@@ -0,0 +1,20 @@
+#include "mapped_profile.hh"
+
+MappedProfile::MappedProfile(std::shared_ptr<const PolicyImage> image, uint32_t index)
+  : image{image},
+    index{index}
+{   }
+
+std::string MappedProfile::getName() const
+{
+  return image->profileName(index);
+}
+
+std::shared_ptr<ProfileNode> MappedProfile::get()
+{
+  std::call_once(decoded, [this]() {
+    node = image->decodeProfile(index);
+  });
+
+  return node;
+}
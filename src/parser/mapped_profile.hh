@@ -0,0 +1,29 @@
+#ifndef MAPPED_PROFILE_HH
+#define MAPPED_PROFILE_HH
+
+#include "policy_image.hh"
+#include "tree/ProfileNode.hh"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// A top-level profile of a mapped policy image. The name is read from the image, and the
+// profile is decoded the first time get() is called and shared from then on.
+class MappedProfile {
+  public:
+    MappedProfile(std::shared_ptr<const PolicyImage> image, uint32_t index);
+
+    std::string getName() const;
+    std::shared_ptr<ProfileNode> get();
+
+  private:
+    std::shared_ptr<const PolicyImage> image;
+    uint32_t index;
+
+    std::once_flag decoded;
+    std::shared_ptr<ProfileNode> node;
+};
+
+#endif // MAPPED_PROFILE_HH
@@ -0,0 +1,36 @@
+#ifndef MEMORY_USAGE_HH
+#define MEMORY_USAGE_HH
+
+#include "apparmor_memory_usage.hh"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+// Heap bytes of a string, or zero when it is stored inside the string object itself
+inline size_t stringUsage(const std::string &str)
+{
+  auto data = reinterpret_cast<uintptr_t>(str.data());
+  auto object = reinterpret_cast<uintptr_t>(&str);
+  if(data >= object && data < object + sizeof(str)) {
+    return 0;
+  }
+
+  return str.capacity() + 1;
+}
+
+// Bytes of one std::list element: the value and its two links
+template<class T>
+constexpr size_t listElementSize()
+{
+  return sizeof(T) + 2 * sizeof(void *);
+}
+
+// Bytes of one std::map element: the key and value, and the colour and three links of its tree node
+template<class Key, class Value>
+constexpr size_t mapElementSize()
+{
+  return sizeof(std::pair<const Key, Value>) + 4 * sizeof(void *);
+}
+
+#endif // MEMORY_USAGE_HH
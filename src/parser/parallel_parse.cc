@@ -0,0 +1,91 @@
+#include "parallel_parse.hh"
+#include "driver.hh"
+#include "prescan.hh"
+
+#include <future>
+#include <sstream>
+#include <vector>
+
+// Parses source[startPos, stopPos) with positions relative to the whole source
+static std::shared_ptr<ParseTree> parseSlice(const std::string &source, uint64_t startPos, uint64_t stopPos,
+                                             const EvaluationContext &context, bool keepConditionals, uint32_t kinds)
+{
+  std::istringstream stream(source.substr(startPos, stopPos - startPos));
+
+  Driver driver;
+  driver.context = context;
+  driver.keep_conditionals = keepConditionals;
+  driver.kinds = kinds;
+  driver.parse(stream, startPos);
+  return driver.ast;
+}
+
+static std::shared_ptr<ParseTree> parseSerial(const std::string &source, const EvaluationContext &context,
+                                              bool keepConditionals, uint32_t kinds)
+{
+  return parseSlice(source, 0, source.size(), context, keepConditionals, kinds);
+}
+
+// Groups consecutive profiles into at most `threads` slices of similar size
+static std::vector<std::pair<uint64_t, uint64_t>> splitProfiles(const std::vector<ProfileRange> &profiles, unsigned int threads)
+{
+  std::vector<std::pair<uint64_t, uint64_t>> slices;
+
+  uint64_t total = profiles.back().stopPos - profiles.front().startPos;
+  uint64_t target = total / threads + 1;
+
+  uint64_t sliceStart = profiles.front().startPos;
+  for(auto &profile : profiles) {
+    if(profile.stopPos - sliceStart >= target || &profile == &profiles.back()) {
+      slices.emplace_back(sliceStart, profile.stopPos);
+      sliceStart = profile.stopPos;
+    }
+  }
+
+  return slices;
+}
+
+std::shared_ptr<ParseTree> parseParallel(const std::string &source, unsigned int threads,
+                                         const EvaluationContext &context, bool keepConditionals, uint32_t kinds)
+{
+  auto scan = prescan(source);
+  if(threads <= 1 || scan.profiles.size() <= 1) {
+    return parseSerial(source, context, keepConditionals, kinds);
+  }
+
+  try {
+    auto slices = splitProfiles(scan.profiles, threads);
+
+    std::vector<std::future<std::shared_ptr<ParseTree>>> results;
+    for(auto &slice : slices) {
+      results.push_back(std::async(std::launch::async, parseSlice, std::cref(source), slice.first, slice.second,
+                                   std::cref(context), keepConditionals, kinds));
+    }
+
+    // Aliases, variables and abi rules are handled once, on this thread
+    auto preamble = parseSlice(source, 0, scan.preambleStop, context, keepConditionals, kinds);
+
+    auto profileList = std::make_shared<std::list<ProfileNode>>();
+    for(auto &result : results) {
+      auto tree = result.get();
+      profileList->splice(profileList->end(), *tree->profileList);
+    }
+
+    // The slices did not see the variables of the preamble, so fold what they left with them
+    auto &definitions = preamble->preamble.getDefinitions();
+    if(!keepConditionals && (!definitions.booleans.empty() || !definitions.variables.empty())) {
+      EvaluationContext merged = context;
+      merged.merge(definitions);
+      for(auto &profile : *profileList) {
+        profile.resolveConditionals(merged);
+      }
+    }
+
+    return std::make_shared<ParseTree>(preamble->preamble, profileList);
+  }
+  catch(const std::exception &) {
+    // The pre-scan does not validate anything, so let a serial parse of the
+    // whole file either succeed or report the error with its real context
+    return parseSerial(source, context, keepConditionals, kinds);
+  }
+}
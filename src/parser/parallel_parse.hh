@@ -0,0 +1,21 @@
+#ifndef PARALLEL_PARSE_HH
+#define PARALLEL_PARSE_HH
+
+#include "apparmor_parse_options.hh"
+#include "tree/Condition.hh"
+#include "tree/ParseTree.hh"
+
+#include <memory>
+#include <string>
+
+// Parses a whole file, splitting it at top-level profile boundaries and handing
+// the pieces to worker threads that each run their own Lexer and Driver.
+// Positions in the resulting tree are relative to the start of source.
+// Conditional rules are folded with context and the variables of the preamble,
+// unless keepConditionals is set, as they would be by a single Driver.
+// Only the kinds of rules in kinds are built, see AppArmor::ParseOptions::kinds.
+std::shared_ptr<ParseTree> parseParallel(const std::string &source, unsigned int threads,
+                                         const EvaluationContext &context = {}, bool keepConditionals = false,
+                                         uint32_t kinds = AppArmor::ParseOptions::ALL);
+
+#endif // PARALLEL_PARSE_HH
@@ -20,17 +20,22 @@
 
 #define YYERROR_VERBOSE 1
 #include <iostream>
+#include <stdexcept>
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 
 #include "parser.h"
 #include "lexer.hh"
 
 // For tracking location
+// Runs once for every reduction, which is also where they are counted
 # define YYLLOC_DEFAULT(Cur, Rhs, N)                \
-do                                                  \
+do {                                                \
+  if (driver.stats)                                 \
+    driver.stats->reductions++;                     \
   if (N)                                            \
     {                                               \
       (Cur).first_pos = YYRHSLOC(Rhs, 1).first_pos; \
@@ -41,7 +46,7 @@ do                                                  \
       (Cur).first_pos = (Cur).last_pos =            \
         YYRHSLOC(Rhs, 0).last_pos;                  \
     }                                               \
-while (0)
+} while (0)
 
 %}
 
@@ -127,6 +132,11 @@ while (0)
 %token TOK_INCLUDE
 %token TOK_INCLUDE_IF_EXISTS
 
+/* never produced from the input, the lexer returns it first when
+ * the Driver asks for a file of rules without an enclosing profile
+ */
+%token TOK_START_RULES
+
  /* rlimits */
 %token TOK_RLIMIT
 %token TOK_SOFT_RLIMIT
@@ -154,15 +164,20 @@ while (0)
 %token TOK_FLAGS
 
 %code requires {
+	#include <map>
 	#include <memory>
 	#include <sstream>
 
 	#include "parser.h"
 	#include "tree/AbstractionNode.hh"
 	#include "tree/AliasNode.hh"
+	#include "tree/ChangeProfileNode.hh"
+	#include "tree/Condition.hh"
+	#include "tree/ConditionalNode.hh"
 	#include "tree/FileNode.hh"
 	#include "tree/LinkNode.hh"
 	#include "tree/ParseTree.hh"
+	#include "tree/PreambleNode.hh"
 	#include "tree/ProfileNode.hh"
 	#include "tree/PrefixNode.hh"
 	#include "tree/RuleList.hh"
@@ -179,7 +194,7 @@ while (0)
 
 %code{
   #undef yylex
-  #define yylex scanner.yylex
+  #define yylex(driver) (driver).lex(scanner)
 }
 
 %type <std::shared_ptr<ParseTree>> 				tree
@@ -187,9 +202,9 @@ while (0)
 %type <ProfileNode> 							profile_base
 %type <ProfileNode> 							profile
 %type <ProfileNode> 							local_profile
-%type <TreeNode> 								preamble
+%type <PreambleNode> 							preamble
 %type <RuleList<ProfileNode>> 					rules
-%type <TreeNode> 								alias
+%type <AliasNode> 								alias
 %type <PrefixNode> 								opt_prefix
 
 %type <AbstractionNode> abstraction
@@ -201,10 +216,20 @@ while (0)
 %type <RuleNode> ptrace_rule
 %type <RuleNode> unix_rule
 %type <RuleNode> userns_rule
-%type <RuleNode> change_profile
+%type <ChangeProfileNode> change_profile
 %type <RuleNode> capability
-%type <RuleNode> hat
-%type <RuleNode> cond_rule
+%type <ProfileNode> hat
+%type <ConditionalNode> cond_rule
+%type <Condition> expr
+%type <VariableAssignment> varassign
+%type <std::vector<std::string>> valuelist
+%type <std::vector<std::string>> flags
+%type <std::vector<std::string>> flagvals
+%type <std::string> flagval
+%type <std::pair<std::string, std::vector<std::string>>> cond
+%type <std::map<std::string, std::vector<std::string>>> opt_conds
+%type <std::map<std::string, std::vector<std::string>>> cond_list
+%type <std::map<std::string, std::vector<std::string>>> opt_cond_list
 %type <LinkNode> link_rule
 %type <FileNode> file_rule
 %type <FileNode> frule
@@ -225,7 +250,7 @@ while (0)
 %type <bool> opt_profile_flag
 %type <bool> opt_flags
 %type <bool> opt_perm_mode
-%type <bool> opt_exec_mode
+%type <std::string> opt_exec_mode
 %type <bool> opt_file
 
 %type <std::string> file_mode
@@ -237,14 +262,33 @@ while (0)
 %%
 
 
-tree: preamble profilelist { 
-								$$ = std::make_shared<ParseTree>($1, $2);
+file: tree
+	| TOK_START_RULES rules {
+								// An abstraction is kept as a single unnamed profile holding its rules
+								auto profileList = std::make_shared<std::list<ProfileNode>>();
+								profileList->push_back(ProfileNode("", $2));
+
+								driver.ast = std::make_shared<ParseTree>(PreambleNode(), profileList);
+								driver.success = true;
+							}
+
+tree: preamble {
+					if (driver.on_profile)
+						driver.preamble = $1;
+				} profilelist { 
+								$$ = std::make_shared<ParseTree>($1, $3);
 								driver.ast = $$;
 								driver.success = true;
 						   };
 
 profilelist:					 { $$ = std::make_shared<std::list<ProfileNode>>(); }
-		   | profilelist profile { $$ = $1; $$->push_back($2); }
+		   | profilelist profile {
+									$$ = $1;
+									if (driver.on_profile)
+										driver.on_profile($2);
+									else if (!driver.visitor)
+										$$->push_back($2);
+								 }
 
 opt_profile_flag:
 				| TOK_PROFILE
@@ -257,44 +301,86 @@ opt_id_or_var:
 			 | id_or_var
 
 // Should eventually add optional stuff into 
-profile_base: TOK_ID opt_id_or_var opt_cond_list flags TOK_OPEN rules TOK_CLOSE {
-		$6.setStartPosition(@6.first_pos);
-		$6.setStopPosition(@6.last_pos);
-
-		$$ = ProfileNode($1, $6);
+profile_base: TOK_ID opt_id_or_var opt_cond_list flags TOK_OPEN {
+		// Blocks around a subprofile do not apply to its rules
+		if (driver.visitor) {
+			driver.visitor->onProfileBegin($1, @1.first_pos);
+			driver.visitor_prefixes.emplace_back();
+		}
+	} rules TOK_CLOSE {
+		$7.setStartPosition(@7.first_pos);
+		$7.setStopPosition(@7.last_pos);
+
+		if (driver.visitor) {
+			driver.visitor_prefixes.pop_back();
+			driver.visitor->onProfileEnd($1, @8.last_pos);
+		}
+
+		$$ = ProfileNode($1, $7, @1.first_pos, @8.last_pos, $2);
+		$$.setXattrs($3);
+		$$.setFlags($4);
 	}
 
 profile: opt_profile_flag profile_base { $$ = $2; }
 
 local_profile: TOK_PROFILE profile_base { $$ = $2; }
 
-hat: hat_start profile_base
-
-preamble:					 	{ $$ = TreeNode(); }
-		| preamble alias	 	{ $$ = $1; $$.appendChild($2); }
-		| preamble varassign 	{ $$ = $1; /*$$.appendChild($2);*/ }
-		| preamble abi_rule	 	{ $$ = $1; $$.appendChild($2); }
-		| preamble abstraction	{ $$ = $1; /*$$.appendChild($2);*/ }
+hat: hat_start profile_base { $$ = $2; $$.setHat(true); }
+
+preamble:					 	{ $$ = PreambleNode(); }
+		| preamble alias	 	{ $$ = $1; if (!driver.visitor) $$.appendAlias($2); }
+		| preamble varassign 	{
+									$$ = $1;
+
+									// Values given by the caller take precedence over the file
+									if ($2.variable[0] == '$') {
+										bool value = strcasecmp($2.values.front().c_str(), "true") == 0;
+										driver.context.booleans.emplace(variableName($2.variable), value);
+										if (!driver.visitor)
+											$$.defineBoolean($2.variable, value);
+									}
+									else {
+										driver.context.variables.insert(variableName($2.variable));
+										if (!driver.visitor)
+											$$.defineVariable($2);
+									}
+								}
+		| preamble abi_rule	 	{ $$ = $1; if (!driver.visitor) $$.appendAbi($2.getText()); }
+		| preamble abstraction	{
+									$$ = $1;
+									if (driver.visitor)
+										driver.visitor->onInclude($2.getPath(), $2.isIfExists(), $2.getStartPosition(), $2.getStopPosition());
+									else if (driver.keeps(AppArmor::ParseOptions::INCLUDE))
+										$$.appendAbstraction($2);
+								}
 
 alias: TOK_ALIAS TOK_ID TOK_ARROW TOK_ID TOK_END_OF_RULE {
+		if (driver.visitor)
+			driver.visitor->onAlias($2, $4, @1.first_pos, @5.last_pos);
+
 		$$ = AliasNode($2, $4);
 	}
 
-varassign: TOK_SET_VAR TOK_EQUALS valuelist
-		 | TOK_SET_VAR TOK_ADD_ASSIGN valuelist
-		 | TOK_BOOL_VAR TOK_EQUALS TOK_VALUE
+varassign: TOK_SET_VAR TOK_EQUALS valuelist		{ $$ = VariableAssignment{$1, false, $3}; }
+		 | TOK_SET_VAR TOK_ADD_ASSIGN valuelist	{ $$ = VariableAssignment{$1, true, $3}; }
+		 | TOK_BOOL_VAR TOK_EQUALS TOK_VALUE	{
+													if (strcasecmp($3.c_str(), "true") != 0 && strcasecmp($3.c_str(), "false") != 0)
+														error(@3, "invalid boolean value for " + $1 + ": " + $3);
+
+													$$ = VariableAssignment{$1, false, {$3}};
+												}
 
-valuelist: TOK_VALUE
-		 | valuelist TOK_VALUE
+valuelist: TOK_VALUE				{ $$.push_back($1); }
+		 | valuelist TOK_VALUE		{ $$ = $1; $$.push_back($2); }
 
 opt_flags:
 	| TOK_CONDID TOK_EQUALS
 
-flags:
-	 | opt_flags TOK_OPENPAREN flagvals TOK_CLOSEPAREN
+flags:										{$$ = {};}
+	 | opt_flags TOK_OPENPAREN flagvals TOK_CLOSEPAREN	{$$ = $3;}
 
-flagvals: flagvals flagval
-		| flagval
+flagvals: flagvals flagval	{$$ = $1; $$.push_back($2);}
+		| flagval			{$$.push_back($1);}
 
 flagval:	TOK_VALUE
 
@@ -317,33 +403,84 @@ opt_perm_mode:				{$$ = false;}
 opt_prefix: opt_audit_flag opt_perm_mode opt_owner_flag {$$ = PrefixNode($1, $2, $3);}
 
 rules:												{$$ = RuleList<ProfileNode>(@0.last_pos);}
-	 | rules abi_rule								{$$ = $1;}
-	 | rules opt_prefix file_rule					{$$ = $1; $$.appendFileNode($2, $3);}
-	 | rules opt_prefix link_rule					{$$ = $1; $$.appendLinkNode($2, $3);}
-	 | rules opt_prefix TOK_OPEN rules TOK_CLOSE	{$$ = $1; $$.appendRuleList($2, $4);}
-	 | rules opt_prefix network_rule				{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules opt_prefix mnt_rule					{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules opt_prefix dbus_rule					{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules opt_prefix signal_rule					{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules opt_prefix ptrace_rule					{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules opt_prefix unix_rule					{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules opt_prefix userns_rule					{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules opt_prefix change_profile				{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules opt_prefix capability					{$$ = $1; /* $$.appendChildren({$2, $3}); */}
-	 | rules hat									{$$ = $1; /* $$.appendChild($2); */}
-	 | rules local_profile							{$$ = $1; $$.appendSubprofile($2);}
-	 | rules cond_rule								{$$ = $1; /* $$.appendChild($2); */}
-	 | rules abstraction							{$$ = $1; $$.appendAbstraction($2);}
-	 | rules TOK_SET TOK_RLIMIT TOK_ID TOK_LE TOK_VALUE opt_id TOK_END_OF_RULE	{$$ = $1;}
-
-cond_rule: TOK_IF expr TOK_OPEN rules TOK_CLOSE
-		 | TOK_IF expr TOK_OPEN rules TOK_CLOSE TOK_ELSE TOK_OPEN rules TOK_CLOSE
-		 | TOK_IF expr TOK_OPEN rules TOK_CLOSE TOK_ELSE cond_rule
-
-expr:	TOK_NOT expr
-	|	TOK_BOOL_VAR
-	|	TOK_DEFINED TOK_SET_VAR
-	|	TOK_DEFINED TOK_BOOL_VAR
+	 | rules abi_rule								{$$ = $1; driver.appendGenericRule($$, PrefixNode(), "abi", @2.first_pos, @2.last_pos);}
+	 | rules opt_prefix file_rule					{
+														$$ = $1;
+														if (driver.visitor)
+															driver.visitor->onFileRule($3.getFilename(), $3.getFilemode(), driver.visitorPrefix($2), $3.getStartPosition(), $3.getStopPosition());
+														else if (driver.keeps(AppArmor::ParseOptions::FILE))
+															$$.appendFileNode($2, $3);
+													}
+	 | rules opt_prefix link_rule					{
+														$$ = $1;
+														if (driver.visitor)
+															driver.visitor->onLinkRule($3.getFrom(), $3.getTo(), driver.visitorPrefix($2), $3.getStartPosition(), $3.getStopPosition());
+														else if (driver.keeps(AppArmor::ParseOptions::LINK))
+															$$.appendLinkNode($2, $3);
+													}
+	 | rules opt_prefix TOK_OPEN					{
+														if (driver.visitor)
+															driver.visitor_prefixes.push_back(driver.visitorPrefix($2));
+													}
+	   rules TOK_CLOSE								{
+														$$ = $1;
+														if (driver.visitor)
+															driver.visitor_prefixes.pop_back();
+														else
+															$$.appendRuleList($2, $5);
+													}
+	 | rules opt_prefix network_rule				{$$ = $1; driver.appendGenericRule($$, $2, "network", @3.first_pos, @3.last_pos);}
+	 | rules opt_prefix mnt_rule					{$$ = $1; driver.appendGenericRule($$, $2, "mount", @3.first_pos, @3.last_pos);}
+	 | rules opt_prefix dbus_rule					{$$ = $1; driver.appendGenericRule($$, $2, "dbus", @3.first_pos, @3.last_pos);}
+	 | rules opt_prefix signal_rule					{$$ = $1; driver.appendGenericRule($$, $2, "signal", @3.first_pos, @3.last_pos);}
+	 | rules opt_prefix ptrace_rule					{$$ = $1; driver.appendGenericRule($$, $2, "ptrace", @3.first_pos, @3.last_pos);}
+	 | rules opt_prefix unix_rule					{$$ = $1; driver.appendGenericRule($$, $2, "unix", @3.first_pos, @3.last_pos);}
+	 | rules opt_prefix userns_rule					{$$ = $1; driver.appendGenericRule($$, $2, "userns", @3.first_pos, @3.last_pos);}
+	 | rules opt_prefix change_profile				{
+														$$ = $1;
+														if (driver.visitor)
+															driver.visitor->onRule("change_profile", @3.first_pos, @3.last_pos);
+														else if (driver.keeps(AppArmor::ParseOptions::CHANGE_PROFILE))
+															$$.appendChangeProfile($2, $3);
+													}
+	 | rules opt_prefix capability					{$$ = $1; driver.appendGenericRule($$, $2, "capability", @3.first_pos, @3.last_pos);}
+	 | rules hat									{$$ = $1; if (!driver.visitor && driver.keeps(AppArmor::ParseOptions::SUBPROFILE)) $$.appendSubprofile($2);}
+	 | rules local_profile							{$$ = $1; if (!driver.visitor && driver.keeps(AppArmor::ParseOptions::SUBPROFILE)) $$.appendSubprofile($2);}
+	 | rules cond_rule								{
+														$$ = $1;
+														if (!driver.visitor)
+															driver.appendConditional($$, $2);
+													}
+	 | rules abstraction							{
+														$$ = $1;
+														if (driver.visitor)
+															driver.visitor->onInclude($2.getPath(), $2.isIfExists(), $2.getStartPosition(), $2.getStopPosition());
+														else if (driver.keeps(AppArmor::ParseOptions::INCLUDE))
+															$$.appendAbstraction($2);
+													}
+	 | rules TOK_SET TOK_RLIMIT TOK_ID TOK_LE TOK_VALUE opt_id TOK_END_OF_RULE	{
+														$$ = $1;
+														driver.appendGenericRule($$, PrefixNode(), "rlimit", @2.first_pos, @8.last_pos);
+													}
+
+cond_rule: TOK_IF expr TOK_OPEN rules TOK_CLOSE	{
+				$$ = ConditionalNode(@1.first_pos, @5.last_pos, $2, $4, RuleList<ProfileNode>(@5.last_pos));
+			}
+		 | TOK_IF expr TOK_OPEN rules TOK_CLOSE TOK_ELSE TOK_OPEN rules TOK_CLOSE	{
+				$$ = ConditionalNode(@1.first_pos, @9.last_pos, $2, $4, $8);
+			}
+		 | TOK_IF expr TOK_OPEN rules TOK_CLOSE TOK_ELSE cond_rule	{
+				RuleList<ProfileNode> otherwise(@7.first_pos);
+				if (!driver.visitor)
+					driver.appendConditional(otherwise, $7);
+
+				$$ = ConditionalNode(@1.first_pos, @7.last_pos, $2, $4, otherwise);
+			}
+
+expr:	TOK_NOT expr				{ $$ = Condition::negate($2); }
+	|	TOK_BOOL_VAR				{ $$ = Condition(Condition::Kind::BOOLEAN, $1); }
+	|	TOK_DEFINED TOK_SET_VAR		{ $$ = Condition(Condition::Kind::DEFINED, $2); }
+	|	TOK_DEFINED TOK_BOOL_VAR	{ $$ = Condition(Condition::Kind::DEFINED, $2); }
 
 id_or_var: TOK_ID		{$$ = $1;}
 		 | TOK_SET_VAR	{$$ = $1;}
@@ -354,49 +491,53 @@ opt_target: /* nothing */
 opt_named_transition:						{$$ = "";}
 					| TOK_ARROW id_or_var	{$$ = $2;}
 
-abi_rule: TOK_ABI TOK_ID 	TOK_END_OF_RULE	{$$ = TreeNode($2);}
-		| TOK_ABI TOK_VALUE TOK_END_OF_RULE	{$$ = TreeNode($2);}
+abi_rule: TOK_ABI TOK_ID 	TOK_END_OF_RULE	{$$ = TreeNode("<" + $2 + ">");}
+		| TOK_ABI TOK_VALUE TOK_END_OF_RULE	{$$ = TreeNode("\"" + $2 + "\"");}
 
 abstraction: TOK_INCLUDE		   TOK_ID 	 {$$ = AbstractionNode(@1.first_pos, @2.last_pos, $2, false);}
 		   | TOK_INCLUDE		   TOK_VALUE {$$ = AbstractionNode(@1.first_pos, @2.last_pos, $2, false);}
 		   | TOK_INCLUDE_IF_EXISTS TOK_ID 	 {$$ = AbstractionNode(@1.first_pos, @2.last_pos, $2, true);}
 		   | TOK_INCLUDE_IF_EXISTS TOK_VALUE {$$ = AbstractionNode(@1.first_pos, @2.last_pos, $2, true);}
 
-opt_exec_mode:
-			 | TOK_UNSAFE
-			 | TOK_SAFE
+opt_exec_mode:				{$$ = "";}
+			 | TOK_UNSAFE	{$$ = "unsafe";}
+			 | TOK_SAFE		{$$ = "safe";}
 
 opt_file:
 		| TOK_FILE
 
 // Should utilize the deleted get_mode() from parser.h instead of yylval mode
-frule: id_or_var file_mode opt_named_transition TOK_END_OF_RULE					{$$ = FileNode(@1.first_pos, @4.last_pos, $1, $2, $3);}
-	 | file_mode opt_subset_flag id_or_var opt_named_transition TOK_END_OF_RULE	{$$ = FileNode(@1.first_pos, @5.last_pos, $3, $1, $4, $2);}
+// File rules that are not kept are left empty, without copying their path and mode
+frule: id_or_var file_mode opt_named_transition TOK_END_OF_RULE					{if (driver.keeps(AppArmor::ParseOptions::FILE)) $$ = FileNode(@1.first_pos, @4.last_pos, $1, $2, $3);}
+	 | file_mode opt_subset_flag id_or_var opt_named_transition TOK_END_OF_RULE	{if (driver.keeps(AppArmor::ParseOptions::FILE)) $$ = FileNode(@1.first_pos, @5.last_pos, $3, $1, $4, $2);}
 
 file_rule: TOK_FILE TOK_END_OF_RULE	{$$ = FileNode(@1.first_pos, @2.last_pos);}
 		 | opt_file file_rule_tail	{$$ = $2;}
 
 file_rule_tail: opt_exec_mode frule							{$$ = $2;}
-			  | opt_exec_mode id_or_var file_mode id_or_var	{$$ = FileNode(@1.first_pos, @4.last_pos, $2, $3, $4);}
+			  | opt_exec_mode id_or_var file_mode id_or_var	{if (driver.keeps(AppArmor::ParseOptions::FILE)) $$ = FileNode(@1.first_pos, @4.last_pos, $2, $3, $4);}
 
-link_rule: TOK_LINK opt_subset_flag id_or_var TOK_ARROW id_or_var TOK_END_OF_RULE	{$$ = LinkNode(@1.first_pos, @6.last_pos, $2, $3, $5);}
+link_rule: TOK_LINK opt_subset_flag id_or_var TOK_ARROW id_or_var TOK_END_OF_RULE	{if (driver.keeps(AppArmor::ParseOptions::LINK)) $$ = LinkNode(@1.first_pos, @6.last_pos, $2, $3, $5);}
 
 network_rule: TOK_NETWORK TOK_END_OF_RULE
 			| TOK_NETWORK TOK_ID TOK_END_OF_RULE
 			| TOK_NETWORK TOK_ID TOK_ID TOK_END_OF_RULE
 
-cond: TOK_CONDID
-	| TOK_CONDID TOK_EQUALS TOK_VALUE
-	| TOK_CONDID TOK_EQUALS TOK_OPENPAREN valuelist TOK_CLOSEPAREN
-	| TOK_CONDID TOK_IN TOK_OPENPAREN valuelist TOK_CLOSEPAREN
+// A condition without a value is kept with an empty list. The lexer drops the parentheses
+// around the values of a condition in a list, so key=(a b) there reads as key= a b.
+cond: TOK_CONDID												{ $$ = std::make_pair($1, std::vector<std::string>()); }
+	| TOK_CONDID TOK_EQUALS valuelist							{ $$ = std::make_pair($1, $3); }
+	| TOK_CONDID TOK_EQUALS TOK_OPENPAREN valuelist TOK_CLOSEPAREN	{ $$ = std::make_pair($1, $4); }
+	| TOK_CONDID TOK_IN TOK_OPENPAREN valuelist TOK_CLOSEPAREN		{ $$ = std::make_pair($1, $4); }
 
-opt_conds:
-		 | opt_conds cond
+opt_conds:							{ $$ = std::map<std::string, std::vector<std::string>>(); }
+		 | opt_conds cond			{ $$ = $1; $$[$2.first] = $2.second; }
 
-cond_list: TOK_CONDLISTID TOK_EQUALS TOK_OPENPAREN opt_conds TOK_CLOSEPAREN
+// Only the xattrs of a profile are kept, see ProfileNode::getXattrs()
+cond_list: TOK_CONDLISTID TOK_EQUALS TOK_OPENPAREN opt_conds TOK_CLOSEPAREN	{ if ($1 == "xattrs") $$ = $4; }
 
-opt_cond_list:
-			 | cond_list
+opt_cond_list:						{ $$ = std::map<std::string, std::vector<std::string>>(); }
+			 | cond_list			{ $$ = $1; }
 
 mnt_rule: TOK_MOUNT opt_conds opt_id TOK_END_OF_RULE
 		| TOK_MOUNT opt_conds opt_id TOK_ARROW opt_conds TOK_ID TOK_END_OF_RULE
@@ -503,7 +644,13 @@ hat_start: TOK_CARET
 
 file_mode: TOK_MODE
 
-change_profile: TOK_CHANGE_PROFILE opt_exec_mode opt_id opt_named_transition TOK_END_OF_RULE
+// Without an arrow, the single id is the target profile rather than the executable
+change_profile: TOK_CHANGE_PROFILE opt_exec_mode opt_id opt_named_transition TOK_END_OF_RULE {
+					if ($4.empty())
+						$$ = ChangeProfileNode(@1.first_pos, @5.last_pos, $2, "", $3);
+					else
+						$$ = ChangeProfileNode(@1.first_pos, @5.last_pos, $2, $3, $4);
+				}
 
 capability:	TOK_CAPABILITY caps TOK_END_OF_RULE
 
@@ -529,15 +676,19 @@ void printyyerror(const char *msg, ...)
 	va_end(arg);
 }
 
+/* Errors are thrown rather than exiting, so that a failure while parsing on a
+ * worker thread can be reported to the caller of AppArmor::Parser
+ */
 void yyerror(const char *msg, ...)
 {
+	char buf[MAXBUFSIZE];
 	va_list arg;
 
 	va_start(arg, msg);
-	vprintyyerror(msg, arg);
+	vsnprintf(buf, sizeof(buf), msg, arg);
 	va_end(arg);
 
-	exit(1);
+	throw std::runtime_error(buf);
 }
 
 void yy::parser::error(YYLTYPE const& location, 
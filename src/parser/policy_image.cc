@@ -0,0 +1,398 @@
+#include "policy_image.hh"
+#include "policy_protocol.hh"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char MAGIC[] = "AAPOLICY";
+
+static void writeRules(PolicyProtocol::Writer &out, const RuleList<ProfileNode> &rules);
+
+static void writePrefix(PolicyProtocol::Writer &out, const PrefixNode &prefix)
+{
+  out.u8(prefix.isAudit() | prefix.isDeny() << 1 | prefix.isOwner() << 2);
+}
+
+static void writeCondition(PolicyProtocol::Writer &out, const Condition &condition)
+{
+  out.u8(static_cast<uint8_t>(condition.getKind()));
+  if(condition.getKind() == Condition::Kind::NOT) {
+    writeCondition(out, condition.getOperand());
+  }
+  else {
+    out.str(condition.getVariable());
+  }
+}
+
+static void writeProfile(PolicyProtocol::Writer &out, const ProfileNode &profile)
+{
+  out.str(profile.getText());
+  out.str(profile.getAttachment());
+  out.u64(profile.getStartPosition());
+  out.u64(profile.getStopPosition());
+  out.u8(profile.isHat());
+
+  out.u32(profile.getXattrs().size());
+  for(auto &xattr : profile.getXattrs()) {
+    out.str(xattr.first);
+    out.u32(xattr.second.size());
+    for(auto &value : xattr.second) {
+      out.str(value);
+    }
+  }
+
+  out.u32(profile.getFlags().size());
+  for(auto &flag : profile.getFlags()) {
+    out.str(flag);
+  }
+
+  writeRules(out, profile.getRules());
+}
+
+static void writeRules(PolicyProtocol::Writer &out, const RuleList<ProfileNode> &rules)
+{
+  out.u64(rules.getStartPosition());
+  out.u64(rules.getStopPosition());
+
+  out.u32(rules.getFileList().size());
+  for(auto &file : rules.getFileList()) {
+    writePrefix(out, file.getPrefix());
+    out.u64(file.getStartPosition());
+    out.u64(file.getStopPosition());
+    out.str(file.getFilename());
+    out.str(file.getFilemode());
+    out.str(file.getExecTarget());
+    out.u8(file.isSubsetRule());
+  }
+
+  out.u32(rules.getLinkList().size());
+  for(auto &link : rules.getLinkList()) {
+    writePrefix(out, link.getPrefix());
+    out.u64(link.getStartPosition());
+    out.u64(link.getStopPosition());
+    out.str(link.getFrom());
+    out.str(link.getTo());
+    out.u8(link.isSubsetRule());
+  }
+
+  out.u32(rules.getRuleList().size());
+  for(auto &block : rules.getRuleList()) {
+    writePrefix(out, block.getPrefix());
+    writeRules(out, block);
+  }
+
+  out.u32(rules.getAbstractionList().size());
+  for(auto &abstraction : rules.getAbstractionList()) {
+    out.u64(abstraction.getStartPosition());
+    out.u64(abstraction.getStopPosition());
+    out.str(abstraction.getPath());
+    out.u8(abstraction.isIfExists());
+  }
+
+  out.u32(rules.getChangeProfileList().size());
+  for(auto &change : rules.getChangeProfileList()) {
+    writePrefix(out, change.getPrefix());
+    out.u64(change.getStartPosition());
+    out.u64(change.getStopPosition());
+    out.str(change.getExecMode());
+    out.str(change.getExecCondition());
+    out.str(change.getTarget());
+  }
+
+  out.u32(rules.getGenericRuleList().size());
+  for(auto &generic : rules.getGenericRuleList()) {
+    writePrefix(out, generic.getPrefix());
+    out.u64(generic.getStartPosition());
+    out.u64(generic.getStopPosition());
+    out.str(generic.getKind());
+    out.str(generic.getText());
+    out.u64(generic.getTokenHash());
+  }
+
+  out.u32(rules.getConditionalList().size());
+  for(auto &conditional : rules.getConditionalList()) {
+    out.u64(conditional.getStartPosition());
+    out.u64(conditional.getStopPosition());
+    writeCondition(out, conditional.getCondition());
+    writeRules(out, conditional.getThen());
+    writeRules(out, conditional.getElse());
+  }
+
+  out.u32(rules.getSubprofiles().size());
+  for(auto &subprofile : rules.getSubprofiles()) {
+    writeProfile(out, subprofile);
+  }
+}
+
+static RuleList<ProfileNode> readRules(PolicyProtocol::Reader &in, size_t depth);
+
+// Blocks, conditionals, subprofiles and negations each take one level. The image may come
+// from another process, so a crafted one must not recurse deep enough to exhaust the stack.
+static const size_t MAX_DEPTH = 64;
+
+static size_t nested(size_t depth)
+{
+  if(depth >= MAX_DEPTH) {
+    throw std::runtime_error("policy image nests too deeply");
+  }
+  return depth + 1;
+}
+
+static PrefixNode readPrefix(PolicyProtocol::Reader &in)
+{
+  uint8_t flags = in.u8();
+  return PrefixNode(flags & 1, flags & 2, flags & 4);
+}
+
+static Condition readCondition(PolicyProtocol::Reader &in, size_t depth)
+{
+  auto kind = static_cast<Condition::Kind>(in.u8());
+  if(kind == Condition::Kind::NOT) {
+    return Condition::negate(readCondition(in, nested(depth)));
+  }
+  if(kind != Condition::Kind::BOOLEAN && kind != Condition::Kind::DEFINED) {
+    throw std::runtime_error("unknown condition in policy image");
+  }
+  return Condition(kind, in.str());
+}
+
+static ProfileNode readProfile(PolicyProtocol::Reader &in, size_t depth)
+{
+  std::string name = in.str();
+  std::string attachment = in.str();
+  uint64_t startPos = in.u64();
+  uint64_t stopPos = in.u64();
+  bool hat = in.u8();
+
+  ProfileNode::Xattrs xattrs;
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    auto &values = xattrs[in.str()];
+    for(uint32_t valueCount = in.u32(); valueCount > 0; valueCount--) {
+      values.push_back(in.str());
+    }
+  }
+
+  std::vector<std::string> flags;
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    flags.push_back(in.str());
+  }
+
+  ProfileNode profile(name, readRules(in, depth), startPos, stopPos, attachment);
+  profile.setHat(hat);
+  profile.setXattrs(xattrs);
+  profile.setFlags(flags);
+  return profile;
+}
+
+// Rules are appended the way the parser appends them, so the hashes come out the same
+static RuleList<ProfileNode> readRules(PolicyProtocol::Reader &in, size_t depth)
+{
+  RuleList<ProfileNode> rules(in.u64());
+  rules.setStopPosition(in.u64());
+
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    PrefixNode prefix = readPrefix(in);
+    uint64_t startPos = in.u64();
+    uint64_t stopPos = in.u64();
+    std::string filename = in.str();
+    std::string mode = in.str();
+    std::string target = in.str();
+    bool subset = in.u8();
+
+    // A bare "file," rule is the only one without a path, and it is hashed apart from the others
+    FileNode file = filename.empty() && mode.empty()? FileNode(startPos, stopPos)
+                                                    : FileNode(startPos, stopPos, filename, mode, target, subset);
+    rules.appendFileNode(prefix, file);
+  }
+
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    PrefixNode prefix = readPrefix(in);
+    uint64_t startPos = in.u64();
+    uint64_t stopPos = in.u64();
+    std::string from = in.str();
+    std::string to = in.str();
+
+    LinkNode link(startPos, stopPos, in.u8(), from, to);
+    rules.appendLinkNode(prefix, link);
+  }
+
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    PrefixNode prefix = readPrefix(in);
+    RuleList<ProfileNode> block = readRules(in, nested(depth));
+    rules.appendRuleList(prefix, block);
+  }
+
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    uint64_t startPos = in.u64();
+    uint64_t stopPos = in.u64();
+    std::string path = in.str();
+
+    AbstractionNode abstraction(startPos, stopPos, path, in.u8());
+    rules.appendAbstraction(abstraction);
+  }
+
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    PrefixNode prefix = readPrefix(in);
+    uint64_t startPos = in.u64();
+    uint64_t stopPos = in.u64();
+    std::string execMode = in.str();
+    std::string execCondition = in.str();
+
+    ChangeProfileNode change(startPos, stopPos, execMode, execCondition, in.str());
+    rules.appendChangeProfile(prefix, change);
+  }
+
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    PrefixNode prefix = readPrefix(in);
+    uint64_t startPos = in.u64();
+    uint64_t stopPos = in.u64();
+    std::string kind = in.str();
+    std::string text = in.str();
+
+    GenericRuleNode generic(startPos, stopPos, kind, text, in.u64());
+    rules.appendGenericRule(prefix, generic);
+  }
+
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    uint64_t startPos = in.u64();
+    uint64_t stopPos = in.u64();
+    Condition condition = readCondition(in, nested(depth));
+    RuleList<ProfileNode> thenRules = readRules(in, nested(depth));
+    RuleList<ProfileNode> elseRules = readRules(in, nested(depth));
+
+    ConditionalNode conditional(startPos, stopPos, condition, thenRules, elseRules);
+    rules.appendConditional(conditional);
+  }
+
+  for(uint32_t count = in.u32(); count > 0; count--) {
+    ProfileNode subprofile = readProfile(in, nested(depth));
+    rules.appendSubprofile(subprofile);
+  }
+
+  return rules;
+}
+
+std::string PolicyImage::encode(const std::vector<std::shared_ptr<ProfileNode>> &profiles)
+{
+  std::vector<std::string> records;
+  size_t offset = HEADER_SIZE + 8 * profiles.size();
+
+  PolicyProtocol::Writer index;
+  for(auto &profile : profiles) {
+    PolicyProtocol::Writer tree;
+    writeProfile(tree, *profile);
+
+    PolicyProtocol::Writer record;
+    record.str(profile->getText());
+
+    index.u64(offset);
+    records.push_back(record.data() + tree.data());
+    offset += records.back().size();
+  }
+
+  PolicyProtocol::Writer header;
+  for(size_t i = 0; i < 8; i++) {
+    header.u8(MAGIC[i]);
+  }
+  header.u32(VERSION);
+  header.u32(profiles.size());
+  header.u64(offset);
+
+  std::string image = header.data() + index.data();
+  image.reserve(offset);
+  for(auto &record : records) {
+    image += record;
+  }
+  return image;
+}
+
+std::shared_ptr<const PolicyImage> PolicyImage::map(int fd)
+{
+  struct stat status;
+  if(fstat(fd, &status) != 0) {
+    throw std::runtime_error(std::string("could not read policy image: ") + strerror(errno));
+  }
+
+  size_t size = status.st_size;
+  if(size < HEADER_SIZE) {
+    throw std::runtime_error("not a policy image");
+  }
+
+  void *base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if(base == MAP_FAILED) {
+    throw std::runtime_error(std::string("could not map policy image: ") + strerror(errno));
+  }
+
+  // Owned from here, so a bad header unmaps it again
+  std::shared_ptr<PolicyImage> image(new PolicyImage(static_cast<const char *>(base), size));
+
+  PolicyProtocol::Reader header(std::string_view(image->base, HEADER_SIZE));
+  for(size_t i = 0; i < 8; i++) {
+    if(header.u8() != static_cast<uint8_t>(MAGIC[i])) {
+      throw std::runtime_error("not a policy image");
+    }
+  }
+  if(header.u32() != VERSION) {
+    throw std::runtime_error("unsupported policy image version");
+  }
+
+  uint32_t count = header.u32();
+  uint64_t length = header.u64();
+  if(length > size || count > (length - HEADER_SIZE) / 8) {
+    throw std::runtime_error("truncated policy image");
+  }
+
+  image->count = count;
+  image->length = length;
+  return image;
+}
+
+PolicyImage::PolicyImage(const char *base, size_t mapped)
+  : base{base},
+    mapped{mapped}
+{   }
+
+PolicyImage::~PolicyImage()
+{
+  munmap(const_cast<char *>(base), mapped);
+}
+
+size_t PolicyImage::size() const
+{
+  return length;
+}
+
+uint32_t PolicyImage::profileCount() const
+{
+  return count;
+}
+
+std::string_view PolicyImage::profileRecord(uint32_t index) const
+{
+  if(index >= count) {
+    throw std::out_of_range("no profile " + std::to_string(index) + " in policy image");
+  }
+
+  std::string_view image(base, length);
+  uint64_t offset = PolicyProtocol::Reader(image.substr(HEADER_SIZE + 8 * index, 8)).u64();
+  if(offset > length) {
+    throw std::runtime_error("truncated policy image");
+  }
+  return image.substr(offset);
+}
+
+std::string PolicyImage::profileName(uint32_t index) const
+{
+  PolicyProtocol::Reader in(profileRecord(index));
+  return in.str();
+}
+
+std::shared_ptr<ProfileNode> PolicyImage::decodeProfile(uint32_t index) const
+{
+  PolicyProtocol::Reader in(profileRecord(index));
+  in.str();
+  return std::make_shared<ProfileNode>(readProfile(in, 0));
+}
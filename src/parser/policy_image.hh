@@ -0,0 +1,62 @@
+#ifndef POLICY_IMAGE_HH
+#define POLICY_IMAGE_HH
+
+#include "tree/ProfileNode.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Parsed profiles laid out in one block of bytes that holds no pointers, as shared by
+// AppArmor::SharedPolicy. Every reference is an offset from the start of the image, so
+// it reads the same in every process that maps it, at whatever address.
+//
+//   header   8 bytes "AAPOLICY", u32 version, u32 profile count, u64 image size
+//   index    u64 offset of each profile
+//   profile  string name, then the tree
+//
+// Fields are encoded as in PolicyProtocol. The tree holds the profile with its rule lists
+// one after another, each list as a u32 count and its rules, with nested blocks,
+// conditionals and subprofiles written in place.
+class PolicyImage {
+  public:
+    static constexpr uint32_t VERSION = 4;
+    static constexpr size_t HEADER_SIZE = 24;
+
+    static std::string encode(const std::vector<std::shared_ptr<ProfileNode>> &profiles);
+
+    // Maps the image behind the descriptor read-only. The descriptor can be closed afterwards.
+    // Throws std::runtime_error when it does not hold a whole image.
+    static std::shared_ptr<const PolicyImage> map(int fd);
+
+    ~PolicyImage();
+    PolicyImage(const PolicyImage &) = delete;
+    PolicyImage &operator=(const PolicyImage &) = delete;
+
+    size_t size() const;
+    uint32_t profileCount() const;
+
+    // Read straight from the image, without decoding the profile
+    std::string profileName(uint32_t index) const;
+
+    // Builds the profile back from the image, with the same rules, positions and hash.
+    // Throws std::runtime_error if its tree runs past the end of the image or nests too deeply.
+    std::shared_ptr<ProfileNode> decodeProfile(uint32_t index) const;
+
+  private:
+    PolicyImage(const char *base, size_t mapped);
+
+    std::string_view profileRecord(uint32_t index) const;
+
+    const char *base;
+    size_t mapped;
+
+    // From the header, checked against the mapping
+    size_t length = 0;
+    uint32_t count = 0;
+};
+
+#endif // POLICY_IMAGE_HH
@@ -0,0 +1,199 @@
+#include "policy_protocol.hh"
+#include "tree/FileNode.hh"
+
+#include <cerrno>
+#include <memory>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+void PolicyProtocol::Writer::u8(uint8_t value)
+{
+  buffer.push_back(static_cast<char>(value));
+}
+
+void PolicyProtocol::Writer::u32(uint32_t value)
+{
+  for(int shift = 0; shift < 32; shift += 8) {
+    u8(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+void PolicyProtocol::Writer::u64(uint64_t value)
+{
+  for(int shift = 0; shift < 64; shift += 8) {
+    u8(static_cast<uint8_t>(value >> shift));
+  }
+}
+
+void PolicyProtocol::Writer::str(const std::string &value)
+{
+  u32(static_cast<uint32_t>(value.size()));
+  buffer.append(value);
+}
+
+const std::string &PolicyProtocol::Writer::data() const
+{
+  return buffer;
+}
+
+PolicyProtocol::Reader::Reader(std::string_view data)
+  : data{data}
+{   }
+
+const char *PolicyProtocol::Reader::take(size_t size)
+{
+  if(size > data.size() - offset) {
+    throw std::runtime_error("truncated message");
+  }
+
+  const char *field = data.data() + offset;
+  offset += size;
+  return field;
+}
+
+uint8_t PolicyProtocol::Reader::u8()
+{
+  return static_cast<uint8_t>(*take(1));
+}
+
+uint32_t PolicyProtocol::Reader::u32()
+{
+  auto *bytes = reinterpret_cast<const unsigned char *>(take(4));
+
+  uint32_t value = 0;
+  for(int i = 3; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+uint64_t PolicyProtocol::Reader::u64()
+{
+  auto *bytes = reinterpret_cast<const unsigned char *>(take(8));
+
+  uint64_t value = 0;
+  for(int i = 7; i >= 0; i--) {
+    value = (value << 8) | bytes[i];
+  }
+  return value;
+}
+
+std::string PolicyProtocol::Reader::str()
+{
+  uint32_t size = u32();
+  return std::string(take(size), size);
+}
+
+void PolicyProtocol::writeRule(Writer &out, const AppArmor::FileRule &rule)
+{
+  uint8_t qualifiers = (rule.isAudit()? AUDIT : 0) | (rule.isDeny()? DENY : 0) | (rule.isOwner()? OWNER : 0);
+
+  out.str(rule.getFilename());
+  out.str(rule.getFilemode());
+  out.str(rule.getExecTarget());
+  out.u8(qualifiers);
+  out.u64(rule.getStartPosition());
+  out.u64(rule.getEndPosition());
+}
+
+AppArmor::FileRule PolicyProtocol::readRule(Reader &in)
+{
+  auto filename = in.str();
+  auto mode = in.str();
+  auto target = in.str();
+  auto qualifiers = in.u8();
+  auto start = in.u64();
+  auto end = in.u64();
+
+  auto node = std::make_shared<FileNode>(start, end, filename, mode, target);
+  node->setPrefix(PrefixNode(qualifiers & AUDIT, qualifiers & DENY, qualifiers & OWNER));
+  return AppArmor::FileRule(node);
+}
+
+static bool sendAll(int fd, const char *data, size_t size)
+{
+  while(size > 0) {
+    // MSG_NOSIGNAL, so a peer that went away is an error rather than a SIGPIPE
+    ssize_t count = send(fd, data, size, MSG_NOSIGNAL);
+    if(count < 0) {
+      if(errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+
+    data += count;
+    size -= count;
+  }
+  return true;
+}
+
+static bool receiveAll(int fd, char *data, size_t size)
+{
+  while(size > 0) {
+    ssize_t count = recv(fd, data, size, 0);
+    if(count < 0 && errno == EINTR) {
+      continue;
+    }
+    if(count <= 0) {
+      return false;
+    }
+
+    data += count;
+    size -= count;
+  }
+  return true;
+}
+
+bool PolicyProtocol::sendMessage(int fd, const std::string &message)
+{
+  Writer header;
+  header.u32(static_cast<uint32_t>(message.size()));
+
+  return message.size() <= MAX_MESSAGE &&
+         sendAll(fd, header.data().data(), header.data().size()) &&
+         sendAll(fd, message.data(), message.size());
+}
+
+bool PolicyProtocol::receiveMessage(int fd, std::string &message)
+{
+  std::string header(4, '\0');
+  if(!receiveAll(fd, &header[0], header.size())) {
+    return false;
+  }
+
+  uint32_t size = Reader(header).u32();
+  if(size > MAX_MESSAGE) {
+    return false;
+  }
+
+  message.resize(size);
+  return size == 0 || receiveAll(fd, &message[0], size);
+}
+
+std::string PolicyProtocol::frameMessage(const std::string &message)
+{
+  Writer header;
+  header.u32(static_cast<uint32_t>(message.size()));
+  return header.data() + message;
+}
+
+bool PolicyProtocol::takeMessage(std::string &received, std::string &message)
+{
+  if(received.size() < 4) {
+    return false;
+  }
+
+  uint32_t size = Reader(std::string_view(received).substr(0, 4)).u32();
+  if(size > MAX_MESSAGE) {
+    throw std::runtime_error("message too large");
+  }
+  if(received.size() - 4 < size) {
+    return false;
+  }
+
+  message = received.substr(4, size);
+  received.erase(0, 4 + size);
+  return true;
+}
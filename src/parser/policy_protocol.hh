@@ -0,0 +1,91 @@
+#ifndef POLICY_PROTOCOL_HH
+#define POLICY_PROTOCOL_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "apparmor_file_rule.hh"
+
+// Wire format shared by AppArmor::PolicyDaemon and AppArmor::PolicyClient.
+//
+// Every message is a 32-bit length followed by that many bytes. A request starts with its
+// kind and a response with its status, then the fields follow one after another: integers
+// are little-endian, strings are a 32-bit length and their bytes. A response with an
+// ERROR status holds a single string, the message of the error.
+namespace PolicyProtocol {
+  enum class Request : uint8_t {
+    // -> u64 generation
+    GENERATION = 1,
+    // -> u32 count, then a string per profile
+    PROFILES = 2,
+    // string profile -> u32 count, then a rule per file rule
+    RULES = 3,
+    // string pattern, string mode -> u32 count, then per match: string profile, rule, string abstraction
+    MATCH = 4,
+  };
+
+  // A rule is: string filename, string mode, string exec target, u8 qualifiers,
+  // u64 start position, u64 end position
+  enum Qualifier : uint8_t {
+    AUDIT = 1,
+    DENY  = 2,
+    OWNER = 4,
+  };
+
+  enum class Status : uint8_t {
+    OK = 0,
+    ERROR = 1,
+  };
+
+  // Larger messages are refused, so a broken peer cannot make the other side allocate without bound
+  constexpr uint32_t MAX_MESSAGE = 64 * 1024 * 1024;
+
+  class Writer {
+    public:
+      void u8(uint8_t value);
+      void u32(uint32_t value);
+      void u64(uint64_t value);
+      void str(const std::string &value);
+
+      const std::string &data() const;
+
+    private:
+      std::string buffer;
+  };
+
+  // Throws std::runtime_error when a field runs past the end of the message.
+  // The data is not copied, so it has to outlive the reader.
+  class Reader {
+    public:
+      explicit Reader(std::string_view data);
+
+      uint8_t u8();
+      uint32_t u32();
+      uint64_t u64();
+      std::string str();
+
+    private:
+      const char *take(size_t size);
+
+      std::string_view data;
+      size_t offset = 0;
+  };
+
+  void writeRule(Writer &out, const AppArmor::FileRule &rule);
+  AppArmor::FileRule readRule(Reader &in);
+
+  // Both return false once the connection is closed or fails
+  bool sendMessage(int fd, const std::string &message);
+  bool receiveMessage(int fd, std::string &message);
+
+  // For peers that do their own non-blocking reads and writes: the message with its length
+  // in front, and the first whole message taken out of the bytes received so far.
+  // takeMessage returns false until a whole message has arrived, and throws
+  // std::runtime_error once the length says it is larger than MAX_MESSAGE.
+  std::string frameMessage(const std::string &message);
+  bool takeMessage(std::string &received, std::string &message);
+}
+
+#endif // POLICY_PROTOCOL_HH
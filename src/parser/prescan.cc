@@ -0,0 +1,229 @@
+#include "prescan.hh"
+#include "parser.h"
+#include "scan.hh"
+
+#include <cctype>
+#include <cstdlib>
+
+// Characters that can continue an unquoted id, see ID_CHARS in parser_lex.l
+static bool isIdChar(char c)
+{
+  return !isspace(static_cast<unsigned char>(c)) && c != '"' && c != '!' && c != ',';
+}
+
+// Splits a profile header into whitespace separated words, keeping quoted words intact
+static std::vector<std::string> splitHeader(const std::string &header)
+{
+  std::vector<std::string> words;
+  std::string word;
+  bool quoted = false;
+
+  for(size_t i = 0; i < header.size(); i++) {
+    char c = header[i];
+
+    if(c == '\\' && i + 1 < header.size()) {
+      word += c;
+      word += header[++i];
+      continue;
+    }
+
+    if(c == '"') {
+      quoted = !quoted;
+    }
+    else if(!quoted && isspace(static_cast<unsigned char>(c))) {
+      if(!word.empty()) {
+        words.push_back(word);
+        word.clear();
+      }
+      continue;
+    }
+
+    word += c;
+  }
+
+  if(!word.empty()) {
+    words.push_back(word);
+  }
+
+  return words;
+}
+
+// Extracts the name of a profile from its header, the same way the lexer would
+static std::string profileName(const std::string &header)
+{
+  auto words = splitHeader(header);
+  auto word = words.begin();
+
+  if(word != words.end() && (*word == "profile" || *word == "hat" || *word == "^")) {
+    word++;
+  }
+
+  if(word == words.end()) {
+    return "";
+  }
+
+  std::string id = *word;
+  if(id.size() > 1 && id[0] == '^') {
+    id = id.substr(1);
+  }
+
+  char *processed = processid(id.c_str(), id.size());
+  if(processed == nullptr) {
+    return id;
+  }
+
+  std::string name(processed);
+  free(processed);
+  return name;
+}
+
+// Returns where a variable assignment like @{HOME} = /home/*/ or $secure = true that starts
+// at pos ends, or pos when there is none. Assignments run until the end of the line, unless
+// it ends in a backslash, and braces in their values never open a block.
+static size_t assignmentEnd(const char *data, size_t pos, size_t size)
+{
+  size_t i = pos + 1;
+  if(i < size && data[i] == '{') {
+    for(i++; i < size && (isalnum(static_cast<unsigned char>(data[i])) || data[i] == '_'); i++);
+    if(i == size || data[i] != '}') {
+      return pos;
+    }
+    i++;
+  }
+  else {
+    for(; i < size && (isalnum(static_cast<unsigned char>(data[i])) || data[i] == '_'); i++);
+  }
+
+  i = skipBlanks(data, i, size);
+  if(i + 1 < size && data[i] == '+' && data[i + 1] == '=') {
+    i++;
+  }
+  if(i == size || data[i] != '=') {
+    return pos;
+  }
+
+  for(;;) {
+    i = skipLine(data, i, size);
+    if(i == size || data[i - 1] != '\\') {
+      return i;
+    }
+    i++;
+  }
+}
+
+PrescanResult prescan(const std::string &text)
+{
+  PrescanResult result;
+
+  const size_t npos = std::string::npos;
+  const size_t length = text.size();
+  const char *data = text.data();
+
+  uint64_t depth = 0;
+  size_t statementStart = npos;
+  size_t lastStatementStart = npos;
+  size_t profileStart = npos;
+  std::string header;
+
+  // Braces only open or close a block at the start of a token, otherwise they are
+  // part of a glob like /usr/{bin,sbin}/ or a variable like @{HOME}
+  bool atTokenStart = true;
+
+  for(size_t i = 0; i < length; i++) {
+    char c = text[i];
+
+    if(c == '#' && atTokenStart) {
+      // Comments and #include both run until the end of the line
+      i = skipLine(data, i, length) - 1;
+      continue;
+    }
+
+    if(depth == 0 && statementStart == npos && !isspace(static_cast<unsigned char>(c)) && c != '{' && c != '}') {
+      if(c == '@' || c == '$') {
+        size_t end = assignmentEnd(data, i, length);
+        if(end != i) {
+          lastStatementStart = npos;
+          atTokenStart = true;
+          i = end - 1;
+          continue;
+        }
+      }
+      statementStart = i;
+    }
+
+    if(c == '"') {
+      for(i++; i < length && text[i] != '"'; i++) {
+        if(text[i] == '\\') {
+          i++;
+        }
+      }
+      atTokenStart = true;
+      continue;
+    }
+
+    if(c == '\\') {
+      i++;
+      atTokenStart = false;
+      continue;
+    }
+
+    if(c == '{' && atTokenStart) {
+      if(depth == 0) {
+        profileStart = (statementStart != npos)? statementStart : lastStatementStart;
+        if(profileStart == npos) {
+          profileStart = i;
+        }
+        header = text.substr(profileStart, i - profileStart);
+      }
+      depth++;
+      continue;
+    }
+
+    if(c == '}' && atTokenStart && depth > 0) {
+      depth--;
+      if(depth == 0) {
+        if(result.profiles.empty()) {
+          result.preambleStop = profileStart;
+        }
+        result.profiles.push_back({profileName(header), profileStart, i + 1});
+        statementStart = lastStatementStart = npos;
+      }
+      continue;
+    }
+
+    if(isspace(static_cast<unsigned char>(c))) {
+      if(c == '\n' && depth == 0 && statementStart != npos) {
+        lastStatementStart = statementStart;
+        statementStart = npos;
+      }
+      atTokenStart = true;
+
+      // Skip the rest of the indentation in one go
+      i = skipBlanks(data, i + 1, length) - 1;
+      continue;
+    }
+
+    if(c == ',' && (i + 1 == length || !isIdChar(text[i + 1]))) {
+      // A comma followed by more id characters is part of the id, eg. {bin,sbin}
+      if(depth == 0) {
+        statementStart = lastStatementStart = npos;
+      }
+      atTokenStart = true;
+      continue;
+    }
+
+    atTokenStart = (c == '!' || c == '(' || c == ')');
+
+    // Nothing inside an id matters until one of the characters above comes up,
+    // unless the id still has to be recorded as the start of a statement
+    if(!atTokenStart && (depth > 0 || statementStart != npos)) {
+      i = skipIdChars(data, i + 1, length) - 1;
+    }
+  }
+
+  if(result.profiles.empty()) {
+    result.preambleStop = length;
+  }
+
+  return result;
+}
@@ -0,0 +1,26 @@
+#ifndef PRESCAN_HH
+#define PRESCAN_HH
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Location of one top-level profile within a file
+struct ProfileRange {
+  std::string name;
+  uint64_t startPos; // First byte of the profile header
+  uint64_t stopPos;  // One past the closing brace
+};
+
+struct PrescanResult {
+  uint64_t preambleStop = 0;
+  std::vector<ProfileRange> profiles;
+};
+
+// Cheap structural pass over a profile file, without running the lexer or parser.
+// It balances braces while skipping comments, quoted strings and the braces used
+// inside globs and variables, and records where each top-level profile lives.
+// A file that the parser would reject is not detected here.
+PrescanResult prescan(const std::string &text);
+
+#endif // PRESCAN_HH
@@ -0,0 +1,326 @@
+#include "profile_writer.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+// Names containing whitespace or quotes have to be quoted to be read back.
+// Other escapes are kept in the tree as written, only the quotes need one.
+static std::string quote(const std::string &name)
+{
+  if(name.find_first_of(" \t\n\"") == std::string::npos) {
+    return name;
+  }
+
+  std::string quoted = "\"";
+  for(char c : name) {
+    if(c == '"') {
+      quoted += '\\';
+    }
+    quoted += c;
+  }
+  return quoted + "\"";
+}
+
+static std::string prefixText(const PrefixNode &prefix)
+{
+  std::string text;
+  text += prefix.isAudit()? "audit " : "";
+  text += prefix.isDeny()?  "deny "  : "";
+  text += prefix.isOwner()? "owner " : "";
+  return text;
+}
+
+static std::string includeText(const AbstractionNode &node)
+{
+  return std::string("include ") + (node.isIfExists()? "if exists " : "") + "<" + node.getPath() + ">";
+}
+
+ProfileWriter::ProfileWriter(Mode mode, std::shared_ptr<const std::string> source)
+  : mode{mode},
+    source{source}
+{
+  if(mode == Mode::PRESERVING && source == nullptr) {
+    throw std::invalid_argument("preserving mode needs the source text");
+  }
+
+  if(source != nullptr) {
+    buffer.reserve(source->size());
+  }
+}
+
+void ProfileWriter::replace(uint64_t startPos, uint64_t stopPos, const std::string &text)
+{
+  edits[startPos] = {stopPos, text};
+}
+
+void ProfileWriter::insert(uint64_t pos, const std::string &text)
+{
+  replace(pos, pos, text);
+}
+
+void ProfileWriter::erase(uint64_t startPos, uint64_t stopPos)
+{
+  replace(startPos, stopPos, "");
+}
+
+// Copies a range of the source, applying the edits that start inside of it
+void ProfileWriter::copySource(uint64_t startPos, uint64_t stopPos)
+{
+  stopPos = std::min<uint64_t>(stopPos, source->size());
+
+  uint64_t pos = startPos;
+  for(auto edit = edits.lower_bound(startPos); edit != edits.end() && edit->first <= stopPos; ++edit) {
+    if(edit->first < pos) {
+      continue;
+    }
+
+    buffer.append(*source, pos, edit->first - pos);
+    buffer.append(edit->second.second);
+    pos = std::max(pos, edit->second.first);
+  }
+
+  if(pos < stopPos) {
+    buffer.append(*source, pos, stopPos - pos);
+  }
+}
+
+void ProfileWriter::writeSource()
+{
+  if(source == nullptr) {
+    throw std::logic_error("there is no source to copy");
+  }
+
+  copySource(0, source->size());
+}
+
+void ProfileWriter::indent(int depth)
+{
+  buffer.append(depth * 2, ' ');
+}
+
+void ProfileWriter::write(const ParseTree &tree)
+{
+  if(mode == Mode::PRESERVING) {
+    writeSource();
+    return;
+  }
+
+  auto &abis = tree.preamble.getAbiList();
+  for(auto &abi : abis) {
+    buffer += "abi " + abi + ",\n";
+  }
+
+  auto &aliases = tree.preamble.getAliasList();
+  for(auto &alias : aliases) {
+    buffer += "alias " + quote(alias.getFrom()) + " -> " + quote(alias.getTo()) + ",\n";
+  }
+
+  auto includes = tree.preamble.getAbstractionList();
+  for(auto &include : includes) {
+    buffer += includeText(include) + "\n";
+  }
+
+  // In file order, since += adds to the values assigned before it
+  auto &assignments = tree.preamble.getAssignments();
+  for(auto &assignment : assignments) {
+    buffer += assignment.variable + (assignment.append? " +=" : " =");
+    for(auto &value : assignment.values) {
+      buffer += " " + quote(value);
+    }
+    buffer += '\n';
+  }
+
+  auto &booleans = tree.preamble.getDefinitions().booleans;
+  for(auto &boolean : booleans) {
+    buffer += "$" + boolean.first + (boolean.second? " = true\n" : " = false\n");
+  }
+
+  bool first = abis.empty() && aliases.empty() && includes.empty() && assignments.empty() && booleans.empty();
+  for(auto &profile : *tree.profileList) {
+    if(!first) {
+      buffer += '\n';
+    }
+    first = false;
+
+    write(profile);
+  }
+}
+
+void ProfileWriter::write(const ProfileNode &profile)
+{
+  if(mode == Mode::PRESERVING) {
+    copySource(profile.getStartPosition(), profile.getStopPosition());
+    buffer += '\n';
+    return;
+  }
+
+  // Abstractions are parsed into a single unnamed profile that has no braces
+  if(profile.getText().empty()) {
+    writeRules(profile.getRules(), 0);
+    return;
+  }
+
+  writeProfile(profile, 0);
+}
+
+void ProfileWriter::writeProfile(const ProfileNode &profile, int depth)
+{
+  indent(depth);
+  buffer += (profile.isHat()? "^" : "profile ") + quote(profile.getText());
+  if(!profile.getAttachment().empty()) {
+    buffer += " " + quote(profile.getAttachment());
+  }
+  if(!profile.getXattrs().empty()) {
+    std::string separator;
+    buffer += " xattrs=(";
+    for(auto &xattr : profile.getXattrs()) {
+      buffer += separator + xattr.first;
+      if(xattr.second.size() == 1) {
+        buffer += "=" + quote(xattr.second.front());
+      }
+      else if(!xattr.second.empty()) {
+        std::string valueSeparator;
+        buffer += "=(";
+        for(auto &value : xattr.second) {
+          buffer += valueSeparator + quote(value);
+          valueSeparator = " ";
+        }
+        buffer += ")";
+      }
+      separator = " ";
+    }
+    buffer += ")";
+  }
+  if(!profile.getFlags().empty()) {
+    std::string separator;
+    buffer += " flags=(";
+    for(auto &flag : profile.getFlags()) {
+      buffer += separator + flag;
+      separator = ", ";
+    }
+    buffer += ")";
+  }
+  buffer += " {\n";
+
+  writeRules(profile.getRules(), depth + 1);
+
+  indent(depth);
+  buffer += "}\n";
+}
+
+void ProfileWriter::writeRules(const RuleList<ProfileNode> &rules, int depth)
+{
+  // Sorted, so the same rules always come out the same way
+  std::vector<std::string> lines;
+
+  for(auto &include : rules.getAbstractionList()) {
+    lines.push_back(includeText(include));
+  }
+  std::sort(lines.begin(), lines.end());
+
+  auto sorted = lines.size();
+  for(auto &file : rules.getFileList()) {
+    if(file.getFilename().empty()) {
+      lines.push_back(prefixText(file.getPrefix()) + "file,");
+      continue;
+    }
+
+    std::string line = prefixText(file.getPrefix()) + quote(file.getFilename()) + " " + file.getFilemode();
+    if(!file.getExecTarget().empty()) {
+      line += " -> " + quote(file.getExecTarget());
+    }
+    lines.push_back(line + ",");
+  }
+
+  for(auto &link : rules.getLinkList()) {
+    lines.push_back(prefixText(link.getPrefix()) + "link " + (link.isSubsetRule()? "subset " : "") +
+                    quote(link.getFrom()) + " -> " + quote(link.getTo()) + ",");
+  }
+
+  for(auto &change : rules.getChangeProfileList()) {
+    std::string line = prefixText(change.getPrefix()) + "change_profile";
+    if(!change.getExecMode().empty()) {
+      line += " " + change.getExecMode();
+    }
+    if(!change.getExecCondition().empty()) {
+      line += " " + quote(change.getExecCondition());
+    }
+    if(!change.getTarget().empty()) {
+      line += (change.getExecCondition().empty()? " " : " -> ") + quote(change.getTarget());
+    }
+    lines.push_back(line + ",");
+  }
+
+  // Kept as written, blanks and comments aside, so they only need their prefix
+  for(auto &rule : rules.getGenericRuleList()) {
+    lines.push_back(prefixText(rule.getPrefix()) + rule.getText());
+  }
+  std::sort(lines.begin() + sorted, lines.end());
+
+  for(auto &line : lines) {
+    indent(depth);
+    buffer += line;
+    buffer += '\n';
+  }
+
+  for(auto &block : rules.getRuleList()) {
+    indent(depth);
+    buffer += prefixText(block.getPrefix()) + "{\n";
+    writeRules(block, depth + 1);
+    indent(depth);
+    buffer += "}\n";
+  }
+
+  for(auto &conditional : rules.getConditionalList()) {
+    writeConditional(conditional, depth);
+  }
+
+  for(auto &subprofile : rules.getSubprofiles()) {
+    buffer += '\n';
+    writeProfile(subprofile, depth);
+  }
+}
+
+void ProfileWriter::writeConditional(const ConditionalNode &conditional, int depth)
+{
+  indent(depth);
+  buffer += "if " + conditional.getCondition().str() + " {\n";
+  writeRules(conditional.getThen(), depth + 1);
+  indent(depth);
+  buffer += "}";
+
+  auto &otherwise = conditional.getElse();
+  if(!otherwise.isEmpty()) {
+    buffer += " else {\n";
+    writeRules(otherwise, depth + 1);
+    indent(depth);
+    buffer += "}";
+  }
+  buffer += '\n';
+}
+
+const std::string &ProfileWriter::str() const
+{
+  return buffer;
+}
+
+void ProfileWriter::save(const std::string &path) const
+{
+  std::string temp = path + ".tmp";
+
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(buffer.data(), buffer.size());
+    if(!file) {
+      throw std::runtime_error("could not write profile: " + temp);
+    }
+  }
+
+  if(std::rename(temp.c_str(), path.c_str()) != 0) {
+    std::remove(temp.c_str());
+    throw std::runtime_error("could not replace profile: " + path);
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef PROFILE_WRITER_HH
+#define PROFILE_WRITER_HH
+
+#include "tree/ParseTree.hh"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+// Serializes parsed profiles back into text. Everything is appended to a single
+// buffer, which is written out with one call once the whole tree has been emitted.
+class ProfileWriter {
+  public:
+    enum class Mode {
+      // Normalized layout for generated policy: two space indentation, one rule
+      // per line and a fixed rule order. Comments are dropped.
+      CANONICAL,
+
+      // The original bytes of the source, with only the edited ranges replaced
+      PRESERVING
+    };
+
+    // The source is required in preserving mode, and must be the text the tree was parsed from
+    explicit ProfileWriter(Mode mode, std::shared_ptr<const std::string> source = nullptr);
+
+    // Edits for preserving mode, in source byte offsets. Edits must not overlap.
+    void replace(uint64_t startPos, uint64_t stopPos, const std::string &text);
+    void insert(uint64_t pos, const std::string &text);
+    void erase(uint64_t startPos, uint64_t stopPos);
+
+    void write(const ParseTree &tree);
+    void write(const ProfileNode &profile);
+
+    // Copies the whole source with the edits applied, which needs no tree at all
+    void writeSource();
+
+    const std::string &str() const;
+
+    // Replaces the file with the buffer, written in one go to a temporary file and renamed over it
+    void save(const std::string &path) const;
+
+  private:
+    void copySource(uint64_t startPos, uint64_t stopPos);
+    void writeProfile(const ProfileNode &profile, int depth);
+    void writeRules(const RuleList<ProfileNode> &rules, int depth);
+    void writeConditional(const ConditionalNode &conditional, int depth);
+    void indent(int depth);
+
+    Mode mode;
+    std::shared_ptr<const std::string> source;
+
+    // Start of the edited range, mapped to its end and replacement text
+    std::map<uint64_t, std::pair<uint64_t, std::string>> edits;
+
+    std::string buffer;
+};
+
+#endif // PROFILE_WRITER_HH
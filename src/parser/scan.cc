@@ -0,0 +1,155 @@
+#include "scan.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+static inline bool isBlank(unsigned char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool endsId(unsigned char c)
+{
+  return c <= '!' || c == '"' || c == '\\' || c == ',' || c == '(' || c == ')';
+}
+
+static size_t skipBlanksScalar(const char *data, size_t pos, size_t size)
+{
+  while(pos < size && isBlank(data[pos])) {
+    pos++;
+  }
+  return pos;
+}
+
+static size_t skipIdCharsScalar(const char *data, size_t pos, size_t size)
+{
+  while(pos < size && !endsId(data[pos])) {
+    pos++;
+  }
+  return pos;
+}
+
+#ifdef SCAN_X86
+// Bit i of the result is set when byte i ends the run
+static inline uint32_t blankStops(__m128i bytes)
+{
+  __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                                            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t'))),
+                               _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')));
+  return ~static_cast<uint32_t>(_mm_movemask_epi8(blank)) & 0xffff;
+}
+
+static inline uint32_t idStops(__m128i bytes)
+{
+  // Unsigned c <= '!' is min(c, '!') == c
+  __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(bytes, _mm_set1_epi8('!')), bytes);
+  __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+                                           _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))),
+                              _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(',')),
+                                           _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('(')),
+                                                        _mm_cmpeq_epi8(bytes, _mm_set1_epi8(')')))));
+  return static_cast<uint32_t>(_mm_movemask_epi8(_mm_or_si128(low, stop)));
+}
+
+static size_t skipBlanksSSE2(const char *data, size_t pos, size_t size)
+{
+  for(; pos + 16 <= size; pos += 16) {
+    uint32_t stops = blankStops(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos)));
+    if(stops != 0) {
+      return pos + __builtin_ctz(stops);
+    }
+  }
+  return skipBlanksScalar(data, pos, size);
+}
+
+static size_t skipIdCharsSSE2(const char *data, size_t pos, size_t size)
+{
+  for(; pos + 16 <= size; pos += 16) {
+    uint32_t stops = idStops(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos)));
+    if(stops != 0) {
+      return pos + __builtin_ctz(stops);
+    }
+  }
+  return skipIdCharsScalar(data, pos, size);
+}
+
+__attribute__((target("avx2")))
+static size_t skipIdCharsAVX2(const char *data, size_t pos, size_t size)
+{
+  const __m256i bang  = _mm256_set1_epi8('!');
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i slash = _mm256_set1_epi8('\\');
+  const __m256i comma = _mm256_set1_epi8(',');
+  const __m256i open  = _mm256_set1_epi8('(');
+  const __m256i close = _mm256_set1_epi8(')');
+
+  for(; pos + 32 <= size; pos += 32) {
+    __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+    __m256i low = _mm256_cmpeq_epi8(_mm256_min_epu8(bytes, bang), bytes);
+    __m256i stop = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, quote),
+                                                   _mm256_cmpeq_epi8(bytes, slash)),
+                                   _mm256_or_si256(_mm256_cmpeq_epi8(bytes, comma),
+                                                   _mm256_or_si256(_mm256_cmpeq_epi8(bytes, open),
+                                                                   _mm256_cmpeq_epi8(bytes, close))));
+    uint32_t stops = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(low, stop)));
+    if(stops != 0) {
+      return pos + __builtin_ctz(stops);
+    }
+  }
+  return skipIdCharsSSE2(data, pos, size);
+}
+#endif
+
+using ScanFunction = size_t (*)(const char *, size_t, size_t);
+
+struct ScanKernels {
+  ScanFunction skipBlanks;
+  ScanFunction skipIdChars;
+};
+
+static ScanKernels selectKernels()
+{
+#ifdef SCAN_X86
+  if(__builtin_cpu_supports("avx2")) {
+    return {skipBlanksSSE2, skipIdCharsAVX2};
+  }
+  return {skipBlanksSSE2, skipIdCharsSSE2};
+#else
+  return {skipBlanksScalar, skipIdCharsScalar};
+#endif
+}
+
+static const ScanKernels &kernels()
+{
+  static const ScanKernels selected = selectKernels();
+  return selected;
+}
+
+size_t skipBlanks(const char *data, size_t pos, size_t size)
+{
+  // Indentation is usually a few bytes, which is faster to check one at a time
+  for(size_t end = std::min(size, pos + 8); pos < end; pos++) {
+    if(!isBlank(data[pos])) {
+      return pos;
+    }
+  }
+  return kernels().skipBlanks(data, pos, size);
+}
+
+size_t skipIdChars(const char *data, size_t pos, size_t size)
+{
+  return kernels().skipIdChars(data, pos, size);
+}
+
+size_t skipLine(const char *data, size_t pos, size_t size)
+{
+  // The C library already vectorizes memchr
+  const void *newline = pos < size? std::memchr(data + pos, '\n', size - pos) : nullptr;
+  return newline? static_cast<const char *>(newline) - data : size;
+}
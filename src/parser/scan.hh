@@ -0,0 +1,24 @@
+#ifndef SCAN_HH
+#define SCAN_HH
+
+#include <cstddef>
+
+// Byte scanning kernels for the hot loops of the pre-scan. Profile files are mostly
+// long paths, indentation and comments, so these skip whole runs of them at a time.
+// They use AVX2 or SSE2 when the CPU has them, picked once at runtime, and plain
+// loops everywhere else. Each returns the offset of the first byte at or after pos
+// that ends the run, or size if the run goes to the end.
+// Only the pre-scan uses them. The Flex lexer still reads every byte through its DFA,
+// since it owns its input buffer and counts positions from yyleng.
+
+// Spaces, tabs and carriage returns, but not newlines
+size_t skipBlanks(const char *data, size_t pos, size_t size);
+
+// Characters that continue an unquoted id. Stops at whitespace and control characters,
+// and at the characters that change how the following bytes are read: " \ , ! ( )
+size_t skipIdChars(const char *data, size_t pos, size_t size);
+
+// Everything up to the next newline
+size_t skipLine(const char *data, size_t pos, size_t size);
+
+#endif // SCAN_HH
@@ -1,21 +1,34 @@
 #include "AbstractionNode.hh"
-
-#include <sstream>
+#include "hash.hh"
+#include "memory_usage.hh"
 
 AbstractionNode::AbstractionNode(uint64_t startPos, uint64_t stopPos, const std::string &path, bool is_if_exists)
   : RuleNode("abstraction", startPos, stopPos),
     path{path},
     is_if_exists{is_if_exists}
-{   }
+{
+  content_hash = hashString("include");
+  content_hash = hashCombine(content_hash, hashString(path));
+  content_hash = hashCombine(content_hash, is_if_exists);
+}
 
 AbstractionNode::operator std::string() const
 {
-  std::stringstream stream;
-  stream << "include (" << getStartPosition() << ", " << getStopPosition() << ") " << path << ",\n";
-  return stream.str();
+  return "include (" + std::to_string(getStartPosition()) + ", " + std::to_string(getStopPosition()) + ") " + path + ",\n";
 };
 
-std::string AbstractionNode::getPath()
+std::string AbstractionNode::getPath() const
 {
   return path;
-}
\ No newline at end of file
+}
+
+bool AbstractionNode::isIfExists() const
+{
+  return is_if_exists;
+}
+
+void AbstractionNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  RuleNode::addMemoryUsage(usage);
+  usage.strings += stringUsage(path);
+}
@@ -1,7 +1,6 @@
 #include "AliasNode.hh"
 #include "tree/TreeNode.hh"
-
-#include <sstream>
+#include "memory_usage.hh"
 
 AliasNode::AliasNode(const std::string &from, const std::string &to)
   : TreeNode(),
@@ -11,7 +10,22 @@ AliasNode::AliasNode(const std::string &from, const std::string &to)
 
 AliasNode::operator std::string() const
 {
-  std::stringstream stream;
-  stream << "alias " << from << " => " << to << ",\n";
-  return stream.str();
+  return "alias " + from + " -> " + to + ",\n";
 };
+
+std::string AliasNode::getFrom() const
+{
+  return from;
+}
+
+std::string AliasNode::getTo() const
+{
+  return to;
+}
+
+void AliasNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  TreeNode::addMemoryUsage(usage);
+  usage.strings += stringUsage(from);
+  usage.strings += stringUsage(to);
+}
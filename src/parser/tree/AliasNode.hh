@@ -6,8 +6,14 @@
 
 class AliasNode : public TreeNode {
   public:
+    AliasNode() = default;
     AliasNode(const std::string &from, const std::string &to);
 
+    std::string getFrom() const;
+    std::string getTo() const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
+
   private:
     virtual operator std::string() const;
     std::string from;
@@ -0,0 +1,39 @@
+#include "ChangeProfileNode.hh"
+#include "hash.hh"
+#include "memory_usage.hh"
+
+ChangeProfileNode::ChangeProfileNode(uint64_t startPos, uint64_t stopPos, const std::string &execMode,
+                                     const std::string &execCondition, const std::string &target)
+  : RuleNode("change_profile", startPos, stopPos),
+    exec_mode{execMode},
+    exec_condition{execCondition},
+    target{target}
+{
+  content_hash = hashString("change_profile");
+  content_hash = hashCombine(content_hash, hashString(exec_mode));
+  content_hash = hashCombine(content_hash, hashString(exec_condition));
+  content_hash = hashCombine(content_hash, hashString(target));
+}
+
+std::string ChangeProfileNode::getExecMode() const
+{
+  return exec_mode;
+}
+
+std::string ChangeProfileNode::getExecCondition() const
+{
+  return exec_condition;
+}
+
+std::string ChangeProfileNode::getTarget() const
+{
+  return target;
+}
+
+void ChangeProfileNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  RuleNode::addMemoryUsage(usage);
+  usage.strings += stringUsage(exec_mode);
+  usage.strings += stringUsage(exec_condition);
+  usage.strings += stringUsage(target);
+}
@@ -0,0 +1,32 @@
+#ifndef CHANGE_PROFILE_NODE_HH
+#define CHANGE_PROFILE_NODE_HH
+
+#include "RuleNode.hh"
+
+#include <string>
+
+// change_profile [safe|unsafe] [exec_cond] [-> target],
+class ChangeProfileNode : public RuleNode {
+  public:
+    ChangeProfileNode() = default;
+    ChangeProfileNode(uint64_t startPos, uint64_t stopPos, const std::string &execMode, const std::string &execCondition,
+                      const std::string &target);
+
+    // "safe" or "unsafe", empty when the rule does not say
+    std::string getExecMode() const;
+
+    // Executable the rule is limited to, empty when any may be used
+    std::string getExecCondition() const;
+
+    // Profile that may be changed to, empty when any may be
+    std::string getTarget() const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
+
+  private:
+    std::string exec_mode;
+    std::string exec_condition;
+    std::string target;
+};
+
+#endif // CHANGE_PROFILE_NODE_HH
@@ -0,0 +1,105 @@
+#include "Condition.hh"
+#include "hash.hh"
+#include "memory_usage.hh"
+
+void EvaluationContext::merge(const EvaluationContext &other)
+{
+  booleans.insert(other.booleans.begin(), other.booleans.end());
+  variables.insert(other.variables.begin(), other.variables.end());
+}
+
+std::string variableName(const std::string &variable)
+{
+  if(variable.size() >= 3 && variable[1] == '{' && variable.back() == '}') {
+    return variable.substr(2, variable.size() - 3);
+  }
+
+  return variable.empty()? variable : variable.substr(1);
+}
+
+Condition::Condition(Kind kind, const std::string &variable)
+  : kind{kind},
+    variable{variable}
+{   }
+
+Condition Condition::negate(const Condition &operand)
+{
+  Condition condition;
+  condition.kind = Kind::NOT;
+  condition.operand = std::make_shared<const Condition>(operand);
+  return condition;
+}
+
+Condition::Kind Condition::getKind() const
+{
+  return kind;
+}
+
+std::string Condition::getVariable() const
+{
+  return variable;
+}
+
+const Condition &Condition::getOperand() const
+{
+  return *operand;
+}
+
+std::optional<bool> Condition::evaluate(const EvaluationContext &context) const
+{
+  if(kind == Kind::NOT) {
+    auto value = operand->evaluate(context);
+    return value? std::optional<bool>(!*value) : std::nullopt;
+  }
+
+  std::string name = variableName(variable);
+  bool isBoolean = !variable.empty() && variable[0] == '$';
+
+  if(kind == Kind::DEFINED) {
+    bool defined = isBoolean? context.booleans.count(name) > 0 : context.variables.count(name) > 0;
+    if(!defined && !context.complete) {
+      return std::nullopt;
+    }
+    return defined;
+  }
+
+  auto value = context.booleans.find(name);
+  if(value == context.booleans.end()) {
+    // An undefined boolean is false, as it is for apparmor_parser
+    return context.complete? std::optional<bool>(false) : std::nullopt;
+  }
+  return value->second;
+}
+
+std::string Condition::str() const
+{
+  switch(kind) {
+    case Kind::NOT:
+      return "not " + operand->str();
+    case Kind::DEFINED:
+      return "defined " + variable;
+    default:
+      return variable;
+  }
+}
+
+uint64_t Condition::hash() const
+{
+  uint64_t hash = hashCombine(hashString("if"), static_cast<uint64_t>(kind));
+  if(kind == Kind::NOT) {
+    return hashCombine(hash, operand->hash());
+  }
+
+  // $foo and ${foo} are the same variable
+  std::string sigil = variable.substr(0, 1);
+  return hashCombine(hash, hashString(sigil + variableName(variable)));
+}
+
+void Condition::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  usage.strings += stringUsage(variable);
+  if(operand) {
+    usage.other += sizeof(Condition);
+    operand->addMemoryUsage(usage);
+  }
+}
@@ -0,0 +1,72 @@
+#ifndef CONDITION_HH
+#define CONDITION_HH
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+
+namespace AppArmor {
+  struct MemoryUsage;
+}
+
+// Values that conditional rules are evaluated against, keyed by the variable name
+// without its sigil or braces ($foo and ${foo} are both "foo")
+struct EvaluationContext {
+  std::map<std::string, bool> booleans;
+
+  // Set variables (@{foo}) that are known to be defined
+  std::set<std::string> variables;
+
+  // Whether every variable is listed. When it is not, a variable that is missing
+  // may still be defined by an include, so conditions reading it are left unresolved.
+  bool complete = false;
+
+  // Adds the values of another context, keeping those that are already set
+  void merge(const EvaluationContext &other);
+};
+
+// The expression of an if rule: $bool, defined $bool, defined @{var} or not <expr>
+class Condition {
+  public:
+    enum class Kind {
+      BOOLEAN,
+      DEFINED,
+      NOT
+    };
+
+    Condition() = default;
+    Condition(Kind kind, const std::string &variable);
+
+    static Condition negate(const Condition &operand);
+
+    Kind getKind() const;
+
+    // The variable as written, such as $foo or @{foo}. Empty for NOT.
+    std::string getVariable() const;
+
+    // The negated expression, only set for NOT
+    const Condition &getOperand() const;
+
+    // The value of the condition, or nothing when it reads a variable the context does not know
+    std::optional<bool> evaluate(const EvaluationContext &context) const;
+
+    // The expression in canonical form
+    std::string str() const;
+
+    uint64_t hash() const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
+
+  private:
+    Kind kind = Kind::BOOLEAN;
+    std::string variable;
+    std::shared_ptr<const Condition> operand;
+};
+
+// The name of a variable without its sigil or braces
+std::string variableName(const std::string &variable);
+
+#endif // CONDITION_HH
@@ -0,0 +1,65 @@
+#include "ConditionalNode.hh"
+#include "ProfileNode.hh"
+#include "RuleList.hh"
+#include "hash.hh"
+#include "memory_usage.hh"
+
+ConditionalNode::ConditionalNode()
+  : then_rules{std::make_shared<const RuleList<ProfileNode>>()},
+    else_rules{std::make_shared<const RuleList<ProfileNode>>()}
+{   }
+
+ConditionalNode::ConditionalNode(uint64_t startPos, uint64_t stopPos, const Condition &condition,
+                                 const RuleList<ProfileNode> &thenRules, const RuleList<ProfileNode> &elseRules)
+  : RuleNode("if", startPos, stopPos),
+    condition{condition},
+    then_rules{std::make_shared<const RuleList<ProfileNode>>(thenRules)},
+    else_rules{std::make_shared<const RuleList<ProfileNode>>(elseRules)}
+{
+  computeHash();
+}
+
+void ConditionalNode::computeHash()
+{
+  content_hash = hashCombine(condition.hash(), then_rules->hash());
+  content_hash = hashCombine(content_hash, else_rules->hash());
+}
+
+const Condition &ConditionalNode::getCondition() const
+{
+  return condition;
+}
+
+const RuleList<ProfileNode> &ConditionalNode::getThen() const
+{
+  return *then_rules;
+}
+
+const RuleList<ProfileNode> &ConditionalNode::getElse() const
+{
+  return *else_rules;
+}
+
+ConditionalNode ConditionalNode::resolve(const EvaluationContext &context) const
+{
+  RuleList<ProfileNode> thenRules = *then_rules;
+  RuleList<ProfileNode> elseRules = *else_rules;
+  thenRules.resolveConditionals(context);
+  elseRules.resolveConditionals(context);
+
+  ConditionalNode node = *this;
+  node.then_rules = std::make_shared<const RuleList<ProfileNode>>(thenRules);
+  node.else_rules = std::make_shared<const RuleList<ProfileNode>>(elseRules);
+  node.computeHash();
+  return node;
+}
+
+void ConditionalNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  RuleNode::addMemoryUsage(usage);
+  condition.addMemoryUsage(usage);
+
+  usage.ruleLists += 2 * sizeof(RuleList<ProfileNode>);
+  then_rules->addMemoryUsage(usage);
+  else_rules->addMemoryUsage(usage);
+}
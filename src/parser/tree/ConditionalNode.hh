@@ -0,0 +1,41 @@
+#ifndef CONDITIONAL_NODE_HH
+#define CONDITIONAL_NODE_HH
+
+#include "Condition.hh"
+#include "RuleNode.hh"
+
+#include <memory>
+
+class ProfileNode;
+
+template <class ProfileNode>
+class RuleList;
+
+// if <condition> { ... } [else { ... }], kept when the condition could not be folded while parsing.
+// An else if chain is a conditional alone in the else branch.
+class ConditionalNode : public RuleNode {
+  public:
+    ConditionalNode();
+    ConditionalNode(uint64_t startPos, uint64_t stopPos, const Condition &condition,
+                    const RuleList<ProfileNode> &thenRules, const RuleList<ProfileNode> &elseRules);
+
+    const Condition &getCondition() const;
+    const RuleList<ProfileNode> &getThen() const;
+    const RuleList<ProfileNode> &getElse() const;
+
+    // The same conditional with the conditions inside its branches folded where the context allows
+    ConditionalNode resolve(const EvaluationContext &context) const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
+
+  private:
+    void computeHash();
+
+    Condition condition;
+
+    // Branches are not modified once parsed, so copies of the node share them
+    std::shared_ptr<const RuleList<ProfileNode>> then_rules;
+    std::shared_ptr<const RuleList<ProfileNode>> else_rules;
+};
+
+#endif // CONDITIONAL_NODE_HH
@@ -1,5 +1,7 @@
 #include "FileNode.hh"
 #include "RuleNode.hh"
+#include "hash.hh"
+#include "memory_usage.hh"
 
 #include <sstream>
 
@@ -19,14 +21,38 @@ FileNode::FileNode(uint64_t startPos,
     filename{filename},
     exec_target{exec_target},
     fileMode{fileMode}
-{   }
+{
+  content_hash = hashString("file");
+  content_hash = hashCombine(content_hash, hashString(filename));
+  content_hash = hashCombine(content_hash, hashString(fileMode));
+  content_hash = hashCombine(content_hash, hashString(exec_target));
+  content_hash = hashCombine(content_hash, isSubset);
+}
 
-std::string FileNode::getFilename() const
+const std::string &FileNode::getFilename() const
 {
   return filename;
 }
 
-std::string FileNode::getFilemode() const
+const std::string &FileNode::getFilemode() const
 {
   return fileMode;
-}
\ No newline at end of file
+}
+
+const std::string &FileNode::getExecTarget() const
+{
+  return exec_target;
+}
+
+bool FileNode::isSubsetRule() const
+{
+  return isSubset;
+}
+
+void FileNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  RuleNode::addMemoryUsage(usage);
+  usage.strings += stringUsage(filename);
+  usage.strings += stringUsage(exec_target);
+  usage.strings += stringUsage(fileMode);
+}
@@ -15,8 +15,12 @@ class FileNode : public RuleNode {
              const std::string &exec_target = "", 
              bool isSubset = false);
 
-    std::string getFilename() const;
-    std::string getFilemode() const;
+    const std::string &getFilename() const;
+    const std::string &getFilemode() const;
+    const std::string &getExecTarget() const;
+    bool isSubsetRule() const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
 
   private:
     bool isSubset;
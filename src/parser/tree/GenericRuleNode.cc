@@ -0,0 +1,28 @@
+#include "GenericRuleNode.hh"
+#include "hash.hh"
+#include "memory_usage.hh"
+
+GenericRuleNode::GenericRuleNode(uint64_t startPos, uint64_t stopPos, const std::string &kind, const std::string &text,
+                                 uint64_t tokenHash)
+  : RuleNode(text, startPos, stopPos),
+    kind{kind},
+    token_hash{tokenHash}
+{
+  content_hash = hashCombine(hashString(kind), token_hash);
+}
+
+const std::string &GenericRuleNode::getKind() const
+{
+  return kind;
+}
+
+uint64_t GenericRuleNode::getTokenHash() const
+{
+  return token_hash;
+}
+
+void GenericRuleNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  RuleNode::addMemoryUsage(usage);
+  usage.strings += stringUsage(kind);
+}
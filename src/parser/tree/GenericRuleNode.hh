@@ -0,0 +1,34 @@
+#ifndef GENERIC_RULE_NODE_HH
+#define GENERIC_RULE_NODE_HH
+
+#include "RuleNode.hh"
+
+#include <cstdint>
+#include <string>
+
+// A rule of a kind that has no node type of its own (capability, network, mount, dbus,
+// signal, ptrace, unix, userns, rlimit, abi), kept as its text without the prefix.
+// It is hashed by its tokens, so spacing and comments inside the rule do not change it.
+class GenericRuleNode : public RuleNode {
+  public:
+    GenericRuleNode() = default;
+    GenericRuleNode(uint64_t startPos, uint64_t stopPos, const std::string &kind, const std::string &text,
+                    uint64_t tokenHash);
+
+    // The keyword the rule starts with, such as "network"
+    const std::string &getKind() const;
+
+    // The rule from its keyword to its comma, with runs of blanks and comments made a single space
+    using TreeNode::getText;
+
+    // Hash of the tokens of the rule, as computed by the driver
+    uint64_t getTokenHash() const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
+
+  private:
+    std::string kind;
+    uint64_t token_hash = 0;
+};
+
+#endif // GENERIC_RULE_NODE_HH
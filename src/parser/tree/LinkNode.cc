@@ -1,20 +1,45 @@
 #include "LinkNode.hh"
 #include "tree/RuleNode.hh"
 #include "tree/TreeNode.hh"
-
-#include <sstream>
+#include "hash.hh"
+#include "memory_usage.hh"
 
 LinkNode::LinkNode(uint64_t startPos, uint64_t stopPos, bool isSubset, const std::string &from, const std::string &to)
   : RuleNode("link", startPos, stopPos),
     isSubset{isSubset},
     from{from},
     to{to}
-{   }
+{
+  content_hash = hashString("link");
+  content_hash = hashCombine(content_hash, hashString(from));
+  content_hash = hashCombine(content_hash, hashString(to));
+  content_hash = hashCombine(content_hash, isSubset);
+}
 
 LinkNode::operator std::string() const
 {
-  std::stringstream stream;
-  stream << "(" << getStartPosition() << ", " << getStopPosition() << "): ";
-  stream << "link " << (isSubset? "subset " : "") << from << " -> " << to << "," << std::endl;;
-  return stream.str();
+  return "(" + std::to_string(getStartPosition()) + ", " + std::to_string(getStopPosition()) + "): " +
+         "link " + (isSubset? "subset " : "") + from + " -> " + to + ",\n";
 };
+
+std::string LinkNode::getFrom() const
+{
+  return from;
+}
+
+std::string LinkNode::getTo() const
+{
+  return to;
+}
+
+bool LinkNode::isSubsetRule() const
+{
+  return isSubset;
+}
+
+void LinkNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  RuleNode::addMemoryUsage(usage);
+  usage.strings += stringUsage(from);
+  usage.strings += stringUsage(to);
+}
@@ -9,6 +9,12 @@ class LinkNode : public RuleNode {
     LinkNode() = default;
     LinkNode(uint64_t startPos, uint64_t stopPos, bool isSubset, const std::string &linkFrom, const std::string &linkTo);
 
+    std::string getFrom() const;
+    std::string getTo() const;
+    bool isSubsetRule() const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
+
     virtual operator std::string() const;
 
   private:
@@ -1,7 +1,27 @@
 #include "ParseTree.hh"
 #include "TreeNode.hh"
+#include "memory_usage.hh"
 
-ParseTree::ParseTree(TreeNode preamble, std::shared_ptr<std::list<ProfileNode>> profileList)
+ParseTree::ParseTree(PreambleNode preamble, std::shared_ptr<std::list<ProfileNode>> profileList)
   : preamble{preamble}, 
     profileList{profileList}
 {   }
+
+AppArmor::MemoryUsage ParseTree::memoryUsage() const
+{
+  AppArmor::MemoryUsage usage;
+  usage.other += sizeof(ParseTree);
+
+  TreeNode::addMemoryUsage(usage);
+  preamble.addMemoryUsage(usage);
+
+  if(profileList != nullptr) {
+    usage.other += sizeof(*profileList);
+    for(auto &profile : *profileList) {
+      usage.profiles += listElementSize<ProfileNode>();
+      profile.addMemoryUsage(usage);
+    }
+  }
+
+  return usage;
+}
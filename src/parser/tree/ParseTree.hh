@@ -1,6 +1,8 @@
 #ifndef PARSE_TREE_HH
 #define PARSE_TREE_HH
 
+#include "apparmor_memory_usage.hh"
+#include "PreambleNode.hh"
 #include "TreeNode.hh"
 #include "ProfileNode.hh"
 
@@ -10,9 +12,12 @@
 // The root node of the abstract syntax tree
 class ParseTree : public TreeNode {
   public:
-    ParseTree(TreeNode preamble, std::shared_ptr<std::list<ProfileNode>> profileList);
+    ParseTree(PreambleNode preamble, std::shared_ptr<std::list<ProfileNode>> profileList);
 
-    TreeNode preamble;
+    // Bytes held by the whole tree, the root included
+    AppArmor::MemoryUsage memoryUsage() const;
+
+    PreambleNode preamble;
     std::shared_ptr<std::list<ProfileNode>> profileList;
 };
 
@@ -0,0 +1,92 @@
+#include "PreambleNode.hh"
+#include "memory_usage.hh"
+
+void PreambleNode::appendAbstraction(AbstractionNode &node)
+{
+  abstractions.push_back(node);
+}
+
+void PreambleNode::appendAlias(AliasNode &node)
+{
+  aliases.push_back(node);
+}
+
+void PreambleNode::appendAbi(const std::string &abi)
+{
+  abis.push_back(abi);
+}
+
+void PreambleNode::defineBoolean(const std::string &variable, bool value)
+{
+  definitions.booleans[variableName(variable)] = value;
+}
+
+void PreambleNode::defineVariable(const VariableAssignment &assignment)
+{
+  definitions.variables.insert(variableName(assignment.variable));
+  assignments.push_back(assignment);
+}
+
+std::list<AbstractionNode> PreambleNode::getAbstractionList() const
+{
+  return abstractions;
+}
+
+const std::list<AliasNode> &PreambleNode::getAliasList() const
+{
+  return aliases;
+}
+
+const std::list<std::string> &PreambleNode::getAbiList() const
+{
+  return abis;
+}
+
+const std::list<VariableAssignment> &PreambleNode::getAssignments() const
+{
+  return assignments;
+}
+
+const EvaluationContext &PreambleNode::getDefinitions() const
+{
+  return definitions;
+}
+
+void PreambleNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  TreeNode::addMemoryUsage(usage);
+
+  for(auto &abstraction : abstractions) {
+    usage.abstractions += listElementSize<AbstractionNode>();
+    abstraction.addMemoryUsage(usage);
+  }
+
+  for(auto &alias : aliases) {
+    usage.aliases += listElementSize<AliasNode>();
+    alias.addMemoryUsage(usage);
+  }
+
+  for(auto &abi : abis) {
+    usage.other += listElementSize<std::string>();
+    usage.strings += stringUsage(abi);
+  }
+
+  for(auto &assignment : assignments) {
+    usage.other += listElementSize<VariableAssignment>() + assignment.values.capacity() * sizeof(std::string);
+    usage.strings += stringUsage(assignment.variable);
+    for(auto &value : assignment.values) {
+      usage.strings += stringUsage(value);
+    }
+  }
+
+  // Map and set nodes hold the value, three links and the color
+  for(auto &boolean : definitions.booleans) {
+    usage.other += sizeof(boolean) + 4 * sizeof(void *);
+    usage.strings += stringUsage(boolean.first);
+  }
+
+  for(auto &variable : definitions.variables) {
+    usage.other += sizeof(variable) + 4 * sizeof(void *);
+    usage.strings += stringUsage(variable);
+  }
+}
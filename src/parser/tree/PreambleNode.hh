@@ -0,0 +1,53 @@
+#ifndef PREAMBLE_NODE_HH
+#define PREAMBLE_NODE_HH
+
+#include "AbstractionNode.hh"
+#include "AliasNode.hh"
+#include "Condition.hh"
+#include "TreeNode.hh"
+
+#include <list>
+#include <string>
+#include <vector>
+
+// A set variable assignment, @{foo} = a b or @{foo} += c, with its values as written
+struct VariableAssignment {
+  std::string variable;
+  bool append = false;
+  std::vector<std::string> values;
+};
+
+// Everything in a file before the first profile: aliases, variables, abi rules and includes
+class PreambleNode : public TreeNode {
+  public:
+    PreambleNode() = default;
+
+    void appendAbstraction(AbstractionNode &node);
+    void appendAlias(AliasNode &node);
+
+    // The abi a file is written against, as written: <abi/3.0> or "abi/3.0"
+    void appendAbi(const std::string &abi);
+
+    // Boolean ($foo = true) and set (@{foo} = ...) variables assigned in the file
+    void defineBoolean(const std::string &variable, bool value);
+    void defineVariable(const VariableAssignment &assignment);
+
+    std::list<AbstractionNode> getAbstractionList() const;
+    const std::list<AliasNode> &getAliasList() const;
+    const std::list<std::string> &getAbiList() const;
+
+    // Set variable assignments in the order they appear in the file
+    const std::list<VariableAssignment> &getAssignments() const;
+    const EvaluationContext &getDefinitions() const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
+
+  private:
+    std::list<AbstractionNode> abstractions;
+    std::list<AliasNode> aliases;
+    std::list<std::string> abis;
+    std::list<VariableAssignment> assignments;
+    EvaluationContext definitions;
+};
+
+#endif // PREAMBLE_NODE_HH
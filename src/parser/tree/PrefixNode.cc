@@ -1,4 +1,5 @@
 #include "PrefixNode.hh"
+#include "hash.hh"
 #include "tree/TreeNode.hh"
 
 PrefixNode::PrefixNode(bool audit, bool should_deny, bool owner)
@@ -7,3 +8,23 @@ PrefixNode::PrefixNode(bool audit, bool should_deny, bool owner)
     should_deny{should_deny},
     owner{owner}
 {   }
+
+bool PrefixNode::isAudit() const
+{
+  return audit;
+}
+
+bool PrefixNode::isDeny() const
+{
+  return should_deny;
+}
+
+bool PrefixNode::isOwner() const
+{
+  return owner;
+}
+
+uint64_t PrefixNode::hash() const
+{
+  return hashMix((audit? 1 : 0) | (should_deny? 2 : 0) | (owner? 4 : 0));
+}
@@ -2,12 +2,19 @@
 #define PREFIX_NODE_HH
 
 #include "TreeNode.hh"
+#include <cstdint>
 #include <string>
 
 class PrefixNode : public TreeNode {
   public:
     PrefixNode(bool audit = DEFAULT_AUDIT, bool should_deny = DEFAULT_PERM_MODE, bool owner = DEFAULT_OWNER);
 
+    bool isAudit() const;
+    bool isDeny() const;
+    bool isOwner() const;
+
+    uint64_t hash() const;
+
     static constexpr bool DEFAULT_AUDIT       = false; 
     static constexpr bool DEFAULT_PERM_MODE   = false;
     static constexpr bool DEFAULT_OWNER       = false;
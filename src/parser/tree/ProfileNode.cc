@@ -1,12 +1,136 @@
 #include "ProfileNode.hh"
 #include "tree/TreeNode.hh"
+#include "hash.hh"
+#include "memory_usage.hh"
+
+#include <algorithm>
 
 ProfileNode::ProfileNode(const std::string &profile_name, const RuleList<ProfileNode> &rules)
+  : ProfileNode(profile_name, rules, 0, 0)
+{   }
+
+ProfileNode::ProfileNode(const std::string &profile_name, const RuleList<ProfileNode> &rules, uint64_t startPos, uint64_t stopPos,
+                         const std::string &attachment)
   : TreeNode(profile_name),
-    rules{rules}
+    rules{rules},
+    attachment{attachment},
+    startPos{startPos},
+    stopPos{stopPos},
+    content_hash{hashCombine(hashCombine(hashString(profile_name), hashString(attachment)), rules.hash())}
 {   }
 
-RuleList<ProfileNode> ProfileNode::getRules()
+const RuleList<ProfileNode> &ProfileNode::getRules() const
 {
   return rules;
 }
+
+std::string ProfileNode::getAttachment() const
+{
+  return attachment;
+}
+
+void ProfileNode::setXattrs(const Xattrs &xattrs)
+{
+  this->xattrs = xattrs;
+}
+
+const ProfileNode::Xattrs &ProfileNode::getXattrs() const
+{
+  return xattrs;
+}
+
+void ProfileNode::setFlags(const std::vector<std::string> &flags)
+{
+  this->flags = flags;
+  std::sort(this->flags.begin(), this->flags.end());
+  this->flags.erase(std::unique(this->flags.begin(), this->flags.end()), this->flags.end());
+}
+
+const std::vector<std::string> &ProfileNode::getFlags() const
+{
+  return flags;
+}
+
+uint64_t ProfileNode::hash() const
+{
+  uint64_t hash = hat? hashCombine(content_hash, hat) : content_hash;
+
+  // Sorted by name, so the order they were written in does not matter
+  for(auto &xattr : xattrs) {
+    uint64_t values = hashString(xattr.first);
+    for(auto &value : xattr.second) {
+      values = hashCombine(values, hashString(value));
+    }
+    hash = hashCombine(hash, values);
+  }
+
+  // Told apart from xattrs, which are hashed as pairs
+  for(auto &flag : flags) {
+    hash = hashCombine(hash, hashCombine(hashString("flag"), hashString(flag)));
+  }
+  return hash;
+}
+
+uint64_t ProfileNode::getStartPosition() const
+{
+  return startPos;
+}
+
+uint64_t ProfileNode::getStopPosition() const
+{
+  return stopPos;
+}
+
+void ProfileNode::setHat(bool hat)
+{
+  this->hat = hat;
+}
+
+bool ProfileNode::isHat() const
+{
+  return hat;
+}
+
+void ProfileNode::resolveConditionals(const EvaluationContext &context)
+{
+  rules.resolveConditionals(context);
+  rehash();
+}
+
+void ProfileNode::appendFileNode(const PrefixNode &prefix, FileNode &node)
+{
+  rules.appendFileNode(prefix, node);
+  rehash();
+}
+
+bool ProfileNode::removeFileNode(const FileNode &node)
+{
+  if(!rules.removeFileNode(node)) {
+    return false;
+  }
+
+  rehash();
+  return true;
+}
+
+void ProfileNode::rehash()
+{
+  content_hash = hashCombine(hashCombine(hashString(text), hashString(attachment)), rules.hash());
+}
+
+void ProfileNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  TreeNode::addMemoryUsage(usage);
+  usage.strings += stringUsage(attachment);
+  for(auto &flag : flags) {
+    usage.strings += sizeof(flag) + stringUsage(flag);
+  }
+  for(auto &xattr : xattrs) {
+    usage.other += mapElementSize<std::string, std::vector<std::string>>();
+    usage.strings += stringUsage(xattr.first);
+    for(auto &value : xattr.second) {
+      usage.strings += sizeof(value) + stringUsage(value);
+    }
+  }
+  rules.addMemoryUsage(usage);
+}
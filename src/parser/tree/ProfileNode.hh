@@ -4,17 +4,72 @@
 #include "RuleList.hh"
 #include "TreeNode.hh"
 
+#include <map>
 #include <string>
+#include <vector>
 
 class ProfileNode : public TreeNode {
   public:
+    // Values of each extended attribute, keyed by attribute name
+    using Xattrs = std::map<std::string, std::vector<std::string>>;
+
     ProfileNode(const std::string &profile_name, const RuleList<ProfileNode> &rules);
+    ProfileNode(const std::string &profile_name, const RuleList<ProfileNode> &rules, uint64_t startPos, uint64_t stopPos,
+                const std::string &attachment = "");
     ProfileNode() = default;
 
-    RuleList<ProfileNode> getRules();
+    const RuleList<ProfileNode> &getRules() const;
+
+    // The executable the profile attaches to, when it is not the profile name itself
+    std::string getAttachment() const;
+
+    // Extended attributes the executable must carry for the profile to attach, from
+    // xattrs=(name=value name=(value value) ...). Values are globs, any one of which may match,
+    // and an attribute written without a value has none.
+    void setXattrs(const Xattrs &xattrs);
+    const Xattrs &getXattrs() const;
+
+    // Mode flags from flags=(...), such as complain or attach_disconnected.
+    // Kept sorted and without duplicates, as their order has no meaning.
+    void setFlags(const std::vector<std::string> &flags);
+    const std::vector<std::string> &getFlags() const;
+
+    // Content hash of the header (name, attachment, xattrs and flags) and every rule, computed
+    // as the profile is built. Two profiles with the same rules in any order, layout or position
+    // hash the same. Variables are hashed as they are written, not by their values.
+    uint64_t hash() const;
+
+    // From the start of the profile name to the closing brace
+    uint64_t getStartPosition() const;
+    uint64_t getStopPosition() const;
+
+    // Hats (^name) are kept as subprofiles, marked so they can be told apart from local profiles
+    void setHat(bool hat);
+    bool isHat() const;
+
+    // Folds the conditional rules that the context decides, see RuleList::resolveConditionals
+    void resolveConditionals(const EvaluationContext &context);
+
+    // Edit the file rules of the profile itself, keeping the hash up to date.
+    // Only used on a copy of a profile that no one else can see yet, see AppArmor::ProfileStore.
+    void appendFileNode(const PrefixNode &prefix, FileNode &node);
+    bool removeFileNode(const FileNode &node);
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
 
   protected:
+    void rehash();
+
     RuleList<ProfileNode> rules;
+    std::string attachment;
+    Xattrs xattrs;
+    std::vector<std::string> flags;
+
+    uint64_t startPos = 0;
+    uint64_t stopPos = 0;
+
+    uint64_t content_hash = 0;
+    bool hat = false;
 };
 
 #endif // PROFILE_NODE_HH
\ No newline at end of file
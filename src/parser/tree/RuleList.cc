@@ -4,6 +4,8 @@
 #include "PrefixNode.hh"
 #include "ProfileNode.hh"
 #include "TreeNode.hh"
+#include "hash.hh"
+#include "memory_usage.hh"
 
 #include <iostream>
 
@@ -24,6 +26,13 @@ void RuleList<ProfileNode>::setStopPosition(uint64_t stopPos)
   this->stopPos = stopPos;
 }
 
+template<class ProfileNode>
+void RuleList<ProfileNode>::addHash(uint64_t hash)
+{
+  rule_sum += hash;
+  content_hash = hashMix(rule_sum);
+}
+
 /** Append methods **/
 template <typename T, typename = typename std::enable_if<std::is_base_of<RuleNode, T>::value, T>::type>
 inline void appendPrefixedNode(const PrefixNode &prefix, T &node, std::list<T> &list)
@@ -36,62 +45,263 @@ template<class ProfileNode>
 void RuleList<ProfileNode>::appendFileNode(const PrefixNode &prefix, FileNode &node)
 {
   appendPrefixedNode(prefix, node, files);
+  addHash(files.back().hash());
 }
 
 template<class ProfileNode>
 void RuleList<ProfileNode>::appendLinkNode(const PrefixNode &prefix, LinkNode &node)
 {
   appendPrefixedNode(prefix, node, links);
+  addHash(links.back().hash());
 }
 
 template<class ProfileNode>
 void RuleList<ProfileNode>::appendRuleList(const PrefixNode &prefix, RuleList<ProfileNode> &node)
 {
   appendPrefixedNode(prefix, node, rules);
+  addHash(rules.back().hash());
 }
 
 template<class ProfileNode>
 void RuleList<ProfileNode>::appendAbstraction(AbstractionNode &node)
 {
   abstractions.push_back(node);
+  addHash(abstractions.back().hash());
+}
+
+template<class ProfileNode>
+void RuleList<ProfileNode>::appendChangeProfile(const PrefixNode &prefix, ChangeProfileNode &node)
+{
+  appendPrefixedNode(prefix, node, change_profiles);
+  addHash(change_profiles.back().hash());
+}
+
+template<class ProfileNode>
+void RuleList<ProfileNode>::appendGenericRule(const PrefixNode &prefix, GenericRuleNode &node)
+{
+  appendPrefixedNode(prefix, node, generic_rules);
+  addHash(generic_rules.back().hash());
+}
+
+template<class ProfileNode>
+void RuleList<ProfileNode>::appendConditional(ConditionalNode &node)
+{
+  conditionals.push_back(node);
+  addHash(conditionals.back().hash());
 }
 
 template<class ProfileNode>
 void RuleList<ProfileNode>::appendSubprofile(ProfileNode &node)
 {
   subprofiles.push_back(node);
+  addHash(subprofiles.back().hash());
+}
+
+template<class ProfileNode>
+void RuleList<ProfileNode>::appendRules(const RuleList<ProfileNode> &other)
+{
+  files.insert(files.end(), other.files.begin(), other.files.end());
+  links.insert(links.end(), other.links.begin(), other.links.end());
+  rules.insert(rules.end(), other.rules.begin(), other.rules.end());
+  abstractions.insert(abstractions.end(), other.abstractions.begin(), other.abstractions.end());
+  change_profiles.insert(change_profiles.end(), other.change_profiles.begin(), other.change_profiles.end());
+  generic_rules.insert(generic_rules.end(), other.generic_rules.begin(), other.generic_rules.end());
+  conditionals.insert(conditionals.end(), other.conditionals.begin(), other.conditionals.end());
+  subprofiles.insert(subprofiles.end(), other.subprofiles.begin(), other.subprofiles.end());
+
+  // The hash is a sum over the rules, so the sums add up
+  addHash(other.rule_sum);
+}
+
+template<class ProfileNode>
+bool RuleList<ProfileNode>::removeFileNode(const FileNode &node)
+{
+  for(auto file = files.begin(); file != files.end(); file++) {
+    const auto &prefix = file->getPrefix();
+    if(file->getFilename() == node.getFilename() && file->getFilemode() == node.getFilemode() &&
+       file->getExecTarget() == node.getExecTarget() && prefix.isAudit() == node.getPrefix().isAudit() &&
+       prefix.isDeny() == node.getPrefix().isDeny() && prefix.isOwner() == node.getPrefix().isOwner()) {
+      rule_sum -= file->hash();
+      files.erase(file);
+
+      // An empty list hashes to 0, the same as one that never held a rule
+      content_hash = isEmpty()? 0 : hashMix(rule_sum);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+template<class ProfileNode>
+void RuleList<ProfileNode>::rehash()
+{
+  rule_sum = 0;
+  content_hash = 0;
+
+  for(auto &file : files) {
+    addHash(file.hash());
+  }
+
+  for(auto &link : links) {
+    addHash(link.hash());
+  }
+
+  for(auto &rule : rules) {
+    addHash(rule.hash());
+  }
+
+  for(auto &abstraction : abstractions) {
+    addHash(abstraction.hash());
+  }
+
+  for(auto &change_profile : change_profiles) {
+    addHash(change_profile.hash());
+  }
+
+  for(auto &generic_rule : generic_rules) {
+    addHash(generic_rule.hash());
+  }
+
+  for(auto &conditional : conditionals) {
+    addHash(conditional.hash());
+  }
+
+  for(auto &subprofile : subprofiles) {
+    addHash(subprofile.hash());
+  }
+}
+
+template<class ProfileNode>
+bool RuleList<ProfileNode>::isEmpty() const
+{
+  return files.empty() && links.empty() && rules.empty() && abstractions.empty() &&
+         change_profiles.empty() && generic_rules.empty() && conditionals.empty() && subprofiles.empty();
+}
+
+template<class ProfileNode>
+void RuleList<ProfileNode>::resolveConditionals(const EvaluationContext &context)
+{
+  for(auto &rule : rules) {
+    rule.resolveConditionals(context);
+  }
+
+  for(auto &subprofile : subprofiles) {
+    subprofile.resolveConditionals(context);
+  }
+
+  std::list<ConditionalNode> pending;
+  pending.swap(conditionals);
+
+  for(auto &conditional : pending) {
+    auto value = conditional.getCondition().evaluate(context);
+    if(!value) {
+      conditionals.push_back(conditional.resolve(context));
+      continue;
+    }
+
+    RuleList<ProfileNode> live = *value? conditional.getThen() : conditional.getElse();
+    live.resolveConditionals(context);
+    appendRules(live);
+  }
+
+  rehash();
 }
 
 /** Get methods **/
 template<class ProfileNode>
-std::list<FileNode> RuleList<ProfileNode>::getFileList()
+const std::list<FileNode> &RuleList<ProfileNode>::getFileList() const
 {
   return files;
 }
 
 template<class ProfileNode>
-std::list<LinkNode> RuleList<ProfileNode>::getLinkList()
+const std::list<LinkNode> &RuleList<ProfileNode>::getLinkList() const
 {
   return links;
 }
 
 template<class ProfileNode>
-std::list<RuleList<ProfileNode>> RuleList<ProfileNode>::getRuleList()
+const std::list<RuleList<ProfileNode>> &RuleList<ProfileNode>::getRuleList() const
 {
   return rules;
 }
 
 template<class ProfileNode>
-std::list<AbstractionNode> RuleList<ProfileNode>::getAbstractionList()
+const std::list<AbstractionNode> &RuleList<ProfileNode>::getAbstractionList() const
 {
   return abstractions;
 }
 
 template<class ProfileNode>
-std::list<ProfileNode> RuleList<ProfileNode>::getSubprofiles()
+const std::list<ChangeProfileNode> &RuleList<ProfileNode>::getChangeProfileList() const
+{
+  return change_profiles;
+}
+
+template<class ProfileNode>
+const std::list<GenericRuleNode> &RuleList<ProfileNode>::getGenericRuleList() const
+{
+  return generic_rules;
+}
+
+template<class ProfileNode>
+const std::list<ConditionalNode> &RuleList<ProfileNode>::getConditionalList() const
+{
+  return conditionals;
+}
+
+template<class ProfileNode>
+const std::list<ProfileNode> &RuleList<ProfileNode>::getSubprofiles() const
 {
   return subprofiles;
 }
 
+template<class ProfileNode>
+void RuleList<ProfileNode>::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  RuleNode::addMemoryUsage(usage);
+
+  for(auto &file : files) {
+    usage.files += listElementSize<FileNode>();
+    file.addMemoryUsage(usage);
+  }
+
+  for(auto &link : links) {
+    usage.links += listElementSize<LinkNode>();
+    link.addMemoryUsage(usage);
+  }
+
+  for(auto &rule : rules) {
+    usage.ruleLists += listElementSize<RuleList>();
+    rule.addMemoryUsage(usage);
+  }
+
+  for(auto &abstraction : abstractions) {
+    usage.abstractions += listElementSize<AbstractionNode>();
+    abstraction.addMemoryUsage(usage);
+  }
+
+  for(auto &change_profile : change_profiles) {
+    usage.other += listElementSize<ChangeProfileNode>();
+    change_profile.addMemoryUsage(usage);
+  }
+
+  for(auto &generic_rule : generic_rules) {
+    usage.other += listElementSize<GenericRuleNode>();
+    generic_rule.addMemoryUsage(usage);
+  }
+
+  for(auto &conditional : conditionals) {
+    usage.other += listElementSize<ConditionalNode>();
+    conditional.addMemoryUsage(usage);
+  }
+
+  for(auto &subprofile : subprofiles) {
+    usage.subprofiles += listElementSize<ProfileNode>();
+    subprofile.addMemoryUsage(usage);
+  }
+}
+
 // Helpful for the linker
 template class RuleList<ProfileNode>;
\ No newline at end of file
@@ -2,7 +2,10 @@
 #define RULE_LIST_HH
 
 #include "AbstractionNode.hh"
+#include "ChangeProfileNode.hh"
+#include "ConditionalNode.hh"
 #include "FileNode.hh"
+#include "GenericRuleNode.hh"
 #include "LinkNode.hh"
 #include "PrefixNode.hh"
 #include "RuleNode.hh"
@@ -24,19 +27,49 @@ class RuleList : public RuleNode {
     void appendLinkNode(const PrefixNode &prefix, LinkNode &node);
     void appendRuleList(const PrefixNode &prefix, RuleList &node);
     void appendAbstraction(AbstractionNode &node);
+    void appendChangeProfile(const PrefixNode &prefix, ChangeProfileNode &node);
+    void appendGenericRule(const PrefixNode &prefix, GenericRuleNode &node);
+    void appendConditional(ConditionalNode &node);
     void appendSubprofile(ProfileNode &node);
 
-    std::list<FileNode>        getFileList();
-    std::list<LinkNode>        getLinkList();
-    std::list<RuleList>        getRuleList();
-    std::list<AbstractionNode> getAbstractionList();
-    std::list<ProfileNode>     getSubprofiles();
+    // Appends every rule of another list, such as the live branch of a folded conditional
+    void appendRules(const RuleList &other);
+
+    // Removes the first file rule with the same path, mode, exec target and audit/deny/owner prefix.
+    // Rules in nested blocks are left alone. Returns whether a rule was removed.
+    bool removeFileNode(const FileNode &node);
+
+    const std::list<FileNode>        &getFileList() const;
+    const std::list<LinkNode>        &getLinkList() const;
+    const std::list<RuleList>        &getRuleList() const;
+    const std::list<AbstractionNode> &getAbstractionList() const;
+    const std::list<ChangeProfileNode> &getChangeProfileList() const;
+    const std::list<GenericRuleNode> &getGenericRuleList() const;
+    const std::list<ConditionalNode> &getConditionalList() const;
+    const std::list<ProfileNode>     &getSubprofiles() const;
+
+    // Whether the list holds no rule of any kind
+    bool isEmpty() const;
+
+    // Replaces the conditionals whose condition the context decides with their live branch,
+    // here and in every nested block, conditional and subprofile
+    void resolveConditionals(const EvaluationContext &context);
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
 
   private:
+    // Rules are added up, so the hash does not depend on their order
+    void addHash(uint64_t hash);
+    void rehash();
+    uint64_t rule_sum = 0;
+
     std::list<FileNode>         files;
     std::list<LinkNode>         links;
     std::list<RuleList>         rules;
     std::list<AbstractionNode>  abstractions;
+    std::list<ChangeProfileNode> change_profiles;
+    std::list<GenericRuleNode>  generic_rules;
+    std::list<ConditionalNode>  conditionals;
     std::list<ProfileNode>      subprofiles;
 };
 
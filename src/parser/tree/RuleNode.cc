@@ -1,5 +1,7 @@
 #include "RuleNode.hh"
 #include "TreeNode.hh"
+#include "hash.hh"
+#include "memory_usage.hh"
 
 #include <assert.h>
 #include <cstdint>
@@ -36,6 +38,16 @@ void RuleNode::setPrefix(const PrefixNode &prefix)
   this->prefix = prefix;
 }
 
+const PrefixNode &RuleNode::getPrefix() const
+{
+  return prefix;
+}
+
+uint64_t RuleNode::hash() const
+{
+  return hashCombine(content_hash, prefix.hash());
+}
+
 uint64_t RuleNode::getStartPosition() const
 {
   assert_things;
@@ -47,3 +59,9 @@ uint64_t RuleNode::getStopPosition() const
   assert_things;
   return stopPos;
 }
+
+void RuleNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  TreeNode::addMemoryUsage(usage);
+  prefix.addMemoryUsage(usage);
+}
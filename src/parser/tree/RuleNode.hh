@@ -16,10 +16,20 @@ class RuleNode : protected TreeNode {
     uint64_t getStopPosition()  const;
 
     void setPrefix(const PrefixNode &prefix);
+    const PrefixNode &getPrefix() const;
+
+    // Content hash of the rule and its prefix.
+    // Does not depend on whitespace, comments or the position in the file.
+    uint64_t hash() const;
+
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
 
   protected:
     PrefixNode prefix;
 
+    // Set by the derived classes from their contents, prefix excluded
+    uint64_t content_hash = 0;
+
     uint64_t startPos;
     uint64_t stopPos;
 };
@@ -1,4 +1,5 @@
 #include "TreeNode.hh"
+#include "memory_usage.hh"
 
 #include <initializer_list>
 #include <memory>
@@ -36,3 +37,13 @@ std::string TreeNode::getText() const
 {
   return text;
 }
+
+void TreeNode::addMemoryUsage(AppArmor::MemoryUsage &usage) const
+{
+  usage.strings += stringUsage(text);
+
+  for(auto &child : children) {
+    usage.other += listElementSize<TreeNode>();
+    child.addMemoryUsage(usage);
+  }
+}
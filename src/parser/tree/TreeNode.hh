@@ -6,6 +6,10 @@
 #include <memory>
 #include <string>
 
+namespace AppArmor {
+  struct MemoryUsage;
+}
+
 class TreeNode {
   public:
     // Constructors
@@ -21,6 +25,10 @@ class TreeNode {
 
     std::string getText() const;
 
+    // Adds the heap memory owned by this node to usage.
+    // The node itself is counted by the list or node that holds it.
+    void addMemoryUsage(AppArmor::MemoryUsage &usage) const;
+
     // Copy/Move assignment operator
     TreeNode& operator=(const TreeNode &) = default;
     TreeNode& operator=(TreeNode &&) = default;
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace AliasCheck {
+  const std::string policy =
+    "alias /usr/ -> /mnt/usr/,\n"
+    "alias /usr/lib/ -> /lib/,\n"
+    "profile a {\n"
+    "  /usr/bin/a rix,\n"
+    "  /usr/lib/** mr,\n"
+    "  /etc/a r,\n"
+    "  profile child { /usr/share/a r, }\n"
+    "}\n"
+    "profile b { /etc/b r, }\n";
+
+  std::list<AppArmor::Profile> parse_text(const std::string &text, AppArmor::ParseOptions options = {})
+  {
+    options.applyAliases = true;
+    return TestHelpers::parse_text(text, options);
+  }
+
+  std::set<std::string> filenames(const AppArmor::Profile &profile)
+  {
+    std::set<std::string> out;
+    for(auto &rule : profile.getFileRules()) {
+      out.insert(rule.getFilename());
+    }
+    return out;
+  }
+
+  TEST(AliasCheck, rules_are_copied_under_every_alias)
+  {
+    auto profile = parse_text(policy).front();
+
+    std::set<std::string> expected = {
+      "/usr/bin/a", "/mnt/usr/bin/a",
+      "/usr/lib/**", "/mnt/usr/lib/**", "/lib/**",
+      "/etc/a"
+    };
+    EXPECT_EQ(filenames(profile), expected);
+  }
+
+  TEST(AliasCheck, unaffected_profile_keeps_hash)
+  {
+    auto written = TestHelpers::parse_text(policy);
+
+    auto aliased = parse_text(policy);
+
+    EXPECT_NE(written.front().hash(), aliased.front().hash());
+    EXPECT_EQ(written.back().hash(), aliased.back().hash());
+  }
+
+  TEST(AliasCheck, lazy_matches_eager)
+  {
+    AppArmor::ParseOptions lazy;
+    lazy.lazy = true;
+
+    auto eager_list = parse_text(policy);
+    auto lazy_list = parse_text(policy, lazy);
+    ASSERT_EQ(eager_list.size(), lazy_list.size());
+
+    auto lazy_profile = lazy_list.begin();
+    for(auto &eager_profile : eager_list) {
+      EXPECT_EQ(eager_profile.hash(), lazy_profile->hash());
+      lazy_profile++;
+    }
+  }
+}
@@ -0,0 +1,56 @@
+#include <cstdint>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+#include "test_helpers.hh"
+
+// Replaces the global operator new of the test program, so tests can count the allocations
+// of a piece of code. The library itself never does this, it only reads the counts back
+// through AppArmor::setAllocationCounter.
+static thread_local AppArmor::AllocationCount counter;
+
+// Usable size of the blocks allocated minus those freed, which is only meaningful as a
+// difference between two points of the same thread
+static thread_local int64_t live = 0;
+
+// Array and nothrow forms fall back to these by default
+void *operator new(std::size_t size)
+{
+  counter.allocations++;
+  counter.bytes += size;
+
+  void *ptr = std::malloc(size == 0? 1 : size);
+  if(ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  live += malloc_usable_size(ptr);
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+  if(ptr != nullptr) {
+    live -= malloc_usable_size(ptr);
+  }
+  std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept
+{
+  operator delete(ptr);
+}
+
+namespace TestHelpers {
+  AppArmor::AllocationCount allocations()
+  {
+    return counter;
+  }
+
+  int64_t liveBytes()
+  {
+    return live;
+  }
+
+  static const bool installed = (AppArmor::setAllocationCounter(allocations), true);
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "apparmor_attachment_resolver.hh"
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace AttachmentResolverCheck {
+  const std::string policy =
+    "/usr/bin/foo { /etc/foo r, }\n"
+    "profile foo-glob /usr/bin/foo* { /etc/foo r, }\n"
+    "profile any /usr/bin/* {\n"
+    "  profile /usr/bin/child { /etc/child r, }\n"
+    "}\n"
+    "profile trusted /srv/app/* xattrs=(security.apparmor=trusted) { /srv/app/** r, }\n"
+    "profile untrusted /srv/app/* { /srv/app/** r, }\n"
+    "profile first /data/x* { /data/** r, }\n"
+    "profile second /data/x? { /data/** r, }\n"
+    "profile unattached { /etc/unattached r, }\n";
+
+  using TestHelpers::parse_text;
+
+  TEST(AttachmentResolverCheck, most_specific_profile_attaches)
+  {
+    AppArmor::AttachmentResolver resolver(parse_text(policy));
+
+    EXPECT_EQ(resolver.resolve("/usr/bin/foo").profile, "/usr/bin/foo");
+    EXPECT_EQ(resolver.resolve("/usr/bin/foobar").profile, "foo-glob");
+    EXPECT_EQ(resolver.resolve("/usr/bin/foobar").attachment, "/usr/bin/foo*");
+    EXPECT_EQ(resolver.resolve("/usr/bin/bar").profile, "any");
+
+    // Local profiles never attach
+    EXPECT_EQ(resolver.resolve("/usr/bin/child").profile, "any");
+
+    auto unconfined = resolver.resolve("/etc/unattached");
+    EXPECT_TRUE(unconfined.profile.empty());
+    EXPECT_TRUE(unconfined.conflicts.empty());
+  }
+
+  TEST(AttachmentResolverCheck, xattrs_break_ties)
+  {
+    AppArmor::AttachmentResolver resolver(parse_text(policy));
+
+    EXPECT_EQ(resolver.resolve("/srv/app/run", {{"security.apparmor", "trusted"}}).profile, "trusted");
+    EXPECT_EQ(resolver.resolve("/srv/app/run", {{"security.apparmor", "other"}}).profile, "untrusted");
+    EXPECT_EQ(resolver.resolve("/srv/app/run").profile, "untrusted");
+  }
+
+  // Any value of a list may match, and an attribute without a value only has to be present
+  TEST(AttachmentResolverCheck, xattr_value_lists)
+  {
+    AppArmor::AttachmentResolver resolver(parse_text(
+      "profile tagged /opt/* xattrs=(user.tag=(alpha \"beta*\") user.seen) { /opt/** r, }\n"
+      "profile plain /opt/* { /opt/** r, }\n"));
+
+    EXPECT_EQ(resolver.resolve("/opt/run", {{"user.tag", "alpha"}, {"user.seen", "1"}}).profile, "tagged");
+    EXPECT_EQ(resolver.resolve("/opt/run", {{"user.tag", "beta2"}, {"user.seen", ""}}).profile, "tagged");
+    EXPECT_EQ(resolver.resolve("/opt/run", {{"user.tag", "gamma"}, {"user.seen", "1"}}).profile, "plain");
+    EXPECT_EQ(resolver.resolve("/opt/run", {{"user.tag", "alpha"}}).profile, "plain");
+  }
+
+  TEST(AttachmentResolverCheck, equal_specificity_conflicts)
+  {
+    AppArmor::AttachmentResolver resolver(parse_text(policy));
+
+    auto tied = resolver.resolve("/data/xy");
+    EXPECT_TRUE(tied.profile.empty());
+    EXPECT_EQ(tied.conflicts, (std::vector<std::string>{"first", "second"}));
+
+    EXPECT_EQ(resolver.resolve("/data/xyz").profile, "first");
+    EXPECT_TRUE(resolver.getSkipped().empty());
+  }
+}
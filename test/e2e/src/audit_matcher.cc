@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+#include "apparmor_audit_matcher.hh"
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace AuditMatcherCheck {
+  using TestHelpers::parse_text;
+
+  std::string denial(const std::string &profile, const std::string &name, const std::string &mask)
+  {
+    return "type=1400 audit(1700000000.123:42): apparmor=\"DENIED\" operation=\"open\" profile=\"" + profile +
+           "\" name=" + name + " pid=1234 comm=\"foo\" requested_mask=\"" + mask + "\" denied_mask=\"" + mask +
+           "\" fsuid=1000 ouid=1000";
+  }
+
+  const std::string policy =
+    "/usr/bin/foo {\n"
+    "  include <abstractions/base>\n"
+    "  /etc/passwd r,\n"
+    "  deny /etc/shadow r,\n"
+    "  profile helper {\n"
+    "    /tmp/** rw,\n"
+    "  }\n"
+    "}\n";
+
+  TEST(AuditMatcherCheck, attributes_records_to_rules)
+  {
+    auto profiles = parse_text(policy);
+    auto base = parse_text("profile base {\n  /etc/ld.so.cache r,\n}\n").front();
+    AppArmor::AuditMatcher matcher(profiles, {{"abstractions/base", base}});
+
+    AppArmor::AuditMatch match;
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo", "\"/etc/shadow\"", "r"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::DENIED);
+    EXPECT_EQ(match.rule.getFilename(), "/etc/shadow");
+
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo", "\"/etc/ld.so.cache\"", "r"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::ALLOWED);
+    EXPECT_EQ(match.abstraction, "abstractions/base");
+
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo//helper", "\"/tmp/x\"", "w"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::ALLOWED);
+    EXPECT_EQ(match.rule.getFilename(), "/tmp/**");
+
+    // Only the permissions no rule grants are reported
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo", "\"/etc/passwd\"", "rw"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::UNMATCHED);
+    EXPECT_EQ(match.mode, "w");
+
+    // Paths with spaces are logged hex encoded
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo", "2F746D702F6120622E747874", "r"), match));
+    EXPECT_EQ(match.path, "/tmp/a b.txt");
+
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/bar", "\"/etc/passwd\"", "r"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::UNKNOWN_PROFILE);
+
+    EXPECT_FALSE(matcher.match("type=1400 audit(1.0:1): apparmor=\"STATUS\" operation=\"profile_load\"", match));
+    EXPECT_FALSE(matcher.match("type=SYSCALL msg=audit(1.0:1): arch=c000003e syscall=2", match));
+  }
+
+  TEST(AuditMatcherCheck, aggregates_suggestions_across_threads)
+  {
+    AppArmor::AuditMatcher matcher(parse_text(policy));
+
+    std::string log;
+    for(int i = 0; i < 10000; i++) {
+      log += denial("/usr/bin/foo", "\"/var/log/foo.log\"", "w") + "\n";
+      log += denial("/usr/bin/foo", "\"/var/log/foo.log\"", "r") + "\n";
+      log += denial("/usr/bin/foo", "\"/etc/passwd\"", "r") + "\n";
+      log += "type=SYSCALL msg=audit(1.0:1): arch=c000003e syscall=2\n";
+    }
+
+    std::istringstream stream(log);
+    auto summary = matcher.process(stream, 4);
+
+    EXPECT_EQ(summary.lines, 40000);
+    EXPECT_EQ(summary.allowed, 10000);
+    EXPECT_EQ(summary.unmatched, 20000);
+
+    ASSERT_EQ(summary.suggestions.size(), 1);
+    EXPECT_EQ(summary.suggestions.front().profile, "/usr/bin/foo");
+    EXPECT_EQ(summary.suggestions.front().path, "/var/log/foo.log");
+    EXPECT_EQ(summary.suggestions.front().mode, "rw");
+    EXPECT_EQ(summary.suggestions.front().count, 20000);
+  }
+
+  // Rules using a variable are not compiled, and make the records they may cover indeterminate
+  TEST(AuditMatcherCheck, variable_rules_are_indeterminate)
+  {
+    AppArmor::AuditMatcher matcher(parse_text(
+      "/usr/bin/foo {\n"
+      "  /etc/** r,\n"
+      "  @{HOME}/.foo/** rw,\n"
+      "  deny @{PROC}/*/mem r,\n"
+      "}\n"));
+
+    auto &skipped = matcher.getSkippedRules();
+    ASSERT_EQ(skipped.size(), 2);
+    EXPECT_EQ(skipped.front().getFilename(), "@{HOME}/.foo/**");
+
+    AppArmor::AuditMatch match;
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo", "\"/home/user/.foo/config\"", "w"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::INDETERMINATE);
+    EXPECT_EQ(match.rule.getFilename(), "@{HOME}/.foo/**");
+
+    // The variable deny rule may take back what /etc/** grants, since @{PROC} could be anything
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo", "\"/etc/1/mem\"", "r"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::INDETERMINATE);
+    EXPECT_EQ(match.rule.getFilename(), "@{PROC}/*/mem");
+
+    // Paths neither of them can match keep their outcome
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo", "\"/etc/passwd\"", "r"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::ALLOWED);
+    ASSERT_TRUE(matcher.match(denial("/usr/bin/foo", "\"/var/log/foo\"", "w"), match));
+    EXPECT_EQ(match.kind, AppArmor::AuditMatch::Kind::UNMATCHED);
+
+    std::istringstream log(denial("/usr/bin/foo", "\"/home/user/.foo/config\"", "w") + "\n");
+    auto summary = matcher.process(log, 1);
+    EXPECT_EQ(summary.indeterminate, 1);
+    EXPECT_TRUE(summary.suggestions.empty());
+  }
+
+  // The log does not say which transition an exec rule should take
+  TEST(AuditMatcherCheck, exec_suggestions_leave_the_transition_open)
+  {
+    AppArmor::AuditMatcher matcher(parse_text(policy));
+
+    std::istringstream log(denial("/usr/bin/foo", "\"/usr/bin/bar\"", "x") + "\n" +
+                           denial("/usr/bin/foo", "\"/usr/bin/bar\"", "r") + "\n");
+    auto summary = matcher.process(log, 1);
+
+    ASSERT_EQ(summary.suggestions.size(), 1);
+    EXPECT_EQ(summary.suggestions.front().mode, "rx");
+  }
+}
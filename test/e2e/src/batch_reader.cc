@@ -0,0 +1,273 @@
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "parser/batch_reader.hh"
+#include "test_helpers.hh"
+
+namespace BatchReaderCheck {
+  using TestHelpers::TempDir;
+
+  // What the callback saw for each path
+  struct Results {
+    std::mutex mutex;
+    std::map<std::string, std::pair<std::string, int>> files;
+    std::atomic<int> calls{0};
+
+    BatchReader::Callback record()
+    {
+      return [this](const std::string &path, const std::string &contents, int error) {
+        calls++;
+        std::lock_guard<std::mutex> lock(mutex);
+        files[path] = {contents, error};
+      };
+    }
+  };
+
+  // The ring is only used when the kernel and the seccomp policy allow it
+  #define REQUIRE_MODE(reader, useIoUring) \
+    if((useIoUring) && !(reader).usesIoUring()) { \
+      GTEST_SKIP() << "io_uring is not available"; \
+    } \
+    ASSERT_EQ((reader).usesIoUring(), (useIoUring))
+
+  // Files of every size around the 4096 byte first read, and bigger than the sizes statx reports
+  void check_reads_whole_files(bool useIoUring)
+  {
+    TempDir directory;
+    std::map<std::string, std::string> expected;
+    for(size_t size : {0, 1, 4095, 4096, 4097, 100000}) {
+      std::string contents;
+      for(size_t i = 0; i < size; i++) {
+        contents.push_back('a' + i % 26);
+      }
+      expected[directory.write("file" + std::to_string(size), contents)] = contents;
+    }
+
+    Results results;
+    BatchReader reader(results.record(), 2, useIoUring);
+    REQUIRE_MODE(reader, useIoUring);
+
+    for(auto &file : expected) {
+      reader.submit(file.first);
+    }
+    reader.wait();
+
+    ASSERT_EQ(results.files.size(), expected.size());
+    for(auto &file : expected) {
+      EXPECT_EQ(results.files[file.first].second, 0) << file.first;
+      EXPECT_EQ(results.files[file.first].first, file.second) << file.first;
+    }
+  }
+
+  TEST(BatchReaderCheck, reads_whole_files_with_threads)
+  {
+    check_reads_whole_files(false);
+  }
+
+  TEST(BatchReaderCheck, reads_whole_files_with_io_uring)
+  {
+    check_reads_whole_files(true);
+  }
+
+  // Reads that return less than asked for, from a pipe whose writer sends the text in pieces,
+  // and from a file that reports a size of zero
+  void check_short_reads(bool useIoUring)
+  {
+    TempDir directory;
+    auto fifo = directory.path() + "/fifo";
+    ASSERT_EQ(mkfifo(fifo.c_str(), 0600), 0);
+
+    Results results;
+    BatchReader reader(results.record(), 2, useIoUring);
+    REQUIRE_MODE(reader, useIoUring);
+
+    std::thread writer([&fifo]() {
+      int fd = open(fifo.c_str(), O_WRONLY);
+      for(const char *piece : {"first ", "second ", "third"}) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        EXPECT_GT(write(fd, piece, strlen(piece)), 0);
+      }
+      close(fd);
+    });
+
+    reader.submit(fifo);
+    reader.submit("/proc/self/status");
+    reader.wait();
+    writer.join();
+
+    EXPECT_EQ(results.files[fifo], std::make_pair(std::string("first second third"), 0));
+    EXPECT_EQ(results.files["/proc/self/status"].second, 0);
+    EXPECT_EQ(results.files["/proc/self/status"].first.compare(0, 5, "Name:"), 0);
+  }
+
+  TEST(BatchReaderCheck, short_reads_with_threads)
+  {
+    check_short_reads(false);
+  }
+
+  TEST(BatchReaderCheck, short_reads_with_io_uring)
+  {
+    check_short_reads(true);
+  }
+
+  // Failures reach the callback as an errno, and the other files are still read
+  void check_errors(bool useIoUring)
+  {
+    TempDir directory;
+    auto good = directory.write("good", "contents");
+    auto missing = directory.path() + "/missing";
+    auto unreadable = directory.write("unreadable", "secret");
+    ASSERT_EQ(chmod(unreadable.c_str(), 0), 0);
+
+    Results results;
+    BatchReader reader(results.record(), 2, useIoUring);
+    REQUIRE_MODE(reader, useIoUring);
+
+    reader.submit(missing);
+    reader.submit(directory.path());
+    reader.submit(good);
+    reader.submit(unreadable);
+    reader.wait();
+
+    EXPECT_EQ(results.files[missing].second, ENOENT);
+    EXPECT_EQ(results.files[directory.path()].second, EISDIR);
+    EXPECT_EQ(results.files[good], std::make_pair(std::string("contents"), 0));
+
+    // Root reads the file anyway
+    int expected = geteuid() == 0? 0 : EACCES;
+    EXPECT_EQ(results.files[unreadable].second, expected);
+  }
+
+  TEST(BatchReaderCheck, errors_with_threads)
+  {
+    check_errors(false);
+  }
+
+  TEST(BatchReaderCheck, errors_with_io_uring)
+  {
+    check_errors(true);
+  }
+
+  // The callback queues the files it finds, as the policy watcher does for includes, and wait()
+  // returns once the last of them is done. The files form a tree, so more of them are queued
+  // at once than the ring keeps in flight.
+  void check_callback_submits(bool useIoUring)
+  {
+    TempDir directory;
+    const int count = 300;
+    for(int i = 0; i < count; i++) {
+      std::string children;
+      for(int child : {2 * i + 1, 2 * i + 2}) {
+        if(child < count) {
+          children += "file" + std::to_string(child) + " ";
+        }
+      }
+      directory.write("file" + std::to_string(i), children);
+    }
+
+    Results results;
+    auto record = results.record();
+    std::unique_ptr<BatchReader> reader;
+    reader = std::make_unique<BatchReader>([&](const std::string &path, const std::string &contents, int error) {
+      record(path, contents, error);
+
+      std::istringstream children(contents);
+      std::string child;
+      while(children >> child) {
+        reader->submit(directory.path() + "/" + child);
+      }
+    }, 4, useIoUring);
+    REQUIRE_MODE(*reader, useIoUring);
+
+    reader->submit(directory.path() + "/file0");
+    reader->wait();
+
+    EXPECT_EQ(results.files.size(), count);
+    EXPECT_EQ(results.calls, count);
+  }
+
+  TEST(BatchReaderCheck, callback_submits_with_threads)
+  {
+    check_callback_submits(false);
+  }
+
+  TEST(BatchReaderCheck, callback_submits_with_io_uring)
+  {
+    check_callback_submits(true);
+  }
+
+  TEST(BatchReaderCheck, callback_exceptions)
+  {
+    TempDir directory;
+    auto file = directory.write("file", "x");
+
+    for(bool useIoUring : {false, true}) {
+      std::atomic<int> calls{0};
+      BatchReader reader([&](const std::string &, const std::string &, int) {
+        if(calls++ == 0) {
+          throw std::runtime_error("first");
+        }
+      }, 1, useIoUring);
+
+      reader.submit(file);
+      reader.submit(file);
+      EXPECT_THROW(reader.wait(), std::runtime_error);
+      EXPECT_EQ(calls, 2);
+
+      // The failure is reported once
+      reader.submit(file);
+      EXPECT_NO_THROW(reader.wait());
+    }
+  }
+
+  // Reports how many small files per second each mode reads. Nothing is asserted about the numbers.
+  TEST(BatchReaderCheck, throughput)
+  {
+    TempDir directory;
+    std::vector<std::string> files;
+    for(int i = 0; i < 2000; i++) {
+      files.push_back(directory.write("abstractions/file" + std::to_string(i),
+                                      "# abstraction " + std::to_string(i) + "\n  /usr/lib/** mr,\n"));
+    }
+
+    for(bool useIoUring : {false, true}) {
+      std::atomic<size_t> bytes{0};
+      auto start = std::chrono::steady_clock::now();
+
+      BatchReader reader([&](const std::string &, const std::string &contents, int error) {
+        EXPECT_EQ(error, 0);
+        bytes += contents.size();
+      }, 4, useIoUring);
+      if(useIoUring && !reader.usesIoUring()) {
+        continue;
+      }
+
+      for(auto &file : files) {
+        reader.submit(file);
+      }
+      reader.wait();
+
+      auto time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+      auto filesPerSecond = time.count() > 0? int64_t(files.size() * 1000000 / time.count()) : 0;
+
+      const char *mode = reader.usesIoUring()? "io_uring" : "threads";
+      RecordProperty(std::string(mode) + "_files_per_s", filesPerSecond);
+      std::cout << mode << ": " << filesPerSecond << " files/s, " << bytes << " bytes\n";
+    }
+  }
+}
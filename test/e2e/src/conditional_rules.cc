@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace ConditionalRulesCheck {
+  const std::string policy =
+    "$secure = true\n"
+    "@{HOME} = /home/*/\n"
+    "profile a {\n"
+    "  /etc/a r,\n"
+    "  if $secure {\n"
+    "    /etc/secure r,\n"
+    "  } else {\n"
+    "    /etc/open r,\n"
+    "  }\n"
+    "  if not defined @{HOME} {\n"
+    "    /home/ r,\n"
+    "  }\n"
+    "  if $unknown {\n"
+    "    /etc/unknown r,\n"
+    "  } else if $secure {\n"
+    "    /etc/chained r,\n"
+    "  }\n"
+    "}\n"
+    "profile b { /etc/b r, }\n";
+
+  using TestHelpers::parse_text;
+
+  std::set<std::string> filenames(const AppArmor::Profile &profile)
+  {
+    std::set<std::string> out;
+    for(auto &rule : profile.getFileRules()) {
+      out.insert(rule.getFilename());
+    }
+    return out;
+  }
+
+  TEST(ConditionalRulesCheck, folds_known_conditions)
+  {
+    auto profile = parse_text(policy).front();
+
+    // $unknown is not assigned in the file, and may be set by an include, so its conditional is kept
+    std::set<std::string> expected = {"/etc/a", "/etc/secure"};
+    EXPECT_EQ(filenames(profile), expected);
+  }
+
+  TEST(ConditionalRulesCheck, options_take_precedence)
+  {
+    AppArmor::ParseOptions options;
+    options.booleans = {{"secure", false}, {"unknown", false}};
+
+    auto profile = parse_text(policy, options).front();
+
+    std::set<std::string> expected = {"/etc/a", "/etc/open"};
+    EXPECT_EQ(filenames(profile), expected);
+  }
+
+  TEST(ConditionalRulesCheck, keep_and_evaluate)
+  {
+    AppArmor::ParseOptions options;
+    options.keepConditionals = true;
+
+    auto profile = parse_text(policy, options).front();
+    EXPECT_EQ(filenames(profile), std::set<std::string>{"/etc/a"});
+
+    // Values left out are undefined, rather than taken from the file
+    std::set<std::string> secure = {"/etc/a", "/etc/secure", "/home/", "/etc/chained"};
+    EXPECT_EQ(filenames(profile.evaluate({{"secure", true}})), secure);
+
+    std::set<std::string> open = {"/etc/a", "/etc/open", "/etc/unknown"};
+    EXPECT_EQ(filenames(profile.evaluate({{"unknown", true}}, {"HOME"})), open);
+  }
+
+  TEST(ConditionalRulesCheck, folded_hash_matches_plain_profile)
+  {
+    auto folded = parse_text(
+      "$on = true\n"
+      "profile a {\n"
+      "  /etc/a r,\n"
+      "  if $on { /etc/on r, } else { /etc/off r, }\n"
+      "}\n").front();
+    auto plain = parse_text("profile a { /etc/a r, /etc/on r, }\n").front();
+
+    EXPECT_EQ(folded.hash(), plain.hash());
+  }
+
+  TEST(ConditionalRulesCheck, lazy_and_parallel_match_eager)
+  {
+    AppArmor::ParseOptions lazy;
+    lazy.lazy = true;
+
+    AppArmor::ParseOptions parallel;
+    parallel.threads = 2;
+
+    auto eager_list = parse_text(policy);
+    auto lazy_list = parse_text(policy, lazy);
+    auto parallel_list = parse_text(policy, parallel);
+
+    ASSERT_EQ(eager_list.size(), lazy_list.size());
+    ASSERT_EQ(eager_list.size(), parallel_list.size());
+
+    auto lazy_profile = lazy_list.begin();
+    auto parallel_profile = parallel_list.begin();
+    for(auto &eager_profile : eager_list) {
+      EXPECT_EQ(eager_profile.hash(), lazy_profile->hash());
+      EXPECT_EQ(eager_profile.hash(), parallel_profile->hash());
+      lazy_profile++;
+      parallel_profile++;
+    }
+  }
+
+  TEST(ConditionalRulesCheck, invalid_boolean_value)
+  {
+    EXPECT_ANY_THROW(parse_text("$on = maybe\nprofile a {}\n"));
+  }
+}
@@ -28,6 +28,13 @@ namespace FileRuleCheck {
 
     auto file_rules = first_profile->getFileRules();
     ASSERT_EQ(file_rules, expected_file_rules);
+
+    // The handles see the same rules
+    std::list<AppArmor::FileRule> handles;
+    for(auto rule : first_profile->fileRules()) {
+      handles.push_back(rule.toFileRule());
+    }
+    ASSERT_EQ(handles, expected_file_rules);
   }
   
   // Creates and inserts an AppArmor::FileRule to the end of a list
@@ -57,6 +64,23 @@ namespace FileRuleCheck {
     check_file_rules_for_single_profile(filename, expected_file_rules, "/usr/bin/foo");
   }
 
+  TEST(FileRuleCheck, rules_outlive_parser)
+  {
+    std::list<AppArmor::FileRule> rules;
+    AppArmor::FileRuleRange range;
+    {
+      auto profile = getProfileList(PROFILE_SOURCE_DIR "/file/ok_1.sd").front();
+      rules = profile.getFileRules();
+      range = profile.fileRules();
+    }
+
+    // Both keep the parsed tree alive once the parser and profile are gone
+    ASSERT_EQ(range.size(), 1);
+    EXPECT_EQ((*range.begin()).getFilename(), "/usr/bin/foo");
+    ASSERT_EQ(rules.size(), 1);
+    EXPECT_EQ(rules.front().getFilemode(), "r");
+  }
+
   TEST(FileRuleCheck, file_ok_2)
   {
     auto filename = PROFILE_SOURCE_DIR "/file/ok_2.sd";
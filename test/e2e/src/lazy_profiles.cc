@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+#include <list>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace LazyProfileCheck {
+  // A lazily loaded file should end up with the same profiles and rules as an eager parse
+  void check_lazy_matches_eager(const std::string &filename)
+  {
+    AppArmor::ParseOptions options;
+    options.lazy = true;
+
+    auto eager_list = AppArmor::Parser(filename).getProfileList();
+    auto lazy_list  = AppArmor::Parser(filename, options).getProfileList();
+
+    ASSERT_EQ(lazy_list.size(), eager_list.size());
+
+    auto eager = eager_list.begin();
+    for(auto lazy = lazy_list.begin(); lazy != lazy_list.end(); lazy++, eager++) {
+      EXPECT_EQ(lazy->name(), eager->name());
+      EXPECT_EQ(lazy->getAbstractions(), eager->getAbstractions());
+
+      auto lazy_rules  = lazy->getFileRules();
+      auto eager_rules = eager->getFileRules();
+      ASSERT_EQ(lazy_rules, eager_rules);
+
+      // Positions should still be relative to the whole file
+      auto eager_rule = eager_rules.begin();
+      for(auto &rule : lazy_rules) {
+        EXPECT_EQ(rule.getStartPosition(), eager_rule->getStartPosition());
+        EXPECT_EQ(rule.getEndPosition(), eager_rule->getEndPosition());
+        eager_rule++;
+      }
+    }
+  }
+
+  TEST(LazyProfileCheck, file_ok_3)
+  {
+    check_lazy_matches_eager(PROFILE_SOURCE_DIR "/file/ok_3.sd");
+  }
+
+  TEST(LazyProfileCheck, bare_include_tests_ok_1)
+  {
+    check_lazy_matches_eager(PROFILE_SOURCE_DIR "/bare_include_tests/ok_1.sd");
+  }
+
+  TEST(LazyProfileCheck, rewrite_alias_good_2)
+  {
+    check_lazy_matches_eager(PROFILE_SOURCE_DIR "/rewrite/alias_good_2.sd");
+  }
+
+  TEST(LazyProfileCheck, variable_values_with_braces)
+  {
+    // The braces in the values must not be taken for profile bodies
+    TestHelpers::TempFile file(
+      "@{DIRS} = {bin,sbin}\n"
+      "@{LIBS} = {lib,lib64} \\\n"
+      "  {usr/lib,usr/lib64}\n"
+      "@{DIRS} += {local/bin,local/sbin}\n"
+      "$secure = true\n"
+      "profile a /usr/@{DIRS}/a {\n"
+      "  /@{LIBS}/** mr,\n"
+      "}\n"
+      "profile b { /etc/b r, }\n");
+
+    check_lazy_matches_eager(file.path());
+
+    AppArmor::ParseOptions options;
+    options.lazy = true;
+    auto profiles = AppArmor::Parser(file.path(), options).getProfileList();
+    ASSERT_EQ(profiles.size(), 2);
+    EXPECT_EQ(profiles.front().name(), "a");
+    EXPECT_EQ(profiles.back().name(), "b");
+  }
+}
@@ -0,0 +1,92 @@
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace MemoryUsageCheck {
+  using TestHelpers::parse_text;
+
+  TEST(MemoryUsageCheck, breakdown_by_node_type)
+  {
+    auto profiles = parse_text(
+      "profile a {\n"
+      "  include <abstractions/base>\n"
+      "  /etc/a r,\n"
+      "  /etc/b -> /etc/c,\n"
+      "  audit { /etc/d r, }\n"
+      "  profile hat { /etc/hat r, }\n"
+      "}\n");
+    auto usage = profiles.front().memoryUsage();
+
+    EXPECT_GT(usage.profiles, 0u);
+    EXPECT_GT(usage.subprofiles, 0u);
+    EXPECT_GT(usage.ruleLists, 0u);
+    EXPECT_GT(usage.files, 0u);
+    EXPECT_GT(usage.links, 0u);
+    EXPECT_GT(usage.abstractions, 0u);
+    EXPECT_EQ(usage.aliases, 0u);
+
+    EXPECT_EQ(usage.total(), usage.profiles + usage.subprofiles + usage.ruleLists + usage.files +
+                             usage.links + usage.abstractions + usage.aliases + usage.strings + usage.other);
+  }
+
+  TEST(MemoryUsageCheck, grows_with_rules)
+  {
+    auto profiles = parse_text(
+      "profile a { /etc/a r, }\n"
+      "profile a { /etc/a r, /etc/b r, }\n");
+
+    auto one = profiles.front().memoryUsage();
+    auto two = profiles.back().memoryUsage();
+
+    // Both paths fit in the small string buffer, so only the node is added
+    EXPECT_EQ(two.files, 2 * one.files);
+    EXPECT_EQ(two.strings, one.strings);
+    EXPECT_EQ(two.total() - one.total(), one.files);
+  }
+
+  TEST(MemoryUsageCheck, counts_long_strings)
+  {
+    std::string path = "/usr/share/applications/some-rather-long-application-name/**";
+    auto profiles = parse_text(
+      "profile a { /etc/a r, }\n"
+      "profile a { " + path + " r, }\n");
+
+    auto shorter = profiles.front().memoryUsage();
+    auto longer = profiles.back().memoryUsage();
+
+    EXPECT_GE(longer.strings - shorter.strings, path.size() + 1);
+  }
+
+  TEST(MemoryUsageCheck, counts_xattrs)
+  {
+    std::string value = "a-value-too-long-for-the-small-string-buffer";
+    auto profiles = parse_text(
+      "profile a /usr/bin/a { /etc/a r, }\n"
+      "profile a /usr/bin/a xattrs=(user.tag=(one " + value + ")) { /etc/a r, }\n");
+
+    auto plain = profiles.front().memoryUsage();
+    auto tagged = profiles.back().memoryUsage();
+
+    EXPECT_GT(tagged.other, plain.other);
+    EXPECT_GE(tagged.strings - plain.strings, 2 * sizeof(std::string) + value.size() + 1);
+  }
+
+  TEST(MemoryUsageCheck, lazy_matches_eager)
+  {
+    AppArmor::ParseOptions options;
+    options.lazy = true;
+
+    std::string filename = PROFILE_SOURCE_DIR "/file/ok_3.sd";
+    auto eager_list = AppArmor::Parser(filename).getProfileList();
+    auto lazy_list = AppArmor::Parser(filename, options).getProfileList();
+    ASSERT_EQ(eager_list.size(), lazy_list.size());
+
+    auto lazy = lazy_list.begin();
+    for(auto &eager : eager_list) {
+      EXPECT_EQ(eager.memoryUsage().total(), (lazy++)->memoryUsage().total());
+    }
+  }
+}
@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace ParallelParseCheck {
+  // Text of a file with many top-level profiles, and a preamble in front of them
+  std::string multi_profile_text(int profile_count)
+  {
+    std::ostringstream file;
+
+    file << "# generated for the parallel parse test\n";
+    file << "@{HOME}=/home/*/ /root/\n";
+    file << "alias /usr/ -> /mnt/usr/,\n\n";
+
+    for(int i = 0; i < profile_count; i++) {
+      file << "profile p" << i << " /usr/bin/p" << i << " {\n";
+      file << "  # a comment with a brace }\n";
+      file << "  /usr/{bin,sbin}/p" << i << " rix,\n";
+      file << "  @{HOME}/.p" << i << "/** rw,\n";
+      file << "}\n\n";
+    }
+
+    return file.str();
+  }
+
+  TEST(ParallelParseCheck, matches_serial_parse)
+  {
+    TestHelpers::TempFile file(multi_profile_text(500));
+    auto &filename = file.path();
+
+    AppArmor::ParseOptions options;
+    options.threads = 4;
+
+    auto serial_list   = AppArmor::Parser(filename).getProfileList();
+    auto parallel_list = AppArmor::Parser(filename, options).getProfileList();
+
+    ASSERT_EQ(parallel_list.size(), 500);
+    ASSERT_EQ(parallel_list.size(), serial_list.size());
+
+    auto serial = serial_list.begin();
+    for(auto &profile : parallel_list) {
+      EXPECT_EQ(profile.name(), serial->name());
+
+      auto parallel_rules = profile.getFileRules();
+      auto serial_rules   = serial->getFileRules();
+      ASSERT_EQ(parallel_rules, serial_rules);
+
+      auto serial_rule = serial_rules.begin();
+      for(auto &rule : parallel_rules) {
+        EXPECT_EQ(rule.getStartPosition(), serial_rule->getStartPosition());
+        serial_rule++;
+      }
+      serial++;
+    }
+  }
+}
@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace ParseStatsCheck {
+  const std::string TEXT =
+    "include <tunables/global>\n"
+    "profile a {\n"
+    "  /etc/a r,\n"
+    "  /var/log/a w,\n"
+    "  profile hat { /etc/hat r, }\n"
+    "}\n";
+
+  AppArmor::ParseStats parse_text(const std::string &text, AppArmor::ParseOptions options)
+  {
+    TestHelpers::TempFile file(text);
+    options.stats = true;
+    return AppArmor::Parser(file.path(), options).getStats();
+  }
+
+  TEST(ParseStatsCheck, counts_default_parse)
+  {
+    auto stats = parse_text(TEXT, {});
+
+    EXPECT_EQ(stats.bytesRead, TEXT.size());
+    EXPECT_GT(stats.tokens["INITIAL"], 0u);
+    EXPECT_GT(stats.reductions, 0u);
+
+    // include, profile and its rule list, two rules, hat and its rule list, one rule
+    EXPECT_EQ(stats.nodes, 8u);
+  }
+
+  TEST(ParseStatsCheck, counts_every_kind_of_rule)
+  {
+    auto stats = parse_text("profile a {\n  capability chown,\n  change_profile -> b,\n  /etc/a r,\n}\n", {});
+
+    // profile and its rule list, three rules
+    EXPECT_EQ(stats.nodes, 5u);
+  }
+
+  // The test program installs an allocation counter, see alloc_counter.cc
+  TEST(ParseStatsCheck, counts_allocations)
+  {
+    auto stats = parse_text(TEXT, {});
+
+    EXPECT_GT(stats.allocations, 0u);
+    EXPECT_GE(stats.allocatedBytes, stats.allocations);
+  }
+
+  TEST(ParseStatsCheck, off_by_default)
+  {
+    TestHelpers::TempFile file(TEXT);
+    auto stats = AppArmor::Parser(file.path()).getStats();
+
+    EXPECT_EQ(stats.bytesRead, 0u);
+    EXPECT_TRUE(stats.tokens.empty());
+    EXPECT_EQ(stats.reductions, 0u);
+  }
+
+  TEST(ParseStatsCheck, lazy_only_reads)
+  {
+    AppArmor::ParseOptions options;
+    options.lazy = true;
+    auto stats = parse_text(TEXT, options);
+
+    EXPECT_EQ(stats.bytesRead, TEXT.size());
+    EXPECT_TRUE(stats.tokens.empty());
+    EXPECT_EQ(stats.reductions, 0u);
+  }
+
+  TEST(ParseStatsCheck, json_output)
+  {
+    AppArmor::ParseStats stats;
+    stats.bytesRead = 12;
+    stats.tokens["INITIAL"] = 3;
+    stats.tokens["SUB_ID"] = 1;
+    stats.lexTime = std::chrono::nanoseconds(5);
+
+    EXPECT_EQ(stats.toJson(),
+      "{\"bytes_read\":12,\"tokens\":{\"INITIAL\":3,\"SUB_ID\":1},\"reductions\":0,\"nodes\":0,"
+      "\"allocations\":0,\"allocated_bytes\":0,"
+      "\"time_ns\":{\"io\":0,\"lex\":5,\"parse\":0,\"conversion\":0}}");
+  }
+}
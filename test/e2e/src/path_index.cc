@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "apparmor_parser.hh"
+#include "apparmor_path_index.hh"
+#include "test_helpers.hh"
+
+namespace PathIndexCheck {
+  using TestHelpers::parse_text;
+
+  std::vector<std::string> matches(const AppArmor::PathIndex &index, const std::string &pattern, const std::string &mode)
+  {
+    std::vector<std::string> out;
+    for(auto &match : index.query(pattern, mode)) {
+      out.push_back(match.profile + " " + match.rule.getFilename());
+    }
+    return out;
+  }
+
+  const std::string policy =
+    "profile a {\n"
+    "  /etc/passwd r,\n"
+    "  /etc/ssh/** rw,\n"
+    "  deny /etc/shadow w,\n"
+    "  profile child { /{etc,var}/child w, }\n"
+    "}\n"
+    "profile b {\n"
+    "  /** r,\n"
+    "  /etc/pa* w,\n"
+    "}\n";
+
+  TEST(PathIndexCheck, finds_rules_by_path_and_mode)
+  {
+    AppArmor::PathIndex index(parse_text(policy));
+
+    std::vector<std::string> writers = {"a /etc/ssh/**", "a//child /{etc,var}/child", "b /etc/pa*"};
+    EXPECT_EQ(matches(index, "/etc/**", "w"), writers);
+
+    std::vector<std::string> readers = {"a /etc/passwd", "b /**", "b /etc/pa*"};
+    EXPECT_EQ(matches(index, "/etc/passwd", ""), readers);
+
+    // Deny rules grant nothing
+    EXPECT_TRUE(matches(index, "/etc/shadow", "w").empty());
+  }
+
+  // Globs sharing a prefix are only reported when some path is matched by both
+  TEST(PathIndexCheck, compares_globs_past_the_prefix)
+  {
+    AppArmor::PathIndex index(parse_text(
+      "profile a {\n"
+      "  /etc/*.conf w,\n"
+      "  /etc/**/*.d/ w,\n"
+      "  /etc/[a-c]* w,\n"
+      "  @{HOME}/.cache/** w,\n"
+      "}\n"));
+
+    EXPECT_EQ(matches(index, "/etc/*.d", "w"), std::vector<std::string>{"a /etc/[a-c]*"});
+    EXPECT_EQ(matches(index, "/etc/x/*.d/", "w"), std::vector<std::string>{"a /etc/**/*.d/"});
+    EXPECT_EQ(matches(index, "/etc/d.conf", "w"), std::vector<std::string>{"a /etc/*.conf"});
+
+    // A variable may stand for any path
+    EXPECT_EQ(matches(index, "/home/user/.cache/x", "w"), std::vector<std::string>{"a @{HOME}/.cache/**"});
+  }
+
+  TEST(PathIndexCheck, deny_rules_take_permissions_back)
+  {
+    AppArmor::PathIndex index(parse_text(
+      "profile a {\n"
+      "  /etc/** rw,\n"
+      "  deny /etc/shadow w,\n"
+      "  deny /etc/ssh/** rw,\n"
+      "  owner /home/*/** w,\n"
+      "  deny owner /home/*/.ssh/** w,\n"
+      "  /srv/** w,\n"
+      "  deny owner /srv/secret w,\n"
+      "}\n"
+      "profile b {\n"
+      "  /etc/shadow w,\n"
+      "  deny { /etc/shadow r, }\n"
+      "}\n"));
+
+    // The deny covers the query, or the rule, or only takes away some of the permissions asked for
+    EXPECT_EQ(matches(index, "/etc/shadow", "w"), std::vector<std::string>{"b /etc/shadow"});
+    EXPECT_TRUE(matches(index, "/etc/ssh/**", "").empty());
+    EXPECT_EQ(matches(index, "/etc/shadow", "rw"), (std::vector<std::string>{"a /etc/**", "b /etc/shadow"}));
+    EXPECT_EQ(matches(index, "/etc/**", "w"), (std::vector<std::string>{"a /etc/**", "b /etc/shadow"}));
+
+    // Owner denies only take back what owner rules grant
+    EXPECT_TRUE(matches(index, "/home/user/.ssh/id_rsa", "w").empty());
+    EXPECT_EQ(matches(index, "/srv/secret", "w"), std::vector<std::string>{"a /srv/**"});
+  }
+
+  TEST(PathIndexCheck, update_replaces_one_profile)
+  {
+    AppArmor::PathIndex index(parse_text(policy));
+
+    index.update(parse_text("profile b { /var/** w, }\n").front());
+
+    std::vector<std::string> writers = {"a /etc/ssh/**", "a//child /{etc,var}/child"};
+    EXPECT_EQ(matches(index, "/etc/**", "w"), writers);
+    EXPECT_EQ(matches(index, "/var/log/x", "w"), std::vector<std::string>{"b /var/**"});
+
+    index.remove("a");
+    EXPECT_EQ(index.getProfiles(), std::vector<std::string>{"b"});
+    EXPECT_TRUE(matches(index, "/etc/**", "w").empty());
+  }
+
+  TEST(PathIndexCheck, includes_abstraction_rules)
+  {
+    auto profiles = parse_text("profile a {\n  include <abstractions/base>\n}\n");
+    auto base = parse_text("profile base {\n  /etc/ld.so.cache rw,\n}\n").front();
+
+    AppArmor::PathIndex index(profiles, {{"abstractions/base", base}});
+
+    auto found = index.query("/etc/**", "w");
+    ASSERT_EQ(found.size(), 1);
+    EXPECT_EQ(found.front().abstraction, "abstractions/base");
+  }
+}
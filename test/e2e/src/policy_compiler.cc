@@ -0,0 +1,295 @@
+#include <fstream>
+#include <gtest/gtest.h>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "apparmor_parser.hh"
+#include "apparmor_policy_compiler.hh"
+#include "test_helpers.hh"
+
+namespace PolicyCompilerCheck {
+  using TestHelpers::parse_text;
+
+  uint64_t big_endian(const std::string &data, size_t pos, size_t size)
+  {
+    uint64_t value = 0;
+    for(size_t i = 0; i < size; i++) {
+      value = (value << 8) | static_cast<uint8_t>(data[pos + i]);
+    }
+    return value;
+  }
+
+  // Reads the file DFA of the first profile in a binary policy, and walks it the way the kernel does
+  class KernelTables {
+    public:
+      explicit KernelTables(const std::string &binary)
+      {
+        size_t start = binary.find("\x1B\x5E\x78\x3D");
+        EXPECT_NE(start, std::string::npos);
+        EXPECT_EQ(start % 8, 0);
+
+        size_t size = big_endian(binary, start + 8, 4);
+        size_t pos = start + big_endian(binary, start + 4, 4);
+
+        while(pos < start + size) {
+          uint16_t id = big_endian(binary, pos, 2);
+          uint16_t width = big_endian(binary, pos + 2, 2);
+          size_t count = big_endian(binary, pos + 8, 4);
+          pos += 12;
+
+          auto &table = tables[id];
+          for(size_t i = 0; i < count; i++, pos += width) {
+            table.push_back(big_endian(binary, pos, width));
+          }
+          pos = (pos + 7) & ~size_t(7);
+        }
+      }
+
+      uint32_t accept(const std::string &path)
+      {
+        uint64_t state = 1;
+        for(unsigned char c : path) {
+          uint64_t pos = tables[2][state] + tables[5][c];
+          state = tables[3][pos] == state? tables[8][pos] : tables[4][state];
+        }
+        return tables[1][state];
+      }
+
+    private:
+      std::map<uint16_t, std::vector<uint64_t>> tables;
+  };
+
+  constexpr uint32_t EXEC = 1, WRITE = 2, READ = 4, APPEND = 8, LINK = 16;
+  constexpr uint32_t OTHER = 14;
+
+  // A string literal with the NUL bytes inside of it
+  template<size_t N>
+  std::string bytes(const char (&text)[N])
+  {
+    return std::string(text, N - 1);
+  }
+
+  // The same exec bits for the owner and for other users
+  uint32_t both(uint32_t bits)
+  {
+    return bits | (bits << OTHER);
+  }
+
+  TEST(PolicyCompilerCheck, file_permissions)
+  {
+    auto profiles = parse_text(
+      "profile a {\n"
+      "  /etc/passwd r,\n"
+      "  /usr/bin/* ix,\n"
+      "  deny /usr/bin/su x,\n"
+      "  owner /home/*/x w,\n"
+      "  link /tmp/a -> /tmp/b,\n"
+      "  @{HOME}/y r,\n"
+      "  deny link @{HOME}/l -> /tmp/b,\n"
+      "}\n");
+
+    AppArmor::PolicyCompiler compiler(profiles);
+    ASSERT_EQ(compiler.getSkippedRules().size(), 1);
+    EXPECT_EQ(compiler.getSkippedRules().front().getFilename(), "@{HOME}/y");
+    EXPECT_EQ(compiler.getSkippedRuleText(), std::list<std::string>({"@{HOME}/y r,", "deny link @{HOME}/l -> /tmp/b,"}));
+
+    KernelTables tables(compiler.getBinary());
+    EXPECT_EQ(tables.accept("/etc/passwd"), READ | (READ << OTHER));
+    EXPECT_EQ(tables.accept("/etc/shadow"), 0);
+    EXPECT_EQ(tables.accept("/usr/bin/ls"), both(0x201));
+    EXPECT_EQ(tables.accept("/usr/bin/su"), 0);
+    EXPECT_EQ(tables.accept("/usr/bin/"), 0);
+    EXPECT_EQ(tables.accept("/home/user/x"), WRITE | APPEND);
+    EXPECT_EQ(tables.accept(std::string("/tmp/a\0/tmp/b", 13)), LINK | (LINK << OTHER));
+  }
+
+  // Accept entries with the exec bits of apparmor_parser (immunix.h): 0x100 unsafe, 0x200 inherit,
+  // and the transition type above them, 1 unconfined, 2 profile, 3 local and 4 on the table
+  TEST(PolicyCompilerCheck, exec_transitions)
+  {
+    auto profiles = parse_text(
+      "profile a {\n"
+      "  /bin/ix ix,\n"
+      "  /bin/ux ux,\n"
+      "  /bin/Ux Ux,\n"
+      "  /bin/px px,\n"
+      "  /bin/Px Px,\n"
+      "  /bin/cx cx,\n"
+      "  /bin/Cx Cx,\n"
+      "  /bin/pix pix,\n"
+      "  /bin/Pix Pix,\n"
+      "  /bin/named Px -> other,\n"
+      "  /bin/child cx -> helper,\n"
+      "  /bin/pux pux,\n"
+      "}\n");
+
+    AppArmor::PolicyCompiler compiler(profiles);
+    ASSERT_EQ(compiler.getSkippedRules().size(), 1);
+    EXPECT_EQ(compiler.getSkippedRules().front().getFilename(), "/bin/pux");
+
+    KernelTables tables(compiler.getBinary());
+    EXPECT_EQ(tables.accept("/bin/ix"), both(0x201));
+    EXPECT_EQ(tables.accept("/bin/ux"), both(0x501));
+    EXPECT_EQ(tables.accept("/bin/Ux"), both(0x401));
+    EXPECT_EQ(tables.accept("/bin/px"), both(0x901));
+    EXPECT_EQ(tables.accept("/bin/Px"), both(0x801));
+    EXPECT_EQ(tables.accept("/bin/cx"), both(0xD01));
+    EXPECT_EQ(tables.accept("/bin/Cx"), both(0xC01));
+    EXPECT_EQ(tables.accept("/bin/pix"), both(0xB01));
+    EXPECT_EQ(tables.accept("/bin/Pix"), both(0xA01));
+    EXPECT_EQ(tables.accept("/bin/named"), both(0x1001));
+    EXPECT_EQ(tables.accept("/bin/child"), both(0x1501));
+    EXPECT_EQ(tables.accept("/bin/pux"), 0);
+
+    // Table entries in order of their index, local profiles under the profile's name
+    auto xtable = bytes("\x04\x07\x00xtable\x00\x07\x0b\x02\x00"
+                       "\x05\x06\x00other\x00\x05\x0a\x00" "a//helper\x00\x0c\x08");
+    EXPECT_NE(compiler.getBinary().find(xtable), std::string::npos);
+  }
+
+  TEST(PolicyCompilerCheck, exact_rules_win_exec_conflicts)
+  {
+    auto profiles = parse_text("profile a {\n  /usr/bin/* ix,\n  /usr/bin/foo Px,\n}\n");
+    KernelTables tables(AppArmor::PolicyCompiler(profiles).getBinary());
+    EXPECT_EQ(tables.accept("/usr/bin/ls"), both(0x201));
+    EXPECT_EQ(tables.accept("/usr/bin/foo"), both(0x801));
+
+    auto conflicting = parse_text("profile a {\n  /usr/bin/* ix,\n  /usr/bin/f* Px,\n}\n");
+    EXPECT_THROW(AppArmor::PolicyCompiler{conflicting}, std::runtime_error);
+  }
+
+  TEST(PolicyCompilerCheck, profile_flags)
+  {
+    auto profiles = parse_text("profile a flags=(complain, attach_disconnected, audit) { /etc/a r, }\n");
+    auto binary = AppArmor::PolicyCompiler(profiles).getBinary();
+
+    // hat, mode and audit, then the path flags
+    auto flags = bytes("\x04\x06\x00" "flags\x00\x07"
+                      "\x02\x00\x00\x00\x00" "\x02\x01\x00\x00\x00" "\x02\x01\x00\x00\x00\x08"
+                      "\x04\x0b\x00" "path_flags\x00\x02\x04\x00\x00\x00");
+    EXPECT_NE(binary.find(flags), std::string::npos);
+
+    auto kill = parse_text("profile a flags=(kill) { }\n");
+    auto killFlags = bytes("flags\x00\x07" "\x02\x00\x00\x00\x00" "\x02\x02\x00\x00\x00");
+    EXPECT_NE(AppArmor::PolicyCompiler(kill).getBinary().find(killFlags), std::string::npos);
+
+    auto unknown = parse_text("profile a flags=(prompt) { }\n");
+    EXPECT_THROW(AppArmor::PolicyCompiler{unknown}, std::runtime_error);
+
+    auto both_modes = parse_text("profile a flags=(complain, kill) { }\n");
+    EXPECT_THROW(AppArmor::PolicyCompiler{both_modes}, std::runtime_error);
+  }
+
+  TEST(PolicyCompilerCheck, capabilities)
+  {
+    auto profiles = parse_text(
+      "profile a {\n"
+      "  capability chown dac_override,\n"
+      "  audit capability setuid,\n"
+      "  deny capability sys_admin,\n"
+      "  audit deny capability sys_module,\n"
+      "  capability bpf,\n"
+      "}\n");
+    auto binary = AppArmor::PolicyCompiler(profiles).getBinary();
+
+    // Allowed, audited, quieted and denied, then the same for capabilities above 31
+    auto caps = bytes("\x02\x83\x00\x00\x00" "\x02\x80\x00\x01\x00" "\x02\x00\x00\x20\x00" "\x02\x00\x00\x21\x00"
+                     "\x04\x07\x00" "caps64\x00\x07" "\x02\x80\x00\x00\x00" "\x02\x00\x00\x00\x00"
+                     "\x02\x00\x00\x00\x00" "\x02\x00\x00\x00\x00\x08");
+    EXPECT_NE(binary.find(caps), std::string::npos);
+
+    auto unknown = parse_text("profile a { capability nope, }\n");
+    EXPECT_THROW(AppArmor::PolicyCompiler{unknown}, std::runtime_error);
+  }
+
+  TEST(PolicyCompilerCheck, attachment_dfa)
+  {
+    auto profiles = parse_text("profile a /usr/bin/a* { /etc/a r, }\n");
+    auto binary = AppArmor::PolicyCompiler(profiles).getBinary();
+
+    // The attachment DFA comes first, followed by the length of its literal prefix
+    KernelTables xmatch(binary);
+    EXPECT_EQ(xmatch.accept("/usr/bin/ab"), EXEC);
+    EXPECT_EQ(xmatch.accept("/usr/bin/b"), 0);
+    EXPECT_EQ(xmatch.accept("/etc/a"), 0);
+    EXPECT_NE(binary.find(bytes("\x02\x0a\x00\x00\x00\x04\x06\x00" "flags")), std::string::npos);
+
+    auto variable = parse_text("profile a @{bin}/a { }\n");
+    EXPECT_THROW(AppArmor::PolicyCompiler{variable}, std::runtime_error);
+  }
+
+  // Loading a profile without these rules would change what it allows, so they are refused
+  TEST(PolicyCompilerCheck, refuses_rules_it_can_not_express)
+  {
+    auto network = parse_text("profile a { /etc/a r, network inet tcp, }\n");
+    EXPECT_THROW(AppArmor::PolicyCompiler{network}, std::runtime_error);
+
+    auto nested = parse_text("profile a { audit { deny ptrace read, } }\n");
+    EXPECT_THROW(AppArmor::PolicyCompiler{nested}, std::runtime_error);
+
+    auto xattrs = parse_text("profile a /usr/bin/a xattrs=(user.tag=x) { }\n");
+    EXPECT_THROW(AppArmor::PolicyCompiler{xattrs}, std::runtime_error);
+
+    AppArmor::ParseOptions options;
+    options.keepConditionals = true;
+    auto conditional = parse_text("profile a {\n  if $debug {\n    /tmp/debug w,\n  }\n}\n", options);
+    EXPECT_THROW(AppArmor::PolicyCompiler{conditional}, std::runtime_error);
+    EXPECT_NO_THROW(AppArmor::PolicyCompiler{{conditional.front().evaluate({{"debug", true}})}});
+  }
+
+  // Each DFA starts on an 8 byte boundary of the whole policy, whatever the length of the names before it
+  TEST(PolicyCompilerCheck, tables_aligned_in_whole_policy)
+  {
+    auto profiles = parse_text(
+      "profile abc {\n"
+      "  /etc/a r,\n"
+      "  profile de { /etc/b r, }\n"
+      "  profile fghij { /etc/c r, }\n"
+      "}\n"
+      "profile k { /etc/d r, }\n");
+    auto binary = AppArmor::PolicyCompiler(profiles).getBinary();
+
+    int found = 0;
+    for(size_t pos = binary.find("\x1B\x5E\x78\x3D"); pos != std::string::npos; pos = binary.find("\x1B\x5E\x78\x3D", pos + 1)) {
+      EXPECT_EQ(pos % 8, 0);
+      found++;
+    }
+    EXPECT_EQ(found, 4);
+  }
+
+  TEST(PolicyCompilerCheck, abstractions_and_subprofiles)
+  {
+    auto abstraction = parse_text("profile base { /usr/lib/** mr, }\n").front();
+    auto profiles = parse_text(
+      "profile a {\n"
+      "  include <abstractions/base>\n"
+      "  profile b { /etc/b r, }\n"
+      "}\n");
+
+    AppArmor::PolicyCompiler compiler(profiles, {{"abstractions/base", abstraction}});
+    auto &binary = compiler.getBinary();
+
+    EXPECT_EQ(binary.find(std::string("\x04\x08\x00version\x00", 11)), 0);
+    EXPECT_NE(binary.find(std::string("a//b\0", 5)), std::string::npos);
+
+    KernelTables tables(binary);
+    EXPECT_EQ(tables.accept("/usr/lib/libc.so") & READ, READ);
+    EXPECT_EQ(tables.accept("/etc/b"), 0);
+  }
+
+  TEST(PolicyCompilerCheck, save_to_cache)
+  {
+    auto profiles = parse_text("profile a { /etc/a r, }\n");
+    AppArmor::PolicyCompiler compiler(profiles);
+
+    TestHelpers::TempDir directory;
+    auto filename = directory.path() + "/policy.cache";
+    compiler.save(filename);
+
+    std::ifstream file(filename, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    EXPECT_EQ(contents, compiler.getBinary());
+  }
+}
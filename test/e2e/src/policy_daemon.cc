@@ -0,0 +1,181 @@
+#include <chrono>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+#include "apparmor_policy_client.hh"
+#include "apparmor_policy_daemon.hh"
+#include "test_helpers.hh"
+
+namespace PolicyDaemonCheck {
+  namespace fs = std::filesystem;
+  using TestHelpers::TempDir;
+
+  TEST(PolicyDaemonCheck, answers_queries_from_another_connection)
+  {
+    TempDir root;
+
+    root.write("policy/abstractions/base", "/etc/ld.so.cache r,\n");
+    root.write("policy/usr.bin.foo",
+               "/usr/bin/foo {\n  include <abstractions/base>\n  /var/log/foo w,\n  profile hat {\n    /tmp/** rw,\n  }\n}\n");
+
+    auto socket = root.path() + "/daemon.sock";
+    AppArmor::PolicyDaemon daemon(root.path() + "/policy", socket, std::chrono::milliseconds(20));
+    AppArmor::PolicyClient client(socket);
+
+    std::vector<std::string> expected_profiles{"/usr/bin/foo", "/usr/bin/foo//hat"};
+    EXPECT_EQ(client.getProfiles(), expected_profiles);
+
+    auto rules = client.getFileRules("/usr/bin/foo");
+    ASSERT_EQ(rules.size(), 1);
+    EXPECT_EQ(rules.front().getFilename(), "/var/log/foo");
+    EXPECT_EQ(rules.front().getFilemode(), "w");
+
+    auto matches = client.query("/etc/**", "r");
+    ASSERT_EQ(matches.size(), 1);
+    EXPECT_EQ(matches.front().profile, "/usr/bin/foo");
+    EXPECT_EQ(matches.front().abstraction, "abstractions/base");
+    EXPECT_EQ(matches.front().rule.getFilename(), "/etc/ld.so.cache");
+
+    EXPECT_TRUE(client.query("/etc/**", "w").empty());
+    EXPECT_THROW(client.getFileRules("/usr/bin/missing"), std::runtime_error);
+
+    // Changes to the directory are picked up without restarting the daemon
+    uint64_t generation = client.getGeneration();
+    root.write("policy/abstractions/base", "/etc/ld.so.cache rw,\n");
+
+    for(int i = 0; i < 200 && client.getGeneration() == generation; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GT(client.getGeneration(), generation);
+
+    // A second client sees the same policy
+    AppArmor::PolicyClient other(socket);
+    EXPECT_EQ(other.query("/etc/**", "w").size(), 1);
+
+  }
+
+  TEST(PolicyDaemonCheck, refuses_socket_in_use)
+  {
+    TempDir root;
+    root.write("policy/usr.bin.foo", "/usr/bin/foo {\n  /usr/bin/foo r,\n}\n");
+
+    auto socket = root.path() + "/daemon.sock";
+    EXPECT_THROW(AppArmor::PolicyClient client(socket), std::runtime_error);
+
+    {
+      AppArmor::PolicyDaemon daemon(root.path() + "/policy", socket);
+      EXPECT_THROW(AppArmor::PolicyDaemon second(root.path() + "/policy", socket), std::runtime_error);
+    }
+
+    // The socket is removed once the daemon stops
+    EXPECT_FALSE(fs::exists(socket));
+
+  }
+
+  // Waits for the daemon to publish a snapshot after the given generation
+  void wait_for_generation(AppArmor::PolicyClient &client, uint64_t generation)
+  {
+    for(int i = 0; i < 200 && client.getGeneration() == generation; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    ASSERT_GT(client.getGeneration(), generation);
+  }
+
+  TEST(PolicyDaemonCheck, follows_added_and_removed_files)
+  {
+    TempDir root;
+    root.write("policy/usr.bin.a", "/usr/bin/a {\n  /srv/a w,\n}\n");
+    root.write("policy/usr.bin.b", "/usr/bin/b {\n  /srv/b w,\n  ^hat {\n    /srv/hat w,\n  }\n}\n");
+
+    auto socket = root.path() + "/daemon.sock";
+    AppArmor::PolicyDaemon daemon(root.path() + "/policy", socket, std::chrono::milliseconds(20));
+    AppArmor::PolicyClient client(socket);
+    EXPECT_EQ(client.query("/srv/**", "w").size(), 3);
+
+    uint64_t generation = client.getGeneration();
+    fs::remove(root.path() + "/policy/usr.bin.b");
+    root.write("policy/usr.bin.c", "/usr/bin/c {\n  /srv/c w,\n}\n");
+    wait_for_generation(client, generation);
+
+    // A second change may still be on its way
+    for(int i = 0; i < 200 && client.getProfiles().size() != 2; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    std::vector<std::string> expected_profiles{"/usr/bin/a", "/usr/bin/c"};
+    EXPECT_EQ(client.getProfiles(), expected_profiles);
+
+    std::vector<std::string> writers;
+    for(auto &match : client.query("/srv/**", "w")) {
+      writers.push_back(match.rule.getFilename());
+    }
+    EXPECT_EQ(writers, (std::vector<std::string>{"/srv/a", "/srv/c"}));
+
+  }
+
+  TEST(PolicyDaemonCheck, rules_keep_qualifiers_and_targets)
+  {
+    TempDir root;
+    root.write("policy/usr.bin.foo",
+               "/usr/bin/foo {\n  audit deny /etc/shadow w,\n  owner /home/*/x rw,\n  /usr/bin/bar Px -> bar,\n}\n");
+
+    auto socket = root.path() + "/daemon.sock";
+    AppArmor::PolicyDaemon daemon(root.path() + "/policy", socket);
+    AppArmor::PolicyClient client(socket);
+
+    auto rules = client.getFileRules("/usr/bin/foo");
+    ASSERT_EQ(rules.size(), 3);
+
+    auto rule = rules.begin();
+    EXPECT_EQ(rule->getFilename(), "/etc/shadow");
+    EXPECT_TRUE(rule->isAudit());
+    EXPECT_TRUE(rule->isDeny());
+    EXPECT_FALSE(rule->isOwner());
+
+    rule++;
+    EXPECT_EQ(rule->getFilename(), "/home/*/x");
+    EXPECT_FALSE(rule->isAudit() || rule->isDeny());
+    EXPECT_TRUE(rule->isOwner());
+
+    rule++;
+    EXPECT_EQ(rule->getFilemode(), "Px");
+    EXPECT_EQ(rule->getExecTarget(), "bar");
+
+  }
+
+  // A client that sends half a request does not hold up the others, and the socket is private
+  TEST(PolicyDaemonCheck, stalled_client_and_socket_mode)
+  {
+    TempDir root;
+    root.write("policy/usr.bin.foo", "/usr/bin/foo {\n  /usr/bin/foo r,\n}\n");
+
+    auto socket = root.path() + "/daemon.sock";
+    AppArmor::PolicyDaemon daemon(root.path() + "/policy", socket);
+
+    struct stat info;
+    ASSERT_EQ(stat(socket.c_str(), &info), 0);
+    EXPECT_EQ(info.st_mode & 0777, 0600);
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    socket.copy(address.sun_path, sizeof(address.sun_path) - 1);
+
+    int stalled = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(stalled, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)), 0);
+    ASSERT_EQ(send(stalled, "\x10\x00", 2, 0), 2);
+
+    AppArmor::PolicyClient client(socket);
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(client.getProfiles(), std::vector<std::string>{"/usr/bin/foo"});
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+
+    close(stalled);
+  }
+}
@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "apparmor_policy_diff.hh"
+#include "test_helpers.hh"
+
+namespace PolicyDiffCheck {
+  using Change = AppArmor::PolicyChange;
+
+  AppArmor::Parser parse_text(const std::string &text)
+  {
+    TestHelpers::TempFile file(text);
+    return AppArmor::Parser(file.path());
+  }
+
+  TEST(PolicyDiffCheck, reordered_rules_are_unchanged)
+  {
+    auto old_policy = parse_text(
+      "profile a /usr/bin/a {\n"
+      "  /etc/a r,\n"
+      "  /var/log/a w,\n"
+      "}\n");
+    auto new_policy = parse_text(
+      "# the rules moved around\n"
+      "profile a /usr/bin/a {\n"
+      "  /var/log/a   w,\n"
+      "\n"
+      "  /etc/a r,\n"
+      "}\n");
+
+    AppArmor::PolicyDiff diff(old_policy, new_policy);
+    EXPECT_TRUE(diff.empty());
+  }
+
+  TEST(PolicyDiffCheck, rule_changes)
+  {
+    auto old_policy = parse_text(
+      "profile a /usr/bin/a {\n"
+      "  /etc/a r,\n"
+      "  /var/log/a w,\n"
+      "  /tmp/a rw,\n"
+      "}\n"
+      "profile b /usr/bin/b {\n"
+      "  /etc/b r,\n"
+      "}\n");
+    auto new_policy = parse_text(
+      "profile a /usr/bin/a {\n"
+      "  /etc/a rw,\n"
+      "  /var/log/a w,\n"
+      "  #include <abstractions/base>\n"
+      "}\n"
+      "profile c /usr/bin/c {\n"
+      "  /etc/c r,\n"
+      "}\n");
+
+    auto changes = AppArmor::PolicyDiff(old_policy, new_policy).getChanges();
+    ASSERT_EQ(changes.size(), 6);
+
+    auto change = changes.begin();
+    EXPECT_EQ(change->kind, Change::Kind::MODIFIED);
+    EXPECT_EQ(change->target, Change::Target::PROFILE);
+    EXPECT_EQ(change->profile, "a");
+
+    change++;
+    EXPECT_EQ(change->kind, Change::Kind::MODIFIED);
+    EXPECT_EQ(change->target, Change::Target::FILE_RULE);
+    EXPECT_EQ(change->oldText, "/etc/a r,");
+    EXPECT_EQ(change->newText, "/etc/a rw,");
+
+    change++;
+    EXPECT_EQ(change->kind, Change::Kind::ADDED);
+    EXPECT_EQ(change->target, Change::Target::ABSTRACTION);
+    EXPECT_EQ(change->newText, "include <abstractions/base>");
+
+    change++;
+    EXPECT_EQ(change->kind, Change::Kind::REMOVED);
+    EXPECT_EQ(change->target, Change::Target::FILE_RULE);
+    EXPECT_EQ(change->oldText, "/tmp/a rw,");
+    EXPECT_NE(change->oldStartPos, 0);
+
+    change++;
+    EXPECT_EQ(change->kind, Change::Kind::ADDED);
+    EXPECT_EQ(change->target, Change::Target::PROFILE);
+
+    change++;
+    EXPECT_EQ(change->kind, Change::Kind::REMOVED);
+    EXPECT_EQ(change->target, Change::Target::PROFILE);
+  }
+
+  TEST(PolicyDiffCheck, change_profile_changes)
+  {
+    auto old_policy = parse_text(
+      "profile a {\n"
+      "  change_profile -> b,\n"
+      "  change_profile /usr/bin/c -> c,\n"
+      "  deny change_profile -> d,\n"
+      "}\n");
+    auto new_policy = parse_text(
+      "profile a {\n"
+      "  change_profile /usr/bin/c -> other,\n"
+      "  change_profile -> b,\n"
+      "}\n");
+
+    auto changes = AppArmor::PolicyDiff(old_policy, new_policy).getChanges();
+    ASSERT_EQ(changes.size(), 3);
+
+    auto change = changes.begin();
+    EXPECT_EQ(change->target, Change::Target::PROFILE);
+
+    change++;
+    EXPECT_EQ(change->kind, Change::Kind::MODIFIED);
+    EXPECT_EQ(change->target, Change::Target::CHANGE_PROFILE);
+    EXPECT_EQ(change->oldText, "change_profile /usr/bin/c -> c,");
+    EXPECT_EQ(change->newText, "change_profile /usr/bin/c -> other,");
+
+    change++;
+    EXPECT_EQ(change->kind, Change::Kind::REMOVED);
+    EXPECT_EQ(change->target, Change::Target::CHANGE_PROFILE);
+    EXPECT_EQ(change->oldText, "deny change_profile -> d,");
+  }
+}
@@ -0,0 +1,102 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+
+#include "apparmor_parser.hh"
+#include "apparmor_policy_watcher.hh"
+
+namespace PolicyWatcherCheck {
+  namespace fs = std::filesystem;
+
+  void write_file(const fs::path &path, const std::string &contents)
+  {
+    fs::create_directories(path.parent_path());
+    std::ofstream file(path);
+    file << contents;
+  }
+
+  // Waits for the watcher to publish a snapshot newer than the given generation
+  std::shared_ptr<const AppArmor::PolicySnapshot> wait_for_update(AppArmor::PolicyWatcher &watcher, uint64_t generation)
+  {
+    for(int i = 0; i < 200; i++) {
+      auto snapshot = watcher.snapshot();
+      if(snapshot->getGeneration() > generation) {
+        return snapshot;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    return watcher.snapshot();
+  }
+
+  TEST(PolicyWatcherCheck, reparses_changed_files_and_dependents)
+  {
+    auto directory = fs::temp_directory_path() / "policy_watcher_test";
+    fs::remove_all(directory);
+
+    write_file(directory / "abstractions" / "foo", "/etc/foo r,\n");
+    write_file(directory / "usr.bin.foo", "/usr/bin/foo {\n  include <abstractions/foo>\n  /usr/bin/foo r,\n}\n");
+    write_file(directory / "usr.bin.bar", "/usr/bin/bar {\n  /usr/bin/bar r,\n}\n");
+
+    AppArmor::PolicyWatcher watcher(directory.string(), std::chrono::milliseconds(20));
+
+    auto first = watcher.snapshot();
+    EXPECT_EQ(first->getFiles().size(), 3);
+    EXPECT_TRUE(first->getErrors().empty());
+
+    std::unordered_set<std::string> expected_includes{(directory / "abstractions" / "foo").string()};
+    EXPECT_EQ(first->getIncludes((directory / "usr.bin.foo").string()), expected_includes);
+
+    // Changing the abstraction should only affect it and the profile that includes it
+    write_file(directory / "abstractions" / "foo", "/etc/foo rw,\n");
+    auto second = wait_for_update(watcher, first->getGeneration());
+
+    ASSERT_GT(second->getGeneration(), first->getGeneration());
+
+    std::unordered_set<std::string> expected_affected{
+      (directory / "abstractions" / "foo").string(),
+      (directory / "usr.bin.foo").string(),
+    };
+    EXPECT_EQ(second->getAffectedFiles(), expected_affected);
+
+    auto rules = second->getProfileList((directory / "abstractions" / "foo").string()).front().getFileRules();
+    ASSERT_EQ(rules.size(), 1);
+    EXPECT_EQ(rules.front().getFilemode(), "rw");
+
+    // The earlier snapshot is immutable
+    auto old_rules = first->getProfileList((directory / "abstractions" / "foo").string()).front().getFileRules();
+    EXPECT_EQ(old_rules.front().getFilemode(), "r");
+
+    fs::remove_all(directory);
+  }
+
+  TEST(PolicyWatcherCheck, load_follows_includes_outside_directory)
+  {
+    auto root = fs::temp_directory_path() / "policy_load_test";
+    fs::remove_all(root);
+
+    auto directory = root / "apparmor.d";
+    auto outside = root / "shared" / "base";
+    write_file(outside, "/etc/shared r,\n");
+
+    for(int i = 0; i < 50; i++) {
+      write_file(directory / ("usr.bin.p" + std::to_string(i)),
+                 "/usr/bin/p" + std::to_string(i) + " {\n  include \"" + outside.string() + "\"\n  /etc/p r,\n}\n");
+    }
+    write_file(directory / "broken", "/usr/bin/broken {\n");
+
+    auto snapshot = AppArmor::PolicyWatcher::load(directory.string());
+
+    // The abstraction outside the directory is loaded once, as a single unnamed profile
+    EXPECT_EQ(snapshot->getFiles().size(), 51);
+    EXPECT_EQ(snapshot->getProfileList().size(), 51);
+    EXPECT_EQ(snapshot->getProfileList(outside.string()).size(), 1);
+    EXPECT_EQ(snapshot->getErrors().size(), 1);
+    EXPECT_EQ(snapshot->getErrors().count((directory / "broken").string()), 1);
+
+    fs::remove_all(root);
+  }
+}
@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace ProfileHashCheck {
+  using TestHelpers::parse_text;
+
+  TEST(ProfileHashCheck, layout_does_not_change_hash)
+  {
+    auto first = parse_text(
+      "profile a {\n"
+      "  /etc/a r,\n"
+      "  /var/log/a w,\n"
+      "}\n");
+    auto second = parse_text(
+      "# moved to the end of the file\n"
+      "profile b {}\n"
+      "profile a {\n"
+      "  /var/log/a   w,  # log file\n"
+      "  /etc/a r,\n"
+      "}\n");
+
+    EXPECT_EQ(first.front().hash(), second.back().hash());
+  }
+
+  TEST(ProfileHashCheck, layout_of_other_rules_does_not_change_hash)
+  {
+    auto profiles = parse_text(
+      "profile a flags=(complain, attach_disconnected) {\n"
+      "  capability chown,\n"
+      "  network inet stream,\n"
+      "  signal (send) peer=b,\n"
+      "}\n"
+      "profile a flags=(attach_disconnected complain) {\n"
+      "  signal (send)   peer=b,\n"
+      "  network inet  # a comment\n"
+      "    stream,\n"
+      "  capability chown,\n"
+      "}\n");
+
+    ASSERT_EQ(profiles.size(), 2);
+    EXPECT_EQ(profiles.front().hash(), profiles.back().hash());
+  }
+
+  TEST(ProfileHashCheck, contents_change_hash)
+  {
+    auto profiles = parse_text(
+      "profile a { /etc/a r, }\n"
+      "profile a { /etc/a rw, }\n"
+      "profile a { audit /etc/a r, }\n"
+      "profile b { /etc/a r, }\n"
+      "profile a { /etc/a r, profile hat { /etc/hat r, } }\n"
+      "profile a flags=(complain) { /etc/a r, }\n"
+      "profile a { /etc/a r, capability chown, }\n"
+      "profile a { /etc/a r, capability setuid, }\n"
+      "profile a { /etc/a r, deny capability setuid, }\n"
+      "profile a { /etc/a r, network inet stream, }\n"
+      "profile a { /etc/a r, network inet dgram, }\n"
+      "profile a { /etc/a r, signal (send) peer=b, }\n"
+      "profile a { /etc/a r, ptrace (read) peer=b, }\n"
+      "profile a { /etc/a r, set rlimit nofile <= 1024, }\n"
+      "profile a { /etc/a r, change_profile /usr/bin/b -> b, }\n"
+      "profile a { /etc/a r, change_profile safe /usr/bin/b -> b, }\n"
+      "profile a { /etc/a r, change_profile unsafe /usr/bin/b -> b, }\n");
+
+    std::set<uint64_t> hashes;
+    for(auto &profile : profiles) {
+      hashes.insert(profile.hash());
+    }
+
+    EXPECT_EQ(hashes.size(), profiles.size());
+  }
+
+  TEST(ProfileHashCheck, lazy_matches_eager)
+  {
+    AppArmor::ParseOptions options;
+    options.lazy = true;
+
+    std::string filename = PROFILE_SOURCE_DIR "/file/ok_3.sd";
+    auto eager_list = AppArmor::Parser(filename).getProfileList();
+    auto lazy_list  = AppArmor::Parser(filename, options).getProfileList();
+
+    ASSERT_EQ(lazy_list.size(), eager_list.size());
+
+    auto eager = eager_list.begin();
+    for(auto &lazy : lazy_list) {
+      EXPECT_EQ(lazy.hash(), eager->hash());
+      eager++;
+    }
+  }
+}
@@ -0,0 +1,113 @@
+#include <atomic>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "apparmor_parser.hh"
+#include "apparmor_profile_store.hh"
+#include "test_helpers.hh"
+
+namespace ProfileStoreCheck {
+  using TestHelpers::parse_text;
+
+  const std::string policy =
+    "profile a {\n"
+    "  /etc/a r,\n"
+    "}\n"
+    "profile b {\n"
+    "  /etc/b r,\n"
+    "}\n";
+
+  TEST(ProfileStoreCheck, edits_publish_new_versions)
+  {
+    AppArmor::ProfileStore store(parse_text(policy));
+    auto first = store.snapshot();
+
+    auto second = store.addRule("a", "/var/log/a", "w");
+    EXPECT_EQ(second->getGeneration(), 1);
+    EXPECT_EQ(store.snapshot(), second);
+    EXPECT_EQ(second->getProfile("a").getFileRules().size(), 2);
+
+    // Earlier versions do not change
+    EXPECT_EQ(first->getProfile("a").getFileRules().size(), 1);
+
+    auto third = store.editRule("a", first->getProfile("a").getFileRules().front(), "/etc/a", "rw");
+    auto rules = third->getProfile("a").getFileRules();
+    ASSERT_EQ(rules.size(), 2);
+    EXPECT_EQ(rules.back().getFilename(), "/etc/a");
+    EXPECT_EQ(rules.back().getFilemode(), "rw");
+
+    // Editing a profile back gives the same hash as before
+    auto fourth = store.removeRule("a", rules.front());
+    fourth = store.editRule("a", rules.back(), "/etc/a", "r");
+    EXPECT_EQ(fourth->getProfile("a").hash(), first->getProfile("a").hash());
+
+    // Untouched profiles are shared, not copied
+    EXPECT_EQ(fourth->getProfile("b").hash(), first->getProfile("b").hash());
+
+    EXPECT_THROW(store.addRule("missing", "/etc/x", "r"), std::runtime_error);
+    EXPECT_THROW(store.removeRule("a", rules.front()), std::runtime_error);
+    EXPECT_EQ(store.snapshot(), fourth);
+  }
+
+  // Rules that differ only in their qualifiers or exec target are different rules
+  TEST(ProfileStoreCheck, removes_only_the_matching_rule)
+  {
+    AppArmor::ProfileStore store(parse_text(
+      "profile a {\n"
+      "  /etc/x r,\n"
+      "  deny /etc/x r,\n"
+      "  /usr/bin/x px -> b,\n"
+      "  /usr/bin/x px -> c,\n"
+      "}\n"));
+
+    auto rules = store.snapshot()->getProfile("a").getFileRules();
+    ASSERT_EQ(rules.size(), 4);
+
+    auto version = store.removeRule("a", *std::next(rules.begin(), 1));
+    auto left = version->getProfile("a").getFileRules();
+    ASSERT_EQ(left.size(), 3);
+    EXPECT_FALSE(left.front().isDeny());
+    EXPECT_EQ(left.front().getFilename(), "/etc/x");
+
+    version = store.removeRule("a", *std::next(rules.begin(), 3));
+    left = version->getProfile("a").getFileRules();
+    ASSERT_EQ(left.size(), 2);
+    EXPECT_EQ(left.back().getExecTarget(), "b");
+  }
+
+  TEST(ProfileStoreCheck, readers_see_whole_versions)
+  {
+    AppArmor::ProfileStore store(parse_text(policy));
+
+    std::atomic<bool> done{false};
+    std::atomic<bool> torn{false};
+    std::vector<std::thread> readers;
+
+    for(int i = 0; i < 4; i++) {
+      readers.emplace_back([&]() {
+        while(!done) {
+          // Every edit adds one rule, so each version holds one more rule than its generation
+          auto version = store.snapshot();
+          if(version->getProfile("a").getFileRules().size() != version->getGeneration() + 1) {
+            torn = true;
+          }
+        }
+      });
+    }
+
+    for(int i = 0; i < 200; i++) {
+      store.addRule("a", "/tmp/" + std::to_string(i), "r");
+    }
+
+    done = true;
+    for(auto &reader : readers) {
+      reader.join();
+    }
+
+    EXPECT_FALSE(torn);
+    EXPECT_EQ(store.snapshot()->getProfile("a").getFileRules().size(), 201);
+  }
+}
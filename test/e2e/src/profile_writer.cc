@@ -0,0 +1,174 @@
+#include <fstream>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace ProfileWriterCheck {
+  using TestHelpers::TempFile;
+
+  std::string read_file(const std::string &filename)
+  {
+    std::ifstream file(filename);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+  }
+
+  TEST(ProfileWriterCheck, canonical_round_trip)
+  {
+    TempFile file(
+      "# comments are dropped\n"
+      "alias /usr/ -> /mnt/usr/,\n"
+      "profile a /usr/bin/a {\n"
+      "  /var/log/a   w,\n"
+      "  #include <abstractions/base>\n"
+      "  audit deny /etc/shadow r,\n"
+      "  owner { /home/*/a rw, }\n"
+      "  /etc/a r,\n"
+      "}\n");
+
+    auto original = AppArmor::Parser(file.path());
+    auto canonical = original.format();
+
+    EXPECT_EQ(canonical,
+      "alias /usr/ -> /mnt/usr/,\n"
+      "\n"
+      "profile a /usr/bin/a {\n"
+      "  include <abstractions/base>\n"
+      "  /etc/a r,\n"
+      "  /var/log/a w,\n"
+      "  audit deny /etc/shadow r,\n"
+      "  owner {\n"
+      "    /home/*/a rw,\n"
+      "  }\n"
+      "}\n");
+
+    // Formatting the canonical form again changes nothing, and neither do the profiles
+    file.write(canonical);
+    auto reparsed = AppArmor::Parser(file.path());
+    EXPECT_EQ(reparsed.format(), canonical);
+    EXPECT_EQ(reparsed.getProfileList().front().hash(), original.getProfileList().front().hash());
+  }
+
+  TEST(ProfileWriterCheck, canonical_keeps_every_rule)
+  {
+    TempFile file(
+      "abi <abi/3.0>,\n"
+      "include <tunables/global>\n"
+      "@{DIRS} = /srv/ \"/srv/my files/\"\n"
+      "@{DIRS} += /data/\n"
+      "$debug = false\n"
+      "profile \"my app\" /usr/bin/app flags=(complain,attach_disconnected) {\n"
+      "  capability   dac_override,\n"
+      "  deny network inet  tcp, # no tcp\n"
+      "  audit ptrace read peer=unconfined,\n"
+      "  set rlimit nofile <= 1024,\n"
+      "  \"/srv/a\\\"b\" r,\n"
+      "}\n");
+
+    auto original = AppArmor::Parser(file.path());
+    auto canonical = original.format();
+
+    EXPECT_EQ(canonical,
+      "abi <abi/3.0>,\n"
+      "include <tunables/global>\n"
+      "@{DIRS} = /srv/ \"/srv/my files/\"\n"
+      "@{DIRS} += /data/\n"
+      "$debug = false\n"
+      "\n"
+      "profile \"my app\" /usr/bin/app flags=(attach_disconnected, complain) {\n"
+      "  \"/srv/a\\\"b\" r,\n"
+      "  audit ptrace read peer=unconfined,\n"
+      "  capability dac_override,\n"
+      "  deny network inet tcp,\n"
+      "  set rlimit nofile <= 1024,\n"
+      "}\n");
+
+    file.write(canonical);
+    auto reparsed = AppArmor::Parser(file.path());
+    EXPECT_EQ(reparsed.format(), canonical);
+    EXPECT_EQ(reparsed.getProfileList().front().hash(), original.getProfileList().front().hash());
+  }
+
+  TEST(ProfileWriterCheck, canonical_keeps_xattr_values)
+  {
+    TempFile file("profile a /usr/bin/a xattrs=(user.b user.a=(one two) user.c=three) {\n  /etc/a r,\n}\n");
+
+    auto original = AppArmor::Parser(file.path());
+    auto canonical = original.format();
+    EXPECT_EQ(canonical, "profile a /usr/bin/a xattrs=(user.a=(one two) user.b user.c=three) {\n  /etc/a r,\n}\n");
+
+    // Values are part of the hash, so a lost list would show up here too
+    file.write(canonical);
+    auto reparsed = AppArmor::Parser(file.path());
+    EXPECT_EQ(reparsed.format(), canonical);
+    EXPECT_EQ(reparsed.getProfileList().front().hash(), original.getProfileList().front().hash());
+
+    file.write("profile a /usr/bin/a xattrs=(user.a=(one) user.b user.c=three) {\n  /etc/a r,\n}\n");
+    EXPECT_NE(AppArmor::Parser(file.path()).getProfileList().front().hash(), original.getProfileList().front().hash());
+  }
+
+  TEST(ProfileWriterCheck, canonical_keeps_change_profile_exec_mode)
+  {
+    TempFile file("profile a {\n  change_profile unsafe /usr/bin/b -> b,\n  change_profile safe -> c,\n}\n");
+
+    auto original = AppArmor::Parser(file.path());
+    auto canonical = original.format();
+    EXPECT_EQ(canonical, "profile a {\n  change_profile safe c,\n  change_profile unsafe /usr/bin/b -> b,\n}\n");
+
+    file.write(canonical);
+    auto reparsed = AppArmor::Parser(file.path());
+    EXPECT_EQ(reparsed.format(), canonical);
+    EXPECT_EQ(reparsed.getProfileList().front().hash(), original.getProfileList().front().hash());
+  }
+
+  TEST(ProfileWriterCheck, canonical_uses_the_parsed_tree)
+  {
+    TempFile file("profile a {\n  /etc/a r,\n}\n");
+    AppArmor::Parser parser(file.path());
+
+    // The file is not read again
+    file.write("profile b {\n  /etc/b r,\n}\n");
+    EXPECT_EQ(parser.format(), "profile a {\n  /etc/a r,\n}\n");
+  }
+
+  TEST(ProfileWriterCheck, canonical_refuses_partial_trees)
+  {
+    TempFile file("profile a {\n  /etc/a r,\n  capability chown,\n}\n");
+
+    AppArmor::ParseOptions lazy;
+    lazy.lazy = true;
+    EXPECT_THROW(AppArmor::Parser(file.path(), lazy).format(), std::logic_error);
+
+    AppArmor::ParseOptions files;
+    files.kinds = AppArmor::ParseOptions::FILE;
+    EXPECT_THROW(AppArmor::Parser(file.path(), files).format(), std::logic_error);
+  }
+
+  TEST(ProfileWriterCheck, edits_preserve_formatting)
+  {
+    TempFile file(
+      "# keep this comment\n"
+      "profile a {\n"
+      "\t/etc/a r,   # and this one\n"
+      "  /etc/b r,\n"
+      "}\n");
+
+    AppArmor::Parser parser(file.path());
+    auto profile = parser.getProfileList().front();
+    std::string mode = "rw";
+    parser.addRule(profile, "/etc/c", mode);
+
+    EXPECT_EQ(read_file(file.path()),
+      "# keep this comment\n"
+      "profile a {\n"
+      "\t/etc/a r,   # and this one\n"
+      "  /etc/b r,\n"
+      "  /etc/c rw,\n"
+      "}\n");
+  }
+}
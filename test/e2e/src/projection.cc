@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace ProjectionCheck {
+  const std::string policy =
+    "profile base {\n"
+    "  /etc/base r,\n"
+    "}\n"
+    "profile a {\n"
+    "  #include <abstractions/base>\n"
+    "  /etc/a r,\n"
+    "  link /etc/a.link -> /etc/a,\n"
+    "  change_profile -> b,\n"
+    "  audit {\n"
+    "    /var/log/a w,\n"
+    "  }\n"
+    "  profile child { /etc/child r, }\n"
+    "}\n"
+    "profile b { /etc/b r, }\n";
+
+  using TestHelpers::parse_text;
+
+  std::set<std::string> filenames(const AppArmor::Profile &profile)
+  {
+    std::set<std::string> out;
+    for(auto &rule : profile.getFileRules()) {
+      out.insert(rule.getFilename());
+    }
+    return out;
+  }
+
+  TEST(ProjectionCheck, only_requested_kinds_are_built)
+  {
+    AppArmor::ParseOptions options;
+    options.kinds = AppArmor::ParseOptions::FILE;
+
+    auto full = *std::next(parse_text(policy).begin());
+    auto files = *std::next(parse_text(policy, options).begin());
+
+    // File rules in blocks are kept, with the same positions
+    EXPECT_EQ(filenames(files), filenames(full));
+    EXPECT_EQ(files.getFileRules().front().getStartPosition(), full.getFileRules().front().getStartPosition());
+
+    EXPECT_TRUE(files.getAbstractions().empty());
+    auto usage = files.memoryUsage();
+    EXPECT_EQ(usage.links, 0);
+    EXPECT_EQ(usage.subprofiles, 0);
+    EXPECT_LT(usage.total(), full.memoryUsage().total());
+  }
+
+  TEST(ProjectionCheck, includes_without_files)
+  {
+    AppArmor::ParseOptions options;
+    options.kinds = AppArmor::ParseOptions::INCLUDE;
+
+    auto profile = *std::next(parse_text(policy, options).begin());
+    EXPECT_EQ(profile.getAbstractions(), std::unordered_set<std::string>{"abstractions/base"});
+    EXPECT_TRUE(profile.getFileRules().empty());
+  }
+
+  TEST(ProjectionCheck, lazy_and_parallel_parses_project_too)
+  {
+    AppArmor::ParseOptions options;
+    options.kinds = AppArmor::ParseOptions::FILE | AppArmor::ParseOptions::INCLUDE;
+    auto serial = parse_text(policy, options);
+
+    AppArmor::ParseOptions lazy = options;
+    lazy.lazy = true;
+    AppArmor::ParseOptions parallel = options;
+    parallel.threads = 2;
+
+    for(auto &other : {parse_text(policy, lazy), parse_text(policy, parallel)}) {
+      ASSERT_EQ(other.size(), serial.size());
+      auto expected = serial.begin();
+      for(auto &profile : other) {
+        EXPECT_EQ(filenames(profile), filenames(*expected));
+        EXPECT_EQ(profile.getAbstractions(), expected->getAbstractions());
+        EXPECT_EQ(profile.memoryUsage().subprofiles, 0);
+        expected++;
+      }
+    }
+  }
+
+  // Counts the heap allocations of a parse, which is what leaving rule kinds out saves
+  uint64_t parseAllocations(const std::string &text, uint32_t kinds)
+  {
+    AppArmor::ParseOptions options;
+    options.kinds = kinds;
+
+    auto before = TestHelpers::allocations().allocations;
+    parse_text(text, options);
+    return TestHelpers::allocations().allocations - before;
+  }
+
+  TEST(ProjectionCheck, leaving_kinds_out_saves_allocations)
+  {
+    std::string text = "profile busy {\n";
+    for(int i = 0; i < 200; i++) {
+      auto n = std::to_string(i);
+      text += "  /srv/file" + n + " r,\n";
+      text += "  link /srv/link" + n + " -> /srv/file" + n + ",\n";
+      text += "  capability net_admin,\n";
+      text += "  network inet stream,\n";
+    }
+    text += "}\n";
+
+    auto all = parseAllocations(text, AppArmor::ParseOptions::ALL);
+    auto files = parseAllocations(text, AppArmor::ParseOptions::FILE);
+    auto filesAndGeneric = parseAllocations(text, AppArmor::ParseOptions::FILE | AppArmor::ParseOptions::GENERIC);
+
+    RecordProperty("all_allocations", std::to_string(all));
+    RecordProperty("file_allocations", std::to_string(files));
+    EXPECT_LT(files, all);
+
+    // Generic rules are built from text the lexer copies, so keeping them costs the most
+    EXPECT_LT(files, filesAndGeneric);
+    EXPECT_LT(filesAndGeneric, all);
+  }
+}
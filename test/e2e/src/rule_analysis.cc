@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "apparmor_rule_analysis.hh"
+#include "test_helpers.hh"
+
+namespace RuleAnalysisCheck {
+  using Finding = AppArmor::RuleFinding;
+
+  AppArmor::Profile parse_profile(const std::string &text)
+  {
+    return TestHelpers::parse_text(text).front();
+  }
+
+  TEST(RuleAnalysisCheck, redundant_and_shadowed)
+  {
+    auto profile = parse_profile(
+      "profile a {\n"
+      "  /usr/lib/** r,\n"
+      "  /usr/lib/foo r,\n"
+      "  /usr/lib/bar rw,\n"
+      "  /usr/{bin,sbin}/a rix,\n"
+      "  /usr/sbin/a ix,\n"
+      "  owner /home/*/a r,\n"
+      "  /home/user/a r,\n"
+      "  deny /etc/shadow w,\n"
+      "  /etc/shadow w,\n"
+      "}\n");
+
+    auto findings = AppArmor::RuleAnalysis(profile).getFindings();
+    ASSERT_EQ(findings.size(), 3);
+
+    auto finding = findings.begin();
+    EXPECT_EQ(finding->kind, Finding::Kind::REDUNDANT);
+    EXPECT_EQ(finding->rule.getFilename(), "/usr/lib/foo");
+    EXPECT_EQ(finding->coveredBy.getFilename(), "/usr/lib/**");
+
+    finding++;
+    EXPECT_EQ(finding->kind, Finding::Kind::REDUNDANT);
+    EXPECT_EQ(finding->rule.getFilename(), "/usr/sbin/a");
+
+    finding++;
+    EXPECT_EQ(finding->kind, Finding::Kind::SHADOWED);
+    EXPECT_EQ(finding->rule.getFilename(), "/etc/shadow");
+    EXPECT_EQ(finding->coveredBy.getFilemode(), "w");
+  }
+
+  TEST(RuleAnalysisCheck, directory_is_not_covered_by_its_contents)
+  {
+    auto profile = parse_profile(
+      "profile a {\n"
+      "  /usr/lib/** r,\n"
+      "  /usr/lib/ r,\n"
+      "  /srv/* r,\n"
+      "  /srv/ r,\n"
+      "  /usr/lib/*/ r,\n"
+      "}\n");
+
+    auto findings = AppArmor::RuleAnalysis(profile).getFindings();
+    ASSERT_EQ(findings.size(), 1);
+    EXPECT_EQ(findings.front().rule.getFilename(), "/usr/lib/*/");
+  }
+
+  TEST(RuleAnalysisCheck, covered_by_abstraction)
+  {
+    auto profile = parse_profile(
+      "profile a {\n"
+      "  #include <abstractions/base>\n"
+      "  /etc/ld.so.cache r,\n"
+      "}\n");
+    auto base = parse_profile(
+      "profile base {\n"
+      "  /etc/ld.so.* r,\n"
+      "}\n");
+
+    auto findings = AppArmor::RuleAnalysis(profile, {{"abstractions/base", base}}).getFindings();
+    ASSERT_EQ(findings.size(), 1);
+    EXPECT_EQ(findings.front().rule.getFilename(), "/etc/ld.so.cache");
+    EXPECT_EQ(findings.front().abstraction, "abstractions/base");
+  }
+
+  TEST(RuleAnalysisCheck, many_rules)
+  {
+    std::string text = "profile a {\n  /srv/** r,\n";
+    for(int i = 0; i < 5000; i++) {
+      text += "  /srv/data/" + std::to_string(i) + " r,\n";
+      text += "  /opt/data/" + std::to_string(i) + " r,\n";
+    }
+    text += "}\n";
+
+    auto findings = AppArmor::RuleAnalysis(parse_profile(text)).getFindings();
+    EXPECT_EQ(findings.size(), 5000);
+  }
+}
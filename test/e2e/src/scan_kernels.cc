@@ -0,0 +1,92 @@
+#include <chrono>
+#include <gtest/gtest.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace ScanKernelCheck {
+  using TestHelpers::TempFile;
+
+  // The lazy pre-scan has to find the same profiles as the full parse, with the same rules
+  void check_lazy_matches_eager(const std::string &filename)
+  {
+    AppArmor::ParseOptions options;
+    options.lazy = true;
+
+    auto eager_list = AppArmor::Parser(filename).getProfileList();
+    auto lazy_list  = AppArmor::Parser(filename, options).getProfileList();
+    ASSERT_EQ(lazy_list.size(), eager_list.size());
+
+    auto eager = eager_list.begin();
+    for(auto lazy = lazy_list.begin(); lazy != lazy_list.end(); lazy++, eager++) {
+      EXPECT_EQ(lazy->name(), eager->name());
+      EXPECT_EQ(lazy->hash(), eager->hash()) << lazy->name();
+    }
+  }
+
+  // Runs of every length around the 16 and 32 byte vector widths, stopped by each kind of character
+  TEST(ScanKernelCheck, runs_around_vector_widths)
+  {
+    std::ostringstream text;
+    for(size_t length = 0; length < 80; length++) {
+      std::string run(length, 'a');
+      std::string blanks(length, length % 2? ' ' : '\t');
+
+      text << "profile p" << run << " /usr/" << run << "{bin,sbin}/x {\n"
+           << blanks << "/srv/" << run << " r,\n"
+           << blanks << "\"/srv/" << run << " b\" r,\n"
+           << blanks << "/srv/" << run << "/{c,d}/** rw," << blanks << " # " << run << " { \n"
+           << blanks << "signal (send) peer=/usr/" << run << ",\r\n"
+           << blanks << "audit network inet," << blanks << "\n"
+           << "  ^hat" << run << " {\n    /etc/\xc3\xa9" << run << " r,\n  }\n"
+           << "}\n";
+    }
+
+    TempFile file(text.str());
+    check_lazy_matches_eager(file.path());
+  }
+
+  // Reports throughput in MB/s of the Flex lexer and of the lazy pre-scan, which is the only part
+  // that runs through the vector kernels. Nothing is asserted about the numbers.
+  TEST(ScanKernelCheck, throughput)
+  {
+    std::ostringstream text;
+    for(int profile = 0; profile < 2000; profile++) {
+      text << "# profile number " << profile << ", generated for the throughput test\n"
+           << "profile app" << profile << " /usr/lib/app" << profile << "/bin/app {\n"
+           << "  #include <abstractions/base>\n";
+      for(int rule = 0; rule < 20; rule++) {
+        text << "  /usr/share/app" << profile << "/data/resources/file" << rule << ".dat r,\n"
+             << "  owner /home/*/.config/app" << profile << "/settings" << rule << " rw,  # settings\n";
+      }
+      text << "}\n\n";
+    }
+
+    TempFile file(text.str());
+
+    AppArmor::ParseOptions eager;
+    eager.stats = true;
+    AppArmor::Parser parsed(file.path(), eager);
+    auto &parseStats = parsed.getStats();
+
+    AppArmor::ParseOptions lazy = eager;
+    lazy.lazy = true;
+    AppArmor::Parser scanned(file.path(), lazy);
+    auto &scanStats = scanned.getStats();
+    ASSERT_EQ(scanned.getProfileList().size(), parsed.getProfileList().size());
+
+    auto megabytesPerSecond = [](uint64_t bytes, std::chrono::nanoseconds time) {
+      return time.count() > 0? int64_t(bytes * 1000 / time.count()) : 0;
+    };
+
+    auto lexing = megabytesPerSecond(parseStats.bytesRead, parseStats.lexTime);
+    auto prescan = megabytesPerSecond(scanStats.bytesRead, scanStats.conversionTime);
+    RecordProperty("lexing_mb_per_s", lexing);
+    RecordProperty("prescan_mb_per_s", prescan);
+    std::cout << "lexing: " << lexing << " MB/s, pre-scan: " << prescan << " MB/s over "
+              << parseStats.bytesRead << " bytes\n";
+  }
+}
@@ -0,0 +1,175 @@
+#include <cstdio>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "apparmor_parser.hh"
+#include "apparmor_shared_policy.hh"
+#include "test_helpers.hh"
+
+namespace SharedPolicyCheck {
+  const std::string policy =
+    "profile a /usr/bin/a xattrs=(user.tag=(x y) user.seen) {\n"
+    "  #include <abstractions/base>\n"
+    "  /etc/a r,\n"
+    "  deny /etc/shadow w,\n"
+    "  link /etc/a.link -> /etc/a,\n"
+    "  change_profile safe /usr/bin/c -> c,\n"
+    "  audit {\n"
+    "    /var/log/a w,\n"
+    "  }\n"
+    "  if $unknown {\n"
+    "    /etc/unknown r,\n"
+    "  }\n"
+    "  profile child { /etc/child r, }\n"
+    "}\n"
+    "profile b { /etc/b r, }\n";
+
+  const std::string name = "/apparmor-shared-policy-test";
+
+  using TestHelpers::parse_text;
+
+  void check_same_profiles(const std::list<AppArmor::Profile> &mapped, const std::list<AppArmor::Profile> &parsed)
+  {
+    ASSERT_EQ(mapped.size(), parsed.size());
+
+    auto expected = parsed.begin();
+    for(auto &profile : mapped) {
+      EXPECT_EQ(profile.name(), expected->name());
+      EXPECT_EQ(profile.hash(), expected->hash());
+      EXPECT_EQ(profile.getAbstractions(), expected->getAbstractions());
+      EXPECT_EQ(profile.getFileRules(), expected->getFileRules());
+      EXPECT_EQ(profile.memoryUsage().total(), expected->memoryUsage().total());
+      EXPECT_EQ(profile.evaluate({{"unknown", true}}).hash(), expected->evaluate({{"unknown", true}}).hash());
+      expected++;
+    }
+  }
+
+  TEST(SharedPolicyCheck, named_segment_round_trip)
+  {
+    auto parsed = parse_text(policy);
+    AppArmor::SharedPolicy::publish(name, parsed);
+
+    check_same_profiles(AppArmor::SharedPolicy(name).getProfileList(), parsed);
+
+    // Another process attaches to the same segment
+    pid_t child = fork();
+    if(child == 0) {
+      auto profiles = AppArmor::SharedPolicy(name).getProfileList();
+      _exit(profiles.size() == 2 && profiles.back().hash() == parsed.back().hash()? 0 : 1);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    AppArmor::SharedPolicy::unpublish(name);
+  }
+
+  TEST(SharedPolicyCheck, mapped_images_survive_republishing)
+  {
+    auto parsed = parse_text(policy);
+    AppArmor::SharedPolicy::publish(name, parsed);
+    auto first = AppArmor::SharedPolicy(name).getProfileList();
+
+    AppArmor::SharedPolicy::publish(name, {parsed.back()});
+    EXPECT_EQ(AppArmor::SharedPolicy(name).getProfileList().size(), 1);
+
+    // Profiles keep their image mapped after the name is gone
+    AppArmor::SharedPolicy::unpublish(name);
+    check_same_profiles(first, parsed);
+
+    EXPECT_THROW(AppArmor::SharedPolicy{name}, std::runtime_error);
+  }
+
+  TEST(SharedPolicyCheck, sealed_memfd)
+  {
+    auto parsed = parse_text(policy);
+
+    int fd = AppArmor::SharedPolicy::publishSealed(parsed);
+    AppArmor::SharedPolicy shared(fd);
+    EXPECT_LT(write(fd, "x", 1), 0);
+    close(fd);
+
+    check_same_profiles(shared.getProfileList(), parsed);
+  }
+
+  TEST(SharedPolicyCheck, rejects_writable_segments)
+  {
+    AppArmor::SharedPolicy::publish(name, parse_text(policy));
+
+    // Root owns segments that every user trusts, anyone else only their own
+    if(geteuid() != 0) {
+      EXPECT_THROW(AppArmor::SharedPolicy(name, geteuid() + 1), std::runtime_error);
+    }
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(fchmod(fd, 0666), 0);
+    close(fd);
+    EXPECT_THROW(AppArmor::SharedPolicy{name}, std::runtime_error);
+
+    AppArmor::SharedPolicy::unpublish(name);
+  }
+
+  // Decoding recurses once per nested block, so an image may only nest so deep
+  TEST(SharedPolicyCheck, rejects_deep_nesting)
+  {
+    std::string text = "profile deep {\n";
+    for(int i = 0; i < 100; i++) {
+      text += "audit {\n";
+    }
+    text += "/etc/deep r,\n";
+    for(int i = 0; i < 100; i++) {
+      text += "}\n";
+    }
+    text += "}\n";
+
+    int fd = AppArmor::SharedPolicy::publishSealed(parse_text(text));
+    AppArmor::SharedPolicy shared(fd);
+    close(fd);
+
+    auto profiles = shared.getProfileList();
+    ASSERT_EQ(profiles.size(), 1);
+    EXPECT_EQ(profiles.front().name(), "deep");
+    EXPECT_THROW(profiles.front().getFileRules(), std::runtime_error);
+  }
+
+  TEST(SharedPolicyCheck, rejects_other_files)
+  {
+    TestHelpers::TempFile garbage("AAPOLICY but not really a policy image");
+
+    FILE *file = std::fopen(garbage.path().c_str(), "r");
+    ASSERT_NE(file, nullptr);
+    EXPECT_THROW(AppArmor::SharedPolicy{fileno(file)}, std::runtime_error);
+    std::fclose(file);
+  }
+
+  // A sender that keeps the memfd writable could change the image after it was checked
+  TEST(SharedPolicyCheck, rejects_unsealed_memfds)
+  {
+    int sealed = AppArmor::SharedPolicy::publishSealed(parse_text(policy));
+    off_t size = lseek(sealed, 0, SEEK_END);
+    std::string image(size, '\0');
+    ASSERT_EQ(pread(sealed, &image[0], size, 0), size);
+    close(sealed);
+
+    int fd = memfd_create("unsealed-policy", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, image.data(), image.size()), size);
+    EXPECT_THROW(AppArmor::SharedPolicy{fd}, std::runtime_error);
+
+    // Sealing only against writes still lets the sender shrink it
+    ASSERT_EQ(fcntl(fd, F_ADD_SEALS, F_SEAL_WRITE), 0);
+    EXPECT_THROW(AppArmor::SharedPolicy{fd}, std::runtime_error);
+
+    ASSERT_EQ(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW), 0);
+    EXPECT_EQ(AppArmor::SharedPolicy(fd).getProfileList().size(), 2);
+    close(fd);
+  }
+}
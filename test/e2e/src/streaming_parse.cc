@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace StreamingParseCheck {
+  const std::string policy =
+    "$secure = true\n"
+    "alias /usr/ -> /mnt/usr/,\n"
+    "profile a {\n"
+    "  /usr/bin/a rix,\n"
+    "  if $secure {\n"
+    "    /etc/secure r,\n"
+    "  } else {\n"
+    "    /etc/open r,\n"
+    "  }\n"
+    "  profile child { /etc/child r, }\n"
+    "}\n"
+    "profile b { /etc/b r, }\n";
+
+  std::set<std::string> filenames(const AppArmor::Profile &profile)
+  {
+    std::set<std::string> out;
+    for(auto &rule : profile.getFileRules()) {
+      out.insert(rule.getFilename());
+    }
+    return out;
+  }
+
+  std::vector<AppArmor::Profile> stream_text(const std::string &text, const AppArmor::ParseOptions &options = {})
+  {
+    TestHelpers::TempFile file(text);
+
+    std::vector<AppArmor::Profile> profiles;
+    AppArmor::Parser::stream(file.path(), options, [&](AppArmor::Profile profile) {
+      profiles.push_back(profile);
+    });
+
+    return profiles;
+  }
+
+  TEST(StreamingParseCheck, profiles_match_tree)
+  {
+    AppArmor::ParseOptions options;
+    options.applyAliases = true;
+
+    auto streamed = stream_text(policy, options);
+
+    auto parsed = TestHelpers::parse_text(policy, options);
+
+    ASSERT_EQ(streamed.size(), parsed.size());
+    auto expected = parsed.begin();
+    for(auto &profile : streamed) {
+      EXPECT_EQ(profile.name(), expected->name());
+      EXPECT_EQ(filenames(profile), filenames(*expected));
+      EXPECT_EQ(profile.hash(), expected->hash());
+      expected++;
+    }
+
+    // The preamble applies to every profile
+    std::set<std::string> first = {"/usr/bin/a", "/mnt/usr/bin/a", "/etc/secure"};
+    EXPECT_EQ(filenames(streamed.front()), first);
+  }
+
+  TEST(StreamingParseCheck, options_apply)
+  {
+    AppArmor::ParseOptions options;
+    options.booleans["secure"] = false;
+    options.kinds = AppArmor::ParseOptions::FILE;
+
+    auto streamed = stream_text(policy, options);
+    ASSERT_EQ(streamed.size(), 2);
+
+    // Aliases are only applied when asked for
+    std::set<std::string> first = {"/usr/bin/a", "/etc/open"};
+    EXPECT_EQ(filenames(streamed.front()), first);
+    EXPECT_EQ(streamed.front().memoryUsage().subprofiles, 0);
+  }
+
+  TEST(StreamingParseCheck, profiles_before_error_are_handed_out)
+  {
+    std::vector<std::string> names;
+    TestHelpers::TempFile file("profile a { /etc/a r, }\nprofile b { /etc/b }\n");
+
+    EXPECT_THROW(AppArmor::Parser::stream(file.path(), {}, [&](AppArmor::Profile profile) {
+      names.push_back(profile.name());
+    }), std::runtime_error);
+
+    EXPECT_EQ(names, std::vector<std::string>{"a"});
+    EXPECT_THROW(AppArmor::Parser::stream("does_not_exist.sd", {}, [](AppArmor::Profile) {}), std::runtime_error);
+  }
+
+  // Counts the most memory the thread held at once while the file was streamed
+  int64_t peak_bytes(const std::string &path, std::vector<AppArmor::Profile> *keep)
+  {
+    auto base = TestHelpers::liveBytes();
+    int64_t peak = 0;
+
+    AppArmor::Parser::stream(path, {}, [&](AppArmor::Profile profile) {
+      peak = std::max(peak, TestHelpers::liveBytes() - base);
+      if(keep != nullptr) {
+        keep->push_back(profile);
+      }
+    });
+
+    return peak;
+  }
+
+  TEST(StreamingParseCheck, earlier_profiles_are_released)
+  {
+    std::string text;
+    for(int i = 0; i < 400; i++) {
+      auto n = std::to_string(i);
+      text += "profile p" + n + " {\n";
+      for(int j = 0; j < 20; j++) {
+        text += "  /srv/p" + n + "/file" + std::to_string(j) + " r,\n";
+      }
+      text += "}\n";
+    }
+    TestHelpers::TempFile file(text);
+
+    std::vector<AppArmor::Profile> kept;
+    auto keeping = peak_bytes(file.path(), &kept);
+    ASSERT_EQ(kept.size(), 400);
+    kept.clear();
+
+    // Once the callback lets go of a profile, nothing else holds it, so memory stays
+    // at about one profile however many have been streamed
+    auto dropping = peak_bytes(file.path(), nullptr);
+    RecordProperty("keeping_bytes", std::to_string(keeping));
+    RecordProperty("dropping_bytes", std::to_string(dropping));
+    EXPECT_LT(dropping * 10, keeping);
+  }
+}
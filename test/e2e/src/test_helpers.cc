@@ -0,0 +1,67 @@
+#include "test_helpers.hh"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+namespace TestHelpers {
+  namespace fs = std::filesystem;
+
+  TempDir::TempDir()
+  {
+    auto pattern = (fs::temp_directory_path() / "apparmor_test_XXXXXX").string();
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back('\0');
+
+    if(mkdtemp(buffer.data()) == nullptr) {
+      throw std::runtime_error("Could not create temporary directory: " + std::string(strerror(errno)));
+    }
+
+    directory = buffer.data();
+  }
+
+  TempDir::~TempDir()
+  {
+    std::error_code error;
+    fs::remove_all(directory, error);
+  }
+
+  const std::string &TempDir::path() const
+  {
+    return directory;
+  }
+
+  std::string TempDir::write(const std::string &name, const std::string &contents) const
+  {
+    auto file = fs::path(directory) / name;
+    fs::create_directories(file.parent_path());
+    std::ofstream(file, std::ios::binary | std::ios::trunc) << contents;
+    return file.string();
+  }
+
+  TempFile::TempFile(const std::string &contents, const std::string &name)
+    : filename{(fs::path(directory.path()) / name).string()}
+  {
+    write(contents);
+  }
+
+  const std::string &TempFile::path() const
+  {
+    return filename;
+  }
+
+  void TempFile::write(const std::string &contents) const
+  {
+    std::ofstream(filename, std::ios::binary | std::ios::trunc) << contents;
+  }
+
+  std::list<AppArmor::Profile> parse_text(const std::string &text, const AppArmor::ParseOptions &options)
+  {
+    TempFile file(text);
+    return AppArmor::Parser(file.path(), options).getProfileList();
+  }
+} // namespace TestHelpers
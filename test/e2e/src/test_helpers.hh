@@ -0,0 +1,55 @@
+#ifndef TEST_HELPERS_HH
+#define TEST_HELPERS_HH
+
+#include <cstdint>
+#include <list>
+#include <string>
+
+#include "apparmor_parse_stats.hh"
+#include "apparmor_parser.hh"
+
+namespace TestHelpers {
+  // A private directory under the system temporary directory, removed with everything in it on destruction
+  class TempDir {
+  public:
+    TempDir();
+    ~TempDir();
+
+    TempDir(const TempDir &) = delete;
+    TempDir &operator=(const TempDir &) = delete;
+
+    const std::string &path() const;
+
+    // Writes a file below the directory (creating parent directories) and returns its path
+    std::string write(const std::string &name, const std::string &contents) const;
+
+  private:
+    std::string directory;
+  };
+
+  // A single file with the given contents inside its own TempDir
+  class TempFile {
+  public:
+    explicit TempFile(const std::string &contents = "", const std::string &name = "policy.sd");
+
+    const std::string &path() const;
+    void write(const std::string &contents) const;
+
+  private:
+    TempDir directory;
+    std::string filename;
+  };
+
+  // Parses the text as if it were a profile file, without leaving anything behind
+  std::list<AppArmor::Profile> parse_text(const std::string &text, const AppArmor::ParseOptions &options = {});
+
+  // Heap allocations made by the calling thread so far. The test program replaces the global
+  // operator new to count them, see alloc_counter.cc.
+  AppArmor::AllocationCount allocations();
+
+  // Bytes allocated by the calling thread and not freed yet. Only the difference between two
+  // calls means anything, as blocks may be freed by another thread than the one that made them.
+  int64_t liveBytes();
+} // namespace TestHelpers
+
+#endif // TEST_HELPERS_HH
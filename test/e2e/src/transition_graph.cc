@@ -0,0 +1,99 @@
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "apparmor_parser.hh"
+#include "apparmor_transition_graph.hh"
+#include "test_helpers.hh"
+
+namespace TransitionGraphCheck {
+  using Names = std::vector<std::string>;
+
+  using TestHelpers::parse_text;
+
+  const std::string POLICY =
+    "profile a {\n"
+    "  /usr/bin/b Px,\n"
+    "  /bin/sh Cx,\n"
+    "  profile sh /bin/sh {\n"
+    "    /usr/bin/curl px -> curl,\n"
+    "  }\n"
+    "  ^h {\n"
+    "    change_profile -> c,\n"
+    "  }\n"
+    "}\n"
+    "profile b /usr/bin/b {\n"
+    "  /bin/** ux,\n"
+    "}\n"
+    "profile c {\n"
+    "  /bin/x ix,\n"
+    "}\n"
+    "profile d {\n"
+    "  /bin/y pux,\n"
+    "  deny /bin/z ux,\n"
+    "}\n";
+
+  TEST(TransitionGraphCheck, transitions)
+  {
+    AppArmor::TransitionGraph graph(parse_text(POLICY));
+
+    std::vector<std::tuple<AppArmor::Transition::Kind, std::string, std::string>> transitions;
+    for(auto &transition : graph.getTransitions()) {
+      transitions.emplace_back(transition.kind, transition.from, transition.to);
+    }
+
+    using Kind = AppArmor::Transition::Kind;
+    EXPECT_EQ(transitions, (std::vector<std::tuple<Kind, std::string, std::string>>{
+      {Kind::HAT, "a", "a//h"},
+      {Kind::EXEC, "a", "b"},
+      {Kind::EXEC, "a", "a//sh"},
+      {Kind::EXEC, "b", "unconfined"},
+      {Kind::EXEC, "d", "unconfined"},
+      {Kind::EXEC, "a//sh", "curl"},
+      {Kind::CHANGE_PROFILE, "a//h", "c"},
+    }));
+  }
+
+  TEST(TransitionGraphCheck, reachability)
+  {
+    AppArmor::TransitionGraph graph(parse_text(POLICY));
+
+    EXPECT_EQ(graph.getReachableFrom("a"), (Names{"a//h", "a//sh", "b", "c", "curl", "unconfined"}));
+    EXPECT_EQ(graph.getReachableFrom("c"), Names{});
+    EXPECT_EQ(graph.getReaching(AppArmor::TransitionGraph::UNCONFINED), (Names{"a", "b", "d"}));
+
+    EXPECT_TRUE(graph.canReach("a//h", "c"));
+    EXPECT_FALSE(graph.canReach("c", "a"));
+    EXPECT_FALSE(graph.canReach("missing", "a"));
+  }
+
+  // A rule leads to a profile when some executable is matched by both globs, not only when
+  // the rule covers the whole attachment
+  TEST(TransitionGraphCheck, overlapping_attachments)
+  {
+    AppArmor::TransitionGraph graph(parse_text(
+      "profile a {\n"
+      "  /usr/bin/* Px,\n"
+      "}\n"
+      "profile b {\n"
+      "  /usr/bin/tool* Px,\n"
+      "}\n"
+      "profile tools /usr/{bin,sbin}/** {\n"
+      "}\n"
+      "profile other /opt/** {\n"
+      "}\n"));
+
+    EXPECT_EQ(graph.getReachableFrom("a"), Names{"tools"});
+    EXPECT_EQ(graph.getReachableFrom("b"), Names{"tools"});
+  }
+
+  TEST(TransitionGraphCheck, abstractions)
+  {
+    auto abstraction = parse_text("profile browsers { /usr/bin/firefox Ux, }\n").front();
+    AppArmor::TransitionGraph graph(parse_text("profile a { include <abstractions/browsers> }\n"),
+                                    {{"abstractions/browsers", abstraction}});
+
+    EXPECT_TRUE(graph.canReach("a", AppArmor::TransitionGraph::UNCONFINED));
+  }
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <list>
+#include <string>
+#include <unordered_set>
+
+#include "apparmor_parser.hh"
+#include "test_helpers.hh"
+
+namespace VisitorCheck {
+  // Records the events it receives, so they can be compared with the ParseTree
+  class RecordingVisitor : public AppArmor::Visitor {
+    public:
+      void onProfileBegin(const std::string &name, uint64_t /*startPos*/) override
+      {
+        if(depth == 0) {
+          profiles.push_back(name);
+        }
+        depth++;
+      }
+
+      void onProfileEnd(const std::string &/*name*/, uint64_t /*stopPos*/) override
+      {
+        depth--;
+      }
+
+      // Rules of subprofiles are not part of the top-level profile in the tree
+      void onFileRule(const std::string &filename, const std::string &filemode,
+                      const AppArmor::RulePrefix &prefix, uint64_t startPos, uint64_t stopPos) override
+      {
+        EXPECT_LE(startPos, stopPos);
+        if(depth == 1) {
+          files.push_back(filename + " " + filemode);
+        }
+        prefixed.push_back(prefix_text(prefix) + filename + " " + filemode);
+      }
+
+      void onLinkRule(const std::string &from, const std::string &to,
+                      const AppArmor::RulePrefix &prefix, uint64_t startPos, uint64_t stopPos) override
+      {
+        EXPECT_LE(startPos, stopPos);
+        prefixed.push_back(prefix_text(prefix) + "link " + from + " -> " + to);
+      }
+
+      void onInclude(const std::string &path, bool /*isIfExists*/, uint64_t /*startPos*/, uint64_t /*stopPos*/) override
+      {
+        includes.insert(path);
+      }
+
+      static std::string prefix_text(const AppArmor::RulePrefix &prefix)
+      {
+        return std::string(prefix.audit? "audit " : "") + (prefix.deny? "deny " : "") + (prefix.owner? "owner " : "");
+      }
+
+      int depth = 0;
+      std::list<std::string> profiles;
+      std::list<std::string> files;
+      std::list<std::string> prefixed;
+      std::unordered_set<std::string> includes;
+  };
+
+  void check_stream_matches_tree(const std::string &filename)
+  {
+    RecordingVisitor visitor;
+    AppArmor::Parser::stream(filename, visitor);
+
+    AppArmor::Parser parser(filename);
+    auto profile_list = parser.getProfileList();
+
+    ASSERT_EQ(visitor.profiles.size(), profile_list.size());
+    EXPECT_EQ(visitor.depth, 0) << "Every onProfileBegin should be matched by an onProfileEnd";
+
+    std::list<std::string> expected_files;
+    for(auto &profile : profile_list) {
+      for(auto &rule : profile.getFileRules()) {
+        expected_files.push_back(rule.getFilename() + " " + rule.getFilemode());
+      }
+    }
+
+    EXPECT_EQ(visitor.files, expected_files);
+  }
+
+  TEST(VisitorCheck, file_ok_1)
+  {
+    check_stream_matches_tree(PROFILE_SOURCE_DIR "/file/ok_1.sd");
+  }
+
+  TEST(VisitorCheck, file_ok_2)
+  {
+    check_stream_matches_tree(PROFILE_SOURCE_DIR "/file/ok_2.sd");
+  }
+
+  TEST(VisitorCheck, bare_include_tests_ok_1)
+  {
+    RecordingVisitor visitor;
+    AppArmor::Parser::stream(PROFILE_SOURCE_DIR "/bare_include_tests/ok_1.sd", visitor);
+
+    std::unordered_set<std::string> expected_includes{
+      "includes/base",
+      "include_tests/includes_okay_helper.include"
+    };
+
+    EXPECT_EQ(visitor.includes, expected_includes);
+  }
+
+  TEST(VisitorCheck, nested_profiles_match_tree)
+  {
+    TestHelpers::TempFile file(
+      "profile a {\n"
+      "  /etc/a r,\n"
+      "  profile child {\n"
+      "    /etc/child r,\n"
+      "    ^hat { /etc/hat r, }\n"
+      "  }\n"
+      "  /etc/a2 w,\n"
+      "}\n"
+      "profile b { /etc/b r, }\n");
+
+    check_stream_matches_tree(file.path());
+
+    RecordingVisitor visitor;
+    AppArmor::Parser::stream(file.path(), visitor);
+    EXPECT_EQ(visitor.profiles, (std::list<std::string>{"a", "b"}));
+  }
+
+  TEST(VisitorCheck, rules_carry_prefix_of_enclosing_blocks)
+  {
+    TestHelpers::TempFile file(
+      "profile a {\n"
+      "  /etc/a r,\n"
+      "  owner /etc/owned r,\n"
+      "  audit {\n"
+      "    /etc/audited r,\n"
+      "    deny {\n"
+      "      owner /etc/all w,\n"
+      "      link /etc/l -> /etc/a,\n"
+      "    }\n"
+      "    profile child { /etc/child r, }\n"
+      "  }\n"
+      "  /etc/after r,\n"
+      "}\n");
+
+    RecordingVisitor visitor;
+    AppArmor::Parser::stream(file.path(), visitor);
+
+    std::list<std::string> expected{
+      "/etc/a r",
+      "owner /etc/owned r",
+      "audit /etc/audited r",
+      "audit deny owner /etc/all w",
+      "audit deny link /etc/l -> /etc/a",
+      "/etc/child r",
+      "/etc/after r"
+    };
+    EXPECT_EQ(visitor.prefixed, expected);
+  }
+}
@@ -1,4 +1,6 @@
 #include <fstream>
+#include <iostream>
+#include <stdexcept>
 #include <stdlib.h>
 
 #include "apparmor_parser.hh"
@@ -6,9 +8,15 @@
 int main(int argc, char** argv) {
 	if(argc == 2) {
 		std::string path = argv[1];
-		AppArmor::Parser parser(path);
+		try {
+			AppArmor::Parser parser(path);
+		}
+		catch(const std::exception &e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
 		return 0;
 	}
 
 	return 1;
-}
\ No newline at end of file
+}